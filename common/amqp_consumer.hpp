@@ -0,0 +1,193 @@
+#pragma once
+#include <amqp.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/time.h>
+#include <vector>
+
+// Consuming side of a rabbitmq-c connection, shared by the PPO and OMS services.
+//
+// Every queue is consumed on its own channel with its own basic.qos prefetch, so a backlog on
+// one queue never holds deliveries of another behind it. Manual acks are batched: handled
+// deliveries are acknowledged with one multiple-ack once ack_batch of them have piled up or
+// ack_interval has passed, and always before the consumer blocks on the socket, so the prefetch
+// window can never stall. Handlers see the body in the connection's frame buffer; nothing is
+// copied, and the views are valid only during the call.
+namespace amqp_consumer {
+
+struct Delivery {
+    std::string_view body;
+    std::string_view routing_key;
+    amqp_channel_t channel = 0;
+    uint64_t delivery_tag = 0;
+};
+
+enum class Outcome { Ack, Requeue };
+
+struct Options {
+    uint16_t prefetch = 256;  // Unacked deliveries the broker may have in flight per channel
+    uint32_t ack_batch = 64;  // Deliveries acknowledged by one multiple-ack
+    std::chrono::milliseconds ack_interval{20};  // Longest an ack is held back
+};
+
+// Options from <prefix>_PREFETCH, <prefix>_ACK_BATCH and <prefix>_ACK_INTERVAL_MS, the defaults
+// above where unset
+inline Options optionsFromEnv(const std::string& prefix) {
+    Options options;
+    auto env = [&prefix](const char* name) { return std::getenv((prefix + name).c_str()); };
+    if (const char* value = env("_PREFETCH")) {
+        options.prefetch = static_cast<uint16_t>(std::stoul(value));
+    }
+    if (const char* value = env("_ACK_BATCH")) {
+        options.ack_batch = static_cast<uint32_t>(std::stoul(value));
+    }
+    if (const char* value = env("_ACK_INTERVAL_MS")) {
+        options.ack_interval = std::chrono::milliseconds(std::stoul(value));
+    }
+    return options;
+}
+
+class Consumer {
+public:
+    Consumer(amqp_connection_state_t conn, Options options) : conn_(conn), options_(options) {
+        if (options_.prefetch > 0 && options_.ack_batch > options_.prefetch) {
+            options_.ack_batch = options_.prefetch;
+        }
+        if (options_.ack_batch == 0) {
+            options_.ack_batch = 1;
+        }
+    }
+
+    Consumer(const Consumer&) = delete;
+    Consumer& operator=(const Consumer&) = delete;
+
+    // Consume queue on channel, opening the channel first unless the caller already has
+    void subscribe(amqp_channel_t channel, const std::string& queue, bool open_channel = true) {
+        if (open_channel) {
+            amqp_channel_open(conn_, channel);
+            if (amqp_get_rpc_reply(conn_).reply_type != AMQP_RESPONSE_NORMAL) {
+                throw std::runtime_error("Opening channel " + std::to_string(channel) + " failed");
+            }
+        }
+        if (options_.prefetch > 0) {
+            amqp_basic_qos(conn_, channel, 0, options_.prefetch, 0);
+            if (amqp_get_rpc_reply(conn_).reply_type != AMQP_RESPONSE_NORMAL) {
+                throw std::runtime_error("Setting the prefetch of " + queue + " failed");
+            }
+        }
+        amqp_basic_consume(conn_, channel, amqp_cstring_bytes(queue.c_str()), amqp_empty_bytes, 0, 0, 0,
+                           amqp_empty_table);
+        if (amqp_get_rpc_reply(conn_).reply_type != AMQP_RESPONSE_NORMAL) {
+            throw std::runtime_error("Consuming " + queue + " failed");
+        }
+        subscriptions_.push_back(Subscription{channel});
+    }
+
+    // Hand the next delivery to handler, an Outcome(const Delivery&), waiting up to timeout
+    // for one; false when none arrived
+    template <typename Handler>
+    bool poll(Handler&& handler, std::chrono::microseconds timeout) {
+        if (!backlogged()) {
+            flushAcks();  // About to wait, so nothing may be held back
+        }
+        amqp_maybe_release_buffers(conn_);
+
+        struct timeval tv;
+        tv.tv_sec = static_cast<time_t>(timeout.count() / 1000000);
+        tv.tv_usec = static_cast<suseconds_t>(timeout.count() % 1000000);
+        amqp_envelope_t envelope;
+        const auto result = amqp_consume_message(conn_, &envelope, &tv, 0);
+        if (result.reply_type != AMQP_RESPONSE_NORMAL) {
+            flushDueAcks();
+            return false;
+        }
+
+        // Released on every path; the handler's views point into it
+        struct EnvelopeGuard {
+            amqp_envelope_t* envelope;
+            ~EnvelopeGuard() { amqp_destroy_envelope(envelope); }
+        } guard{&envelope};
+
+        Delivery delivery;
+        delivery.body = std::string_view(static_cast<const char*>(envelope.message.body.bytes),
+                                         envelope.message.body.len);
+        delivery.routing_key = std::string_view(static_cast<const char*>(envelope.routing_key.bytes),
+                                                envelope.routing_key.len);
+        delivery.channel = envelope.channel;
+        delivery.delivery_tag = envelope.delivery_tag;
+
+        settle(delivery.channel, delivery.delivery_tag, handler(static_cast<const Delivery&>(delivery)));
+        return true;
+    }
+
+    // Another delivery has already been read from the socket: the consumer is behind
+    bool backlogged() const { return amqp_data_in_buffer(conn_) || amqp_frames_enqueued(conn_); }
+
+    void flushAcks() {
+        for (auto& subscription : subscriptions_) {
+            flush(subscription);
+        }
+    }
+
+private:
+    struct Subscription {
+        amqp_channel_t channel;
+        uint32_t pending = 0;   // Handled but not yet acknowledged
+        uint64_t last_tag = 0;  // Newest of them; a multiple-ack covers the rest
+        std::chrono::steady_clock::time_point oldest_pending{};
+    };
+
+    Subscription* find(amqp_channel_t channel) {
+        for (auto& subscription : subscriptions_) {
+            if (subscription.channel == channel) return &subscription;
+        }
+        return nullptr;
+    }
+
+    void settle(amqp_channel_t channel, uint64_t delivery_tag, Outcome outcome) {
+        Subscription* subscription = find(channel);
+        if (!subscription) return;
+
+        if (outcome == Outcome::Requeue) {
+            // Earlier deliveries are acked first so the multiple-ack never covers this one
+            flush(*subscription);
+            amqp_basic_reject(conn_, channel, delivery_tag, 1);
+            return;
+        }
+
+        if (subscription->pending == 0) {
+            subscription->oldest_pending = std::chrono::steady_clock::now();
+        }
+        subscription->pending++;
+        subscription->last_tag = delivery_tag;
+        if (subscription->pending >= options_.ack_batch ||
+            std::chrono::steady_clock::now() - subscription->oldest_pending >= options_.ack_interval) {
+            flush(*subscription);
+        }
+    }
+
+    void flushDueAcks() {
+        const auto now = std::chrono::steady_clock::now();
+        for (auto& subscription : subscriptions_) {
+            if (subscription.pending > 0 && now - subscription.oldest_pending >= options_.ack_interval) {
+                flush(subscription);
+            }
+        }
+    }
+
+    void flush(Subscription& subscription) {
+        if (subscription.pending == 0) return;
+        amqp_basic_ack(conn_, subscription.channel, subscription.last_tag, subscription.pending > 1);
+        subscription.pending = 0;
+    }
+
+    amqp_connection_state_t conn_;
+    Options options_;
+    std::vector<Subscription> subscriptions_;
+};
+
+} // namespace amqp_consumer
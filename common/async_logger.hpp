@@ -0,0 +1,520 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "spsc_queue.hpp"
+
+// Asynchronous logging for the trading threads.
+//
+// A log call captures its level, wall time, format string and arguments (numbers by value,
+// text copied) into a slot of the calling thread's own SPSC ring; a background writer formats
+// and writes the records and flushes once per batch. Nothing on the calling thread formats,
+// locks, flushes or allocates, and a full ring drops the record instead of blocking (the writer
+// reports how many). The ring of an exited thread is reused by the next thread once drained.
+//
+//   LOG_INFO("Received action: Price={} Volume={:.4f}", price, volume);
+//   LOG_DEBUG_STREAM << "Order " << id << " details:\n" << ...;  // Formats on the caller
+//   LOG_SAMPLED(100, Debug, "Raw message: {}", text);             // 1 in 100 calls
+//   LOG_RATE_LIMITED(1000, Warn, "Queue full");                   // At most once per second
+//
+// Placeholders are {} and {:.Nf} (fixed with N decimals). Levels below RTDPPO_LOG_MIN_LEVEL
+// (0 debug, 1 info, 2 warn, 3 error) are compiled out; LOG_LEVEL (debug, info, warn, error)
+// sets the runtime level, info by default. Warnings and errors go to stderr, the rest to
+// stdout, one line per record:
+//   2026-01-01 12:00:00.123456 INFO  [oms] Received action: ...
+#ifndef RTDPPO_LOG_MIN_LEVEL
+#define RTDPPO_LOG_MIN_LEVEL 0
+#endif
+
+namespace logging {
+
+enum class Level : uint8_t { Debug = 0, Info = 1, Warn = 2, Error = 3 };
+
+constexpr int MIN_LEVEL = RTDPPO_LOG_MIN_LEVEL;
+
+constexpr bool compiledIn(Level level) { return static_cast<int>(level) >= MIN_LEVEL; }
+
+namespace detail {
+
+// One log call; text that does not fit is truncated, except stream records, which continue
+// in the following slots of the same ring
+struct Record {
+    static constexpr size_t PAYLOAD_SIZE = 960;
+    using Formatter = void (*)(std::string& out, const char* format, const unsigned char* payload, size_t size);
+
+    uint64_t wall_ns = 0;
+    const char* format = nullptr;
+    Formatter formatter = nullptr;
+    Level level = Level::Info;
+    bool continued = false;  // The next record of this ring continues this line
+    uint16_t size = 0;
+    unsigned char payload[PAYLOAD_SIZE];
+};
+
+constexpr size_t RING_CAPACITY = 256;
+
+struct ThreadRing {
+    SpscQueue<Record, RING_CAPACITY> queue;
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> retired{false};  // Its thread exited; recycled once the writer drained it
+    char name[16] = {};
+    std::string partial;  // Writer only: a continued line being assembled
+};
+
+// ---- Argument encoding: a byte stream read back in the same order by the formatter
+
+template <typename T>
+constexpr bool IS_TEXT = std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view> ||
+                         std::is_same_v<T, const char*> || std::is_same_v<T, char*>;
+
+template <typename T>
+using Stored = std::conditional_t<IS_TEXT<std::decay_t<T>>, std::string_view, std::decay_t<T>>;
+
+inline bool encodeText(unsigned char*& out, unsigned char* end, std::string_view text) {
+    if (end - out < 2) return false;
+    const size_t length = std::min<size_t>(text.size(), static_cast<size_t>(end - out) - 2);
+    const uint16_t stored = static_cast<uint16_t>(length);
+    std::memcpy(out, &stored, sizeof(stored));
+    std::memcpy(out + 2, text.data(), length);
+    out += 2 + length;
+    return length == text.size();
+}
+
+template <typename T>
+bool encodeArg(unsigned char*& out, unsigned char* end, const T& value) {
+    using S = Stored<T>;
+    if constexpr (std::is_same_v<std::decay_t<T>, std::string>) {
+        return encodeText(out, end, value);
+    } else if constexpr (std::is_same_v<S, std::string_view>) {
+        if constexpr (std::is_same_v<std::decay_t<T>, std::string_view>) {
+            return encodeText(out, end, value);
+        } else {
+            const char* text = value;
+            return encodeText(out, end, text ? std::string_view(text) : std::string_view("(null)"));
+        }
+    } else {
+        static_assert(std::is_arithmetic_v<S> || std::is_enum_v<S>, "Log arguments are numbers or text");
+        if (static_cast<size_t>(end - out) < sizeof(S)) return false;
+        std::memcpy(out, &value, sizeof(S));
+        out += sizeof(S);
+        return true;
+    }
+}
+
+// Copies the format text up to the next placeholder; returns its decimals (-1 for {}) or
+// -2 at the end of the format
+inline int nextPlaceholder(std::string& out, const char*& format) {
+    while (*format) {
+        if (format[0] == '{' && format[1] == '}') {
+            format += 2;
+            return -1;
+        }
+        if (format[0] == '{' && format[1] == ':' && format[2] == '.') {
+            const char* p = format + 3;
+            int decimals = 0;
+            while (*p >= '0' && *p <= '9') decimals = decimals * 10 + (*p++ - '0');
+            if (p[0] == 'f' && p[1] == '}') {
+                format = p + 2;
+                return decimals;
+            }
+        }
+        out.push_back(*format++);
+    }
+    return -2;
+}
+
+template <typename S>
+void appendArg(std::string& out, int decimals, const unsigned char*& in, const unsigned char* end) {
+    char buffer[64];
+    if constexpr (std::is_same_v<S, std::string_view>) {
+        if (end - in < 2) return;
+        uint16_t length;
+        std::memcpy(&length, in, sizeof(length));
+        length = static_cast<uint16_t>(std::min<size_t>(length, static_cast<size_t>(end - in) - 2));
+        out.append(reinterpret_cast<const char*>(in + 2), length);
+        in += 2 + length;
+    } else {
+        if (static_cast<size_t>(end - in) < sizeof(S)) return;
+        S value;
+        std::memcpy(&value, in, sizeof(S));
+        in += sizeof(S);
+        if constexpr (std::is_same_v<S, bool>) {
+            out.append(value ? "true" : "false");
+        } else if constexpr (std::is_same_v<S, char>) {
+            out.push_back(value);
+        } else if constexpr (std::is_floating_point_v<S>) {
+            const int n = decimals >= 0 ? std::snprintf(buffer, sizeof(buffer), "%.*f", decimals, static_cast<double>(value))
+                                        : std::snprintf(buffer, sizeof(buffer), "%g", static_cast<double>(value));
+            out.append(buffer, static_cast<size_t>(std::max(n, 0)));
+        } else if constexpr (std::is_enum_v<S>) {
+            auto result = std::to_chars(buffer, buffer + sizeof(buffer), static_cast<std::underlying_type_t<S>>(value));
+            out.append(buffer, result.ptr);
+        } else {
+            auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+            out.append(buffer, result.ptr);
+        }
+    }
+}
+
+template <typename... S>
+void formatRecord(std::string& out, const char* format, const unsigned char* payload, size_t size) {
+    const unsigned char* in = payload;
+    const unsigned char* end = payload + size;
+    auto one = [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        const int decimals = nextPlaceholder(out, format);
+        if (decimals == -2) return;
+        appendArg<T>(out, decimals, in, end);
+    };
+    (void)one;  // Unused without arguments
+    (one(std::common_type<S>{}), ...);
+    nextPlaceholder(out, format);  // Text after the last placeholder
+}
+
+inline uint64_t wallNanos() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+inline uint64_t steadyNanos() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// ---- Writer
+
+class Logger {
+public:
+    static constexpr auto IDLE_SLEEP = std::chrono::milliseconds(2);
+
+    // Never destroyed: threads may still log while the process exits; the atexit hook
+    // writes out what is queued by then
+    static Logger& instance() {
+        static Logger* logger = new Logger();
+        return *logger;
+    }
+
+    bool enabled(Level level) const { return static_cast<int>(level) >= level_.load(std::memory_order_relaxed); }
+    void setLevel(Level level) { level_.store(static_cast<int>(level), std::memory_order_relaxed); }
+
+    // The calling thread's ring, taken on first use and handed back when the thread exits.
+    // Null in thread_local destructors that run after that; their records are dropped.
+    ThreadRing* ring() {
+        if (!current_ring_ && !ring_released_) {
+            current_ring_ = registerThread();
+            thread_local RingLease lease;
+            (void)lease;
+        }
+        return current_ring_;
+    }
+
+    void setThreadName(std::string_view name) {
+        ThreadRing* current = ring();
+        if (!current) return;
+        std::lock_guard<std::mutex> lock(drain_mutex_);  // The writer reads names while draining
+        const size_t length = std::min(name.size(), sizeof(current->name) - 1);
+        std::memcpy(current->name, name.data(), length);
+        current->name[length] = '\0';
+    }
+
+    // Blocks until the queued records are written
+    void flush() {
+        std::lock_guard<std::mutex> lock(drain_mutex_);
+        drainAll();
+    }
+
+    void stop() {
+        if (running_.exchange(false) && writer_.joinable()) {
+            writer_.join();
+        }
+        flush();
+    }
+
+private:
+    Logger() {
+        if (const char* name = std::getenv("LOG_LEVEL")) {
+            const std::string_view value(name);
+            if (value == "debug") level_ = static_cast<int>(Level::Debug);
+            else if (value == "warn") level_ = static_cast<int>(Level::Warn);
+            else if (value == "error") level_ = static_cast<int>(Level::Error);
+        }
+        running_.store(true);
+        writer_ = std::thread([this] { run(); });
+        std::atexit([] { Logger::instance().stop(); });
+    }
+
+    // Retires the thread's ring when the thread exits
+    struct RingLease {
+        ~RingLease() {
+            current_ring_->retired.store(true, std::memory_order_release);
+            current_ring_ = nullptr;
+            ring_released_ = true;
+        }
+    };
+
+    // A ring of an exited thread if there is one, so short-lived threads do not add rings
+    ThreadRing* registerThread() {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        if (free_rings_.empty()) {
+            free_rings_.push_back(std::make_unique<ThreadRing>());
+        }
+        rings_.push_back(std::move(free_rings_.back()));
+        free_rings_.pop_back();
+        ThreadRing* ring = rings_.back().get();
+        ring->retired.store(false, std::memory_order_relaxed);
+        std::snprintf(ring->name, sizeof(ring->name), "t%zu", registered_++);
+        return ring;
+    }
+
+    // Take drained rings of exited threads off the writer's list, keeping up to MAX_FREE_RINGS
+    // for reuse and releasing the rest; drain_mutex_ held
+    void recycle(const std::vector<ThreadRing*>& drained) {
+        std::vector<std::unique_ptr<ThreadRing>> released;
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        for (ThreadRing* ring : drained) {
+            auto it = std::find_if(rings_.begin(), rings_.end(), [ring](const auto& r) { return r.get() == ring; });
+            (free_rings_.size() < MAX_FREE_RINGS ? free_rings_ : released).push_back(std::move(*it));
+            rings_.erase(it);
+        }
+    }
+
+    void run() {
+        while (running_.load(std::memory_order_acquire)) {
+            size_t written;
+            {
+                std::lock_guard<std::mutex> lock(drain_mutex_);
+                written = drainAll();
+            }
+            if (written == 0) {
+                std::this_thread::sleep_for(IDLE_SLEEP);
+            }
+        }
+    }
+
+    // Drain every ring once; drain_mutex_ held
+    size_t drainAll() {
+        std::vector<ThreadRing*> rings;
+        {
+            std::lock_guard<std::mutex> lock(rings_mutex_);
+            for (auto& ring : rings_) rings.push_back(ring.get());
+        }
+
+        size_t written = 0;
+        std::vector<ThreadRing*> drained;
+        for (ThreadRing* ring : rings) {
+            // Read before draining: once retired, the ring's last record is already committed
+            const bool retired = ring->retired.load(std::memory_order_acquire);
+            while (Record* record = ring->queue.front()) {
+                if (ring->partial.empty()) {
+                    appendHeader(ring->partial, *record, ring->name);
+                }
+                record->formatter(ring->partial, record->format, record->payload, record->size);
+                const bool continued = record->continued;
+                const Level level = record->level;
+                ring->queue.pop();
+                if (continued) continue;
+
+                ring->partial.push_back('\n');
+                (level >= Level::Warn ? err_ : out_).append(ring->partial);
+                ring->partial.clear();
+                ++written;
+            }
+            if (const uint64_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed)) {
+                err_.append("[logger] dropped " + std::to_string(dropped) + " records of thread " + ring->name + "\n");
+            }
+            if (retired && ring->partial.empty()) {
+                drained.push_back(ring);
+            }
+        }
+        if (!drained.empty()) {
+            recycle(drained);
+        }
+
+        if (!out_.empty()) {
+            std::fwrite(out_.data(), 1, out_.size(), stdout);
+            std::fflush(stdout);
+            out_.clear();
+        }
+        if (!err_.empty()) {
+            std::fwrite(err_.data(), 1, err_.size(), stderr);
+            std::fflush(stderr);
+            err_.clear();
+        }
+        return written;
+    }
+
+    void appendHeader(std::string& out, const Record& record, const char* thread_name) {
+        // Seconds are formatted once per second
+        const time_t seconds = static_cast<time_t>(record.wall_ns / 1000000000ULL);
+        if (seconds != cached_second_) {
+            std::tm local{};
+            localtime_r(&seconds, &local);
+            cached_length_ = std::strftime(cached_time_, sizeof(cached_time_), "%Y-%m-%d %H:%M:%S", &local);
+            cached_second_ = seconds;
+        }
+        char buffer[96];
+        static constexpr const char* NAMES[] = {"DEBUG", "INFO ", "WARN ", "ERROR"};
+        const int n = std::snprintf(buffer, sizeof(buffer), "%.*s.%06u %s [%s] ", static_cast<int>(cached_length_),
+                                    cached_time_, static_cast<unsigned>(record.wall_ns / 1000 % 1000000),
+                                    NAMES[static_cast<int>(record.level)], thread_name);
+        out.append(buffer, static_cast<size_t>(std::max(n, 0)));
+    }
+
+    std::atomic<int> level_{static_cast<int>(Level::Info)};
+    std::atomic<bool> running_{false};
+    std::thread writer_;
+
+    static constexpr size_t MAX_FREE_RINGS = 8;
+
+    std::mutex rings_mutex_;  // Registration and recycling
+    std::vector<std::unique_ptr<ThreadRing>> rings_;       // Drained by the writer
+    std::vector<std::unique_ptr<ThreadRing>> free_rings_;  // Of exited threads, drained
+    size_t registered_ = 0;
+    static inline thread_local ThreadRing* current_ring_ = nullptr;
+    static inline thread_local bool ring_released_ = false;
+
+    std::mutex drain_mutex_;  // One consumer at a time: the writer or flush()
+    std::string out_;
+    std::string err_;
+    time_t cached_second_ = -1;
+    char cached_time_[32] = {};
+    size_t cached_length_ = 0;
+};
+
+template <typename... Args>
+void write(Level level, const char* format, const Args&... args) {
+    ThreadRing* ring = Logger::instance().ring();
+    if (!ring) return;
+    Record* record = ring->queue.tryAcquire();
+    if (!record) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    record->wall_ns = wallNanos();
+    record->level = level;
+    record->format = format;
+    record->formatter = &formatRecord<Stored<Args>...>;
+    record->continued = false;
+    unsigned char* out = record->payload;
+    (encodeArg(out, record->payload + Record::PAYLOAD_SIZE, args), ...);
+    record->size = static_cast<uint16_t>(out - record->payload);
+    ring->queue.commit();
+}
+
+// Text formatted by the caller, split over as many records as it needs. The line is dropped
+// whole when the ring cannot take every chunk, so a continued record is always completed.
+inline void writeText(Level level, std::string_view text) {
+    ThreadRing* ring = Logger::instance().ring();
+    if (!ring) return;
+    constexpr size_t CHUNK = Record::PAYLOAD_SIZE - 2;
+    const size_t chunks = std::max<size_t>(1, (text.size() + CHUNK - 1) / CHUNK);
+    if (chunks > RING_CAPACITY - ring->queue.size()) {  // size() only overstates for the producer
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    const uint64_t wall_ns = wallNanos();
+    do {
+        Record* record = ring->queue.tryAcquire();
+        const std::string_view chunk = text.substr(0, CHUNK);
+        text.remove_prefix(chunk.size());
+        record->wall_ns = wall_ns;
+        record->level = level;
+        record->format = "{}";
+        record->formatter = &formatRecord<std::string_view>;
+        record->continued = !text.empty();
+        unsigned char* out = record->payload;
+        encodeText(out, record->payload + Record::PAYLOAD_SIZE, chunk);
+        record->size = static_cast<uint16_t>(out - record->payload);
+        ring->queue.commit();
+    } while (!text.empty());
+}
+
+// Collects one streamed line on the calling thread and queues it when destroyed
+class StreamRecord {
+public:
+    explicit StreamRecord(Level level) : level_(level) {
+        stream().str(std::string());
+        stream().clear();
+        stream().copyfmt(defaultFormat());
+    }
+    ~StreamRecord() { writeText(level_, stream().str()); }
+
+    std::ostringstream& stream() {
+        thread_local std::ostringstream stream;
+        return stream;
+    }
+
+private:
+    static const std::ios& defaultFormat() {
+        thread_local std::ostringstream pristine;
+        return pristine;
+    }
+
+    Level level_;
+};
+
+} // namespace detail
+
+inline bool enabled(Level level) { return compiledIn(level) && detail::Logger::instance().enabled(level); }
+inline void setLevel(Level level) { detail::Logger::instance().setLevel(level); }
+inline void setThreadName(std::string_view name) { detail::Logger::instance().setThreadName(name); }
+inline void flush() { detail::Logger::instance().flush(); }
+
+} // namespace logging
+
+#define LOG_AT(level, ...)                                                                  \
+    do {                                                                                    \
+        if constexpr (::logging::compiledIn(::logging::Level::level)) {                     \
+            if (::logging::detail::Logger::instance().enabled(::logging::Level::level)) {   \
+                ::logging::detail::write(::logging::Level::level, __VA_ARGS__);             \
+            }                                                                               \
+        }                                                                                   \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(Debug, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(Info, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(Warn, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(Error, __VA_ARGS__)
+
+// Every n-th call of this call site, per thread
+#define LOG_SAMPLED(n, level, ...)                                                          \
+    do {                                                                                    \
+        static thread_local uint64_t log_sample_count_ = 0;                                 \
+        if (log_sample_count_++ % (n) == 0) LOG_AT(level, __VA_ARGS__);                     \
+    } while (0)
+
+// At most once per interval_ms for this call site, per thread
+#define LOG_RATE_LIMITED(interval_ms, level, ...)                                           \
+    do {                                                                                    \
+        static thread_local uint64_t log_next_ns_ = 0;                                      \
+        const uint64_t log_now_ns_ = ::logging::detail::steadyNanos();                      \
+        if (log_now_ns_ >= log_next_ns_) {                                                  \
+            log_next_ns_ = log_now_ns_ + static_cast<uint64_t>(interval_ms) * 1000000ULL;   \
+            LOG_AT(level, __VA_ARGS__);                                                     \
+        }                                                                                   \
+    } while (0)
+
+// Streamed line formatted on the calling thread; nothing is evaluated when the level is off
+#define LOG_STREAM_AT(level)                                                                \
+    if (!::logging::enabled(::logging::Level::level)) {                                     \
+    } else                                                                                  \
+        ::logging::detail::StreamRecord(::logging::Level::level).stream()
+
+#define LOG_DEBUG_STREAM LOG_STREAM_AT(Debug)
+#define LOG_INFO_STREAM LOG_STREAM_AT(Info)
+#define LOG_WARN_STREAM LOG_STREAM_AT(Warn)
+#define LOG_ERROR_STREAM LOG_STREAM_AT(Error)
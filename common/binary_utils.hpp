@@ -1,10 +1,25 @@
 #pragma once
 #include <cstdint>
+#include <cstddef>
+#include <cstdlib>
 #include <limits>
 #include <cmath>
 #include <cstring>
 #include <stdexcept>
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define BINARY_UTILS_X86_SIMD 1
+#endif
+
+// Batch loops stay out of line so the scalar and AVX2 tails are never inlined
+// into (and FMA-contracted by) an AVX-512 caller
+#if defined(__GNUC__) || defined(__clang__)
+#define BINARY_UTILS_NOINLINE __attribute__((noinline))
+#else
+#define BINARY_UTILS_NOINLINE
+#endif
+
 namespace binary_utils {
 
 // Precomputed constants for faster encoding/decoding
@@ -30,6 +45,15 @@ inline bool isZero(double value) {
     return std::abs(value) < ZERO_THRESHOLD;
 }
 
+// Truncating double -> uint64 conversion that is defined for every input.
+// Values >= 2^64 and NaN convert to 0, which is what the plain cast produced on x86-64.
+inline uint64_t truncToUint64(double value) {
+    constexpr double TWO_POW_63 = 9223372036854775808.0;
+    if (value < TWO_POW_63) return value > -1.0 ? static_cast<uint64_t>(value) : 0;
+    if (value < 2.0 * TWO_POW_63) return static_cast<uint64_t>(value - TWO_POW_63) | (1ULL << 63);
+    return 0;
+}
+
 // For price changes, VWAP changes, imbalance changes, etc.
 // Format: 1 bit sign, 63 bits fraction
 inline uint64_t encodeChangeValue(double value) {
@@ -37,7 +61,7 @@ inline uint64_t encodeChangeValue(double value) {
 
     const uint64_t sign = value < 0 ? 1ULL : 0ULL;
     const double absValue = std::abs(value);
-    const uint64_t fraction = static_cast<uint64_t>(absValue * PRICE_FRAC_SCALE);
+    const uint64_t fraction = truncToUint64(absValue * PRICE_FRAC_SCALE);  // Magnitudes >= 2 keep only the sign
     
     return (sign << 63) | (fraction & PRICE_FRAC_MASK);
 }
@@ -64,8 +88,8 @@ inline uint64_t encodeOrderBookValue(double value) {
     const double fracPart = std::modf(absValue, &wholePart);
     
     // Ensure whole part fits in 10 bits (0-1023)
-    const uint64_t wholeInt = static_cast<uint64_t>(std::min(wholePart, 1023.0));
-    const uint64_t fractionInt = static_cast<uint64_t>(fracPart * ORDERBOOK_FRAC_SCALE);
+    const uint64_t wholeInt = truncToUint64(std::min(wholePart, 1023.0));
+    const uint64_t fractionInt = truncToUint64(fracPart * ORDERBOOK_FRAC_SCALE);
     
     return (sign << 63) | ((wholeInt & ((1ULL << 10) - 1)) << 53) | (fractionInt & ORDERBOOK_FRAC_MASK);
 }
@@ -155,9 +179,419 @@ inline void decodeOmsActionV2(const char* __restrict buffer, uint8_t& __restrict
     state_id = *reinterpret_cast<const uint16_t*>(buffer + 21);
 }
 
+// Sizes of the OMS action messages
+constexpr size_t OMS_ACTION_V2_SIZE = 23;
+constexpr size_t OMS_ACTION_V3_SIZE = 31;
+
+// For OMS action messages carrying the origin of the orderbook state they answer
+// Format: the V2 message + 8 bytes origin (latency::nowNanos() of the websocket frame, 0 if unknown)
+inline void encodeOmsActionV3(char* __restrict buffer, uint8_t action_type, double price, double volume,
+                              double mid_price, uint16_t state_id, uint64_t origin_ns) {
+    encodeOmsActionV2(buffer, action_type, price, volume, mid_price, state_id);
+    std::memcpy(buffer + OMS_ACTION_V2_SIZE, &origin_ns, sizeof(origin_ns));
+}
+
+inline void decodeOmsActionV3(const char* __restrict buffer, uint8_t& __restrict action_type,
+                              double& __restrict price, double& __restrict volume,
+                              double& __restrict mid_price, uint16_t& __restrict state_id,
+                              uint64_t& __restrict origin_ns) {
+    decodeOmsActionV2(buffer, action_type, price, volume, mid_price, state_id);
+    std::memcpy(&origin_ns, buffer + OMS_ACTION_V2_SIZE, sizeof(origin_ns));
+}
+
 // Decode state ID from message
 inline uint16_t decodeStateId(const char* data) {
     return *reinterpret_cast<const uint16_t*>(data);
 }
 
+// ---------------------------------------------------------------------------
+// Batch codecs for whole orderbook messages.
+//
+// Levels are interleaved [price, volume, orders] doubles (the layout of
+// OrderBookLevel and of OrderBookState::bids/asks); prices use the change
+// value format, volumes and order counts the orderbook value format.
+// The vector paths are bit-identical to the scalar functions above (checked by
+// okx-orderbook/tests/binary_utils_test.cpp) and the widest one the CPU supports
+// is chosen once at runtime (AVX-512, AVX2 or scalar).
+// ---------------------------------------------------------------------------
+
+namespace detail {
+
+inline void storeWord(char* out, uint64_t word) { std::memcpy(out, &word, sizeof(word)); }
+
+inline uint64_t loadWord(const char* in) {
+    uint64_t word;
+    std::memcpy(&word, in, sizeof(word));
+    return word;
+}
+
+BINARY_UTILS_NOINLINE inline void encodeLevelsScalar(const double* levels, size_t num_levels, char* out) {
+    for (size_t i = 0; i < num_levels; ++i, levels += 3, out += 3 * sizeof(uint64_t)) {
+        storeWord(out, encodeChangeValue(levels[0]));
+        storeWord(out + 8, encodeOrderBookValue(levels[1]));
+        storeWord(out + 16, encodeOrderBookValue(levels[2]));
+    }
+}
+
+BINARY_UTILS_NOINLINE inline void decodeLevelsScalar(const char* in, size_t num_levels, double* levels) {
+    for (size_t i = 0; i < num_levels; ++i, levels += 3, in += 3 * sizeof(uint64_t)) {
+        levels[0] = decodeChangeValue(loadWord(in));
+        levels[1] = decodeOrderBookValue(loadWord(in + 8));
+        levels[2] = decodeOrderBookValue(loadWord(in + 16));
+    }
+}
+
+BINARY_UTILS_NOINLINE inline void encodeChangeValuesScalar(const double* values, size_t count, char* out) {
+    for (size_t i = 0; i < count; ++i) {
+        storeWord(out + i * sizeof(uint64_t), encodeChangeValue(values[i]));
+    }
+}
+
+BINARY_UTILS_NOINLINE inline void decodeChangeValuesScalar(const char* in, size_t count, double* values) {
+    for (size_t i = 0; i < count; ++i) {
+        values[i] = decodeChangeValue(loadWord(in + i * sizeof(uint64_t)));
+    }
+}
+
+#ifdef BINARY_UTILS_X86_SIMD
+
+constexpr uint64_t MANTISSA_MASK = (1ULL << 52) - 1;
+constexpr uint64_t IMPLICIT_BIT = 1ULL << 52;
+constexpr double TWO_POW_52 = 4503599627370496.0;
+constexpr double TWO_POW_84 = 19342813113834066795298816.0;
+constexpr double TWO_POW_MINUS_63 = 1.0 / 9223372036854775808.0;
+
+// ---- AVX2 (4 doubles per vector) ----
+
+#define BINARY_UTILS_AVX2 __attribute__((target("avx2")))
+
+// trunc(x * 2^shift_bias) for finite non-negative x, computed on the IEEE fields
+// so it does not depend on a double->int64 instruction AVX2 lacks
+BINARY_UTILS_AVX2 inline __m256i truncScaledAvx2(__m256d x, int64_t shift_bias) {
+    const __m256i bits = _mm256_castpd_si256(x);
+    const __m256i exponent = _mm256_sub_epi64(_mm256_srli_epi64(bits, 52), _mm256_set1_epi64x(1023));
+    const __m256i mantissa = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x(MANTISSA_MASK)),
+                                             _mm256_set1_epi64x(IMPLICIT_BIT));
+    const __m256i shift = _mm256_add_epi64(exponent, _mm256_set1_epi64x(shift_bias - 52));
+    // Counts >= 64 (including negated ones) shift everything out
+    return _mm256_or_si256(_mm256_sllv_epi64(mantissa, shift),
+                           _mm256_srlv_epi64(mantissa, _mm256_sub_epi64(_mm256_setzero_si256(), shift)));
+}
+
+// Correctly rounded uint64 -> double
+BINARY_UTILS_AVX2 inline __m256d uint64ToDoubleAvx2(__m256i x) {
+    __m256i high = _mm256_srli_epi64(x, 32);
+    high = _mm256_or_si256(high, _mm256_castpd_si256(_mm256_set1_pd(TWO_POW_84)));
+    const __m256i low = _mm256_blend_epi16(x, _mm256_castpd_si256(_mm256_set1_pd(TWO_POW_52)), 0xcc);
+    const __m256d high_d = _mm256_sub_pd(_mm256_castsi256_pd(high), _mm256_set1_pd(TWO_POW_84 + TWO_POW_52));
+    return _mm256_add_pd(high_d, _mm256_castsi256_pd(low));
+}
+
+BINARY_UTILS_AVX2 inline __m256i encodeChangeAvx2(__m256d v) {
+    const __m256d abs_v = _mm256_and_pd(v, _mm256_castsi256_pd(_mm256_set1_epi64x(PRICE_FRAC_MASK)));
+    const __m256i exponent = _mm256_srli_epi64(_mm256_castpd_si256(abs_v), 52);
+
+    // |v| * 2^63 only fits for |v| < 2 (biased exponent <= 1023)
+    const __m256i in_range = _mm256_cmpgt_epi64(_mm256_set1_epi64x(1024), exponent);
+    __m256i fraction = _mm256_and_si256(truncScaledAvx2(abs_v, 63), in_range);
+    fraction = _mm256_and_si256(fraction, _mm256_set1_epi64x(PRICE_FRAC_MASK));
+
+    const __m256i sign = _mm256_and_si256(_mm256_castpd_si256(_mm256_cmp_pd(v, _mm256_setzero_pd(), _CMP_LT_OQ)),
+                                          _mm256_set1_epi64x(PRICE_SIGN_MASK));
+    const __m256i zero = _mm256_castpd_si256(_mm256_cmp_pd(abs_v, _mm256_set1_pd(ZERO_THRESHOLD), _CMP_LT_OQ));
+    return _mm256_andnot_si256(zero, _mm256_or_si256(sign, fraction));
+}
+
+BINARY_UTILS_AVX2 inline __m256i encodeOrderBookAvx2(__m256d v) {
+    const __m256d abs_v = _mm256_and_pd(v, _mm256_castsi256_pd(_mm256_set1_epi64x(PRICE_FRAC_MASK)));
+    const __m256d whole = _mm256_round_pd(abs_v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    const __m256d frac = _mm256_sub_pd(abs_v, whole);  // NaN for infinities, which truncates to 0
+
+    const __m256i whole_int = truncScaledAvx2(_mm256_min_pd(whole, _mm256_set1_pd(1023.0)), 0);
+    const __m256i frac_int = truncScaledAvx2(_mm256_mul_pd(frac, _mm256_set1_pd(ORDERBOOK_FRAC_SCALE)), 0);
+
+    const __m256i sign = _mm256_and_si256(_mm256_castpd_si256(_mm256_cmp_pd(v, _mm256_setzero_pd(), _CMP_LT_OQ)),
+                                          _mm256_set1_epi64x(ORDERBOOK_SIGN_MASK));
+    const __m256i value = _mm256_or_si256(sign, _mm256_or_si256(_mm256_slli_epi64(whole_int, 53),
+                                          _mm256_and_si256(frac_int, _mm256_set1_epi64x(ORDERBOOK_FRAC_MASK))));
+
+    // Zero and NaN inputs encode as 0
+    const __m256i keep = _mm256_castpd_si256(_mm256_cmp_pd(abs_v, _mm256_set1_pd(ZERO_THRESHOLD), _CMP_NLT_UQ));
+    const __m256i is_number = _mm256_castpd_si256(_mm256_cmp_pd(v, v, _CMP_ORD_Q));
+    return _mm256_and_si256(value, _mm256_and_si256(keep, is_number));
+}
+
+BINARY_UTILS_AVX2 inline __m256d decodeChangeAvx2(__m256i encoded) {
+    const __m256d value = _mm256_mul_pd(
+        uint64ToDoubleAvx2(_mm256_and_si256(encoded, _mm256_set1_epi64x(PRICE_FRAC_MASK))),
+        _mm256_set1_pd(TWO_POW_MINUS_63));
+    return _mm256_or_pd(value, _mm256_castsi256_pd(_mm256_and_si256(encoded, _mm256_set1_epi64x(PRICE_SIGN_MASK))));
+}
+
+BINARY_UTILS_AVX2 inline __m256d decodeOrderBookAvx2(__m256i encoded) {
+    // Whole part (< 2^10) via the 2^52 trick, fraction (< 2^53) converts exactly
+    const __m256i whole_bits = _mm256_or_si256(
+        _mm256_and_si256(_mm256_srli_epi64(encoded, 53), _mm256_set1_epi64x(1023)),
+        _mm256_castpd_si256(_mm256_set1_pd(TWO_POW_52)));
+    const __m256d whole = _mm256_sub_pd(_mm256_castsi256_pd(whole_bits), _mm256_set1_pd(TWO_POW_52));
+    const __m256d frac = uint64ToDoubleAvx2(_mm256_and_si256(encoded, _mm256_set1_epi64x(ORDERBOOK_FRAC_MASK)));
+    const __m256d value = _mm256_add_pd(whole, _mm256_mul_pd(frac, _mm256_set1_pd(ORDERBOOK_FRAC_SCALE_INV)));
+    return _mm256_or_pd(value, _mm256_castsi256_pd(_mm256_and_si256(encoded, _mm256_set1_epi64x(ORDERBOOK_SIGN_MASK))));
+}
+
+// Four levels span three vectors; these lane masks pick the price lanes
+BINARY_UTILS_AVX2 inline __m256i priceLanesAvx2(size_t vector_idx) {
+    switch (vector_idx) {
+        case 0: return _mm256_setr_epi64x(-1, 0, 0, -1);
+        case 1: return _mm256_setr_epi64x(0, 0, -1, 0);
+        default: return _mm256_setr_epi64x(0, -1, 0, 0);
+    }
+}
+
+BINARY_UTILS_AVX2 BINARY_UTILS_NOINLINE inline void encodeLevelsAvx2(const double* levels, size_t num_levels, char* out) {
+    const size_t blocks = num_levels / 4;
+    for (size_t b = 0; b < blocks; ++b, levels += 12, out += 12 * sizeof(uint64_t)) {
+        for (size_t k = 0; k < 3; ++k) {
+            const __m256d v = _mm256_loadu_pd(levels + 4 * k);
+            const __m256i encoded = _mm256_blendv_epi8(encodeOrderBookAvx2(v), encodeChangeAvx2(v), priceLanesAvx2(k));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 32 * k), encoded);
+        }
+    }
+    encodeLevelsScalar(levels, num_levels % 4, out);
+}
+
+BINARY_UTILS_AVX2 BINARY_UTILS_NOINLINE inline void decodeLevelsAvx2(const char* in, size_t num_levels, double* levels) {
+    const size_t blocks = num_levels / 4;
+    for (size_t b = 0; b < blocks; ++b, levels += 12, in += 12 * sizeof(uint64_t)) {
+        for (size_t k = 0; k < 3; ++k) {
+            const __m256i encoded = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 32 * k));
+            const __m256d decoded = _mm256_blendv_pd(decodeOrderBookAvx2(encoded), decodeChangeAvx2(encoded),
+                                                     _mm256_castsi256_pd(priceLanesAvx2(k)));
+            _mm256_storeu_pd(levels + 4 * k, decoded);
+        }
+    }
+    decodeLevelsScalar(in, num_levels % 4, levels);
+}
+
+BINARY_UTILS_AVX2 BINARY_UTILS_NOINLINE inline void encodeChangeValuesAvx2(const double* values, size_t count, char* out) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * 8), encodeChangeAvx2(_mm256_loadu_pd(values + i)));
+    }
+    encodeChangeValuesScalar(values + i, count - i, out + i * 8);
+}
+
+BINARY_UTILS_AVX2 BINARY_UTILS_NOINLINE inline void decodeChangeValuesAvx2(const char* in, size_t count, double* values) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm256_storeu_pd(values + i, decodeChangeAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i * 8))));
+    }
+    decodeChangeValuesScalar(in + i * 8, count - i, values + i);
+}
+
+// ---- AVX-512 (8 doubles per vector) ----
+
+// GCC 12 reports the _mm512_undefined_* placeholders inside its own intrinsics
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#define BINARY_UTILS_AVX512 __attribute__((target("avx512f,avx512dq")))
+#define BINARY_UTILS_ROUND (_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)
+
+BINARY_UTILS_AVX512 inline __m512i truncScaledAvx512(__m512d x, int64_t shift_bias) {
+    const __m512i bits = _mm512_castpd_si512(x);
+    const __m512i exponent = _mm512_sub_epi64(_mm512_srli_epi64(bits, 52), _mm512_set1_epi64(1023));
+    const __m512i mantissa = _mm512_or_si512(_mm512_and_si512(bits, _mm512_set1_epi64(MANTISSA_MASK)),
+                                             _mm512_set1_epi64(IMPLICIT_BIT));
+    const __m512i shift = _mm512_add_epi64(exponent, _mm512_set1_epi64(shift_bias - 52));
+    return _mm512_or_si512(_mm512_sllv_epi64(mantissa, shift),
+                           _mm512_srlv_epi64(mantissa, _mm512_sub_epi64(_mm512_setzero_si512(), shift)));
+}
+
+BINARY_UTILS_AVX512 inline __m512i encodeChangeAvx512(__m512d v) {
+    const __m512d abs_v = _mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(v), _mm512_set1_epi64(PRICE_FRAC_MASK)));
+    const __mmask8 in_range = _mm512_cmplt_epu64_mask(_mm512_srli_epi64(_mm512_castpd_si512(abs_v), 52),
+                                                      _mm512_set1_epi64(1024));
+    const __mmask8 negative = _mm512_cmp_pd_mask(v, _mm512_setzero_pd(), _CMP_LT_OQ);
+    const __mmask8 keep = _mm512_cmp_pd_mask(abs_v, _mm512_set1_pd(ZERO_THRESHOLD), _CMP_NLT_UQ);
+
+    const __m512i fraction = _mm512_maskz_and_epi64(in_range, truncScaledAvx512(abs_v, 63), _mm512_set1_epi64(PRICE_FRAC_MASK));
+    const __m512i value = _mm512_mask_or_epi64(fraction, negative, fraction, _mm512_set1_epi64(PRICE_SIGN_MASK));
+    return _mm512_maskz_mov_epi64(keep, value);
+}
+
+BINARY_UTILS_AVX512 inline __m512i encodeOrderBookAvx512(__m512d v) {
+    const __m512d abs_v = _mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(v), _mm512_set1_epi64(PRICE_FRAC_MASK)));
+    const __m512d whole = _mm512_roundscale_pd(abs_v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    const __m512d frac = _mm512_sub_round_pd(abs_v, whole, BINARY_UTILS_ROUND);
+
+    const __m512i whole_int = truncScaledAvx512(_mm512_min_pd(whole, _mm512_set1_pd(1023.0)), 0);
+    const __m512i frac_int = truncScaledAvx512(_mm512_mul_round_pd(frac, _mm512_set1_pd(ORDERBOOK_FRAC_SCALE), BINARY_UTILS_ROUND), 0);
+
+    const __mmask8 negative = _mm512_cmp_pd_mask(v, _mm512_setzero_pd(), _CMP_LT_OQ);
+    const __mmask8 keep = _mm512_cmp_pd_mask(abs_v, _mm512_set1_pd(ZERO_THRESHOLD), _CMP_NLT_UQ) &
+                          _mm512_cmp_pd_mask(v, v, _CMP_ORD_Q);
+
+    __m512i value = _mm512_or_si512(_mm512_slli_epi64(whole_int, 53),
+                                    _mm512_and_si512(frac_int, _mm512_set1_epi64(ORDERBOOK_FRAC_MASK)));
+    value = _mm512_mask_or_epi64(value, negative, value, _mm512_set1_epi64(ORDERBOOK_SIGN_MASK));
+    return _mm512_maskz_mov_epi64(keep, value);
+}
+
+BINARY_UTILS_AVX512 inline __m512d decodeChangeAvx512(__m512i encoded) {
+    const __m512d value = _mm512_mul_round_pd(
+        _mm512_cvtepu64_pd(_mm512_and_si512(encoded, _mm512_set1_epi64(PRICE_FRAC_MASK))),
+        _mm512_set1_pd(TWO_POW_MINUS_63), BINARY_UTILS_ROUND);
+    return _mm512_castsi512_pd(_mm512_or_si512(_mm512_castpd_si512(value),
+                                               _mm512_and_si512(encoded, _mm512_set1_epi64(PRICE_SIGN_MASK))));
+}
+
+BINARY_UTILS_AVX512 inline __m512d decodeOrderBookAvx512(__m512i encoded) {
+    const __m512d whole = _mm512_cvtepu64_pd(_mm512_and_si512(_mm512_srli_epi64(encoded, 53), _mm512_set1_epi64(1023)));
+    const __m512d frac = _mm512_cvtepu64_pd(_mm512_and_si512(encoded, _mm512_set1_epi64(ORDERBOOK_FRAC_MASK)));
+    // Separate multiply and add with explicit rounding so nothing is fused into an FMA
+    const __m512d value = _mm512_add_round_pd(
+        whole, _mm512_mul_round_pd(frac, _mm512_set1_pd(ORDERBOOK_FRAC_SCALE_INV), BINARY_UTILS_ROUND), BINARY_UTILS_ROUND);
+    return _mm512_castsi512_pd(_mm512_or_si512(_mm512_castpd_si512(value),
+                                               _mm512_and_si512(encoded, _mm512_set1_epi64(ORDERBOOK_SIGN_MASK))));
+}
+
+// Eight levels span three vectors; bits mark the price lanes
+constexpr __mmask8 AVX512_PRICE_LANES[3] = {0x49, 0x92, 0x24};
+
+BINARY_UTILS_AVX512 inline void encodeLevelsAvx512(const double* levels, size_t num_levels, char* out) {
+    const size_t blocks = num_levels / 8;
+    for (size_t b = 0; b < blocks; ++b, levels += 24, out += 24 * sizeof(uint64_t)) {
+        for (size_t k = 0; k < 3; ++k) {
+            const __m512d v = _mm512_loadu_pd(levels + 8 * k);
+            const __m512i encoded = _mm512_mask_blend_epi64(AVX512_PRICE_LANES[k], encodeOrderBookAvx512(v), encodeChangeAvx512(v));
+            _mm512_storeu_si512(out + 64 * k, encoded);
+        }
+    }
+    encodeLevelsAvx2(levels, num_levels % 8, out);
+}
+
+BINARY_UTILS_AVX512 inline void decodeLevelsAvx512(const char* in, size_t num_levels, double* levels) {
+    const size_t blocks = num_levels / 8;
+    for (size_t b = 0; b < blocks; ++b, levels += 24, in += 24 * sizeof(uint64_t)) {
+        for (size_t k = 0; k < 3; ++k) {
+            const __m512i encoded = _mm512_loadu_si512(in + 64 * k);
+            const __m512d decoded = _mm512_mask_blend_pd(AVX512_PRICE_LANES[k], decodeOrderBookAvx512(encoded), decodeChangeAvx512(encoded));
+            _mm512_storeu_pd(levels + 8 * k, decoded);
+        }
+    }
+    decodeLevelsAvx2(in, num_levels % 8, levels);
+}
+
+BINARY_UTILS_AVX512 inline void encodeChangeValuesAvx512(const double* values, size_t count, char* out) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm512_storeu_si512(out + i * 8, encodeChangeAvx512(_mm512_loadu_pd(values + i)));
+    }
+    encodeChangeValuesAvx2(values + i, count - i, out + i * 8);
+}
+
+BINARY_UTILS_AVX512 inline void decodeChangeValuesAvx512(const char* in, size_t count, double* values) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm512_storeu_pd(values + i, decodeChangeAvx512(_mm512_loadu_si512(in + i * 8)));
+    }
+    decodeChangeValuesAvx2(in + i * 8, count - i, values + i);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif  // BINARY_UTILS_X86_SIMD
+
+enum class CodecPath { Scalar, Avx2, Avx512 };
+
+struct BatchCodec {
+    CodecPath path;
+    const char* name;
+    void (*encodeLevels)(const double*, size_t, char*);
+    void (*decodeLevels)(const char*, size_t, double*);
+    void (*encodeChangeValues)(const double*, size_t, char*);
+    void (*decodeChangeValues)(const char*, size_t, double*);
+};
+
+inline BatchCodec scalarCodec() {
+    return {CodecPath::Scalar, "scalar", encodeLevelsScalar, decodeLevelsScalar,
+            encodeChangeValuesScalar, decodeChangeValuesScalar};
+}
+
+#ifdef BINARY_UTILS_X86_SIMD
+inline BatchCodec avx2Codec() {
+    return {CodecPath::Avx2, "avx2", encodeLevelsAvx2, decodeLevelsAvx2,
+            encodeChangeValuesAvx2, decodeChangeValuesAvx2};
+}
+
+inline BatchCodec avx512Codec() {
+    return {CodecPath::Avx512, "avx512", encodeLevelsAvx512, decodeLevelsAvx512,
+            encodeChangeValuesAvx512, decodeChangeValuesAvx512};
+}
+#endif
+
+// Whether this CPU runs the codec's instructions
+inline bool cpuSupports(CodecPath path) {
+#ifdef BINARY_UTILS_X86_SIMD
+    __builtin_cpu_init();
+    switch (path) {
+        case CodecPath::Avx512: return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq");
+        case CodecPath::Avx2: return __builtin_cpu_supports("avx2");
+        case CodecPath::Scalar: return true;
+    }
+    return false;
+#else
+    return path == CodecPath::Scalar;
+#endif
+}
+
+// Pick the widest codec the CPU supports.
+// BINARY_UTILS_SIMD=scalar|avx2|avx512 caps the selection.
+inline BatchCodec selectCodec() {
+#ifdef BINARY_UTILS_X86_SIMD
+    const char* requested = std::getenv("BINARY_UTILS_SIMD");
+    const bool allow_avx512 = !requested || std::strcmp(requested, "avx512") == 0;
+    const bool allow_avx2 = allow_avx512 || std::strcmp(requested, "avx2") == 0;
+    if (allow_avx512 && cpuSupports(CodecPath::Avx512)) return avx512Codec();
+    if (allow_avx2 && cpuSupports(CodecPath::Avx2)) return avx2Codec();
+#endif
+    return scalarCodec();
+}
+
+inline const BatchCodec& activeCodec() {
+    static const BatchCodec codec = selectCodec();
+    return codec;
+}
+
+} // namespace detail
+
+// Name of the codec in use ("avx512", "avx2" or "scalar")
+inline const char* activeCodecName() {
+    return detail::activeCodec().name;
+}
+
+// Encode interleaved [price, volume, orders] levels into 24 bytes per level
+inline void encodeLevels(const double* levels, size_t num_levels, char* out) {
+    detail::activeCodec().encodeLevels(levels, num_levels, out);
+}
+
+// Decode 24-byte levels into interleaved [price, volume, orders] doubles
+inline void decodeLevels(const char* in, size_t num_levels, double* levels) {
+    detail::activeCodec().decodeLevels(in, num_levels, levels);
+}
+
+// Encode/decode a contiguous run of change values (8 bytes each)
+inline void encodeChangeValues(const double* values, size_t count, char* out) {
+    detail::activeCodec().encodeChangeValues(values, count, out);
+}
+
+inline void decodeChangeValues(const char* in, size_t count, double* values) {
+    detail::activeCodec().decodeChangeValues(in, count, values);
+}
+
 } // namespace binary_utils 
\ No newline at end of file
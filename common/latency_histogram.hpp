@@ -0,0 +1,166 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+// Lock-free latency histograms for the pipeline stages, exported in the Prometheus text format.
+//
+// Buckets are log-linear like HdrHistogram: values below 2^PRECISION_BITS nanoseconds get a
+// bucket each, and every further power of two is split into 2^(PRECISION_BITS - 1) equal
+// buckets, so any value is reported within ~3% of what was recorded. record() is a few relaxed
+// atomic adds, safe from any number of threads; readers take a snapshot without stopping them.
+namespace latency {
+
+// Monotonic nanoseconds. CLOCK_MONOTONIC is shared by every process on one host, containers
+// included, so an origin stamped by one service can be subtracted in another.
+inline uint64_t nowNanos() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+class Histogram {
+public:
+    static constexpr int PRECISION_BITS = 6;
+    static constexpr int MAX_BITS = 40;  // Values clamp to ~18 minutes
+    static constexpr uint64_t LINEAR_BUCKETS = 1ULL << PRECISION_BITS;
+    static constexpr uint64_t HALF = LINEAR_BUCKETS / 2;
+    static constexpr size_t BUCKETS = static_cast<size_t>((MAX_BITS - PRECISION_BITS + 2) * HALF);
+
+    struct Snapshot {
+        std::array<uint64_t, BUCKETS> counts{};
+        uint64_t count = 0;
+        uint64_t sum = 0;  // Nanoseconds
+        uint64_t max = 0;
+
+        // Nanoseconds at quantile q in [0, 1]: the highest value of the bucket holding that rank
+        uint64_t percentile(double q) const {
+            if (count == 0) return 0;
+            const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * static_cast<double>(count))));
+            uint64_t seen = 0;
+            for (size_t b = 0; b < BUCKETS; ++b) {
+                seen += counts[b];
+                if (seen >= rank) {
+                    return std::min(highestValue(b), max);
+                }
+            }
+            return max;
+        }
+    };
+
+    Histogram() = default;
+    Histogram(const Histogram&) = delete;
+    Histogram& operator=(const Histogram&) = delete;
+
+    void record(uint64_t nanos) {
+        counts_[bucketOf(nanos)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(nanos, std::memory_order_relaxed);
+        uint64_t max = max_.load(std::memory_order_relaxed);
+        while (nanos > max && !max_.compare_exchange_weak(max, nanos, std::memory_order_relaxed)) {}
+    }
+
+    // Time from start_nanos (a nowNanos() value, possibly from another process) until now;
+    // 0 means the start is unknown and nothing is recorded
+    void recordSince(uint64_t start_nanos) {
+        if (start_nanos == 0) return;
+        const uint64_t now = nowNanos();
+        record(now > start_nanos ? now - start_nanos : 0);
+    }
+
+    Snapshot snapshot() const {
+        Snapshot snapshot;
+        for (size_t b = 0; b < BUCKETS; ++b) {
+            snapshot.counts[b] = counts_[b].load(std::memory_order_relaxed);
+            snapshot.count += snapshot.counts[b];  // Consistent with the buckets, unlike count_
+        }
+        snapshot.sum = sum_.load(std::memory_order_relaxed);
+        snapshot.max = max_.load(std::memory_order_relaxed);
+        return snapshot;
+    }
+
+    static size_t bucketOf(uint64_t nanos) {
+        if (nanos < LINEAR_BUCKETS) return static_cast<size_t>(nanos);
+        const int msb = 63 - __builtin_clzll(nanos);
+        if (msb >= MAX_BITS) return BUCKETS - 1;
+        const int shift = msb - PRECISION_BITS + 1;
+        return static_cast<size_t>(static_cast<uint64_t>(shift) * HALF + (nanos >> shift));
+    }
+
+    static uint64_t highestValue(size_t bucket) {
+        if (bucket < LINEAR_BUCKETS) return bucket;
+        const uint64_t shift = bucket / HALF - 1;
+        const uint64_t upper = bucket - shift * HALF;
+        return ((upper + 1) << shift) - 1;
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS> counts_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+// Named histograms of one process. Look a histogram up once at setup and keep the reference;
+// recording never touches the registry.
+class Registry {
+public:
+    Histogram& histogram(const std::string& name, const std::string& help) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& entry : entries_) {
+            if (entry.name == name) return entry.histogram;
+        }
+        entries_.emplace_back(name, help);
+        return entries_.back().histogram;
+    }
+
+    // One summary per histogram in seconds, over everything recorded since startup
+    std::string renderPrometheus() const {
+        std::ostringstream out;
+        out << std::setprecision(9);
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& entry : entries_) {
+            const auto snapshot = entry.histogram.snapshot();
+            out << "# HELP " << entry.name << " " << entry.help << "\n"
+                << "# TYPE " << entry.name << " summary\n";
+            for (const char* quantile : {"0.5", "0.99", "0.999"}) {
+                out << entry.name << "{quantile=\"" << quantile << "\"} "
+                    << seconds(snapshot.percentile(std::stod(quantile))) << "\n";
+            }
+            out << entry.name << "_sum " << seconds(snapshot.sum) << "\n"
+                << entry.name << "_count " << snapshot.count << "\n"
+                << "# TYPE " << entry.name << "_max gauge\n"
+                << entry.name << "_max " << seconds(snapshot.max) << "\n";
+        }
+        return out.str();
+    }
+
+private:
+    struct Entry {
+        Entry(const std::string& entry_name, const std::string& entry_help) : name(entry_name), help(entry_help) {}
+        std::string name;
+        std::string help;
+        Histogram histogram;
+    };
+
+    static double seconds(uint64_t nanos) { return static_cast<double>(nanos) * 1e-9; }
+
+    mutable std::mutex mutex_;
+    std::deque<Entry> entries_;  // Deque keeps handed out references valid
+};
+
+// Registry of this process, served by MetricsServer
+inline Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+} // namespace latency
@@ -0,0 +1,458 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <async_logger.hpp>
+#include <spsc_queue.hpp>
+
+// Recorded orderbook streams: append-only segment files of published messages, each with the
+// wall-clock time its exchange frame was received.
+//
+// A segment is preallocated and mapped; records are copied into the mapping and the header's
+// record count and data end are published after each one, so a segment cut short by a crash
+// still reads up to its last complete record. Closing trims the file to its data.
+//
+// Publishers record through AsyncRecorder, which copies each message into an SPSC queue and
+// leaves the file work (page faults, opening, mapping, trimming) to a recorder thread.
+//
+// Layout:
+//   SegmentHeader (page aligned): magic, version, topic (the routing key the messages were
+//   published on), committed record count and data end, first/last receive time, and a
+//   sparse index of every INDEX_STRIDE-th record's receive time and offset
+//   then records: uint64 receive ns, uint32 size, uint32 reserved, payload, padded to 8 bytes
+namespace recording {
+
+constexpr uint64_t SEGMENT_MAGIC = 0x7274647365'673031ULL;  // "rtdseg01"
+constexpr uint32_t SEGMENT_VERSION = 1;
+constexpr size_t INDEX_STRIDE = 256;     // Records between index entries
+constexpr size_t INDEX_CAPACITY = 4096;  // Index entries per segment, then the segment rotates
+constexpr size_t MAX_TOPIC_SIZE = 128;
+constexpr size_t RECORD_ALIGNMENT = 8;
+constexpr size_t DEFAULT_SEGMENT_SIZE = size_t(256) << 20;
+constexpr const char* SEGMENT_EXTENSION = ".seg";
+
+struct IndexEntry {
+    uint64_t receive_ns;
+    uint64_t offset;
+};
+
+struct SegmentHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t data_offset;  // First record
+    char topic[MAX_TOPIC_SIZE];
+    uint64_t created_ns;
+    std::atomic<uint64_t> records;
+    std::atomic<uint64_t> data_end;
+    std::atomic<uint64_t> first_ns;
+    std::atomic<uint64_t> last_ns;
+    std::atomic<uint64_t> index_entries;
+    IndexEntry index[INDEX_CAPACITY];
+};
+
+struct RecordHeader {
+    uint64_t receive_ns;
+    uint32_t size;
+    uint32_t reserved;
+};
+
+constexpr size_t DATA_OFFSET = (sizeof(SegmentHeader) + 4095) / 4096 * 4096;
+
+inline size_t recordSize(size_t payload) {
+    return (sizeof(RecordHeader) + payload + RECORD_ALIGNMENT - 1) / RECORD_ALIGNMENT * RECORD_ALIGNMENT;
+}
+
+inline uint64_t wallNanos() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+// Wall-clock time of a steady_clock nanosecond reading (latency::nowNanos()), 0 meaning now
+inline uint64_t wallNanosOf(uint64_t steady_ns) {
+    const uint64_t wall = wallNanos();
+    if (steady_ns == 0) return wall;
+    const uint64_t steady = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+    return steady >= steady_ns ? wall - (steady - steady_ns) : wall;
+}
+
+// Appends records to segments named <dir>/<topic>.<created ns>.seg; one thread per writer.
+// open() starts a segment, append() fills it until roomFor() says no, close() trims it.
+class SegmentWriter {
+public:
+    SegmentWriter(std::string dir, std::string topic, size_t segment_size = DEFAULT_SEGMENT_SIZE)
+        : dir_(std::move(dir)), topic_(std::move(topic)), segment_size_(segment_size) {
+        if (topic_.size() >= MAX_TOPIC_SIZE) {
+            throw std::invalid_argument("Recording topic is too long: " + topic_);
+        }
+        if (segment_size_ < DATA_OFFSET + recordSize(0)) {
+            throw std::invalid_argument("Recording segment size is too small");
+        }
+    }
+
+    ~SegmentWriter() { close(); }
+
+    SegmentWriter(const SegmentWriter&) = delete;
+    SegmentWriter& operator=(const SegmentWriter&) = delete;
+
+    // Record a message whose frame arrived at receive_ns (wall clock); false if it does not fit
+    // the open segment, or none is open
+    bool append(const char* data, size_t size, uint64_t receive_ns) {
+        if (!roomFor(size)) {
+            return false;
+        }
+        const size_t bytes = recordSize(size);
+
+        SegmentHeader* h = header();
+        const uint64_t offset = h->data_end.load(std::memory_order_relaxed);
+        const uint64_t records = h->records.load(std::memory_order_relaxed);
+        auto* record = reinterpret_cast<RecordHeader*>(base_ + offset);
+        record->receive_ns = receive_ns;
+        record->size = static_cast<uint32_t>(size);
+        record->reserved = 0;
+        std::memcpy(record + 1, data, size);
+
+        if (records % INDEX_STRIDE == 0) {
+            const uint64_t entry = h->index_entries.load(std::memory_order_relaxed);
+            h->index[entry] = IndexEntry{receive_ns, offset};
+            h->index_entries.store(entry + 1, std::memory_order_release);
+        }
+        if (records == 0) {
+            h->first_ns.store(receive_ns, std::memory_order_relaxed);
+        }
+        h->last_ns.store(receive_ns, std::memory_order_relaxed);
+        h->data_end.store(offset + bytes, std::memory_order_release);
+        h->records.store(records + 1, std::memory_order_release);
+        bytes_ += bytes;
+        return true;
+    }
+
+    // Whether a message of size bytes still fits the open segment
+    bool roomFor(size_t size) const {
+        if (!base_) return false;
+        const SegmentHeader* h = header();
+        const uint64_t records = h->records.load(std::memory_order_relaxed);
+        if (records % INDEX_STRIDE == 0 && h->index_entries.load(std::memory_order_relaxed) >= INDEX_CAPACITY) {
+            return false;
+        }
+        return h->data_end.load(std::memory_order_relaxed) + recordSize(size) <= segment_size_;
+    }
+
+    // Bytes left for records in the open segment
+    size_t room() const {
+        return base_ ? segment_size_ - header()->data_end.load(std::memory_order_relaxed) : 0;
+    }
+
+    // Records the open segment's index still has room for
+    uint64_t recordsLeft() const {
+        if (!base_) return 0;
+        const SegmentHeader* h = header();
+        const uint64_t records = h->records.load(std::memory_order_relaxed);
+        return INDEX_CAPACITY * INDEX_STRIDE - std::min<uint64_t>(records, INDEX_CAPACITY * INDEX_STRIDE);
+    }
+
+    bool isOpen() const { return base_ != nullptr; }
+    size_t segmentSize() const { return segment_size_; }
+
+    void close() {
+        if (!base_) return;
+        const uint64_t end = header()->data_end.load(std::memory_order_acquire);
+        const uint64_t records = header()->records.load(std::memory_order_acquire);
+        ::munmap(base_, segment_size_);
+        base_ = nullptr;
+        if (records == 0) {
+            ::unlink(path_.c_str());  // Opened ahead but never used
+            ::close(fd_);
+            fd_ = -1;
+            return;
+        }
+        if (::ftruncate(fd_, static_cast<off_t>(end)) != 0) {
+            LOG_WARN("Trimming {} failed: {}", path_, std::strerror(errno));
+        }
+        ::close(fd_);
+        fd_ = -1;
+        LOG_INFO("Closed recording segment {}", path_);
+    }
+
+    const std::string& path() const { return path_; }
+    uint64_t bytesWritten() const { return bytes_; }
+
+    // Start a new segment, closing the open one first; throws if it cannot be created
+    void open() {
+        close();
+        const uint64_t created = wallNanos();
+        path_ = dir_ + "/" + topic_ + "." + std::to_string(created) + SEGMENT_EXTENSION;
+        fd_ = ::open(path_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd_ < 0) {
+            throw std::runtime_error("Creating " + path_ + " failed: " + std::strerror(errno));
+        }
+        void* base = MAP_FAILED;
+        if (::ftruncate(fd_, static_cast<off_t>(segment_size_)) == 0) {
+            base = ::mmap(nullptr, segment_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        }
+        if (base == MAP_FAILED) {
+            const std::string error = std::strerror(errno);
+            ::close(fd_);
+            fd_ = -1;
+            ::unlink(path_.c_str());
+            throw std::runtime_error("Mapping " + path_ + " failed: " + error);
+        }
+        base_ = static_cast<char*>(base);
+
+        // The file starts zeroed, so only the identifying fields need writing
+        SegmentHeader* h = header();
+        h->version = SEGMENT_VERSION;
+        h->data_offset = static_cast<uint32_t>(DATA_OFFSET);
+        std::memcpy(h->topic, topic_.c_str(), topic_.size() + 1);
+        h->created_ns = created;
+        h->data_end.store(DATA_OFFSET, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        h->magic = SEGMENT_MAGIC;
+        LOG_INFO("Recording {} to {}", topic_, path_);
+    }
+
+private:
+    SegmentHeader* header() const { return reinterpret_cast<SegmentHeader*>(base_); }
+
+    std::string dir_;
+    std::string topic_;
+    size_t segment_size_;
+    std::string path_;
+    int fd_ = -1;
+    char* base_ = nullptr;
+    uint64_t bytes_ = 0;
+};
+
+// Records one publisher's messages from a recorder thread. The publisher only copies each
+// message into a queue slot; the thread appends it, opens the next segment ahead of time and
+// switches to it on a keyframe, so every segment replays on its own. wantsKeyframe() asks the
+// publisher for one: when a next segment is ready or records were lost in between. A segment
+// that cannot be created is retried every OPEN_RETRY, dropping records meanwhile.
+class AsyncRecorder {
+public:
+    static constexpr size_t MAX_RECORD_SIZE = 20 << 10;  // Largest message that is recorded
+    static constexpr size_t QUEUE_CAPACITY = 128;         // Messages between publisher and thread
+    static constexpr auto IDLE_WAIT = std::chrono::milliseconds(1);
+    static constexpr auto OPEN_RETRY = std::chrono::seconds(5);
+
+    AsyncRecorder(std::string dir, std::string topic, size_t segment_size = DEFAULT_SEGMENT_SIZE)
+        : current_(std::make_unique<SegmentWriter>(dir, topic, segment_size)),
+          next_(std::make_unique<SegmentWriter>(dir, topic, segment_size)),
+          topic_(std::move(topic)) {
+        // Room kept when the next segment is requested, for what is queued and in flight until
+        // its keyframe comes
+        headroom_ = std::min((QUEUE_CAPACITY + 2) * recordSize(MAX_RECORD_SIZE), (segment_size - DATA_OFFSET) / 2);
+        queue_ = std::make_unique<SpscQueue<QueuedRecord, QUEUE_CAPACITY>>();
+        prepareNext();  // The first segment is ready for the first keyframe
+        thread_ = std::thread(&AsyncRecorder::run, this);
+    }
+
+    ~AsyncRecorder() {
+        running_.store(false, std::memory_order_release);
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    AsyncRecorder(const AsyncRecorder&) = delete;
+    AsyncRecorder& operator=(const AsyncRecorder&) = delete;
+
+    // Publisher: the next message should be a keyframe
+    bool wantsKeyframe() const { return resync_ || keyframe_wanted_.load(std::memory_order_relaxed); }
+
+    // Publisher: record a published message whose frame arrived at receive_ns (wall clock);
+    // keyframe marks one that decodes without the messages before it
+    void append(const char* data, size_t size, uint64_t receive_ns, bool keyframe) {
+        if (resync_ && !keyframe) return;  // A delta on a lost base would not replay
+        QueuedRecord* slot = size <= MAX_RECORD_SIZE ? queue_->tryAcquire() : nullptr;
+        if (!slot) {
+            resync_ = true;
+            LOG_RATE_LIMITED(1000, Warn, "Recording {} fell behind, dropping until the next keyframe", topic_);
+            return;
+        }
+        resync_ = false;
+        std::memcpy(slot->data.data(), data, size);
+        slot->size = size;
+        slot->receive_ns = receive_ns;
+        slot->keyframe = keyframe;
+        queue_->commit();
+    }
+
+private:
+    struct QueuedRecord {
+        std::array<char, MAX_RECORD_SIZE> data;
+        size_t size = 0;
+        uint64_t receive_ns = 0;
+        bool keyframe = false;
+    };
+
+    void run() {
+        logging::setThreadName("recorder");
+        for (;;) {
+            QueuedRecord* record = queue_->front();
+            if (!record) {
+                if (!running_.load(std::memory_order_acquire)) break;
+                prepareNext();
+                std::this_thread::sleep_for(IDLE_WAIT);
+                continue;
+            }
+            write(*record);
+            queue_->pop();
+        }
+        current_->close();
+        next_->close();
+    }
+
+    bool rotationDue() const {
+        return !current_->isOpen() || current_->room() < headroom_ || current_->recordsLeft() < QUEUE_CAPACITY + 2;
+    }
+
+    // Open the next segment once the current one runs low, then ask for a keyframe to start it
+    void prepareNext() {
+        if (!rotationDue()) return;
+        if (!next_->isOpen()) {
+            const auto now = std::chrono::steady_clock::now();
+            if (now < retry_at_) return;
+            try {
+                next_->open();
+            } catch (const std::exception& e) {
+                LOG_ERROR("Recording {} failed, retrying in {} s: {}", topic_,
+                          std::chrono::duration_cast<std::chrono::seconds>(OPEN_RETRY).count(), e.what());
+                retry_at_ = now + OPEN_RETRY;
+                return;
+            }
+        }
+        keyframe_wanted_.store(true, std::memory_order_relaxed);
+    }
+
+    void write(const QueuedRecord& record) {
+        if (record.keyframe && next_->isOpen() && rotationDue()) {
+            std::swap(current_, next_);
+            next_->close();
+            keyframe_wanted_.store(false, std::memory_order_relaxed);
+        }
+        if (!current_->append(record.data.data(), record.size, record.receive_ns)) {
+            ++dropped_;
+            LOG_RATE_LIMITED(1000, Warn, "Recording {} has no segment with room, {} records dropped so far",
+                             topic_, dropped_);
+        }
+        prepareNext();
+    }
+
+    std::unique_ptr<SegmentWriter> current_;
+    std::unique_ptr<SegmentWriter> next_;  // Opened ahead, waiting for a keyframe
+    std::string topic_;
+    size_t headroom_ = 0;
+    std::unique_ptr<SpscQueue<QueuedRecord, QUEUE_CAPACITY>> queue_;
+    std::atomic<bool> keyframe_wanted_{false};
+    std::atomic<bool> running_{true};
+    bool resync_ = false;  // Publisher only: a record was lost, waiting for a keyframe
+    uint64_t dropped_ = 0;
+    std::chrono::steady_clock::time_point retry_at_{};
+    std::thread thread_;
+};
+
+struct Record {
+    uint64_t receive_ns = 0;
+    std::string_view data;  // Points into the mapped segment
+};
+
+// Reads the committed records of one segment, also while it is still being written
+class SegmentReader {
+public:
+    explicit SegmentReader(const std::string& path) : path_(path) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Opening " + path + " failed: " + std::strerror(errno));
+        }
+        struct stat st {};
+        if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < DATA_OFFSET) {
+            ::close(fd);
+            throw std::runtime_error(path + " is not a recording segment");
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        void* base = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            throw std::runtime_error("Mapping " + path + " failed: " + std::strerror(errno));
+        }
+        base_ = static_cast<const char*>(base);
+        ::madvise(base, size_, MADV_SEQUENTIAL);
+
+        const SegmentHeader* h = header();
+        if (h->magic != SEGMENT_MAGIC || h->version != SEGMENT_VERSION || h->data_offset != DATA_OFFSET) {
+            ::munmap(base, size_);
+            throw std::runtime_error(path + " is not a version " + std::to_string(SEGMENT_VERSION) +
+                                     " recording segment");
+        }
+        offset_ = DATA_OFFSET;
+    }
+
+    ~SegmentReader() { ::munmap(const_cast<char*>(base_), size_); }
+
+    SegmentReader(const SegmentReader&) = delete;
+    SegmentReader& operator=(const SegmentReader&) = delete;
+
+    std::string topic() const { return std::string(header()->topic, ::strnlen(header()->topic, MAX_TOPIC_SIZE)); }
+    uint64_t records() const { return header()->records.load(std::memory_order_acquire); }
+    uint64_t firstNanos() const { return header()->first_ns.load(std::memory_order_relaxed); }
+    uint64_t lastNanos() const { return header()->last_ns.load(std::memory_order_relaxed); }
+    const std::string& path() const { return path_; }
+
+    // Next record in file order; false at the end of what has been committed
+    bool next(Record& record) {
+        const uint64_t end = std::min<uint64_t>(header()->data_end.load(std::memory_order_acquire), size_);
+        if (offset_ + sizeof(RecordHeader) > end) return false;
+        const auto* rh = reinterpret_cast<const RecordHeader*>(base_ + offset_);
+        if (offset_ + recordSize(rh->size) > end) {
+            throw std::runtime_error(path_ + " has a record past its data end");
+        }
+        record.receive_ns = rh->receive_ns;
+        record.data = std::string_view(reinterpret_cast<const char*>(rh + 1), rh->size);
+        offset_ += recordSize(rh->size);
+        return true;
+    }
+
+    // Position on the first record received at or after receive_ns
+    void seek(uint64_t receive_ns) {
+        const SegmentHeader* h = header();
+        const uint64_t entries = std::min<uint64_t>(h->index_entries.load(std::memory_order_acquire), INDEX_CAPACITY);
+        const IndexEntry* begin = h->index;
+        const IndexEntry* it = std::upper_bound(begin, begin + entries, receive_ns,
+            [](uint64_t ns, const IndexEntry& entry) { return ns < entry.receive_ns; });
+        offset_ = it == begin ? DATA_OFFSET : (it - 1)->offset;
+
+        Record record;
+        uint64_t position = offset_;
+        while (next(record) && record.receive_ns < receive_ns) {
+            position = offset_;
+        }
+        offset_ = record.receive_ns >= receive_ns ? position : offset_;
+    }
+
+    void rewind() { offset_ = DATA_OFFSET; }
+
+private:
+    const SegmentHeader* header() const { return reinterpret_cast<const SegmentHeader*>(base_); }
+
+    std::string path_;
+    const char* base_ = nullptr;
+    size_t size_ = 0;
+    uint64_t offset_ = 0;
+};
+
+} // namespace recording
@@ -0,0 +1,121 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "async_logger.hpp"
+#include "latency_histogram.hpp"
+
+namespace latency {
+
+// Minimal HTTP endpoint serving a registry at GET /metrics for Prometheus to scrape. One thread
+// handles one request at a time; scrapes are rare, and nothing on the hot path waits for it.
+class MetricsServer {
+public:
+    static constexpr int POLL_INTERVAL_MS = 200;  // How long stop() may wait for the thread
+    static constexpr size_t MAX_REQUEST_SIZE = 4096;
+
+    explicit MetricsServer(uint16_t port, Registry& metrics = registry()) : port_(port), registry_(metrics) {}
+    ~MetricsServer() { stop(); }
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    // Listen on all interfaces; false if the port cannot be bound
+    bool start() {
+        listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (listen_fd_ < 0) {
+            LOG_ERROR("Metrics socket failed: {}", std::strerror(errno));
+            return false;
+        }
+        const int reuse = 1;
+        ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port_);
+        if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            ::listen(listen_fd_, 4) != 0) {
+            LOG_ERROR("Metrics endpoint on port {} failed: {}", port_, std::strerror(errno));
+            ::close(listen_fd_);
+            listen_fd_ = -1;
+            return false;
+        }
+
+        running_.store(true);
+        thread_ = std::thread(&MetricsServer::run, this);
+        LOG_INFO("Serving latency metrics on :{}/metrics", port_);
+        return true;
+    }
+
+    void stop() {
+        running_.store(false);
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        if (listen_fd_ >= 0) {
+            ::close(listen_fd_);
+            listen_fd_ = -1;
+        }
+    }
+
+private:
+    void run() {
+        while (running_.load()) {
+            pollfd pfd{listen_fd_, POLLIN, 0};
+            if (::poll(&pfd, 1, POLL_INTERVAL_MS) <= 0) continue;
+
+            const int client = ::accept(listen_fd_, nullptr, nullptr);
+            if (client < 0) continue;
+            timeval timeout{1, 0};  // A stalled client must not hold the thread
+            ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            ::setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            respond(client);
+            ::close(client);
+        }
+    }
+
+    void respond(int client) {
+        std::string request;
+        char buffer[1024];
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < MAX_REQUEST_SIZE) {
+            const ssize_t n = ::recv(client, buffer, sizeof(buffer), 0);
+            if (n <= 0) break;
+            request.append(buffer, static_cast<size_t>(n));
+        }
+
+        std::string status = "404 Not Found";
+        std::string body = "Not found\n";
+        if (request.rfind("GET /metrics", 0) == 0) {
+            status = "200 OK";
+            body = registry_.renderPrometheus();
+        }
+        const std::string response = "HTTP/1.1 " + status + "\r\n"
+                                     "Content-Type: text/plain; version=0.0.4\r\n"
+                                     "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                                     "Connection: close\r\n\r\n" + body;
+        size_t sent = 0;
+        while (sent < response.size()) {
+            const ssize_t n = ::send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) break;
+            sent += static_cast<size_t>(n);
+        }
+    }
+
+    uint16_t port_;
+    Registry& registry_;
+    int listen_fd_ = -1;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
+
+} // namespace latency
@@ -0,0 +1,85 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Bounded multi-producer single-consumer queue of fixed-size slots (Vyukov's bounded queue).
+// A producer claims a slot with one CAS, fills it in place and commits it; the consumer reads
+// committed slots in place, in claim order. Producers never wait for each other while filling,
+// and neither side ever blocks or allocates.
+template <typename T, size_t Capacity>
+class MpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    static constexpr size_t CAPACITY = Capacity;
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    MpscQueue() {
+        for (size_t i = 0; i < Capacity; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    // Producer: claim the next free slot, or nullptr when the queue is full. ticket identifies
+    // the slot for commit().
+    T* tryAcquire(size_t& ticket) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots_[pos & (Capacity - 1)];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    ticket = pos;
+                    return &slot.value;
+                }
+            } else if (diff < 0) {
+                return nullptr;  // The consumer has not released this slot yet
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Producer: publish the slot claimed with this ticket
+    void commit(size_t ticket) {
+        slots_[ticket & (Capacity - 1)].sequence.store(ticket + 1, std::memory_order_release);
+    }
+
+    // Consumer: oldest claimed slot once it is committed, or nullptr. A slot claimed but not
+    // yet committed holds back the ones behind it.
+    T* front() {
+        Slot& slot = slots_[head_ & (Capacity - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != head_ + 1) return nullptr;
+        return &slot.value;
+    }
+
+    // Consumer: release the slot returned by front
+    void pop() {
+        slots_[head_ & (Capacity - 1)].sequence.store(head_ + Capacity, std::memory_order_release);
+        ++head_;
+    }
+
+    // Consumer: whether front() would return nullptr
+    bool empty() const {
+        return slots_[head_ & (Capacity - 1)].sequence.load(std::memory_order_acquire) != head_ + 1;
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Slot {
+        std::atomic<size_t> sequence{0};
+        T value;
+    };
+
+    // Consumer-owned line
+    alignas(CACHE_LINE_SIZE) size_t head_ = 0;
+
+    // Claimed by every producer
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail_{0};
+
+    std::array<Slot, Capacity> slots_;
+};
@@ -0,0 +1,534 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include "binary_utils.hpp"
+
+// Orderbook state messages published on orderbook.updates.
+//
+// v2 (fixed 19370 bytes, no header):
+//   400 bids, 400 asks as [price, volume, orders] 8-byte words,
+//   21 feature words, uint32 mid price cents, uint16 state ID
+//
+// v3 (variable size, versioned header):
+//   [0]  uint8  version (3)
+//   [1]  uint8  flags (bit 0: keyframe)
+//   [2]  uint8  packing (Packing)
+//   [3]  uint8  header size in bytes, later fields are appended after the known ones
+//   [4]  uint16 state ID
+//   [6]  uint16 base state ID the delta applies to (equals state ID on keyframes)
+//   [8]  uint32 mid price cents
+//   [12] uint64 origin: latency::nowNanos() when the exchange frame was received, 0 if unknown
+//        (headers of 12 bytes from older producers end before it)
+//   then 21 feature values, then the bid side and the ask side.
+//
+//   Keyframe side: 400 levels x 3 values.
+//   Delta side:    uint16 delete count, uint16 change count,
+//                  deleted level indices into the base side (ascending),
+//                  changes as uint16 index into the new side (ascending, bit 15 set
+//                  for inserted levels) followed by the level's 3 values.
+//
+// A v2 message is recognised by its size alone; the v3 encoder never emits that size.
+namespace orderbook_wire {
+
+constexpr size_t LEVELS = 400;
+constexpr size_t VALUES_PER_LEVEL = 3;
+constexpr size_t SIDE_VALUES = LEVELS * VALUES_PER_LEVEL;
+constexpr size_t FEATURE_VALUES = 21;  // Mid price change + 5 depths x 4 features
+constexpr size_t V2_MESSAGE_SIZE = (2 * SIDE_VALUES + FEATURE_VALUES) * sizeof(uint64_t) +
+                                   sizeof(uint32_t) + sizeof(uint16_t);
+
+constexpr uint8_t VERSION_3 = 3;
+constexpr uint8_t FLAG_KEYFRAME = 0x01;
+constexpr size_t V3_MIN_HEADER_SIZE = 12;  // Header up to the mid price
+constexpr size_t V3_HEADER_SIZE = 20;      // Header this encoder writes
+constexpr size_t MAX_V3_MESSAGE_SIZE = V3_HEADER_SIZE + (FEATURE_VALUES + 2 * SIDE_VALUES) * sizeof(uint64_t);
+constexpr uint16_t INSERT_FLAG = 0x8000;
+constexpr uint16_t INDEX_MASK = 0x7FFF;
+constexpr size_t DEFAULT_KEYFRAME_INTERVAL = 100;
+
+// How each value is carried on the wire
+enum class Packing : uint8_t {
+    Raw64 = 0,    // The v2 8-byte words, decodes bit-exactly like v2
+    Float32 = 1,  // The decoded value as an IEEE float
+    Fixed32 = 2   // The decoded value as a 32-bit fixed-point integer
+};
+
+inline size_t packedValueSize(Packing packing) {
+    return packing == Packing::Raw64 ? sizeof(uint64_t) : sizeof(uint32_t);
+}
+
+inline const char* packingName(Packing packing) {
+    switch (packing) {
+        case Packing::Raw64: return "raw64";
+        case Packing::Float32: return "float32";
+        case Packing::Fixed32: return "fixed32";
+    }
+    return "unknown";
+}
+
+inline bool parsePacking(const std::string& name, Packing& packing) {
+    if (name == "raw64") packing = Packing::Raw64;
+    else if (name == "float32") packing = Packing::Float32;
+    else if (name == "fixed32") packing = Packing::Fixed32;
+    else return false;
+    return true;
+}
+
+struct MessageHeader {
+    uint8_t version = 0;
+    uint8_t flags = 0;
+    Packing packing = Packing::Raw64;
+    uint8_t header_size = 0;
+    uint16_t state_id = 0;
+    uint16_t base_state_id = 0;
+    uint32_t mid_price_cents = 0;
+    uint64_t origin_ns = 0;
+
+    bool keyframe() const { return (flags & FLAG_KEYFRAME) != 0; }
+};
+
+namespace detail {
+
+// Fixed-point scales: change values decode into (-1, 1), orderbook values into (-1024, 1024)
+constexpr double FIXED_CHANGE_SCALE = static_cast<double>(1 << 30);
+constexpr double FIXED_BOOK_SCALE = static_cast<double>(1 << 21);
+
+// Price is change encoded, volume and orders are orderbook encoded
+inline bool isChangeValue(size_t value_idx) { return value_idx == 0; }
+
+template <typename T>
+inline void store(char* out, T value) { std::memcpy(out, &value, sizeof(T)); }
+
+template <typename T>
+inline T load(const char* in) {
+    T value;
+    std::memcpy(&value, in, sizeof(T));
+    return value;
+}
+
+inline double decodeWord(uint64_t word, bool change) {
+    return change ? binary_utils::decodeChangeValue(word) : binary_utils::decodeOrderBookValue(word);
+}
+
+inline int32_t toFixed(double value, double scale) {
+    const double scaled = std::nearbyint(value * scale);
+    if (scaled >= static_cast<double>(std::numeric_limits<int32_t>::max())) return std::numeric_limits<int32_t>::max();
+    if (scaled <= static_cast<double>(std::numeric_limits<int32_t>::min())) return std::numeric_limits<int32_t>::min();
+    return static_cast<int32_t>(scaled);
+}
+
+inline char* packValue(char* out, uint64_t word, bool change, Packing packing) {
+    switch (packing) {
+        case Packing::Raw64:
+            store(out, word);
+            return out + sizeof(uint64_t);
+        case Packing::Float32:
+            store(out, static_cast<float>(decodeWord(word, change)));
+            return out + sizeof(float);
+        case Packing::Fixed32:
+            store(out, toFixed(decodeWord(word, change), change ? FIXED_CHANGE_SCALE : FIXED_BOOK_SCALE));
+            return out + sizeof(int32_t);
+    }
+    return out;
+}
+
+inline const char* unpackValue(const char* in, bool change, Packing packing, double& value) {
+    switch (packing) {
+        case Packing::Raw64:
+            value = decodeWord(load<uint64_t>(in), change);
+            return in + sizeof(uint64_t);
+        case Packing::Float32:
+            value = static_cast<double>(load<float>(in));
+            return in + sizeof(float);
+        case Packing::Fixed32:
+            value = static_cast<double>(load<int32_t>(in)) / (change ? FIXED_CHANGE_SCALE : FIXED_BOOK_SCALE);
+            return in + sizeof(int32_t);
+    }
+    return in;
+}
+
+inline char* packLevel(char* out, const uint64_t* words, Packing packing) {
+    for (size_t v = 0; v < VALUES_PER_LEVEL; ++v) {
+        out = packValue(out, words[v], isChangeValue(v), packing);
+    }
+    return out;
+}
+
+inline const char* unpackLevel(const char* in, Packing packing, double* level) {
+    for (size_t v = 0; v < VALUES_PER_LEVEL; ++v) {
+        in = unpackValue(in, isChangeValue(v), packing, level[v]);
+    }
+    return in;
+}
+
+// Bounds-checked reader over one received message
+class Reader {
+public:
+    Reader(const char* data, size_t size) : pos_(data), end_(data + size) {}
+
+    const char* take(size_t bytes) {
+        if (static_cast<size_t>(end_ - pos_) < bytes) {
+            throw std::runtime_error("Truncated v3 orderbook message");
+        }
+        const char* at = pos_;
+        pos_ += bytes;
+        return at;
+    }
+
+    bool done() const { return pos_ == end_; }
+
+private:
+    const char* pos_;
+    const char* end_;
+};
+
+inline void decodeKeyframeSide(Reader& reader, Packing packing, double* levels) {
+    const char* in = reader.take(SIDE_VALUES * packedValueSize(packing));
+    if (packing == Packing::Raw64) {
+        binary_utils::decodeLevels(in, LEVELS, levels);
+        return;
+    }
+    for (size_t i = 0; i < LEVELS; ++i) {
+        in = unpackLevel(in, packing, levels + i * VALUES_PER_LEVEL);
+    }
+}
+
+// Splices the base side with the deleted and changed levels into a new side
+inline void decodeDeltaSide(Reader& reader, Packing packing, const double* base, double* levels) {
+    const uint16_t num_deletes = load<uint16_t>(reader.take(sizeof(uint16_t)));
+    const uint16_t num_changes = load<uint16_t>(reader.take(sizeof(uint16_t)));
+    if (num_deletes > LEVELS || num_changes > LEVELS) {
+        throw std::runtime_error("Invalid v3 delta op counts");
+    }
+    const char* deletes = reader.take(num_deletes * sizeof(uint16_t));
+    const size_t change_size = sizeof(uint16_t) + VALUES_PER_LEVEL * packedValueSize(packing);
+
+    size_t next = 0;      // Next level of the new side
+    size_t base_idx = 0;  // Next level of the base side
+    size_t del = 0;       // Next delete op
+
+    auto skipDeleted = [&]() {
+        while (del < num_deletes && load<uint16_t>(deletes + del * sizeof(uint16_t)) == base_idx) {
+            ++del;
+            ++base_idx;
+        }
+    };
+
+    // Copy unchanged base levels, in runs between deletes, until the new side reaches end
+    auto copyUntil = [&](size_t end) {
+        while (next < end) {
+            skipDeleted();
+            size_t run = end - next;
+            if (del < num_deletes) {
+                const size_t next_delete = load<uint16_t>(deletes + del * sizeof(uint16_t));
+                if (next_delete < base_idx) throw std::runtime_error("Unordered v3 delete ops");
+                run = std::min(run, next_delete - base_idx);
+            }
+            if (base_idx + run > LEVELS) throw std::runtime_error("v3 delta runs past the base side");
+            std::memcpy(levels + next * VALUES_PER_LEVEL, base + base_idx * VALUES_PER_LEVEL,
+                        run * VALUES_PER_LEVEL * sizeof(double));
+            next += run;
+            base_idx += run;
+        }
+    };
+
+    for (size_t c = 0; c < num_changes; ++c) {
+        const char* op = reader.take(change_size);
+        const uint16_t tagged = load<uint16_t>(op);
+        const size_t index = tagged & INDEX_MASK;
+        if (index < next || index >= LEVELS) throw std::runtime_error("Invalid v3 change index");
+
+        copyUntil(index);
+        if (!(tagged & INSERT_FLAG)) {
+            // An updated level replaces its base level
+            skipDeleted();
+            if (base_idx >= LEVELS) throw std::runtime_error("v3 update past the base side");
+            ++base_idx;
+        }
+        unpackLevel(op + sizeof(uint16_t), packing, levels + next * VALUES_PER_LEVEL);
+        ++next;
+    }
+    copyUntil(LEVELS);
+    skipDeleted();
+
+    if (base_idx != LEVELS || del != num_deletes) {
+        throw std::runtime_error("v3 delta does not cover the base side");
+    }
+}
+
+} // namespace detail
+
+// True for messages that carry a v3 header. v2 messages have no header and are
+// identified by their fixed size.
+inline bool isV3Message(const char* data, size_t size) {
+    return size != V2_MESSAGE_SIZE && size >= V3_MIN_HEADER_SIZE &&
+           static_cast<uint8_t>(data[0]) == VERSION_3;
+}
+
+inline MessageHeader parseHeader(const char* data, size_t size) {
+    if (!isV3Message(data, size)) {
+        throw std::runtime_error("Not a v3 orderbook message");
+    }
+
+    MessageHeader header;
+    header.version = static_cast<uint8_t>(data[0]);
+    header.flags = static_cast<uint8_t>(data[1]);
+    header.header_size = static_cast<uint8_t>(data[3]);
+    header.state_id = detail::load<uint16_t>(data + 4);
+    header.base_state_id = detail::load<uint16_t>(data + 6);
+    header.mid_price_cents = detail::load<uint32_t>(data + 8);
+
+    const uint8_t packing = static_cast<uint8_t>(data[2]);
+    if (packing > static_cast<uint8_t>(Packing::Fixed32)) {
+        throw std::runtime_error("Unknown v3 packing " + std::to_string(packing));
+    }
+    header.packing = static_cast<Packing>(packing);
+
+    if (header.header_size < V3_MIN_HEADER_SIZE || header.header_size > size) {
+        throw std::runtime_error("Invalid v3 header size " + std::to_string(header.header_size));
+    }
+    if (header.header_size >= V3_MIN_HEADER_SIZE + sizeof(uint64_t)) {
+        header.origin_ns = detail::load<uint64_t>(data + V3_MIN_HEADER_SIZE);
+    }
+    return header;
+}
+
+// Overwrite the origin of a v3 message in place, as a replay does so latencies are measured
+// from the replayed send; false for v2 messages and headers without an origin
+inline bool setOrigin(char* data, size_t size, uint64_t origin_ns) {
+    if (!isV3Message(data, size) || static_cast<uint8_t>(data[3]) < V3_MIN_HEADER_SIZE + sizeof(uint64_t) ||
+        static_cast<uint8_t>(data[3]) > size) {
+        return false;
+    }
+    detail::store<uint64_t>(data + V3_MIN_HEADER_SIZE, origin_ns);
+    return true;
+}
+
+// State ID of a v2 or v3 message, which must hold at least its header
+inline uint16_t stateIdOf(const char* data, size_t size) {
+    return isV3Message(data, size) ? detail::load<uint16_t>(data + 4)
+                                   : detail::load<uint16_t>(data + size - sizeof(uint16_t));
+}
+
+// Shift the state ID (and a v3 delta's base ID) of a message in place, as a replay does to
+// keep the IDs of a second pass after those of the first
+inline void offsetStateId(char* data, size_t size, uint16_t offset) {
+    if (isV3Message(data, size)) {
+        detail::store<uint16_t>(data + 4, static_cast<uint16_t>(detail::load<uint16_t>(data + 4) + offset));
+        detail::store<uint16_t>(data + 6, static_cast<uint16_t>(detail::load<uint16_t>(data + 6) + offset));
+    } else if (size >= sizeof(uint16_t)) {
+        char* id = data + size - sizeof(uint16_t);
+        detail::store<uint16_t>(id, static_cast<uint16_t>(detail::load<uint16_t>(id) + offset));
+    }
+}
+
+// Rebuilds a full state from a v3 message. base_bids/base_asks are the levels of the
+// state with header.base_state_id and are only read for deltas; they must not alias
+// the output arrays. Level arrays hold LEVELS interleaved [price, volume, orders].
+inline void decodeMessage(const char* data, size_t size, const MessageHeader& header,
+                          const double* base_bids, const double* base_asks,
+                          double* bids, double* asks, double* feature_values) {
+    detail::Reader reader(data, size);
+    reader.take(header.header_size);
+
+    const char* features = reader.take(FEATURE_VALUES * packedValueSize(header.packing));
+    if (header.packing == Packing::Raw64) {
+        binary_utils::decodeChangeValues(features, FEATURE_VALUES, feature_values);
+    } else {
+        for (size_t i = 0; i < FEATURE_VALUES; ++i) {
+            features = detail::unpackValue(features, true, header.packing, feature_values[i]);
+        }
+    }
+
+    if (header.keyframe()) {
+        detail::decodeKeyframeSide(reader, header.packing, bids);
+        detail::decodeKeyframeSide(reader, header.packing, asks);
+    } else {
+        if (!base_bids || !base_asks) {
+            throw std::runtime_error("v3 delta without a base state");
+        }
+        detail::decodeDeltaSide(reader, header.packing, base_bids, bids);
+        detail::decodeDeltaSide(reader, header.packing, base_asks, asks);
+    }
+
+    if (!reader.done()) {
+        throw std::runtime_error("Trailing bytes after v3 orderbook message");
+    }
+}
+
+// Producer side of v3: remembers the last published levels and emits only the
+// levels whose encoded values changed, with a keyframe every keyframe_interval states.
+class DeltaEncoder {
+public:
+    explicit DeltaEncoder(Packing packing = Packing::Raw64,
+                          size_t keyframe_interval = DEFAULT_KEYFRAME_INTERVAL)
+        : packing_(packing), keyframe_interval_(keyframe_interval > 0 ? keyframe_interval : 1) {}
+
+    Packing packing() const { return packing_; }
+    bool lastWasKeyframe() const { return last_was_keyframe_; }
+
+    // Next message is a keyframe, e.g. after a snapshot or a failed publish
+    void forceKeyframe() { have_base_ = false; }
+
+    // Encodes one state into out (resized to the message) and returns its size.
+    // bids/asks hold LEVELS interleaved [price, volume, orders], best level first.
+    size_t encode(const double* bids, const double* asks, const double* feature_values,
+                  uint32_t mid_price_cents, uint16_t state_id, std::vector<char>& out,
+                  uint64_t origin_ns = 0) {
+        SideState* current = sides_[current_];
+        const SideState* previous = sides_[1 - current_];
+        loadSide(bids, current[0]);
+        loadSide(asks, current[1]);
+
+        const size_t value_size = packedValueSize(packing_);
+        const size_t prefix_size = V3_HEADER_SIZE + FEATURE_VALUES * value_size;
+        const size_t keyframe_size = prefix_size + 2 * SIDE_VALUES * value_size;
+
+        bool keyframe = !have_base_ || states_since_keyframe_ + 1 >= keyframe_interval_;
+        size_t message_size = keyframe_size;
+        if (!keyframe) {
+            diffSide<true>(previous[0], current[0], ops_[0]);
+            diffSide<false>(previous[1], current[1], ops_[1]);
+            message_size = prefix_size + deltaSideSize(ops_[0]) + deltaSideSize(ops_[1]);
+            // Fall back to a keyframe when it is no larger, or when the size would read as v2
+            if (message_size >= keyframe_size || message_size == V2_MESSAGE_SIZE) {
+                keyframe = true;
+                message_size = keyframe_size;
+            }
+        }
+
+        out.resize(message_size);
+        char* data = out.data();
+        data[0] = static_cast<char>(VERSION_3);
+        data[1] = static_cast<char>(keyframe ? FLAG_KEYFRAME : 0);
+        data[2] = static_cast<char>(packing_);
+        data[3] = static_cast<char>(V3_HEADER_SIZE);
+        detail::store<uint16_t>(data + 4, state_id);
+        detail::store<uint16_t>(data + 6, keyframe ? state_id : base_state_id_);
+        detail::store<uint32_t>(data + 8, mid_price_cents);
+        detail::store<uint64_t>(data + V3_MIN_HEADER_SIZE, origin_ns);
+        char* pos = data + V3_HEADER_SIZE;
+
+        if (packing_ == Packing::Raw64) {
+            binary_utils::encodeChangeValues(feature_values, FEATURE_VALUES, pos);
+            pos += FEATURE_VALUES * sizeof(uint64_t);
+        } else {
+            for (size_t i = 0; i < FEATURE_VALUES; ++i) {
+                pos = detail::packValue(pos, binary_utils::encodeChangeValue(feature_values[i]), true, packing_);
+            }
+        }
+
+        if (keyframe) {
+            pos = writeKeyframeSide(pos, current[0]);
+            pos = writeKeyframeSide(pos, current[1]);
+            states_since_keyframe_ = 0;
+        } else {
+            pos = writeDeltaSide(pos, current[0], ops_[0]);
+            pos = writeDeltaSide(pos, current[1], ops_[1]);
+            ++states_since_keyframe_;
+        }
+
+        last_was_keyframe_ = keyframe;
+        have_base_ = true;
+        base_state_id_ = state_id;
+        current_ = 1 - current_;
+        return message_size;
+    }
+
+private:
+    struct SideState {
+        std::array<double, LEVELS> prices;
+        std::array<uint64_t, SIDE_VALUES> words;  // v2 encoded [price, volume, orders]
+    };
+
+    struct SideOps {
+        std::array<uint16_t, LEVELS> deletes;
+        std::array<uint16_t, LEVELS> changes;
+        size_t num_deletes = 0;
+        size_t num_changes = 0;
+    };
+
+    static void loadSide(const double* levels, SideState& side) {
+        binary_utils::encodeLevels(levels, LEVELS, reinterpret_cast<char*>(side.words.data()));
+        for (size_t i = 0; i < LEVELS; ++i) {
+            side.prices[i] = levels[i * VALUES_PER_LEVEL];
+        }
+    }
+
+    // Merge walk over both best-first sides, matching levels by exact price
+    template <bool IsBids>
+    static void diffSide(const SideState& previous, const SideState& current, SideOps& ops) {
+        ops.num_deletes = 0;
+        ops.num_changes = 0;
+        size_t i = 0;
+        size_t k = 0;
+        while (i < LEVELS || k < LEVELS) {
+            if (i < LEVELS && k < LEVELS && previous.prices[i] == current.prices[k]) {
+                if (std::memcmp(&previous.words[i * VALUES_PER_LEVEL], &current.words[k * VALUES_PER_LEVEL],
+                                VALUES_PER_LEVEL * sizeof(uint64_t)) != 0) {
+                    ops.changes[ops.num_changes++] = static_cast<uint16_t>(k);
+                }
+                ++i;
+                ++k;
+            } else if (k == LEVELS ||
+                       (i < LEVELS && (IsBids ? previous.prices[i] > current.prices[k]
+                                              : previous.prices[i] < current.prices[k]))) {
+                ops.deletes[ops.num_deletes++] = static_cast<uint16_t>(i++);
+            } else {
+                ops.changes[ops.num_changes++] = static_cast<uint16_t>(k++) | INSERT_FLAG;
+            }
+        }
+    }
+
+    size_t deltaSideSize(const SideOps& ops) const {
+        return 2 * sizeof(uint16_t) + ops.num_deletes * sizeof(uint16_t) +
+               ops.num_changes * (sizeof(uint16_t) + VALUES_PER_LEVEL * packedValueSize(packing_));
+    }
+
+    char* writeKeyframeSide(char* pos, const SideState& side) const {
+        if (packing_ == Packing::Raw64) {
+            std::memcpy(pos, side.words.data(), SIDE_VALUES * sizeof(uint64_t));
+            return pos + SIDE_VALUES * sizeof(uint64_t);
+        }
+        for (size_t i = 0; i < LEVELS; ++i) {
+            pos = detail::packLevel(pos, &side.words[i * VALUES_PER_LEVEL], packing_);
+        }
+        return pos;
+    }
+
+    char* writeDeltaSide(char* pos, const SideState& side, const SideOps& ops) const {
+        detail::store<uint16_t>(pos, static_cast<uint16_t>(ops.num_deletes));
+        detail::store<uint16_t>(pos + sizeof(uint16_t), static_cast<uint16_t>(ops.num_changes));
+        pos += 2 * sizeof(uint16_t);
+
+        std::memcpy(pos, ops.deletes.data(), ops.num_deletes * sizeof(uint16_t));
+        pos += ops.num_deletes * sizeof(uint16_t);
+
+        for (size_t c = 0; c < ops.num_changes; ++c) {
+            const uint16_t tagged = ops.changes[c];
+            detail::store<uint16_t>(pos, tagged);
+            pos = detail::packLevel(pos + sizeof(uint16_t),
+                                    &side.words[(tagged & INDEX_MASK) * VALUES_PER_LEVEL], packing_);
+        }
+        return pos;
+    }
+
+    Packing packing_;
+    size_t keyframe_interval_;
+    SideState sides_[2][2];  // [buffer][bids, asks], current and previously published
+    size_t current_ = 0;
+    SideOps ops_[2];
+    bool have_base_ = false;
+    bool last_was_keyframe_ = false;
+    uint16_t base_state_id_ = 0;
+    size_t states_since_keyframe_ = 0;
+};
+
+} // namespace orderbook_wire
@@ -0,0 +1,309 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Single-writer ring of fixed-size message slots in POSIX shared memory (/dev/shm), for
+// services on one host. Each slot is guarded by a seqlock: the writer makes the slot's
+// sequence odd, copies the message in and publishes an even sequence, so it never waits for
+// readers. A reader copies a slot out and keeps it only if the sequence did not move
+// meanwhile; a reader that falls a whole ring behind skips to the newest message.
+//
+// The writer holds an exclusive flock on the segment for its lifetime, so a second writer on
+// the same ring fails instead of corrupting its slots. A segment of a different layout is never
+// resized under readers that map it: the writer retires it (readers see the magic cleared and
+// re-attach), unlinks it and creates a fresh one under the same name.
+//
+// Layout: one cache line of header, then CAPACITY slots of SLOT_HEADER + slot_size bytes,
+// each rounded up to a cache line. Message n lives in slot n % capacity and, once complete,
+// carries sequence 2n + 2.
+namespace shm {
+
+constexpr uint64_t RING_MAGIC = 0x7274647070'6f7231ULL;  // "rtdppor1"
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+struct RingHeader {
+    uint64_t magic;
+    uint32_t slot_size;      // Largest message
+    uint32_t slot_stride;    // Bytes between slots
+    uint64_t capacity;       // Slots, a power of two
+    std::atomic<uint64_t> head;  // Messages written so far
+};
+
+struct SlotHeader {
+    std::atomic<uint64_t> sequence;
+    uint32_t size;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(RingHeader) <= CACHE_LINE_SIZE, "Ring header must fit one cache line");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Sequences must be lock-free across processes");
+
+inline size_t slotStride(size_t slot_size) {
+    const size_t bytes = sizeof(SlotHeader) + slot_size;
+    return (bytes + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+}
+
+// A mapping of one ring; the writer creates it, readers open it
+class Mapping {
+public:
+    Mapping() = default;
+    ~Mapping() { reset(); }
+    Mapping(const Mapping&) = delete;
+    Mapping& operator=(const Mapping&) = delete;
+
+    bool valid() const { return base_ != nullptr; }
+    RingHeader* header() const { return static_cast<RingHeader*>(base_); }
+    SlotHeader* slot(uint64_t n) const {
+        const uint64_t index = n & (header()->capacity - 1);
+        return reinterpret_cast<SlotHeader*>(static_cast<char*>(base_) + CACHE_LINE_SIZE +
+                                             index * header()->slot_stride);
+    }
+    static char* payload(SlotHeader* slot) { return reinterpret_cast<char*>(slot + 1); }
+
+    // Writer: create the ring or reuse a compatible one, keeping its head so readers that are
+    // already attached carry on. Throws if another writer holds the ring.
+    void create(const std::string& name, size_t slot_size, size_t capacity) {
+        if (capacity < 2 || (capacity & (capacity - 1)) != 0) {
+            throw std::invalid_argument("Ring capacity must be a power of two");
+        }
+        const size_t stride = slotStride(slot_size);
+        const size_t bytes = CACHE_LINE_SIZE + capacity * stride;
+
+        int fd = ::shm_open(name.c_str(), O_RDWR, 0600);
+        if (fd >= 0) {
+            lockWriter(fd, name);
+            struct stat st {};
+            if (::fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) == bytes) {
+                mapOrClose(fd, bytes, name);
+                const RingHeader* h = header();
+                if (h->magic == RING_MAGIC && h->slot_size == slot_size && h->capacity == capacity) {
+                    fd_ = fd;
+                    return;  // Compatible: keep the head and the attached readers
+                }
+                reset();
+            }
+            retire(fd, static_cast<size_t>(st.st_size));
+            ::shm_unlink(name.c_str());
+            ::close(fd);
+        }
+
+        fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) {
+            throw std::runtime_error("shm_open " + name + " failed: " + std::strerror(errno));
+        }
+        lockWriter(fd, name);
+        if (::ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Sizing " + name + " failed: " + std::strerror(errno));
+        }
+        mapOrClose(fd, bytes, name);
+        fd_ = fd;
+
+        RingHeader* h = header();
+        h->slot_size = static_cast<uint32_t>(slot_size);
+        h->slot_stride = static_cast<uint32_t>(stride);
+        h->capacity = capacity;
+        h->head.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        h->magic = RING_MAGIC;
+    }
+
+    // Reader: false while the writer has not created the ring yet
+    bool open(const std::string& name) {
+        const int fd = ::shm_open(name.c_str(), O_RDWR, 0600);
+        if (fd < 0) return false;
+        struct stat st {};
+        if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < CACHE_LINE_SIZE) {
+            ::close(fd);
+            return false;
+        }
+        try {
+            mapOrClose(fd, static_cast<size_t>(st.st_size), name);
+        } catch (const std::exception&) {
+            return false;
+        }
+        ::close(fd);
+        const RingHeader* h = header();
+        if (h->magic != RING_MAGIC || CACHE_LINE_SIZE + h->capacity * h->slot_stride > size_) {
+            reset();
+            return false;
+        }
+        return true;
+    }
+
+    // Reader: the writer replaced the ring this mapping still shows
+    bool retired() const { return header()->magic != RING_MAGIC; }
+
+    void reset() {
+        if (base_) {
+            ::munmap(base_, size_);
+            base_ = nullptr;
+            size_ = 0;
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);  // Releases the writer's lock
+            fd_ = -1;
+        }
+    }
+
+private:
+    // The fd stays with the caller
+    void map(int fd, size_t bytes, const std::string& name) {
+        void* base = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) {
+            throw std::runtime_error("Mapping " + name + " failed: " + std::strerror(errno));
+        }
+        if (base_) {
+            ::munmap(base_, size_);
+        }
+        base_ = base;
+        size_ = bytes;
+    }
+
+    void mapOrClose(int fd, size_t bytes, const std::string& name) {
+        try {
+            map(fd, bytes, name);
+        } catch (const std::exception&) {
+            ::close(fd);
+            throw;
+        }
+    }
+
+    static void lockWriter(int fd, const std::string& name) {
+        if (::flock(fd, LOCK_EX | LOCK_NB) != 0) {
+            const int error = errno;
+            ::close(fd);
+            throw std::runtime_error(error == EWOULDBLOCK ? "Ring " + name + " already has a writer"
+                                                          : "Locking " + name + " failed: " + std::strerror(error));
+        }
+    }
+
+    // Clear the magic of a segment about to be unlinked, at its current size
+    static void retire(int fd, size_t bytes) {
+        if (bytes < CACHE_LINE_SIZE) return;
+        void* base = ::mmap(nullptr, CACHE_LINE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) return;
+        static_cast<RingHeader*>(base)->magic = 0;
+        std::atomic_thread_fence(std::memory_order_release);
+        ::munmap(base, CACHE_LINE_SIZE);
+    }
+
+    void* base_ = nullptr;
+    size_t size_ = 0;
+    int fd_ = -1;  // Writer only: the locked segment
+};
+
+class RingWriter {
+public:
+    RingWriter(const std::string& name, size_t slot_size, size_t capacity) {
+        mapping_.create(name, slot_size, capacity);
+        slot_size_ = slot_size;
+    }
+
+    size_t slotSize() const { return slot_size_; }
+
+    // False if the message does not fit a slot
+    bool write(const char* data, size_t size) {
+        if (size > slot_size_) return false;
+        RingHeader* h = mapping_.header();
+        const uint64_t n = h->head.load(std::memory_order_relaxed);
+        SlotHeader* slot = mapping_.slot(n);
+
+        slot->sequence.store(2 * n + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);  // Odd before any payload byte
+        slot->size = static_cast<uint32_t>(size);
+        std::memcpy(Mapping::payload(slot), data, size);
+        slot->sequence.store(2 * n + 2, std::memory_order_release);
+        h->head.store(n + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    Mapping mapping_;
+    size_t slot_size_ = 0;
+};
+
+class RingReader {
+public:
+    explicit RingReader(std::string name) : name_(std::move(name)) {}
+
+    // Attach to the ring, starting after the newest message; false until the writer made it
+    bool attach() {
+        if (mapping_.valid()) return true;
+        if (!mapping_.open(name_)) return false;
+        buffer_.resize(mapping_.header()->slot_size);
+        next_ = mapping_.header()->head.load(std::memory_order_acquire);
+        return true;
+    }
+
+    // Copy the next message into the reader's buffer; false when there is none yet. The view
+    // stays valid until the next call.
+    bool read(const char*& data, size_t& size) {
+        if (!attach()) return false;
+        RingHeader* h = mapping_.header();
+        for (;;) {
+            const uint64_t head = h->head.load(std::memory_order_acquire);
+            if (next_ >= head) {
+                if (mapping_.retired()) {
+                    mapping_.reset();  // Recreated with another layout; attach to the new one
+                    return false;
+                }
+                if (next_ > head) next_ = head;  // The writer restarted with a fresh ring
+                return false;
+            }
+            if (head - next_ >= h->capacity) {
+                skipped_ += head - 1 - next_;
+                next_ = head - 1;  // Lapped: only the newest message is still safe to read
+            }
+
+            SlotHeader* slot = mapping_.slot(next_);
+            const uint64_t expected = 2 * next_ + 2;
+            const uint64_t before = slot->sequence.load(std::memory_order_acquire);
+            if (before == expected) {
+                const size_t length = std::min<size_t>(slot->size, buffer_.size());
+                std::memcpy(buffer_.data(), Mapping::payload(slot), length);
+                std::atomic_thread_fence(std::memory_order_acquire);  // Payload before the re-check
+                if (slot->sequence.load(std::memory_order_relaxed) == expected) {
+                    ++next_;
+                    data = buffer_.data();
+                    size = length;
+                    return true;
+                }
+            }
+            // Overwritten by a lapping writer while we looked: the message is lost
+            ++skipped_;
+            ++next_;
+        }
+    }
+
+    // Messages already written that read() has not returned yet
+    uint64_t pending() const {
+        if (!mapping_.valid()) return 0;
+        const uint64_t head = mapping_.header()->head.load(std::memory_order_acquire);
+        return head > next_ ? head - next_ : 0;
+    }
+
+    // Messages lost to the writer lapping this reader
+    uint64_t skipped() const { return skipped_; }
+
+private:
+    std::string name_;
+    Mapping mapping_;
+    std::vector<char> buffer_;
+    uint64_t next_ = 0;
+    uint64_t skipped_ = 0;
+};
+
+} // namespace shm
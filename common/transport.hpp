@@ -0,0 +1,149 @@
+#pragma once
+#include <amqp.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <async_logger.hpp>
+#include <shm_ring.hpp>
+
+// Message transports between the services. RabbitMQ is the default and works across hosts;
+// services on one host can instead pass orderbook states and actions through shared-memory
+// rings (shm_ring.hpp), skipping the broker hop. The rings broadcast: readers never hold the
+// writer back and a reader that falls a whole ring behind loses the oldest messages.
+//
+// Publishing goes through Publisher for either transport. Consuming does not: a service's
+// RabbitMQ queues share one connection and arrive interleaved through amqp_consumer.hpp,
+// while each ring is read on its own, so only the rings have subscriber classes here.
+namespace transport {
+
+enum class Kind {
+    RabbitMQ,
+    Shm
+};
+
+inline bool parseKind(const std::string& name, Kind& kind) {
+    if (name == "rabbitmq") {
+        kind = Kind::RabbitMQ;
+    } else if (name == "shm") {
+        kind = Kind::Shm;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Shared-memory ring carrying the messages of a routing key, e.g. /rtdppo.orderbook.updates.BTC-USDT-SWAP
+inline std::string ringName(const std::string& routing_key) { return "/rtdppo." + routing_key; }
+
+// The actions of one instrument's PPO process; every ring has a single writer, so each
+// process gets its own and the OMS reads the one of the instrument it trades
+inline std::string actionRingName(const std::string& instrument) { return ringName("oms.action." + instrument); }
+
+class Publisher {
+public:
+    virtual ~Publisher() = default;
+    // False if the message was not taken (queue full, too large, broker error)
+    virtual bool publish(const char* data, size_t size) = 0;
+    // True once after messages that publish() took were lost later on, e.g. nacked by a broker,
+    // so a delta stream should resync with a keyframe
+    virtual bool takeResync() { return false; }
+};
+
+class ShmPublisher : public Publisher {
+public:
+    ShmPublisher(const std::string& name, size_t slot_size, size_t capacity)
+        : ring_(name, slot_size, capacity) {}
+
+    bool publish(const char* data, size_t size) override { return ring_.write(data, size); }
+
+private:
+    shm::RingWriter ring_;
+};
+
+// Waits for read() to return true: spins for SPIN_TIME, then sleeps SLEEP_STEP between checks
+template <typename Read>
+bool waitFor(Read&& read, std::chrono::microseconds timeout) {
+    constexpr auto SPIN_TIME = std::chrono::microseconds(20);
+    constexpr auto SLEEP_STEP = std::chrono::microseconds(50);
+    const auto start = std::chrono::steady_clock::now();
+    for (;;) {
+        if (read()) return true;
+        const auto waited = std::chrono::steady_clock::now() - start;
+        if (waited >= timeout) return false;
+        if (waited >= SPIN_TIME) {
+            std::this_thread::sleep_for(SLEEP_STEP);
+        }
+    }
+}
+
+// Reads one ring. The views it returns are valid until its next read.
+class ShmSubscriber {
+public:
+    explicit ShmSubscriber(const std::string& name) : name_(name), ring_(name) {}
+
+    // Next message, waiting up to timeout for one
+    bool poll(std::string_view& message, std::chrono::microseconds timeout) {
+        return waitFor([&] { return read(message); }, timeout);
+    }
+
+    // A newer message is already waiting
+    bool backlogged() const { return ring_.pending() > 0; }
+
+    // Next message if one is waiting
+    bool read(std::string_view& message) {
+        if (!attached_) {
+            if (!ring_.attach()) return false;
+            attached_ = true;
+            LOG_INFO("Attached to shared-memory ring {}", name_);
+        }
+        const char* data = nullptr;
+        size_t size = 0;
+        if (!ring_.read(data, size)) return false;
+        if (ring_.skipped() != reported_skipped_) {
+            reported_skipped_ = ring_.skipped();
+            LOG_RATE_LIMITED(1000, Warn, "Reader of {} fell behind, {} messages skipped so far", name_,
+                             reported_skipped_);
+        }
+        message = std::string_view(data, size);
+        return true;
+    }
+
+private:
+    std::string name_;
+    shm::RingReader ring_;
+    bool attached_ = false;
+    uint64_t reported_skipped_ = 0;
+};
+
+// Publishes straight on a rabbitmq-c connection the caller owns and publishes from one thread
+class AmqpPublisher : public Publisher {
+public:
+    AmqpPublisher(amqp_connection_state_t conn, amqp_channel_t channel, std::string exchange,
+                  std::string routing_key, bool persistent = true)
+        : conn_(conn), channel_(channel), exchange_(std::move(exchange)), routing_key_(std::move(routing_key)) {
+        props_._flags = AMQP_BASIC_CONTENT_TYPE_FLAG | AMQP_BASIC_DELIVERY_MODE_FLAG;
+        props_.content_type = amqp_cstring_bytes("application/octet-stream");
+        props_.delivery_mode = persistent ? 2 : 1;
+    }
+
+    bool publish(const char* data, size_t size) override {
+        const int status = amqp_basic_publish(conn_, channel_, amqp_cstring_bytes(exchange_.c_str()),
+                                              amqp_cstring_bytes(routing_key_.c_str()), 0, 0, &props_,
+                                              amqp_bytes_t{size, const_cast<char*>(data)});
+        return status == AMQP_STATUS_OK;
+    }
+
+private:
+    amqp_connection_state_t conn_;
+    amqp_channel_t channel_;
+    std::string exchange_;
+    std::string routing_key_;
+    amqp_basic_properties_t props_{};
+};
+
+} // namespace transport
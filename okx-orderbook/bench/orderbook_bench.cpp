@@ -0,0 +1,494 @@
+// Hot path benchmarks of the orderbook service on synthetic BTC-USDT-SWAP books:
+//
+//   orderbook_bench --benchmark_out=orderbook.json --benchmark_out_format=json
+//
+// The books messages are generated in OKX's books channel format from a fixed seed, so every
+// run and every commit sees the same payloads: a 400-level snapshot followed by updates that
+// change, remove and insert levels. --benchmark_perf_counters=CYCLES,INSTRUCTIONS adds hardware
+// counters when Google Benchmark is built with libpfm.
+#include "../include/orderbook_handler.hpp"
+#include "../include/alloc_counter.hpp"
+#include "../include/decimal_parser.hpp"
+#include <binary_utils.hpp>
+#include <async_logger.hpp>
+#include <benchmark/benchmark.h>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Reaches the handler's feature and publish stages on their own, see the friend declaration
+struct OrderBookBenchAccess {
+    static OrderBookFeatures calculateFeatures(const OrderBookHandler& handler) { return handler.calculateFeatures(); }
+    static void publishOrderBookUpdate(OrderBookHandler& handler) { handler.publishOrderBookUpdate(); }
+};
+
+namespace {
+
+constexpr size_t BOOK_LEVELS = 400;
+constexpr size_t UPDATES = 1024;        // Update messages per feed, replayed from the snapshot
+constexpr int64_t MID_TICKS = 650000;   // 65000.0 in 0.1 ticks
+constexpr int64_t LEVEL_SPACING = 2;    // Every other tick, so levels can be inserted between
+constexpr uint64_t SEED = 20240101;
+
+// One [price, size, liquidated orders, orders] entry; volume 0 removes the level
+struct Entry {
+    int64_t ticks;
+    double volume;
+    int orders;
+};
+
+struct Update {
+    std::vector<Entry> asks;
+    std::vector<Entry> bids;
+};
+
+// A message with the receive buffer padding the handler parses over
+struct PaddedMessage {
+    std::vector<char> buffer;
+    size_t size = 0;
+
+    explicit PaddedMessage(const std::string& text)
+        : buffer(text.size() + WebSocketClient::RX_PADDING, '\0'), size(text.size()) {
+        std::memcpy(buffer.data(), text.data(), text.size());
+    }
+    std::string_view view() const { return {buffer.data(), size}; }
+};
+
+void appendEntry(std::string& out, const Entry& entry) {
+    char text[96];
+    std::snprintf(text, sizeof(text), R"(["%lld.%lld","%.2f","0","%d"])",
+                  static_cast<long long>(entry.ticks / 10), static_cast<long long>(entry.ticks % 10),
+                  entry.volume, entry.orders);
+    out += text;
+}
+
+void appendSide(std::string& out, const char* name, const std::vector<Entry>& entries) {
+    out += '"';
+    out += name;
+    out += "\":[";
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (i > 0) out += ',';
+        appendEntry(out, entries[i]);
+    }
+    out += ']';
+}
+
+std::string booksMessage(const char* action, const Update& update, uint64_t seq_id) {
+    std::string out = R"({"arg":{"channel":"books","instId":"BTC-USDT-SWAP"},"action":")";
+    out += action;
+    out += R"(","data":[{)";
+    appendSide(out, "asks", update.asks);
+    out += ',';
+    appendSide(out, "bids", update.bids);
+    out += R"(,"ts":")" + std::to_string(1700000000000ULL + seq_id * 10) + R"(","checksum":0,"seqId":)" +
+           std::to_string(seq_id) + R"(,"prevSeqId":)" + std::to_string(seq_id - 1) + "}]}";
+    return out;
+}
+
+// Level model of one side that only generates updates keeping it at BOOK_LEVELS levels
+class SideModel {
+public:
+    SideModel(int64_t lowest, std::mt19937_64& rng) : rng_(rng) {
+        for (size_t i = 0; i < BOOK_LEVELS; ++i) {
+            levels_[lowest + LEVEL_SPACING * static_cast<int64_t>(i)] = randomLevel();
+        }
+    }
+
+    std::vector<Entry> snapshot() const {
+        std::vector<Entry> entries;
+        for (const auto& [ticks, level] : levels_) entries.push_back({ticks, level.first, level.second});
+        return entries;
+    }
+
+    // changes volume updates, plus one removal and insertion for every four of them. Only inner
+    // levels are removed, so the price range and the number of free ticks in it stay fixed.
+    void update(size_t changes, std::vector<Entry>& out) {
+        for (size_t c = 0; c < changes; ++c) {
+            auto it = pick();
+            it->second = randomLevel();
+            out.push_back({it->first, it->second.first, it->second.second});
+
+            if (c % 4 == 3) {
+                // Insert into a gap between two levels, then remove another level
+                const int64_t gap = freeTick();
+                const auto level = randomLevel();
+                levels_[gap] = level;
+                out.push_back({gap, level.first, level.second});
+
+                auto removed = pick(1);
+                while (removed->first == gap) removed = pick(1);
+                out.push_back({removed->first, 0.0, 0});
+                levels_.erase(removed);
+            }
+        }
+    }
+
+private:
+    std::pair<double, int> randomLevel() {
+        return {std::uniform_int_distribution<int>(1, 50000)(rng_) / 100.0,
+                std::uniform_int_distribution<int>(1, 40)(rng_)};
+    }
+
+    // A random level, at least margin levels away from both ends
+    std::map<int64_t, std::pair<double, int>>::iterator pick(size_t margin = 0) {
+        auto it = levels_.begin();
+        std::advance(it, std::uniform_int_distribution<size_t>(margin, levels_.size() - 1 - margin)(rng_));
+        return it;
+    }
+
+    int64_t freeTick() {
+        auto it = levels_.begin();
+        std::advance(it, std::uniform_int_distribution<size_t>(0, levels_.size() - 2)(rng_));
+        while (true) {
+            auto next = std::next(it);
+            if (next == levels_.end()) it = levels_.begin(), next = std::next(it);
+            if (next->first - it->first > 1) return it->first + 1;
+            it = next;
+        }
+    }
+
+    std::mt19937_64& rng_;
+    std::map<int64_t, std::pair<double, int>> levels_;  // Volume and orders by price
+};
+
+// A snapshot and the updates following it, generated once per number of changed levels
+struct Feed {
+    std::vector<Update> updates;
+    std::unique_ptr<PaddedMessage> snapshot;
+    std::vector<PaddedMessage> messages;
+    std::vector<Entry> snapshot_bids;
+
+    static const Feed& get(size_t changes) {
+        static std::map<size_t, Feed> feeds;
+        auto it = feeds.find(changes);
+        if (it == feeds.end()) {
+            it = feeds.emplace(changes, Feed(changes)).first;
+        }
+        return it->second;
+    }
+
+private:
+    explicit Feed(size_t changes) {
+        std::mt19937_64 rng(SEED + changes);
+        SideModel asks(MID_TICKS + 1, rng);
+        SideModel bids(MID_TICKS - 1 - LEVEL_SPACING * static_cast<int64_t>(BOOK_LEVELS - 1), rng);
+
+        Update initial{asks.snapshot(), bids.snapshot()};
+        snapshot_bids = initial.bids;
+        snapshot = std::make_unique<PaddedMessage>(booksMessage("snapshot", initial, 1));
+        for (size_t i = 0; i < UPDATES; ++i) {
+            Update update;
+            asks.update(changes, update.asks);
+            bids.update(changes, update.bids);
+            messages.emplace_back(booksMessage("update", update, i + 2));
+            updates.push_back(std::move(update));
+        }
+    }
+};
+
+// Takes every state like an idle broker, counting what would have gone out
+class NullPublisher : public transport::Publisher {
+public:
+    bool publish(const char* data, size_t size) override {
+        benchmark::DoNotOptimize(data);
+        bytes += size;
+        return true;
+    }
+    uint64_t bytes = 0;
+};
+
+struct Handler {
+    OrderBookHandler handler{nullptr, nullptr, "BTC-USDT-SWAP"};
+    NullPublisher* publisher = nullptr;
+
+    explicit Handler(WireFormat format, orderbook_wire::Packing packing = orderbook_wire::Packing::Raw64) {
+        auto sink = std::make_unique<NullPublisher>();
+        publisher = sink.get();
+        handler.setPublisher(std::move(sink));
+        handler.setWireFormat(format, packing);
+    }
+};
+
+WireFormat formatArg(int64_t value) { return value == 3 ? WireFormat::V3 : WireFormat::V2; }
+
+// Whole books message: parse, apply every level, features, encode and publish.
+// Args: changed levels per side, wire format (2 or 3)
+void BM_HandleUpdate(benchmark::State& state) {
+    const Feed& feed = Feed::get(static_cast<size_t>(state.range(0)));
+    Handler book(formatArg(state.range(1)));
+    book.handler.handleMessage(feed.snapshot->view());
+
+    size_t next = 0;
+    uint64_t bytes = 0;
+    const uint64_t allocations_before = alloc_counter::threadAllocations();
+    for (auto _ : state) {
+        if (next == feed.messages.size()) {
+            state.PauseTiming();
+            book.handler.handleMessage(feed.snapshot->view());
+            next = 0;
+            state.ResumeTiming();
+        }
+        const PaddedMessage& message = feed.messages[next++];
+        book.handler.handleMessage(message.view());
+        bytes += message.size;
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.counters["allocations"] = benchmark::Counter(
+        static_cast<double>(alloc_counter::threadAllocations() - allocations_before), benchmark::Counter::kAvgIterations);
+    state.counters["published_bytes"] = benchmark::Counter(
+        static_cast<double>(book.publisher->bytes), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_HandleUpdate)
+    ->ArgNames({"levels", "wire"})
+    ->ArgsProduct({{1, 10, 50}, {2, 3}});
+
+// Snapshot parse, sort and first publish
+void BM_HandleSnapshot(benchmark::State& state) {
+    const Feed& feed = Feed::get(10);
+    Handler book(WireFormat::V2);
+    for (auto _ : state) {
+        book.handler.handleMessage(feed.snapshot->view());
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * feed.snapshot->size));
+}
+BENCHMARK(BM_HandleSnapshot);
+
+// The book side updates behind updatePriceLevel, without the JSON parse.
+// Arg: changed levels per side of the updates applied
+void BM_BookSideApply(benchmark::State& state) {
+    const Feed& feed = Feed::get(static_cast<size_t>(state.range(0)));
+    OrderBookSide<true> side;
+    auto load = [&]() {
+        side.clear();
+        for (const Entry& entry : feed.snapshot_bids) {
+            side.append(entry.ticks, entry.ticks / 10.0, entry.volume, entry.orders);
+        }
+        side.sort();
+    };
+    load();
+
+    size_t next = 0;
+    int64_t applied = 0;
+    for (auto _ : state) {
+        if (next == feed.updates.size()) {
+            state.PauseTiming();
+            load();
+            next = 0;
+            state.ResumeTiming();
+        }
+        for (const Entry& entry : feed.updates[next].bids) {
+            side.apply(entry.ticks, entry.ticks / 10.0, entry.volume, entry.orders);
+        }
+        applied += static_cast<int64_t>(feed.updates[next++].bids.size());
+        benchmark::DoNotOptimize(side.data());
+    }
+    state.SetItemsProcessed(applied);
+}
+BENCHMARK(BM_BookSideApply)->ArgName("levels")->Arg(1)->Arg(10)->Arg(50);
+
+void BM_CalculateFeatures(benchmark::State& state) {
+    Handler book(WireFormat::V2);
+    book.handler.handleMessage(Feed::get(10).snapshot->view());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(OrderBookBenchAccess::calculateFeatures(book.handler));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CalculateFeatures);
+
+// Features, encoding and publishing one state of an unchanged book.
+// Args: wire format (2 or 3), v3 packing (0 raw64, 1 fixed32)
+void BM_PublishOrderBookUpdate(benchmark::State& state) {
+    const auto packing = state.range(1) == 1 ? orderbook_wire::Packing::Fixed32 : orderbook_wire::Packing::Raw64;
+    Handler book(formatArg(state.range(0)), packing);
+    book.handler.handleMessage(Feed::get(10).snapshot->view());
+    const uint64_t published_before = book.publisher->bytes;
+    for (auto _ : state) {
+        OrderBookBenchAccess::publishOrderBookUpdate(book.handler);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(static_cast<int64_t>(book.publisher->bytes - published_before));
+}
+BENCHMARK(BM_PublishOrderBookUpdate)
+    ->ArgNames({"wire", "packing"})
+    ->Args({2, 0})
+    ->Args({3, 0})
+    ->Args({3, 1});
+
+// ---- Price and size strings, as the handler parses the level fields
+
+// The price, size and order count fields of a snapshot's bids, formatted as OKX sends them
+const std::vector<std::string>& levelFields() {
+    static const std::vector<std::string> fields = [] {
+        std::vector<std::string> out;
+        char text[32];
+        for (const Entry& entry : Feed::get(10).snapshot_bids) {
+            std::snprintf(text, sizeof(text), "%lld.%lld", static_cast<long long>(entry.ticks / 10),
+                          static_cast<long long>(entry.ticks % 10));
+            out.emplace_back(text);
+            std::snprintf(text, sizeof(text), "%.2f", entry.volume);
+            out.emplace_back(text);
+            out.push_back(std::to_string(entry.orders));
+        }
+        return out;
+    }();
+    return fields;
+}
+
+// The parser's case: the handler needs every price as integer ticks, the book side's level key,
+// as well as the double. Compare BM_FromCharsTicks, the same output from std::from_chars.
+void BM_ParseDecimalTicks(benchmark::State& state) {
+    const auto& fields = levelFields();
+    for (auto _ : state) {
+        for (const std::string& field : fields) {
+            double value;
+            int64_t ticks;
+            benchmark::DoNotOptimize(decimal::parseWithTicks(field, value, ticks));
+            benchmark::DoNotOptimize(value);
+            benchmark::DoNotOptimize(ticks);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * fields.size()));
+}
+BENCHMARK(BM_ParseDecimalTicks);
+
+// std::from_chars and ticks rounded from the double, which are not exact for every string
+void BM_FromCharsTicks(benchmark::State& state) {
+    const auto& fields = levelFields();
+    for (auto _ : state) {
+        for (const std::string& field : fields) {
+            double value;
+            benchmark::DoNotOptimize(std::from_chars(field.data(), field.data() + field.size(), value));
+            const int64_t ticks = std::llround(value * decimal::detail::POW10[decimal::TICK_DECIMALS]);
+            benchmark::DoNotOptimize(value);
+            benchmark::DoNotOptimize(ticks);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * fields.size()));
+}
+BENCHMARK(BM_FromCharsTicks);
+
+// The double alone
+void BM_ParseDecimal(benchmark::State& state) {
+    const auto& fields = levelFields();
+    for (auto _ : state) {
+        for (const std::string& field : fields) {
+            double value;
+            benchmark::DoNotOptimize(decimal::parse(field, value));
+            benchmark::DoNotOptimize(value);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * fields.size()));
+}
+BENCHMARK(BM_ParseDecimal);
+
+// The standard library's correctly rounded parser, without locale or errno handling
+void BM_FromChars(benchmark::State& state) {
+    const auto& fields = levelFields();
+    for (auto _ : state) {
+        for (const std::string& field : fields) {
+            double value;
+            benchmark::DoNotOptimize(std::from_chars(field.data(), field.data() + field.size(), value));
+            benchmark::DoNotOptimize(value);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * fields.size()));
+}
+BENCHMARK(BM_FromChars);
+
+// The libc baseline decimal::parse must match bit for bit
+void BM_ParseStrtod(benchmark::State& state) {
+    const auto& fields = levelFields();
+    for (auto _ : state) {
+        for (const std::string& field : fields) {
+            benchmark::DoNotOptimize(std::strtod(field.c_str(), nullptr));
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * fields.size()));
+}
+BENCHMARK(BM_ParseStrtod);
+
+// ---- binary_utils batch codecs, once per codec path this CPU supports
+
+std::vector<binary_utils::detail::BatchCodec> supportedCodecs() {
+    using namespace binary_utils::detail;
+    std::vector<BatchCodec> codecs{scalarCodec()};
+#ifdef BINARY_UTILS_X86_SIMD
+    for (const BatchCodec& codec : {avx2Codec(), avx512Codec()}) {
+        if (cpuSupports(codec.path)) codecs.push_back(codec);
+    }
+#endif
+    return codecs;
+}
+
+// The levels of both sides of a snapshot, interleaved [price, volume, orders]
+std::vector<double> bookValues() {
+    std::vector<double> values;
+    for (const Entry& entry : Feed::get(10).snapshot_bids) {
+        values.insert(values.end(), {entry.ticks / 10.0, entry.volume, static_cast<double>(entry.orders)});
+    }
+    return values;
+}
+
+void registerCodecBenchmarks() {
+    for (const auto& codec : supportedCodecs()) {
+        benchmark::RegisterBenchmark(("BM_EncodeLevels/" + std::string(codec.name)).c_str(),
+                                     [codec](benchmark::State& state) {
+            const std::vector<double> levels = bookValues();
+            std::vector<char> out(levels.size() * sizeof(uint64_t));
+            for (auto _ : state) {
+                codec.encodeLevels(levels.data(), BOOK_LEVELS, out.data());
+                benchmark::ClobberMemory();
+            }
+            state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * out.size()));
+        });
+        benchmark::RegisterBenchmark(("BM_DecodeLevels/" + std::string(codec.name)).c_str(),
+                                     [codec](benchmark::State& state) {
+            std::vector<double> levels = bookValues();
+            std::vector<char> encoded(levels.size() * sizeof(uint64_t));
+            codec.encodeLevels(levels.data(), BOOK_LEVELS, encoded.data());
+            for (auto _ : state) {
+                codec.decodeLevels(encoded.data(), BOOK_LEVELS, levels.data());
+                benchmark::ClobberMemory();
+            }
+            state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * encoded.size()));
+        });
+        benchmark::RegisterBenchmark(("BM_EncodeChangeValues/" + std::string(codec.name)).c_str(),
+                                     [codec](benchmark::State& state) {
+            std::vector<double> values(orderbook_wire::FEATURE_VALUES);
+            for (size_t i = 0; i < values.size(); ++i) values[i] = 0.01 * static_cast<double>(i) - 0.1;
+            std::vector<char> out(values.size() * sizeof(uint64_t));
+            for (auto _ : state) {
+                codec.encodeChangeValues(values.data(), values.size(), out.data());
+                benchmark::ClobberMemory();
+            }
+            state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * out.size()));
+        });
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    // The handler logs its average every 100 messages
+    logging::setLevel(logging::Level::Warn);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    registerCodecBenchmarks();
+    benchmark::AddCustomContext("binary_utils_codec", binary_utils::activeCodecName());
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <cstdint>
+
+// Counts heap allocations made through operator new on the calling thread.
+// The global replacement operators live in alloc_counter.cpp.
+namespace alloc_counter {
+
+uint64_t threadAllocations();
+
+} // namespace alloc_counter
@@ -0,0 +1,136 @@
+#pragma once
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <system_error>
+
+// Exact parsing of the plain decimal strings OKX sends for prices and sizes ("65432.1", "0.003").
+//
+// Digits are accumulated into an integer mantissa. When the mantissa fits in 53 bits and at
+// most 22 fractional digits are present, mantissa / 10^k is a single correctly rounded IEEE
+// division of two exactly representable values (Clinger's fast path), so the result equals
+// strtod. Anything else (exponents, very long mantissas) falls back to std::from_chars.
+namespace decimal {
+
+// Prices are also kept as integer ticks of 10^-TICK_DECIMALS for exact comparisons
+constexpr int TICK_DECIMALS = 10;
+
+namespace detail {
+
+constexpr double POW10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+constexpr int MAX_EXACT_POW10 = 22;
+
+constexpr int64_t POW10_INT[] = {
+    1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL, 100000000LL,
+    1000000000LL, 10000000000LL, 100000000000LL, 1000000000000LL, 10000000000000LL,
+    100000000000000LL, 1000000000000000LL, 10000000000000000LL, 100000000000000000LL,
+    1000000000000000000LL};
+
+constexpr uint64_t MAX_EXACT_MANTISSA = 1ULL << 53;
+constexpr int MAX_MANTISSA_DIGITS = 19;  // Always fits in uint64_t
+
+struct Digits {
+    uint64_t mantissa = 0;
+    int frac_digits = 0;   // Digits after the decimal point
+    bool negative = false;
+};
+
+// Plain [-]digits[.digits] only; false for anything the fast path does not cover
+inline bool scanDigits(std::string_view str, Digits& out) {
+    const char* p = str.data();
+    const char* end = p + str.size();
+    if (p < end && *p == '-') {
+        out.negative = true;
+        ++p;
+    }
+
+    int significant = 0;
+    bool seen_digit = false;
+    bool seen_dot = false;
+    for (; p < end; ++p) {
+        const char c = *p;
+        if (c >= '0' && c <= '9') {
+            seen_digit = true;
+            if (out.mantissa != 0 || c != '0') {
+                if (++significant > MAX_MANTISSA_DIGITS) return false;
+            }
+            out.mantissa = out.mantissa * 10 + static_cast<uint64_t>(c - '0');
+            if (seen_dot) ++out.frac_digits;
+        } else if (c == '.' && !seen_dot) {
+            seen_dot = true;
+        } else {
+            return false;
+        }
+    }
+    return seen_digit;
+}
+
+inline bool fallback(std::string_view str, double& value) {
+    auto result = std::from_chars(str.data(), str.data() + str.size(), value);
+    return result.ec == std::errc() && result.ptr == str.data() + str.size();
+}
+
+} // namespace detail
+
+// Correctly rounded string to double; returns false (value 0) for malformed input
+inline bool parse(std::string_view str, double& value) {
+    detail::Digits digits;
+    if (detail::scanDigits(str, digits) && digits.mantissa <= detail::MAX_EXACT_MANTISSA &&
+        digits.frac_digits <= detail::MAX_EXACT_POW10) {
+        value = static_cast<double>(digits.mantissa) / detail::POW10[digits.frac_digits];
+        if (digits.negative) value = -value;
+        return true;
+    }
+    if (detail::fallback(str, value)) return true;
+    value = 0.0;
+    return false;
+}
+
+// As parse(), and also the value in integer ticks of 10^-TICK_DECIMALS. Decimals beyond
+// TICK_DECIMALS are rounded half away from zero.
+inline bool parseWithTicks(std::string_view str, double& value, int64_t& ticks) {
+    detail::Digits digits;
+    if (detail::scanDigits(str, digits)) {
+        if (digits.mantissa <= detail::MAX_EXACT_MANTISSA && digits.frac_digits <= detail::MAX_EXACT_POW10) {
+            value = static_cast<double>(digits.mantissa) / detail::POW10[digits.frac_digits];
+            if (digits.negative) value = -value;
+        } else if (!detail::fallback(str, value)) {
+            value = 0.0;
+            return false;
+        }
+
+        bool exact = true;
+        uint64_t magnitude = digits.mantissa;
+        if (digits.frac_digits <= TICK_DECIMALS) {
+            const int64_t scale = detail::POW10_INT[TICK_DECIMALS - digits.frac_digits];
+            exact = magnitude <= static_cast<uint64_t>(std::numeric_limits<int64_t>::max() / scale);
+            magnitude *= static_cast<uint64_t>(scale);
+        } else {
+            const int drop = digits.frac_digits - TICK_DECIMALS;
+            if (drop <= 18) {
+                const uint64_t divisor = static_cast<uint64_t>(detail::POW10_INT[drop]);
+                magnitude = magnitude / divisor + (magnitude % divisor >= divisor / 2 ? 1 : 0);
+            } else {
+                magnitude = 0;
+            }
+            exact = magnitude <= static_cast<uint64_t>(std::numeric_limits<int64_t>::max());
+        }
+        if (exact) {
+            ticks = digits.negative ? -static_cast<int64_t>(magnitude) : static_cast<int64_t>(magnitude);
+            return true;
+        }
+    } else if (!detail::fallback(str, value)) {
+        value = 0.0;
+        return false;
+    }
+
+    // Exponent notation or out of range for the integer path
+    ticks = std::llround(value * detail::POW10[TICK_DECIMALS]);
+    return true;
+}
+
+} // namespace decimal
@@ -0,0 +1,117 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <spsc_queue.hpp>
+#include "orderbook_handler.hpp"
+#include "websocket_client.hpp"
+#include "rabbitmq_handler.hpp"
+
+class OrderBookWorker;
+
+// Raw websocket message, followed by RX_PADDING zero bytes. The buffer is the receive buffer
+// it was reassembled in; the router swaps it with the buffer of a consumed slot.
+struct InboxMessage {
+    std::vector<char> data;
+    size_t size = 0;
+    uint64_t received_ns = 0;  // latency::nowNanos() when the router took it off the socket
+};
+
+// Book and feature engine of one instrument, fed through its own inbox
+class OrderBookShard {
+public:
+    static constexpr size_t INBOX_CAPACITY = 256;        // Messages queued between router and worker
+    static constexpr size_t INBOX_MESSAGE_RESERVE = 16384;  // Initial slot size; the client grows buffers for larger frames
+
+    OrderBookShard(const std::string& instrument, WebSocketClient* client,
+                   RabbitMQHandler* rmq, OrderBookWorker* worker);
+
+    const std::string& instrument() const { return handler_.instrument(); }
+    OrderBookHandler& handler() { return handler_; }
+    OrderBookWorker* worker() const { return worker_; }
+
+    // Router thread: queue the message in buffer[0, size) by swapping buffer with a free slot's
+    // buffer, without copying it. False when the inbox is full, and buffer is left as it was.
+    bool push(std::vector<char>& buffer, size_t size);
+
+    // Worker thread: handle up to max_messages queued messages
+    size_t drain(size_t max_messages);
+    bool hasPending() const { return !inbox_->empty(); }
+
+    // Router thread only: updates are discarded after an overflow until a new snapshot
+    bool awaiting_snapshot = false;
+    uint64_t overflows = 0;
+
+private:
+    OrderBookHandler handler_;
+    OrderBookWorker* worker_;
+    std::unique_ptr<SpscQueue<InboxMessage, INBOX_CAPACITY>> inbox_;
+};
+
+// Thread that drains the inboxes of its shards; it is the only publisher on its RabbitMQHandler
+class OrderBookWorker {
+public:
+    static constexpr size_t DRAIN_BATCH = 16;  // Messages per shard before moving to the next one
+    static constexpr auto IDLE_WAIT = std::chrono::milliseconds(10);  // Backstop for missed wakeups
+
+    OrderBookWorker(size_t index, RabbitMQHandler* rmq) : index_(index), rmq_(rmq) {}
+    ~OrderBookWorker() { stop(); }
+
+    size_t index() const { return index_; }
+    RabbitMQHandler* rmq() const { return rmq_; }
+    void addShard(OrderBookShard* shard) { shards_.push_back(shard); }
+
+    void start(int cpu);  // Pinned to cpu unless it is negative
+    void stop();
+
+    // Router thread: wake the worker if it is idle
+    void notify();
+
+private:
+    void run();
+    bool hasPending() const;
+
+    size_t index_;
+    RabbitMQHandler* rmq_;
+    std::vector<OrderBookShard*> shards_;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    std::atomic<bool> sleeping_{false};
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+};
+
+// Splits the messages of one websocket connection by instrument onto the shard inboxes.
+// route() runs on the LWS service thread and only hands the receive buffers on, it never
+// processes or copies messages.
+class InstrumentRouter {
+public:
+    explicit InstrumentRouter(WebSocketClient* client) : client_(client) {}
+    ~InstrumentRouter() { stop(); }
+
+    // Set up before start(); the RabbitMQHandler must outlive the router
+    OrderBookWorker& addWorker(RabbitMQHandler* rmq);
+    OrderBookHandler& addInstrument(const std::string& instrument, size_t worker_idx);
+
+    void start(bool pin_workers);
+    void stop();
+
+    // A routed message takes buffer, leaving a buffer of an already consumed message in its place
+    void route(std::vector<char>& buffer, size_t size);
+
+private:
+    // The arg object leads every books message, so a plain scan finds it in the first bytes
+    static std::string_view findInstrument(std::string_view message);
+    OrderBookShard* findShard(std::string_view instrument);
+    void resubscribe(OrderBookShard& shard);
+
+    WebSocketClient* client_;
+    std::vector<std::unique_ptr<OrderBookWorker>> workers_;
+    std::vector<std::unique_ptr<OrderBookShard>> shards_;  // Linear lookup, a few dozen instruments at most
+};
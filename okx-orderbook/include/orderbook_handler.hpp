@@ -9,33 +9,25 @@
 #include <chrono>
 #include "rabbitmq_handler.hpp"
 #include <array>
+#include <memory>
 #include <iomanip>
-
-struct OrderBookLevel {
-    double price;
-    double volume;
-    double orders;
-
-    OrderBookLevel() : price(0.0), volume(0.0), orders(0.0) {}
-    OrderBookLevel(double p, double v, double o) : price(p), volume(v), orders(o) {}
-};
-
-struct PreprocessedLevel {
-    double price_change;     // % change from previous state
-    double volume_change;    // % change from 10-state average
-    double orders_change;    // % change from 10-state average
-};
+#include "orderbook_side.hpp"
+#include <orderbook_wire.hpp>
+#include <latency_histogram.hpp>
+#include <transport.hpp>
+#include <market_recording.hpp>
+#include "decimal_parser.hpp"
 
 struct OrderBookFeatures {
-    static constexpr size_t NUM_DEPTHS = 5;
+    static constexpr size_t NUM_DEPTHS = NUM_BOOK_DEPTHS;
     static constexpr size_t NUM_FEATURES = 4;
+    static constexpr std::array<size_t, NUM_DEPTHS> depthLevels = BOOK_DEPTH_LEVELS;
     
     double midPrice;
     std::array<double, 5> volumeImbalance;  // For levels 10, 20, 50, 100, 400
     std::array<double, 5> orderImbalance;   // For levels 10, 20, 50, 100, 400
     std::array<double, 5> bidVwapChange;    // Bid VWAP % change relative to mid price
     std::array<double, 5> askVwapChange;    // Ask VWAP % change relative to mid price
-    std::array<size_t, 5> depthLevels = {10, 20, 50, 100, 400};
 };
 
 class OrderBookException : public std::runtime_error {
@@ -43,6 +35,12 @@ public:
     explicit OrderBookException(const std::string& message) : std::runtime_error(message) {}
 };
 
+// Layout of the messages published on orderbook.updates, see orderbook_wire.hpp
+enum class WireFormat {
+    V2,  // Fixed-size full state
+    V3   // Versioned header, changed levels only with periodic keyframes
+};
+
 class OrderBookHandler {
 public:
     // Constants for message sizes and binary format
@@ -51,71 +49,103 @@ public:
     static constexpr size_t STATE_ID_SIZE = sizeof(uint16_t);
 
     // Buffer size constants
-    static constexpr size_t HISTORY_SIZE = 10;  // Store last 10 states
     static constexpr uint16_t MAX_STATE_ID = 65535;  // Maximum state ID value (2^16 - 1)
     static constexpr size_t TIMING_BUFFER_SIZE = 100;  // Number of timings to average
 
-    OrderBookHandler(WebSocketClient* client, RabbitMQHandler* rmq) 
-        : ws_client_(client), rmq_handler_(rmq), current_state_id_(0), parser_(), json_buffer_() {}
+    // One handler owns the book of one instrument and publishes on orderbook.updates.<instrument>,
+    // through the worker's RabbitMQ connection unless setPublisher() replaces it
+    OrderBookHandler(WebSocketClient* client, RabbitMQHandler* rmq, const std::string& instrument)
+        : ws_client_(client), instrument_(instrument), current_state_id_(0), parser_(),
+          publish_routing_key_("orderbook.updates." + instrument),
+          publisher_(std::make_unique<RabbitMQPublisher>(rmq, "orderbook", publish_routing_key_)),
+          inbox_latency_(latency::registry().histogram("orderbook_inbox_wait_seconds",
+                                                       "Frame received until its worker starts on it")),
+          apply_latency_(latency::registry().histogram("orderbook_book_apply_seconds",
+                                                       "Parsing a books message and applying it to the book")),
+          publish_latency_(latency::registry().histogram("orderbook_publish_seconds",
+                                                         "Features, encoding and publishing one state")) {
+        // Sized once so publishing never allocates
+        publish_buffer_.reserve(orderbook_wire::V2_MESSAGE_SIZE);
+        v3_buffer_.reserve(orderbook_wire::MAX_V3_MESSAGE_SIZE);
+    }
     
-    void handleMessage(const std::string& message);
-    void subscribe(const std::string& instrument);
+    // Message must be followed by WebSocketClient::RX_PADDING readable bytes. received_ns is
+    // the latency::nowNanos() of its arrival, published as the state's origin (0: now).
+    void handleMessage(std::string_view message, uint64_t received_ns = 0);
+    void subscribe();
+    const std::string& instrument() const { return instrument_; }
+    const std::string& routingKey() const { return publish_routing_key_; }
+
+    // Publish the states elsewhere, e.g. a shared-memory ring; called only by the worker thread
+    void setPublisher(std::unique_ptr<transport::Publisher> publisher) { publisher_ = std::move(publisher); }
+
+    // Also append every published state to recording segments (see market_recording.hpp)
+    void setRecorder(std::unique_ptr<recording::AsyncRecorder> recorder) { recorder_ = std::move(recorder); }
+
+    // OKX books channel request, op is "subscribe" or "unsubscribe"
+    static std::string subscriptionRequest(const std::string& op, const std::string& instrument);
+    void setWireFormat(WireFormat format, orderbook_wire::Packing packing = orderbook_wire::Packing::Raw64,
+                       size_t keyframe_interval = orderbook_wire::DEFAULT_KEYFRAME_INTERVAL);
 
 private:
+    friend struct OrderBookBenchAccess;  // bench/orderbook_bench.cpp times the stages on their own
+
     WebSocketClient* ws_client_;
-    RabbitMQHandler* rmq_handler_;
-    std::vector<OrderBookLevel> bids;
-    std::vector<OrderBookLevel> asks;
+    std::string instrument_;
+    OrderBookSide<true> bids;
+    OrderBookSide<false> asks;
     uint16_t current_state_id_;  // Current state ID (0-65535)
     
-    // JSON parsing
+    // JSON parsing, directly over the websocket receive buffer
     simdjson::ondemand::parser parser_;
-    simdjson::padded_string json_buffer_;
-
-    // Timing tracking
-    std::deque<std::chrono::microseconds> processing_times_;
+    static_assert(WebSocketClient::RX_PADDING >= simdjson::SIMDJSON_PADDING,
+                  "WebSocket receive buffer padding is too small for simdjson");
+
+    // Published message format and reusable message buffers
+    WireFormat wire_format_ = WireFormat::V2;
+    orderbook_wire::DeltaEncoder delta_encoder_;
+    std::vector<char> publish_buffer_;
+    std::vector<char> v3_buffer_;
+    const std::string publish_routing_key_;
+    std::unique_ptr<transport::Publisher> publisher_;
+    std::unique_ptr<recording::AsyncRecorder> recorder_;  // None unless recording
+
+    // Timing tracking, a fixed ring of the last TIMING_BUFFER_SIZE samples
+    std::array<std::chrono::microseconds, TIMING_BUFFER_SIZE> processing_times_{};
     size_t total_messages_processed_ = 0;
+    uint64_t window_allocations_ = 0;  // Heap allocations on the data path since the last log
+
+    // Stage latencies, shared by the handlers of every instrument
+    uint64_t origin_ns_ = 0;  // Arrival of the message being handled
+    latency::Histogram& inbox_latency_;
+    latency::Histogram& apply_latency_;
+    latency::Histogram& publish_latency_;
     
-    // Historical data for calculating changes
-    std::deque<std::vector<OrderBookLevel>> previous_bids;
-    std::deque<std::vector<OrderBookLevel>> previous_asks;
     double previous_mid_price = 0.0;
 
-    // Fast string to double conversion
-    inline double fast_stod(std::string_view str);
+    // One [price, size, liquidated orders, orders] entry of a books message
+    struct ParsedLevel {
+        int64_t price_ticks = 0;
+        double price = 0.0;
+        double volume = 0.0;
+        double orders = 0.0;
+    };
+    static bool parseLevel(simdjson::ondemand::array&& level, ParsedLevel& out);
 
     void handleSnapshot(simdjson::ondemand::value&& data);
     void processOrderBookUpdate(simdjson::ondemand::value&& data);
-    void updatePriceLevel(std::vector<OrderBookLevel>& side, simdjson::ondemand::array&& level, bool is_bids);
+    template <typename Side>
+    void updatePriceLevel(Side& side, simdjson::ondemand::array&& level);
     void validateOrderBookState();
     void publishOrderBookUpdate();
-    void updateHistory();
+    void publishV3Update(const double* feature_values, uint32_t mid_price_cents);
     void incrementStateId() { current_state_id_ = (current_state_id_ + 1) % (MAX_STATE_ID + 1); }
-    void logAverageProcessingTime(std::chrono::microseconds current_duration);
+    void logAverageProcessingTime(std::chrono::microseconds current_duration, uint64_t allocations);
 
-    // Feature calculation methods
+    // Feature calculation methods, read from the incrementally maintained depth aggregates
     OrderBookFeatures calculateFeatures() const;
     double calculateMidPrice() const;
-    double calculateVolumeImbalance(size_t depth) const;
-    double calculateOrderImbalance(size_t depth) const;
-    double calculateVWAP(size_t depth, bool is_bids) const;
-    std::string getCurrentTimestamp() const;
-
-    // Preprocessing methods
-    std::vector<PreprocessedLevel> preprocessLevels(
-        const std::vector<OrderBookLevel>& current,
-        const std::vector<OrderBookLevel>& previous,
-        const std::deque<std::vector<OrderBookLevel>>& history
-    ) const;
-
-    double calculateAverageVolume(const std::deque<std::vector<OrderBookLevel>>& history, size_t level_idx) const;
-    double calculateAverageOrders(const std::deque<std::vector<OrderBookLevel>>& history, size_t level_idx) const;
-
-    static bool compareAsks(const OrderBookLevel& a, const OrderBookLevel& b) {
-        return a.price < b.price;  // Ascending order for asks
-    }
-
-    static bool compareBids(const OrderBookLevel& a, const OrderBookLevel& b) {
-        return a.price > b.price;  // Descending order for bids
-    }
+    double calculateVolumeImbalance(size_t depth_idx) const;
+    double calculateOrderImbalance(size_t depth_idx) const;
+    double calculateVWAP(size_t depth_idx, bool is_bids) const;
 };
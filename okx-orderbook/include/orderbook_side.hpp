@@ -0,0 +1,202 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <algorithm>
+#include <cstdint>
+
+struct OrderBookLevel {
+    double price;
+    double volume;
+    double orders;
+
+    OrderBookLevel() : price(0.0), volume(0.0), orders(0.0) {}
+    OrderBookLevel(double p, double v, double o) : price(p), volume(v), orders(o) {}
+};
+
+// Level arrays are handed to the batch codecs as interleaved doubles
+static_assert(sizeof(OrderBookLevel) == 3 * sizeof(double), "OrderBookLevel must be three packed doubles");
+
+// Depths (in levels) at which the features are aggregated
+inline constexpr size_t NUM_BOOK_DEPTHS = 5;
+inline constexpr std::array<size_t, NUM_BOOK_DEPTHS> BOOK_DEPTH_LEVELS = {10, 20, 50, 100, 400};
+
+// Running totals over the best N levels of one side
+struct DepthAggregate {
+    double volume = 0.0;
+    double orders = 0.0;
+    double notional = 0.0;  // sum(price * volume), for VWAP
+
+    void add(const OrderBookLevel& level) {
+        volume += level.volume;
+        orders += level.orders;
+        notional += level.price * level.volume;
+    }
+
+    void subtract(const OrderBookLevel& level) {
+        volume -= level.volume;
+        orders -= level.orders;
+        notional -= level.price * level.volume;
+    }
+};
+
+// One side of the book kept as a contiguous, best-first array of fixed capacity.
+// Updates shift levels in place, so the hot path never allocates or re-sorts.
+// Depth aggregates are maintained incrementally in O(NUM_BOOK_DEPTHS) per update.
+// Levels are located by an integer price key (decimal ticks) kept in a parallel array,
+// so lookups compare exact integers rather than parsed doubles.
+template <bool IsBids, size_t Capacity = 512>
+class OrderBookSide {
+public:
+    static constexpr size_t CAPACITY = Capacity;  // Headroom over the 400 levels OKX maintains
+    static constexpr size_t RESYNC_INTERVAL = 4096;  // Updates between exact aggregate recomputes
+
+    static_assert(BOOK_DEPTH_LEVELS[NUM_BOOK_DEPTHS - 1] < Capacity, "Deepest aggregate must fit in the side");
+
+    void clear() {
+        size_ = 0;
+        depth_.fill(DepthAggregate{});
+        updates_since_resync_ = 0;
+    }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    const OrderBookLevel& operator[](size_t i) const { return levels_[i]; }
+    const OrderBookLevel* data() const { return levels_.data(); }
+    const OrderBookLevel* begin() const { return levels_.data(); }
+    const OrderBookLevel* end() const { return levels_.data() + size_; }
+    int64_t key(size_t i) const { return keys_[i]; }
+
+    // Totals over the best BOOK_DEPTH_LEVELS[depth_idx] levels
+    const DepthAggregate& depthAggregate(size_t depth_idx) const { return depth_[depth_idx]; }
+
+    // Apply an incremental update: volume <= 0 removes the level, otherwise the
+    // level is updated in place or inserted at its sorted position.
+    void apply(int64_t key, double price, double volume, double orders) {
+        size_t pos = lowerBound(key);
+
+        if (pos < size_ && keys_[pos] == key) {
+            if (volume <= 0.0) {
+                erase(pos);
+            } else {
+                updateAggregates(pos, levels_[pos], OrderBookLevel{price, volume, orders});
+                levels_[pos].volume = volume;
+                levels_[pos].orders = orders;
+            }
+        } else if (volume > 0.0) {
+            insert(pos, key, OrderBookLevel{price, volume, orders});
+        } else {
+            return;  // Removing an unknown level is a no-op
+        }
+
+        // Bound floating point drift of the running totals
+        if (++updates_since_resync_ >= RESYNC_INTERVAL) {
+            resyncAggregates();
+        }
+    }
+
+    // Unordered append used while loading a snapshot, followed by a single sort()
+    bool append(int64_t key, double price, double volume, double orders) {
+        if (size_ >= Capacity) return false;
+        keys_[size_] = key;
+        levels_[size_++] = OrderBookLevel{price, volume, orders};
+        return true;
+    }
+
+    void sort() {
+        // Sort a permutation by key, then gather both arrays through it
+        std::array<uint16_t, Capacity> order;
+        for (size_t i = 0; i < size_; ++i) order[i] = static_cast<uint16_t>(i);
+        std::sort(order.begin(), order.begin() + size_,
+                  [this](uint16_t a, uint16_t b) { return better(keys_[a], keys_[b]); });
+
+        std::array<OrderBookLevel, Capacity> levels;
+        std::array<int64_t, Capacity> keys;
+        for (size_t i = 0; i < size_; ++i) {
+            levels[i] = levels_[order[i]];
+            keys[i] = keys_[order[i]];
+        }
+        std::copy(levels.begin(), levels.begin() + size_, levels_.begin());
+        std::copy(keys.begin(), keys.begin() + size_, keys_.begin());
+        resyncAggregates();
+    }
+
+    // Recompute all depth aggregates with a single prefix pass
+    void resyncAggregates() {
+        DepthAggregate running;
+        size_t i = 0;
+        for (size_t d = 0; d < NUM_BOOK_DEPTHS; ++d) {
+            const size_t depth = std::min(BOOK_DEPTH_LEVELS[d], size_);
+            for (; i < depth; ++i) {
+                running.add(levels_[i]);
+            }
+            depth_[d] = running;
+        }
+        updates_since_resync_ = 0;
+    }
+
+private:
+    static_assert(Capacity <= 65536, "sort() permutes through 16-bit indices");
+
+    static bool better(int64_t a, int64_t b) {
+        return IsBids ? a > b : a < b;  // Descending bids, ascending asks
+    }
+
+    // First position whose key is not better than the given one
+    size_t lowerBound(int64_t key) const {
+        size_t left = 0;
+        size_t right = size_;
+        while (left < right) {
+            size_t mid = (left + right) / 2;
+            if (better(keys_[mid], key)) left = mid + 1;
+            else right = mid;
+        }
+        return left;
+    }
+
+    void insert(size_t pos, int64_t key, const OrderBookLevel& level) {
+        if (pos >= Capacity) return;  // Worse than every level of a full side
+
+        // The new level enters every depth below it; the level at depth - 1 is pushed out
+        for (size_t d = 0; d < NUM_BOOK_DEPTHS; ++d) {
+            const size_t depth = BOOK_DEPTH_LEVELS[d];
+            if (pos >= depth) continue;
+            depth_[d].add(level);
+            if (size_ >= depth) depth_[d].subtract(levels_[depth - 1]);
+        }
+
+        size_t last = size_ < Capacity ? size_ : Capacity - 1;  // Full side drops its worst level
+        std::copy_backward(levels_.begin() + pos, levels_.begin() + last, levels_.begin() + last + 1);
+        std::copy_backward(keys_.begin() + pos, keys_.begin() + last, keys_.begin() + last + 1);
+        levels_[pos] = level;
+        keys_[pos] = key;
+        if (size_ < Capacity) ++size_;
+    }
+
+    void erase(size_t pos) {
+        // The removed level leaves every depth below it; the level at depth moves in
+        for (size_t d = 0; d < NUM_BOOK_DEPTHS; ++d) {
+            const size_t depth = BOOK_DEPTH_LEVELS[d];
+            if (pos >= depth) continue;
+            depth_[d].subtract(levels_[pos]);
+            if (size_ > depth) depth_[d].add(levels_[depth]);
+        }
+
+        std::copy(levels_.begin() + pos + 1, levels_.begin() + size_, levels_.begin() + pos);
+        std::copy(keys_.begin() + pos + 1, keys_.begin() + size_, keys_.begin() + pos);
+        --size_;
+    }
+
+    void updateAggregates(size_t pos, const OrderBookLevel& before, const OrderBookLevel& after) {
+        for (size_t d = 0; d < NUM_BOOK_DEPTHS; ++d) {
+            if (pos >= BOOK_DEPTH_LEVELS[d]) continue;
+            depth_[d].subtract(before);
+            depth_[d].add(after);
+        }
+    }
+
+    std::array<OrderBookLevel, Capacity> levels_;
+    std::array<int64_t, Capacity> keys_;  // Price of each level in decimal ticks
+    size_t size_ = 0;
+    std::array<DepthAggregate, NUM_BOOK_DEPTHS> depth_{};
+    size_t updates_since_resync_ = 0;
+};
@@ -1,25 +1,160 @@
 #pragma once
 #include <string>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <chrono>
+#include <cstdint>
 #include <amqp.h>
 #include <amqp_tcp_socket.h>
 #include <nlohmann/json.hpp>
+#include <spsc_queue.hpp>
+#include <transport.hpp>
+
+// Snapshot of the async publisher counters
+struct PublisherStats {
+    size_t queue_depth = 0;        // Messages waiting for the publisher thread
+    uint64_t enqueued = 0;         // Accepted by publish calls
+    uint64_t dropped = 0;          // Rejected because the queue was full or the message too large
+    uint64_t published = 0;        // Handed to the broker
+    uint64_t failed = 0;           // amqp_basic_publish errors
+    uint64_t acked = 0;            // Confirmed by the broker
+    uint64_t nacked = 0;           // Rejected by the broker
+    uint64_t lost = 0;             // Accepted but lost with the connection, unpublished or unconfirmed
+    uint64_t reconnects = 0;       // Connections reopened by the publisher thread
+    uint64_t unconfirmed = 0;      // Published but not yet confirmed
+    double avg_confirm_latency_us = 0.0;  // Enqueue to confirm, since the previous stats log
+    uint64_t max_confirm_latency_us = 0;
+};
 
 class RabbitMQHandler {
 public:
+    enum class PublishMode {
+        Sync,  // Publish on the calling thread, without confirms
+        Async  // Queue for a publisher thread that uses publisher confirms
+    };
+
+    static constexpr size_t QUEUE_CAPACITY = 256;          // Slots between the caller and the publisher thread
+    static constexpr size_t MAX_MESSAGE_SIZE = 32768;     // Largest message a slot holds
+    static constexpr size_t MAX_NAME_SIZE = 128;          // Exchange and routing key buffer size
+    static constexpr size_t PUBLISH_BATCH_SIZE = 32;      // Messages published between confirm polls
+    static constexpr size_t MAX_UNCONFIRMED = 1024;       // Outstanding confirms before publishing pauses
+    static constexpr long IDLE_POLL_TIMEOUT_US = 100;     // Confirm wait while the queue is empty
+    static constexpr auto RECONNECT_MIN_WAIT = std::chrono::milliseconds(100);  // Doubled per failed reconnect
+    static constexpr auto RECONNECT_MAX_WAIT = std::chrono::seconds(5);
+    static constexpr auto STATS_LOG_INTERVAL = std::chrono::seconds(10);
+
     RabbitMQHandler(const std::string& host, int port,
                     const std::string& username, const std::string& password);
     ~RabbitMQHandler();
 
+    // Configure before connect()
+    void setPublishMode(PublishMode mode) { mode_ = mode; }
+    void setDeliveryMode(const std::string& exchange, bool persistent);
+
     bool connect();
+
+    // In async mode both calls only copy the message into the queue and never block;
+    // they must then be called from a single thread.
     bool publishMessage(const std::string& exchange, const std::string& routingKey,
                        const std::string& message);
     bool publishBinaryMessage(const std::string& exchange, const std::string& routingKey,
                             const char* data, size_t size);
 
+    // Reads the counters without resetting anything; the confirm latency window is reset only
+    // by the periodic stats log, so polling this (e.g. to wait for a drain) does not skew it
+    PublisherStats getStats() const;
+
+    // Bumped whenever accepted messages were lost after the enqueue (nacks, failed publishes, a
+    // dropped connection); publishers compare it to know their delta streams need a keyframe
+    uint64_t resyncGeneration() const { return resync_generation_.load(std::memory_order_acquire); }
+
 private:
+    struct PublishSlot {
+        char exchange[MAX_NAME_SIZE];
+        char routing_key[MAX_NAME_SIZE];
+        bool binary;
+        size_t size;
+        std::chrono::steady_clock::time_point enqueued_at;
+        std::array<char, MAX_MESSAGE_SIZE> data;
+    };
+
     std::string host_;
     int port_;
     std::string username_;
     std::string password_;
     amqp_connection_state_t conn;
-}; 
\ No newline at end of file
+
+    PublishMode mode_ = PublishMode::Sync;
+    std::vector<std::pair<std::string, uint8_t>> delivery_modes_;  // Per exchange, persistent (2) otherwise
+
+    // Async publishing
+    std::unique_ptr<SpscQueue<PublishSlot, QUEUE_CAPACITY>> queue_;
+    std::thread publisher_thread_;
+    std::atomic<bool> publisher_running_{false};
+    uint64_t next_delivery_tag_ = 1;     // Publisher thread only
+    uint64_t confirmed_up_to_ = 0;       // Publisher thread only
+    std::array<std::chrono::steady_clock::time_point, MAX_UNCONFIRMED> confirm_pending_;  // Enqueue time by delivery tag
+    std::array<bool, MAX_UNCONFIRMED> confirm_done_{};  // Confirmed out of order, ahead of confirmed_up_to_
+    std::chrono::steady_clock::time_point last_stats_log_;
+    bool connection_lost_ = false;  // Publisher thread only: reconnect before publishing again
+    std::chrono::milliseconds reconnect_wait_ = RECONNECT_MIN_WAIT;
+    std::atomic<uint64_t> resync_generation_{0};
+
+    // Counters
+    std::atomic<uint64_t> enqueued_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> published_{0};
+    std::atomic<uint64_t> failed_{0};
+    std::atomic<uint64_t> acked_{0};
+    std::atomic<uint64_t> nacked_{0};
+    std::atomic<uint64_t> lost_{0};
+    std::atomic<uint64_t> reconnects_{0};
+    std::atomic<uint64_t> confirm_latency_total_us_{0};
+    std::atomic<uint64_t> confirm_latency_count_{0};
+    std::atomic<uint64_t> confirm_latency_max_us_{0};
+
+    bool enqueue(const std::string& exchange, const std::string& routingKey,
+                 const char* data, size_t size, bool binary);
+    void openConnection();
+    void closeConnection();
+    bool reconnect();
+    void markConnectionLost(const char* reason);
+    void requestResync() { resync_generation_.fetch_add(1, std::memory_order_release); }
+    bool publishNow(const char* exchange, const char* routingKey,
+                    const char* data, size_t size, bool binary);
+    uint8_t deliveryModeFor(const char* exchange) const;
+    void publisherLoop();
+    void publishBatch();
+    bool pollConfirms(bool wait);
+    void handleConfirm(uint64_t delivery_tag, bool multiple, bool ack);
+    void stopPublisher();
+    void logStats();
+    void takeConfirmLatency(PublisherStats& stats);
+};
+
+// Binary messages to one exchange and routing key of a handler, as a transport::Publisher
+class RabbitMQPublisher : public transport::Publisher {
+public:
+    RabbitMQPublisher(RabbitMQHandler* handler, std::string exchange, std::string routing_key)
+        : handler_(handler), exchange_(std::move(exchange)), routing_key_(std::move(routing_key)) {}
+
+    bool publish(const char* data, size_t size) override {
+        return handler_->publishBinaryMessage(exchange_, routing_key_, data, size);
+    }
+
+    bool takeResync() override {
+        const uint64_t generation = handler_->resyncGeneration();
+        if (generation == resync_seen_) return false;
+        resync_seen_ = generation;
+        return true;
+    }
+
+private:
+    RabbitMQHandler* handler_;
+    uint64_t resync_seen_ = 0;
+    const std::string exchange_;
+    const std::string routing_key_;  // Longer than the SSO buffer, so build it once
+};
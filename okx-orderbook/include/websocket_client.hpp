@@ -1,20 +1,32 @@
 #pragma once
 #include <string>
+#include <string_view>
+#include <vector>
 #include <functional>
 #include <memory>
 #include <libwebsockets.h>
 
 class WebSocketClient {
 public:
+    // Messages handed to the callback are followed by this many readable bytes,
+    // so parsers that need padding (simdjson) can read the frame in place
+    static constexpr size_t RX_PADDING = 64;
+    static constexpr size_t RX_BUFFER_SIZE = 262144;  // Initial reassembly buffer
+
+    // The message is buffer[0, size), followed by RX_PADDING zero bytes. The callback may take
+    // the message by swapping buffer for another one, which then receives the next frames.
+    using MessageCallback = std::function<void(std::vector<char>& buffer, size_t size)>;
+
     WebSocketClient(const std::string& url, const std::string& protocol);
     ~WebSocketClient();
 
     bool connect();
     void run();
     void send(const std::string& message);
-    void setMessageCallback(std::function<void(const std::string&)> callback);
-    void setPendingSubscribeMessage(const std::string& message) { 
-        pending_subscribe_message_ = message; 
+    void setMessageCallback(MessageCallback callback);
+    // Subscriptions are (re)sent whenever the connection is established; add them before connect()
+    void addSubscription(const std::string& message) {
+        subscriptions_.push_back(message);
     }
     void schedulePing();
 
@@ -26,10 +38,13 @@ private:
     std::string protocol_;
     struct lws_context* context_;
     struct lws* connection_;
-    std::function<void(const std::string&)> message_callback_;
-    std::string pending_subscribe_message_;
-    std::string message_buffer_;
-    
-    static WebSocketClient* instance_;
+    MessageCallback message_callback_;
+    std::vector<std::string> subscriptions_;
+
+    // Fragment reassembly buffer (payload + RX_PADDING), reused unless the callback swaps it out
+    std::vector<char> rx_buffer_;
+    size_t rx_size_;
+
+    void handleReceive(struct lws* wsi, const void* in, size_t len);
     void sendPing();
 };
@@ -0,0 +1,201 @@
+#include "../include/instrument_router.hpp"
+#include <async_logger.hpp>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+
+OrderBookShard::OrderBookShard(const std::string& instrument, WebSocketClient* client,
+                               RabbitMQHandler* rmq, OrderBookWorker* worker)
+    : handler_(client, rmq, instrument), worker_(worker),
+      inbox_(std::make_unique<SpscQueue<InboxMessage, INBOX_CAPACITY>>()) {
+    // Size every slot up front so routing ordinary frames never allocates
+    for (size_t i = 0; i < INBOX_CAPACITY; ++i) {
+        InboxMessage* slot = inbox_->tryAcquire();
+        slot->data.resize(INBOX_MESSAGE_RESERVE);
+        inbox_->commit();
+    }
+    while (inbox_->front()) {
+        inbox_->pop();
+    }
+}
+
+bool OrderBookShard::push(std::vector<char>& buffer, size_t size) {
+    InboxMessage* slot = inbox_->tryAcquire();
+    if (!slot) {
+        return false;
+    }
+
+    // The frame and its padding stay where the client reassembled them; the client continues
+    // in the slot's buffer, whose message the worker has finished with
+    slot->data.swap(buffer);
+    slot->size = size;
+    slot->received_ns = latency::nowNanos();
+    inbox_->commit();
+    return true;
+}
+
+size_t OrderBookShard::drain(size_t max_messages) {
+    size_t processed = 0;
+    while (processed < max_messages) {
+        InboxMessage* message = inbox_->front();
+        if (!message) break;
+
+        try {
+            handler_.handleMessage(std::string_view(message->data.data(), message->size), message->received_ns);
+        } catch (const std::exception& e) {
+            LOG_ERROR("[{}] Error handling message: {}", instrument(), e.what());
+        }
+        inbox_->pop();
+        ++processed;
+    }
+    return processed;
+}
+
+void OrderBookWorker::start(int cpu) {
+    running_.store(true, std::memory_order_release);
+    thread_ = std::thread(&OrderBookWorker::run, this);
+
+    if (cpu >= 0) {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(cpu, &cpuset);
+        int rc = pthread_setaffinity_np(thread_.native_handle(), sizeof(cpu_set_t), &cpuset);
+        if (rc != 0) {
+            LOG_ERROR("Failed to pin orderbook worker {} to CPU {}: {}", index_, cpu, std::strerror(rc));
+        }
+    }
+}
+
+void OrderBookWorker::stop() {
+    if (!thread_.joinable()) return;
+    running_.store(false, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        wake_cv_.notify_one();
+    }
+    thread_.join();
+}
+
+void OrderBookWorker::notify() {
+    // Pairs with the fence in run(): either the worker sees the new message or we see it sleeping
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        wake_cv_.notify_one();
+    }
+}
+
+bool OrderBookWorker::hasPending() const {
+    for (const auto* shard : shards_) {
+        if (shard->hasPending()) return true;
+    }
+    return false;
+}
+
+void OrderBookWorker::run() {
+    logging::setThreadName("worker" + std::to_string(index_));
+    while (running_.load(std::memory_order_acquire)) {
+        size_t processed = 0;
+        for (auto* shard : shards_) {
+            processed += shard->drain(DRAIN_BATCH);
+        }
+        if (processed > 0) continue;
+
+        // Sleep until the router queues a message
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        sleeping_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!hasPending() && running_.load(std::memory_order_acquire)) {
+            wake_cv_.wait_for(lock, IDLE_WAIT);
+        }
+        sleeping_.store(false, std::memory_order_relaxed);
+    }
+}
+
+OrderBookWorker& InstrumentRouter::addWorker(RabbitMQHandler* rmq) {
+    workers_.push_back(std::make_unique<OrderBookWorker>(workers_.size(), rmq));
+    return *workers_.back();
+}
+
+OrderBookHandler& InstrumentRouter::addInstrument(const std::string& instrument, size_t worker_idx) {
+    if (worker_idx >= workers_.size()) {
+        throw std::runtime_error("No orderbook worker " + std::to_string(worker_idx) + " for " + instrument);
+    }
+    if (findShard(instrument)) {
+        throw std::runtime_error("Instrument " + instrument + " added twice");
+    }
+
+    OrderBookWorker* worker = workers_[worker_idx].get();
+    shards_.push_back(std::make_unique<OrderBookShard>(instrument, client_, worker->rmq(), worker));
+    worker->addShard(shards_.back().get());
+    return shards_.back()->handler();
+}
+
+void InstrumentRouter::start(bool pin_workers) {
+    const unsigned int cpus = std::thread::hardware_concurrency();
+    for (auto& worker : workers_) {
+        const int cpu = pin_workers && cpus > 0 ? static_cast<int>(worker->index() % cpus) : -1;
+        worker->start(cpu);
+    }
+}
+
+void InstrumentRouter::stop() {
+    for (auto& worker : workers_) {
+        worker->stop();
+    }
+}
+
+std::string_view InstrumentRouter::findInstrument(std::string_view message) {
+    constexpr std::string_view key = "\"instId\":\"";
+    const size_t pos = message.find(key);
+    if (pos == std::string_view::npos) return {};
+
+    const size_t start = pos + key.size();
+    const size_t end = message.find('"', start);
+    if (end == std::string_view::npos) return {};
+    return message.substr(start, end - start);
+}
+
+OrderBookShard* InstrumentRouter::findShard(std::string_view instrument) {
+    for (auto& shard : shards_) {
+        if (shard->instrument() == instrument) return shard.get();
+    }
+    return nullptr;
+}
+
+void InstrumentRouter::route(std::vector<char>& buffer, size_t size) {
+    const std::string_view message(buffer.data(), size);
+    const std::string_view instrument = findInstrument(message);
+    OrderBookShard* shard = instrument.empty() ? nullptr : findShard(instrument);
+    if (!shard) {
+        // Connection-level replies (pong, errors) carry no instrument
+        if (message != "pong") {
+            LOG_INFO("Unrouted message: {}", message.substr(0, 256));
+        }
+        return;
+    }
+
+    if (shard->awaiting_snapshot) {
+        if (message.find("\"action\":\"snapshot\"") == std::string_view::npos) {
+            return;
+        }
+        shard->awaiting_snapshot = false;
+    }
+
+    if (!shard->push(buffer, size)) {
+        // A dropped update leaves the book inconsistent, so start over from a snapshot
+        shard->overflows++;
+        shard->awaiting_snapshot = true;
+        LOG_WARN("[{}] Inbox full ({} overflows), resubscribing for a fresh snapshot",
+                 shard->instrument(), shard->overflows);
+        resubscribe(*shard);
+        return;
+    }
+    shard->worker()->notify();
+}
+
+void InstrumentRouter::resubscribe(OrderBookShard& shard) {
+    if (!client_) return;
+    client_->send(OrderBookHandler::subscriptionRequest("unsubscribe", shard.instrument()));
+    client_->send(OrderBookHandler::subscriptionRequest("subscribe", shard.instrument()));
+}
@@ -1,10 +1,17 @@
 #include "../include/websocket_client.hpp"
 #include "../include/orderbook_handler.hpp"
 #include "../include/rabbitmq_handler.hpp"
+#include "../include/instrument_router.hpp"
+#include <metrics_server.hpp>
+#include <transport.hpp>
 #include <iostream>
 #include <thread>
 #include <cstdlib>
 #include <csignal>
+#include <sstream>
+#include <memory>
+#include <vector>
+#include <algorithm>
 
 // Helper function to get environment variable with default value
 std::string getEnvVar(const char* name, const std::string& defaultValue) {
@@ -12,6 +19,18 @@ std::string getEnvVar(const char* name, const std::string& defaultValue) {
     return value ? value : defaultValue;
 }
 
+// Helper function to split a comma-separated environment variable
+std::vector<std::string> getEnvList(const char* name, const std::string& defaultValue) {
+    std::vector<std::string> items;
+    std::stringstream list(getEnvVar(name, defaultValue));
+    for (std::string item; std::getline(list, item, ',');) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
 int main() {
     try {
         // Get RabbitMQ connection parameters from environment variables
@@ -20,28 +39,127 @@ int main() {
         std::string rmqUser = getEnvVar("RABBITMQ_USER", "guest");
         std::string rmqPass = getEnvVar("RABBITMQ_PASS", "guest");
 
-        std::cout << "Connecting to RabbitMQ at " << rmqHost << ":" << rmqPort << std::endl;
-        
-        // Initialize RabbitMQ handler with environment variables
-        RabbitMQHandler rmq(rmqHost, rmqPort, rmqUser, rmqPass);
-        if (!rmq.connect()) {
-            std::cerr << "Failed to connect to RabbitMQ" << std::endl;
+        // Instruments served by this process and the workers their books are spread over
+        std::vector<std::string> instruments = getEnvList("ORDERBOOK_INSTRUMENTS", "BTC-USDT-SWAP");
+        if (instruments.empty()) {
+            std::cerr << "ORDERBOOK_INSTRUMENTS is empty" << std::endl;
+            return 1;
+        }
+        const size_t defaultWorkers = std::max(1u, std::thread::hardware_concurrency());
+        size_t numWorkers = std::stoul(getEnvVar("ORDERBOOK_WORKERS", std::to_string(defaultWorkers)));
+        numWorkers = std::max<size_t>(1, std::min(numWorkers, instruments.size()));
+        bool pinWorkers = getEnvVar("ORDERBOOK_PIN_WORKERS", "0") == "1";
+
+        // Publish from a dedicated thread with publisher confirms unless sync is requested
+        std::string publishMode = getEnvVar("RABBITMQ_PUBLISH_MODE", "async");
+        if (publishMode != "async" && publishMode != "sync") {
+            std::cerr << "Unknown RABBITMQ_PUBLISH_MODE " << publishMode << std::endl;
             return 1;
         }
 
+        // Comma-separated exchanges published with transient delivery
+        std::vector<std::string> transientExchanges = getEnvList("RABBITMQ_TRANSIENT_EXCHANGES", "");
+        for (const auto& exchange : transientExchanges) {
+            std::cout << "Publishing to exchange " << exchange << " with transient delivery" << std::endl;
+        }
+
+        // Select the published message format (v2 full states by default)
+        std::string wireFormat = getEnvVar("ORDERBOOK_WIRE_FORMAT", "v2");
+        orderbook_wire::Packing packing = orderbook_wire::Packing::Raw64;
+        size_t keyframeInterval = orderbook_wire::DEFAULT_KEYFRAME_INTERVAL;
+        if (wireFormat == "v3") {
+            std::string packingName = getEnvVar("ORDERBOOK_V3_PACKING", "raw64");
+            if (!orderbook_wire::parsePacking(packingName, packing)) {
+                std::cerr << "Unknown ORDERBOOK_V3_PACKING " << packingName << std::endl;
+                return 1;
+            }
+            keyframeInterval = std::stoul(getEnvVar("ORDERBOOK_V3_KEYFRAME_INTERVAL",
+                                                    std::to_string(orderbook_wire::DEFAULT_KEYFRAME_INTERVAL)));
+            std::cout << "Publishing v3 orderbook messages (" << orderbook_wire::packingName(packing)
+                      << ", keyframe every " << keyframeInterval << " states)" << std::endl;
+        } else if (wireFormat != "v2") {
+            std::cerr << "Unknown ORDERBOOK_WIRE_FORMAT " << wireFormat << std::endl;
+            return 1;
+        }
+
+        // Publish states through RabbitMQ (default) or shared-memory rings for services on this host
+        std::string transportName = getEnvVar("ORDERBOOK_TRANSPORT", "rabbitmq");
+        transport::Kind transportKind = transport::Kind::RabbitMQ;
+        if (!transport::parseKind(transportName, transportKind)) {
+            std::cerr << "Unknown ORDERBOOK_TRANSPORT " << transportName << std::endl;
+            return 1;
+        }
+        const size_t shmSlots = std::stoul(getEnvVar("ORDERBOOK_SHM_SLOTS", "64"));
+
+        // Record the published states for replay, into this directory when set
+        const std::string recordDir = getEnvVar("ORDERBOOK_RECORD_DIR", "");
+        const size_t recordSegmentSize = std::stoul(getEnvVar("ORDERBOOK_RECORD_SEGMENT_MB", "256")) << 20;
+
+        // Stage latency histograms for Prometheus, 0 disables the endpoint
+        const int metricsPort = std::stoi(getEnvVar("ORDERBOOK_METRICS_PORT", "9101"));
+        latency::MetricsServer metrics(static_cast<uint16_t>(metricsPort));
+        if (metricsPort > 0) {
+            metrics.start();
+        }
+
+        std::cout << "Connecting to RabbitMQ at " << rmqHost << ":" << rmqPort << std::endl;
+
+        // One RabbitMQ connection per worker, each published to only by its worker thread
+        std::vector<std::unique_ptr<RabbitMQHandler>> rmqHandlers;
+        for (size_t i = 0; i < numWorkers; ++i) {
+            auto rmq = std::make_unique<RabbitMQHandler>(rmqHost, rmqPort, rmqUser, rmqPass);
+            if (publishMode == "async") {
+                rmq->setPublishMode(RabbitMQHandler::PublishMode::Async);
+            }
+            for (const auto& exchange : transientExchanges) {
+                rmq->setDeliveryMode(exchange, false);
+            }
+            if (!rmq->connect()) {
+                std::cerr << "Failed to connect to RabbitMQ" << std::endl;
+                return 1;
+            }
+            rmqHandlers.push_back(std::move(rmq));
+        }
+
         std::cout << "Successfully connected to RabbitMQ" << std::endl;
 
-        // Initialize WebSocket client
+        // Initialize WebSocket client, shared by every instrument
         WebSocketClient client("ws.okx.com", "wss");
-        OrderBookHandler orderbook(&client, &rmq);
+        InstrumentRouter router(&client);
+        for (auto& rmq : rmqHandlers) {
+            router.addWorker(rmq.get());
+        }
+
+        // Spread the instruments round-robin over the workers
+        for (size_t i = 0; i < instruments.size(); ++i) {
+            OrderBookHandler& orderbook = router.addInstrument(instruments[i], i % numWorkers);
+            if (wireFormat == "v3") {
+                orderbook.setWireFormat(WireFormat::V3, packing, keyframeInterval);
+            }
+            if (transportKind == transport::Kind::Shm) {
+                const std::string ring = transport::ringName(orderbook.routingKey());
+                orderbook.setPublisher(std::make_unique<transport::ShmPublisher>(
+                    ring, std::max(orderbook_wire::V2_MESSAGE_SIZE, orderbook_wire::MAX_V3_MESSAGE_SIZE), shmSlots));
+                std::cout << "Publishing " << instruments[i] << " to shared-memory ring " << ring << std::endl;
+            }
+            if (!recordDir.empty()) {
+                orderbook.setRecorder(std::make_unique<recording::AsyncRecorder>(
+                    recordDir, orderbook.routingKey(), recordSegmentSize));
+            }
+            orderbook.subscribe();
+        }
 
-        // Set message callback
-        client.setMessageCallback([&orderbook](const std::string& msg) {
-            orderbook.handleMessage(msg);
+        std::cout << "Serving " << instruments.size() << " instruments on " << numWorkers
+                  << " workers" << (pinWorkers ? " (pinned)" : "") << std::endl;
+        router.start(pinWorkers);
+
+        // The service thread only routes messages to the worker inboxes
+        client.setMessageCallback([&router](std::vector<char>& buffer, size_t size) {
+            router.route(buffer, size);
         });
 
         std::cout << "Connecting to WebSocket..." << std::endl;
-        
+
         // Connect to WebSocket
         if (!client.connect()) {
             std::cerr << "Failed to connect to WebSocket server" << std::endl;
@@ -50,9 +168,6 @@ int main() {
 
         std::cout << "Successfully connected to WebSocket" << std::endl;
 
-        // Subscribe to orderbook
-        orderbook.subscribe("BTC-USDT-SWAP");
-
         // Run WebSocket client on a separate thread
         std::thread clientThread([&client]() {
             client.run();
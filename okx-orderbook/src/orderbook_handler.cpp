@@ -1,18 +1,26 @@
 #include "../include/orderbook_handler.hpp"
+#include "../include/alloc_counter.hpp"
 #include <binary_utils.hpp>
+#include <async_logger.hpp>
 #include <iostream>
 #include <iomanip>
 #include <sstream>
 #include <chrono>
+#include <cstdio>
+#include <ctime>
 #include <simdjson.h>
 
-void OrderBookHandler::handleMessage(const std::string& message) {
+void OrderBookHandler::handleMessage(std::string_view message, uint64_t received_ns) {
     auto start_time = std::chrono::high_resolution_clock::now();
+    const uint64_t allocations_before = alloc_counter::threadAllocations();
+    const uint64_t start_ns = latency::nowNanos();
+    inbox_latency_.recordSince(received_ns);
+    origin_ns_ = received_ns != 0 ? received_ns : start_ns;
     
     try {
-        // Parse JSON using simdjson
-        json_buffer_ = simdjson::padded_string(message);
-        auto doc = parser_.iterate(json_buffer_);
+        // Parse JSON in place using simdjson; the receive buffer carries the padding
+        auto doc = parser_.iterate(simdjson::padded_string_view(
+            message.data(), message.size(), message.size() + WebSocketClient::RX_PADDING));
         
         // Handle ping-pong messages
         if (auto op = doc["op"].get_string(); !op.error()) {
@@ -27,9 +35,9 @@ void OrderBookHandler::handleMessage(const std::string& message) {
                 if (auto msg = doc["msg"].get_string(); !msg.error() && msg.value().find("ping") != std::string_view::npos) {
                     return;
                 }
-                std::cerr << "WebSocket error: " << doc["msg"].get_string().value() << std::endl;
+                LOG_ERROR("WebSocket error: {}", doc["msg"].get_string().value());
             } else {
-                std::cout << "Event: " << event.value() << std::endl;
+                LOG_INFO("Event: {}", event.value());
             }
             return;
         }
@@ -43,72 +51,56 @@ void OrderBookHandler::handleMessage(const std::string& message) {
             if (!error) {
                 if (action.value() == "snapshot") {
                     handleSnapshot(std::move(first_item));
+                    apply_latency_.recordSince(start_ns);
                     publishOrderBookUpdate();
                 } else if (action.value() == "update") {
                     processOrderBookUpdate(std::move(first_item));
+                    apply_latency_.recordSince(start_ns);
                     publishOrderBookUpdate();
                 }
 
                 auto end_time = std::chrono::high_resolution_clock::now();
                 auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
                 
-                logAverageProcessingTime(duration);
+                logAverageProcessingTime(duration, alloc_counter::threadAllocations() - allocations_before);
             }
         }
 
     } catch (const simdjson::simdjson_error& e) {
-        std::cerr << "Error processing message: " << e.what() << std::endl;
+        LOG_ERROR("Error processing message: {}", e.what());
     }
 }
 
-void OrderBookHandler::logAverageProcessingTime(std::chrono::microseconds current_duration) {
-    processing_times_.push_back(current_duration);
+void OrderBookHandler::logAverageProcessingTime(std::chrono::microseconds current_duration, uint64_t allocations) {
+    processing_times_[total_messages_processed_ % TIMING_BUFFER_SIZE] = current_duration;
     total_messages_processed_++;
-    
-    if (processing_times_.size() > TIMING_BUFFER_SIZE) {
-        processing_times_.pop_front();
-    }
+    window_allocations_ += allocations;
     
     // Log average every TIMING_BUFFER_SIZE messages
-    if (total_messages_processed_ % TIMING_BUFFER_SIZE == 0 && processing_times_.size() == TIMING_BUFFER_SIZE) {
+    if (total_messages_processed_ % TIMING_BUFFER_SIZE == 0) {
         auto total_duration = std::chrono::microseconds(0);
         for (const auto& duration : processing_times_) {
             total_duration += duration;
         }
         
         auto average_duration = total_duration.count() / TIMING_BUFFER_SIZE;
-        
-        std::cout << "[" << getCurrentTimestamp() << "] Average processing time over last " 
-                  << TIMING_BUFFER_SIZE << " messages: " << average_duration 
-                  << "µs, Current State ID: " << static_cast<int>(current_state_id_) << std::endl;
+
+        // Allocations should be 0 in steady state; anything else is a hot path regression
+        LOG_INFO("[{}] Average processing time over last {} messages: {}µs, Current State ID: {}, heap allocations: {}",
+                 instrument_, TIMING_BUFFER_SIZE, average_duration, current_state_id_, window_allocations_);
+        window_allocations_ = 0;
     }
 }
 
-std::string OrderBookHandler::getCurrentTimestamp() const {
-    auto now = std::chrono::system_clock::now();
-    auto now_c = std::chrono::system_clock::to_time_t(now);
-    auto now_ms = std::chrono::duration_cast<std::chrono::microseconds>(
-        now.time_since_epoch()) % 1000000;
-    
-    std::stringstream ss;
-    ss << std::put_time(std::localtime(&now_c), "%Y-%m-%d %H:%M:%S")
-       << '.' << std::setfill('0') << std::setw(6) << now_ms.count();
-    return ss.str();
+std::string OrderBookHandler::subscriptionRequest(const std::string& op, const std::string& instrument) {
+    return R"({"op":")" + op + R"(","args":[{"channel":"books","instId":")" + instrument + R"("}]})";
 }
 
-void OrderBookHandler::subscribe(const std::string& instrument) {
-    simdjson::padded_string subscription_json = simdjson::padded_string(R"({
-        "op": "subscribe",
-        "args": [{
-            "channel": "books",
-            "instId": ")" + instrument + R"("
-        }]
-    })");
-    
-    std::cout << "Subscribing to " << instrument << std::endl;
+void OrderBookHandler::subscribe() {
+    LOG_INFO("Subscribing to {}", instrument_);
     
     if (ws_client_) {
-        ws_client_->setPendingSubscribeMessage(subscription_json.data());
+        ws_client_->addSubscription(subscriptionRequest("subscribe", instrument_));
     }
 }
 
@@ -125,150 +117,61 @@ void OrderBookHandler::validateOrderBookState() {
 
 void OrderBookHandler::processOrderBookUpdate(simdjson::ondemand::value&& data) {
     try {
-        // Process asks and bids
+        // Process asks and bids; levels are kept sorted in place
         if (auto asks_array = data["asks"].get_array(); !asks_array.error()) {
             for (auto ask : asks_array) {
                 if (auto ask_array = ask.get_array(); !ask_array.error()) {
-                    updatePriceLevel(asks, std::move(ask_array), false);
+                    updatePriceLevel(asks, std::move(ask_array));
                 }
             }
-            std::sort(asks.begin(), asks.end(), compareAsks);
         }
 
         if (auto bids_array = data["bids"].get_array(); !bids_array.error()) {
             for (auto bid : bids_array) {
                 if (auto bid_array = bid.get_array(); !bid_array.error()) {
-                    updatePriceLevel(bids, std::move(bid_array), true);
+                    updatePriceLevel(bids, std::move(bid_array));
                 }
             }
-            std::sort(bids.begin(), bids.end(), compareBids);
         }
 
         validateOrderBookState();
 
     } catch (const simdjson::simdjson_error& e) {
-        std::cerr << "Error processing order book update: " << e.what() << std::endl;
+        LOG_ERROR("Error processing order book update: {}", e.what());
         throw;
     }
 }
 
-void OrderBookHandler::updatePriceLevel(std::vector<OrderBookLevel>& side, simdjson::ondemand::array&& level, bool is_bids) {
+template <typename Side>
+void OrderBookHandler::updatePriceLevel(Side& side, simdjson::ondemand::array&& level) {
+    ParsedLevel parsed;
+    if (!parseLevel(std::move(level), parsed)) {
+        LOG_RATE_LIMITED(1000, Warn, "Invalid price level format");
+        return;
+    }
+
+    // Binary search on the integer price plus an in-place shift within the fixed-capacity side
+    side.apply(parsed.price_ticks, parsed.price, parsed.volume, parsed.orders);
+}
+
+bool OrderBookHandler::parseLevel(simdjson::ondemand::array&& level, ParsedLevel& out) {
     size_t idx = 0;
-    double price = 0.0, volume = 0.0, orders = 0.0;
-    
+    bool valid = true;
+
     // Extract values from the array
     for (auto value : level) {
         if (idx >= 4) break;
-        
+
         if (auto str_val = value.get_string(); !str_val.error()) {
             switch(idx) {
-                case 0: price = fast_stod(str_val.value()); break;
-                case 1: volume = fast_stod(str_val.value()); break;
-                case 3: orders = fast_stod(str_val.value()); break;
+                case 0: valid &= decimal::parseWithTicks(str_val.value(), out.price, out.price_ticks); break;
+                case 1: valid &= decimal::parse(str_val.value(), out.volume); break;
+                case 3: valid &= decimal::parse(str_val.value(), out.orders); break;
             }
         }
         idx++;
     }
-    
-    if (idx < 4) {
-        std::cerr << "Invalid price level format" << std::endl;
-        return;
-    }
-
-    // Use custom binary search implementation for better cache locality
-    size_t left = 0;
-    size_t right = side.size();
-    
-    while (left < right) {
-        size_t mid = (left + right) / 2;
-        double mid_price = side[mid].price;
-        
-        if (is_bids) {
-            if (mid_price > price) left = mid + 1;
-            else if (mid_price < price) right = mid;
-            else {
-                // Exact match found
-                if (volume <= 0.0) {
-                    side.erase(side.begin() + mid);
-                } else {
-                    side[mid].volume = volume;
-                    side[mid].orders = orders;
-                }
-                return;
-            }
-        } else {
-            if (mid_price < price) left = mid + 1;
-            else if (mid_price > price) right = mid;
-            else {
-                // Exact match found
-                if (volume <= 0.0) {
-                    side.erase(side.begin() + mid);
-                } else {
-                    side[mid].volume = volume;
-                    side[mid].orders = orders;
-                }
-                return;
-            }
-        }
-    }
-
-    // If volume is 0, no need to insert
-    if (volume <= 0.0) return;
-
-    // Insert new level at the correct position
-    side.insert(side.begin() + left, OrderBookLevel{price, volume, orders});
-}
-
-// Fast string to double conversion
-inline double OrderBookHandler::fast_stod(std::string_view str) {
-    const char* p = str.data();
-    const char* end = p + str.size();
-    bool neg = false;
-    if (p < end && *p == '-') {
-        neg = true;
-        ++p;
-    }
-    
-    double val = 0.0;
-    while (p < end && *p >= '0' && *p <= '9') {
-        val = val * 10.0 + (*p - '0');
-        ++p;
-    }
-    
-    if (p < end && *p == '.') {
-        double factor = 0.1;
-        ++p;
-        while (p < end && *p >= '0' && *p <= '9') {
-            val += (*p - '0') * factor;
-            factor *= 0.1;
-            ++p;
-        }
-    }
-    
-    if (p < end && (*p == 'e' || *p == 'E')) {
-        ++p;
-        bool exp_neg = false;
-        if (p < end && *p == '-') {
-            exp_neg = true;
-            ++p;
-        } else if (p < end && *p == '+') {
-            ++p;
-        }
-        
-        int exp = 0;
-        while (p < end && *p >= '0' && *p <= '9') {
-            exp = exp * 10 + (*p - '0');
-            ++p;
-        }
-        
-        if (exp_neg) {
-            while (exp-- > 0) val *= 0.1;
-        } else {
-            while (exp-- > 0) val *= 10.0;
-        }
-    }
-    
-    return neg ? -val : val;
+    return valid && idx >= 4;
 }
 
 void OrderBookHandler::handleSnapshot(simdjson::ondemand::value&& data) {
@@ -277,70 +180,42 @@ void OrderBookHandler::handleSnapshot(simdjson::ondemand::value&& data) {
         bids.clear();
         asks.clear();
 
-        // Reserve space for efficiency
-        const size_t REQUIRED_LEVELS = 400;
-        bids.reserve(REQUIRED_LEVELS);
-        asks.reserve(REQUIRED_LEVELS);
-
         // Process initial bids
         if (auto bids_array = data["bids"].get_array(); !bids_array.error()) {
             for (auto bid : bids_array) {
                 if (auto bid_array = bid.get_array(); !bid_array.error()) {
-                    size_t idx = 0;
-                    double price = 0.0, volume = 0.0, orders = 0.0;
-                    
-                    for (auto value : bid_array) {
-                        if (idx >= 4) break;
-                        if (auto str_val = value.get_string(); !str_val.error()) {
-                            switch(idx) {
-                                case 0: price = fast_stod(str_val.value()); break;
-                                case 1: volume = fast_stod(str_val.value()); break;
-                                case 3: orders = fast_stod(str_val.value()); break;
-                            }
-                        }
-                        idx++;
-                    }
-                    
-                    if (idx >= 4 && volume > 0.0) {
-                        bids.emplace_back(price, volume, orders);
+                    ParsedLevel parsed;
+                    if (!parseLevel(std::move(bid_array.value()), parsed)) {
+                        LOG_RATE_LIMITED(1000, Warn, "Invalid snapshot bid level");
+                    } else if (parsed.volume > 0.0) {
+                        bids.append(parsed.price_ticks, parsed.price, parsed.volume, parsed.orders);
                     }
                 }
             }
-            std::sort(bids.begin(), bids.end(), compareBids);
+            bids.sort();
         }
 
         // Process initial asks
         if (auto asks_array = data["asks"].get_array(); !asks_array.error()) {
             for (auto ask : asks_array) {
                 if (auto ask_array = ask.get_array(); !ask_array.error()) {
-                    size_t idx = 0;
-                    double price = 0.0, volume = 0.0, orders = 0.0;
-                    
-                    for (auto value : ask_array) {
-                        if (idx >= 4) break;
-                        if (auto str_val = value.get_string(); !str_val.error()) {
-                            switch(idx) {
-                                case 0: price = fast_stod(str_val.value()); break;
-                                case 1: volume = fast_stod(str_val.value()); break;
-                                case 3: orders = fast_stod(str_val.value()); break;
-                            }
-                        }
-                        idx++;
-                    }
-                    
-                    if (idx >= 4 && volume > 0.0) {
-                        asks.emplace_back(price, volume, orders);
+                    ParsedLevel parsed;
+                    if (!parseLevel(std::move(ask_array.value()), parsed)) {
+                        LOG_RATE_LIMITED(1000, Warn, "Invalid snapshot ask level");
+                    } else if (parsed.volume > 0.0) {
+                        asks.append(parsed.price_ticks, parsed.price, parsed.volume, parsed.orders);
                     }
                 }
             }
-            std::sort(asks.begin(), asks.end(), compareAsks);
+            asks.sort();
         }
 
         validateOrderBookState();
         previous_mid_price = calculateMidPrice();
+        delta_encoder_.forceKeyframe();  // Deltas against the old book are meaningless
 
     } catch (const simdjson::simdjson_error& e) {
-        std::cerr << "Error processing snapshot: " << e.what() << std::endl;
+        LOG_ERROR("Error processing snapshot: {}", e.what());
         throw;
     }
 }
@@ -352,17 +227,9 @@ double OrderBookHandler::calculateMidPrice() const {
     return 0.0;
 }
 
-double OrderBookHandler::calculateVolumeImbalance(size_t depth) const {
-    double bidVolume = 0.0;
-    double askVolume = 0.0;
-
-    // Sum volumes up to specified depth
-    for (size_t i = 0; i < depth && i < bids.size(); ++i) {
-        bidVolume += bids[i].volume;
-    }
-    for (size_t i = 0; i < depth && i < asks.size(); ++i) {
-        askVolume += asks[i].volume;
-    }
+double OrderBookHandler::calculateVolumeImbalance(size_t depth_idx) const {
+    double bidVolume = bids.depthAggregate(depth_idx).volume;
+    double askVolume = asks.depthAggregate(depth_idx).volume;
 
     double totalVolume = bidVolume + askVolume;
     if (totalVolume > 0.0) {
@@ -371,17 +238,9 @@ double OrderBookHandler::calculateVolumeImbalance(size_t depth) const {
     return 0.0;
 }
 
-double OrderBookHandler::calculateOrderImbalance(size_t depth) const {
-    double bidOrders = 0.0;
-    double askOrders = 0.0;
-
-    // Sum orders up to specified depth
-    for (size_t i = 0; i < depth && i < bids.size(); ++i) {
-        bidOrders += bids[i].orders;
-    }
-    for (size_t i = 0; i < depth && i < asks.size(); ++i) {
-        askOrders += asks[i].orders;
-    }
+double OrderBookHandler::calculateOrderImbalance(size_t depth_idx) const {
+    double bidOrders = bids.depthAggregate(depth_idx).orders;
+    double askOrders = asks.depthAggregate(depth_idx).orders;
 
     double totalOrders = bidOrders + askOrders;
     if (totalOrders > 0.0) {
@@ -390,117 +249,27 @@ double OrderBookHandler::calculateOrderImbalance(size_t depth) const {
     return 0.0;
 }
 
-double OrderBookHandler::calculateVWAP(size_t depth, bool is_bids) const {
-    const auto& side = is_bids ? bids : asks;
-    double volumeSum = 0.0;
-    double weightedPriceSum = 0.0;
+double OrderBookHandler::calculateVWAP(size_t depth_idx, bool is_bids) const {
+    const DepthAggregate& depth = is_bids ? bids.depthAggregate(depth_idx) : asks.depthAggregate(depth_idx);
 
-    for (size_t i = 0; i < depth && i < side.size(); ++i) {
-        volumeSum += side[i].volume;
-        weightedPriceSum += side[i].price * side[i].volume;
-    }
-
-    if (volumeSum > 0.0) {
-        return weightedPriceSum / volumeSum;
+    if (depth.volume > 0.0) {
+        return depth.notional / depth.volume;
     }
     return 0.0;
 }
 
-double OrderBookHandler::calculateAverageVolume(
-    const std::deque<std::vector<OrderBookLevel>>& history, 
-    size_t level_idx) const {
-    double sum = 0.0;
-    size_t count = 0;
-    for (const auto& state : history) {
-        if (level_idx < state.size()) {
-            sum += state[level_idx].volume;
-            count++;
-        }
-    }
-    return count > 0 ? sum / count : 0.0;
-}
-
-double OrderBookHandler::calculateAverageOrders(
-    const std::deque<std::vector<OrderBookLevel>>& history, 
-    size_t level_idx) const {
-    double sum = 0.0;
-    size_t count = 0;
-    for (const auto& state : history) {
-        if (level_idx < state.size()) {
-            sum += state[level_idx].orders;
-            count++;
-        }
-    }
-    return count > 0 ? sum / count : 0.0;
-}
-
-std::vector<PreprocessedLevel> OrderBookHandler::preprocessLevels(
-    const std::vector<OrderBookLevel>& current,
-    const std::vector<OrderBookLevel>& previous,
-    const std::deque<std::vector<OrderBookLevel>>& history) const {
-    
-    std::vector<PreprocessedLevel> result;
-    result.reserve(current.size());
-
-    for (size_t i = 0; i < current.size(); ++i) {
-        PreprocessedLevel level;
-
-        // Calculate price change from previous state
-        if (i < previous.size() && previous[i].price != 0.0) {
-            level.price_change = ((current[i].price - previous[i].price) / previous[i].price);
-        } else {
-            level.price_change = 0.0;
-        }
-
-        // Calculate volume change from average
-        double avg_volume = calculateAverageVolume(history, i);
-        if (avg_volume > 0.0) {
-            level.volume_change = ((current[i].volume - avg_volume) / avg_volume);
-        } else {
-            level.volume_change = 0.0;
-        }
-
-        // Calculate orders change from average
-        double avg_orders = calculateAverageOrders(history, i);
-        if (avg_orders > 0.0) {
-            level.orders_change = ((current[i].orders - avg_orders) / avg_orders);
-        } else {
-            level.orders_change = 0.0;
-        }
-
-        result.push_back(level);
-    }
-
-    return result;
-}
-
-void OrderBookHandler::updateHistory() {
-    // Update bid history
-    previous_bids.push_back(bids);
-    if (previous_bids.size() > HISTORY_SIZE) {
-        previous_bids.pop_front();
-    }
-
-    // Update ask history
-    previous_asks.push_back(asks);
-    if (previous_asks.size() > HISTORY_SIZE) {
-        previous_asks.pop_front();
-    }
-}
-
 OrderBookFeatures OrderBookHandler::calculateFeatures() const {
     OrderBookFeatures features;
     features.midPrice = calculateMidPrice();
 
     // Calculate imbalances and VWAP for different depths
-    for (size_t i = 0; i < features.depthLevels.size(); ++i) {
-        size_t depth = features.depthLevels[i];
-        features.volumeImbalance[i] = calculateVolumeImbalance(depth);
-        features.orderImbalance[i] = calculateOrderImbalance(depth);
+    for (size_t i = 0; i < OrderBookFeatures::NUM_DEPTHS; ++i) {
+        features.volumeImbalance[i] = calculateVolumeImbalance(i);
+        features.orderImbalance[i] = calculateOrderImbalance(i);
         
         // Calculate bid and ask VWAP changes relative to mid price
-        double bid_vwap = calculateVWAP(depth, true);
-        double ask_vwap = calculateVWAP(depth, false);
+        double bid_vwap = calculateVWAP(i, true);
+        double ask_vwap = calculateVWAP(i, false);
         if (features.midPrice > 0.0) {
             features.bidVwapChange[i] = (bid_vwap - features.midPrice) / features.midPrice;
             features.askVwapChange[i] = (ask_vwap - features.midPrice) / features.midPrice;
@@ -513,8 +282,37 @@ OrderBookFeatures OrderBookHandler::calculateFeatures() const {
     return features;
 }
 
+void OrderBookHandler::setWireFormat(WireFormat format, orderbook_wire::Packing packing,
+                                     size_t keyframe_interval) {
+    wire_format_ = format;
+    delta_encoder_ = orderbook_wire::DeltaEncoder(packing, keyframe_interval);
+}
+
 void OrderBookHandler::publishOrderBookUpdate() {
+    const uint64_t start_ns = latency::nowNanos();
     try {
+        // Calculate features: mid price change, then 4 features per depth
+        auto features = calculateFeatures();
+        std::array<double, 1 + OrderBookFeatures::NUM_DEPTHS * OrderBookFeatures::NUM_FEATURES> feature_values;
+        feature_values[0] = features.midPrice;
+        for (size_t depth = 0; depth < OrderBookFeatures::NUM_DEPTHS; ++depth) {
+            double* values = &feature_values[1 + depth * OrderBookFeatures::NUM_FEATURES];
+            values[0] = features.volumeImbalance[depth];
+            values[1] = features.orderImbalance[depth];
+            values[2] = features.bidVwapChange[depth];
+            values[3] = features.askVwapChange[depth];
+        }
+        static_assert(feature_values.size() == orderbook_wire::FEATURE_VALUES, "Feature layout out of sync with the wire format");
+
+        // Actual mid-price in cents
+        uint32_t mid_price_cents = static_cast<uint32_t>(features.midPrice * binary_utils::CENTS_MULTIPLIER);
+
+        if (wire_format_ == WireFormat::V3) {
+            publishV3Update(feature_values.data(), mid_price_cents);
+            publish_latency_.recordSince(start_ns);
+            return;
+        }
+
         // Calculate total size needed for the binary message
         const size_t message_size = (bids.size() * LEVEL_VALUES + asks.size() * LEVEL_VALUES + 1 + 
                                    OrderBookFeatures::NUM_DEPTHS * OrderBookFeatures::NUM_FEATURES) * 
@@ -522,51 +320,20 @@ void OrderBookHandler::publishOrderBookUpdate() {
                                    sizeof(uint32_t) +  // 4 bytes for mid-price
                                    STATE_ID_SIZE;      // 2 bytes for state ID
 
-        std::vector<char> buffer(message_size);
-        char* data = buffer.data();
+        publish_buffer_.resize(message_size);  // Within the reserved capacity
+        char* data = publish_buffer_.data();
         size_t offset = 0;
 
-        // Write bids
-        for (const auto& level : bids) {
-            *reinterpret_cast<uint64_t*>(data + offset) = binary_utils::encodeChangeValue(level.price);
-            offset += VALUE_SIZE;
-            *reinterpret_cast<uint64_t*>(data + offset) = binary_utils::encodeOrderBookValue(level.volume);
-            offset += VALUE_SIZE;
-            *reinterpret_cast<uint64_t*>(data + offset) = binary_utils::encodeOrderBookValue(level.orders);
-            offset += VALUE_SIZE;
-        }
+        // Bulk-encode both sides straight from the contiguous level arrays
+        binary_utils::encodeLevels(reinterpret_cast<const double*>(bids.data()), bids.size(), data + offset);
+        offset += bids.size() * LEVEL_VALUES * VALUE_SIZE;
+        binary_utils::encodeLevels(reinterpret_cast<const double*>(asks.data()), asks.size(), data + offset);
+        offset += asks.size() * LEVEL_VALUES * VALUE_SIZE;
 
-        // Write asks
-        for (const auto& level : asks) {
-            *reinterpret_cast<uint64_t*>(data + offset) = binary_utils::encodeChangeValue(level.price);
-            offset += VALUE_SIZE;
-            *reinterpret_cast<uint64_t*>(data + offset) = binary_utils::encodeOrderBookValue(level.volume);
-            offset += VALUE_SIZE;
-            *reinterpret_cast<uint64_t*>(data + offset) = binary_utils::encodeOrderBookValue(level.orders);
-            offset += VALUE_SIZE;
-        }
-
-        // Calculate and write features
-        auto features = calculateFeatures();
-        
-        // Write mid price change
-        *reinterpret_cast<uint64_t*>(data + offset) = binary_utils::encodeChangeValue(features.midPrice);
-        offset += VALUE_SIZE;
-
-        // Write market features
-        for (size_t depth = 0; depth < OrderBookFeatures::NUM_DEPTHS; ++depth) {
-            *reinterpret_cast<uint64_t*>(data + offset) = binary_utils::encodeChangeValue(features.volumeImbalance[depth]);
-            offset += VALUE_SIZE;
-            *reinterpret_cast<uint64_t*>(data + offset) = binary_utils::encodeChangeValue(features.orderImbalance[depth]);
-            offset += VALUE_SIZE;
-            *reinterpret_cast<uint64_t*>(data + offset) = binary_utils::encodeChangeValue(features.bidVwapChange[depth]);
-            offset += VALUE_SIZE;
-            *reinterpret_cast<uint64_t*>(data + offset) = binary_utils::encodeChangeValue(features.askVwapChange[depth]);
-            offset += VALUE_SIZE;
-        }
+        binary_utils::encodeChangeValues(feature_values.data(), feature_values.size(), data + offset);
+        offset += feature_values.size() * VALUE_SIZE;
 
         // Write actual mid-price in cents (4 bytes)
-        uint32_t mid_price_cents = static_cast<uint32_t>(features.midPrice * binary_utils::CENTS_MULTIPLIER);
         *reinterpret_cast<uint32_t*>(data + offset) = mid_price_cents;
         offset += sizeof(uint32_t);
 
@@ -577,10 +344,38 @@ void OrderBookHandler::publishOrderBookUpdate() {
         incrementStateId();
 
         // Publish binary message
-        rmq_handler_->publishBinaryMessage("orderbook", "orderbook.updates", 
-                                         buffer.data(), buffer.size());
+        const bool published = publisher_->publish(publish_buffer_.data(), publish_buffer_.size());
+        publish_latency_.recordSince(start_ns);
+        if (published && recorder_) {
+            recorder_->append(publish_buffer_.data(), publish_buffer_.size(), recording::wallNanosOf(origin_ns_), true);
+        }
 
     } catch (const std::exception& e) {
-        std::cerr << "[ERROR] Failed to publish orderbook update: " << e.what() << std::endl;
+        LOG_ERROR("Failed to publish orderbook update: {}", e.what());
+    }
+}
+
+void OrderBookHandler::publishV3Update(const double* feature_values, uint32_t mid_price_cents) {
+    if (bids.size() != orderbook_wire::LEVELS || asks.size() != orderbook_wire::LEVELS) {
+        throw OrderBookException("v3 messages need " + std::to_string(orderbook_wire::LEVELS) + " levels per side");
+    }
+
+    // Consumers that lost a delta after it was accepted (e.g. nacked by the broker), and the
+    // recorder switching segments or recovering from dropped records, resync on a keyframe
+    if (publisher_->takeResync() || (recorder_ && recorder_->wantsKeyframe())) {
+        delta_encoder_.forceKeyframe();
+    }
+
+    const size_t size = delta_encoder_.encode(reinterpret_cast<const double*>(bids.data()),
+                                              reinterpret_cast<const double*>(asks.data()),
+                                              feature_values, mid_price_cents, current_state_id_, v3_buffer_,
+                                              origin_ns_);
+    incrementStateId();
+
+    // A lost delta would leave consumers without a base, so resync them with a keyframe
+    if (!publisher_->publish(v3_buffer_.data(), size)) {
+        delta_encoder_.forceKeyframe();
+    } else if (recorder_) {
+        recorder_->append(v3_buffer_.data(), size, recording::wallNanosOf(origin_ns_), delta_encoder_.lastWasKeyframe());
     }
 }
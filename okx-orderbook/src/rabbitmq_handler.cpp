@@ -1,11 +1,16 @@
 #include "../include/rabbitmq_handler.hpp"
+#include <async_logger.hpp>
 #include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <sys/time.h>
 
 RabbitMQHandler::RabbitMQHandler(const std::string& host, int port,
                                const std::string& username, const std::string& password)
     : host_(host), port_(port), username_(username), password_(password), conn(nullptr) {}
 
 RabbitMQHandler::~RabbitMQHandler() {
+    stopPublisher();
     if (conn) {
         amqp_channel_close(conn, 1, AMQP_REPLY_SUCCESS);
         amqp_connection_close(conn, AMQP_REPLY_SUCCESS);
@@ -15,100 +20,190 @@ RabbitMQHandler::~RabbitMQHandler() {
 
 bool RabbitMQHandler::connect() {
     try {
-        conn = amqp_new_connection();
-        amqp_socket_t* socket = amqp_tcp_socket_new(conn);
-        if (!socket) {
-            throw std::runtime_error("Creating TCP socket failed");
-        }
-
-        int status = amqp_socket_open(socket, host_.c_str(), port_);
-        if (status != AMQP_STATUS_OK) {
-            throw std::runtime_error("Opening TCP socket failed");
-        }
-
-        auto login_status = amqp_login(conn, "/", 0, 131072, 0, AMQP_SASL_METHOD_PLAIN,
-                                     username_.c_str(), password_.c_str());
-        if (login_status.reply_type != AMQP_RESPONSE_NORMAL) {
-            throw std::runtime_error("Login failed");
-        }
-
-        amqp_channel_open(conn, 1);
-        auto channel_status = amqp_get_rpc_reply(conn);
-        if (channel_status.reply_type != AMQP_RESPONSE_NORMAL) {
-            throw std::runtime_error("Opening channel failed");
-        }
+        openConnection();
 
-        // Declare the exchange
-        amqp_exchange_declare(conn, 1, 
-                            amqp_cstring_bytes("orderbook"), // exchange name
-                            amqp_cstring_bytes("topic"),     // exchange type
-                            0,                               // passive
-                            1,                               // durable
-                            0,                               // auto_delete
-                            0,                               // internal
-                            amqp_empty_table);              // arguments
-
-        auto exchange_status = amqp_get_rpc_reply(conn);
-        if (exchange_status.reply_type != AMQP_RESPONSE_NORMAL) {
-            throw std::runtime_error("Declaring exchange failed");
+        if (mode_ == PublishMode::Async) {
+            queue_ = std::make_unique<SpscQueue<PublishSlot, QUEUE_CAPACITY>>();
+            last_stats_log_ = std::chrono::steady_clock::now();
+            publisher_running_ = true;
+            publisher_thread_ = std::thread(&RabbitMQHandler::publisherLoop, this);
         }
 
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "RabbitMQ connection error: " << e.what() << std::endl;
-        if (conn) {
-            amqp_destroy_connection(conn);
-            conn = nullptr;
-        }
+        LOG_ERROR("RabbitMQ connection error: {}", e.what());
+        closeConnection();
         return false;
     }
 }
 
-bool RabbitMQHandler::publishMessage(const std::string& exchange, const std::string& routingKey,
-                                   const std::string& message) {
-    if (!conn) {
-        std::cerr << "Not connected to RabbitMQ" << std::endl;
-        return false;
+// Connect, log in and open channel 1 with the exchange declared; throws, leaving conn to the caller
+void RabbitMQHandler::openConnection() {
+    conn = amqp_new_connection();
+    amqp_socket_t* socket = amqp_tcp_socket_new(conn);
+    if (!socket) {
+        throw std::runtime_error("Creating TCP socket failed");
     }
 
-    try {
-        amqp_basic_properties_t props;
-        props._flags = AMQP_BASIC_CONTENT_TYPE_FLAG | AMQP_BASIC_DELIVERY_MODE_FLAG;
-        props.content_type = amqp_cstring_bytes("application/json");
-        props.delivery_mode = 2; // persistent delivery mode
+    int status = amqp_socket_open(socket, host_.c_str(), port_);
+    if (status != AMQP_STATUS_OK) {
+        throw std::runtime_error("Opening TCP socket failed");
+    }
 
-        int status = amqp_basic_publish(conn,
-                                      1,
-                                      amqp_cstring_bytes(exchange.c_str()),
-                                      amqp_cstring_bytes(routingKey.c_str()),
-                                      0,
-                                      0,
-                                      &props,
-                                      amqp_cstring_bytes(message.c_str()));
+    auto login_status = amqp_login(conn, "/", 0, 131072, 0, AMQP_SASL_METHOD_PLAIN,
+                                 username_.c_str(), password_.c_str());
+    if (login_status.reply_type != AMQP_RESPONSE_NORMAL) {
+        throw std::runtime_error("Login failed");
+    }
 
-        if (status != AMQP_STATUS_OK) {
-            throw std::runtime_error("Publishing message failed");
+    amqp_channel_open(conn, 1);
+    auto channel_status = amqp_get_rpc_reply(conn);
+    if (channel_status.reply_type != AMQP_RESPONSE_NORMAL) {
+        throw std::runtime_error("Opening channel failed");
+    }
+
+    // Declare the exchange
+    amqp_exchange_declare(conn, 1, 
+                        amqp_cstring_bytes("orderbook"), // exchange name
+                        amqp_cstring_bytes("topic"),     // exchange type
+                        0,                               // passive
+                        1,                               // durable
+                        0,                               // auto_delete
+                        0,                               // internal
+                        amqp_empty_table);              // arguments
+
+    auto exchange_status = amqp_get_rpc_reply(conn);
+    if (exchange_status.reply_type != AMQP_RESPONSE_NORMAL) {
+        throw std::runtime_error("Declaring exchange failed");
+    }
+
+    if (mode_ == PublishMode::Async) {
+        // Broker acks every message on this channel from now on
+        amqp_confirm_select(conn, 1);
+        auto confirm_status = amqp_get_rpc_reply(conn);
+        if (confirm_status.reply_type != AMQP_RESPONSE_NORMAL) {
+            throw std::runtime_error("Enabling publisher confirms failed");
         }
+    }
+}
 
-        return true;
+// Drop the connection without the closing handshake, which a lost connection cannot complete
+void RabbitMQHandler::closeConnection() {
+    if (conn) {
+        amqp_destroy_connection(conn);
+        conn = nullptr;
+    }
+}
+
+// Publisher thread: replace a lost connection; false (logged) if the broker is still unreachable
+bool RabbitMQHandler::reconnect() {
+    closeConnection();
+    try {
+        openConnection();
     } catch (const std::exception& e) {
-        std::cerr << "Error publishing message: " << e.what() << std::endl;
+        LOG_RATE_LIMITED(5000, Error, "Reconnecting to RabbitMQ failed, retrying in {} ms: {}",
+                         reconnect_wait_.count(), e.what());
+        closeConnection();
         return false;
     }
+
+    // Delivery tags restart with the channel
+    next_delivery_tag_ = 1;
+    confirmed_up_to_ = 0;
+    confirm_done_.fill(false);
+    connection_lost_ = false;
+    reconnect_wait_ = RECONNECT_MIN_WAIT;
+    reconnects_.fetch_add(1, std::memory_order_relaxed);
+    LOG_INFO("Reconnected to RabbitMQ at {}:{}", host_, port_);
+    return true;
+}
+
+// Publisher thread: stop publishing until reconnected; what the broker has not confirmed is lost
+void RabbitMQHandler::markConnectionLost(const char* reason) {
+    if (connection_lost_) return;
+    connection_lost_ = true;
+    lost_.fetch_add(next_delivery_tag_ - 1 - confirmed_up_to_, std::memory_order_relaxed);
+    requestResync();
+    LOG_ERROR("RabbitMQ publish connection lost: {}", reason);
+}
+
+void RabbitMQHandler::setDeliveryMode(const std::string& exchange, bool persistent) {
+    const uint8_t mode = persistent ? 2 : 1;
+    for (auto& entry : delivery_modes_) {
+        if (entry.first == exchange) {
+            entry.second = mode;
+            return;
+        }
+    }
+    delivery_modes_.emplace_back(exchange, mode);
+}
+
+uint8_t RabbitMQHandler::deliveryModeFor(const char* exchange) const {
+    for (const auto& entry : delivery_modes_) {
+        if (entry.first == exchange) return entry.second;
+    }
+    return 2;  // Persistent unless configured otherwise
+}
+
+bool RabbitMQHandler::publishMessage(const std::string& exchange, const std::string& routingKey,
+                                   const std::string& message) {
+    if (mode_ == PublishMode::Async) {
+        return enqueue(exchange, routingKey, message.data(), message.size(), false);
+    }
+    return publishNow(exchange.c_str(), routingKey.c_str(), message.data(), message.size(), false);
 }
 
 bool RabbitMQHandler::publishBinaryMessage(const std::string& exchange, const std::string& routingKey,
                                          const char* data, size_t size) {
+    if (mode_ == PublishMode::Async) {
+        return enqueue(exchange, routingKey, data, size, true);
+    }
+    return publishNow(exchange.c_str(), routingKey.c_str(), data, size, true);
+}
+
+bool RabbitMQHandler::enqueue(const std::string& exchange, const std::string& routingKey,
+                              const char* data, size_t size, bool binary) {
+    if (!queue_) {
+        LOG_RATE_LIMITED(1000, Error, "Not connected to RabbitMQ");
+        return false;
+    }
+    if (size > MAX_MESSAGE_SIZE || exchange.size() >= MAX_NAME_SIZE || routingKey.size() >= MAX_NAME_SIZE) {
+        LOG_ERROR("Message too large for the publish queue: {} bytes", size);
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Never wait for the publisher thread; a full queue means the broker is falling behind
+    PublishSlot* slot = queue_->tryAcquire();
+    if (!slot) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    std::memcpy(slot->exchange, exchange.c_str(), exchange.size() + 1);
+    std::memcpy(slot->routing_key, routingKey.c_str(), routingKey.size() + 1);
+    slot->binary = binary;
+    slot->size = size;
+    slot->enqueued_at = std::chrono::steady_clock::now();
+    std::memcpy(slot->data.data(), data, size);
+    queue_->commit();
+
+    enqueued_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool RabbitMQHandler::publishNow(const char* exchange, const char* routingKey,
+                                 const char* data, size_t size, bool binary) {
     if (!conn) {
-        std::cerr << "Not connected to RabbitMQ" << std::endl;
+        LOG_RATE_LIMITED(1000, Error, "Not connected to RabbitMQ");
         return false;
     }
 
     try {
         amqp_basic_properties_t props;
         props._flags = AMQP_BASIC_CONTENT_TYPE_FLAG | AMQP_BASIC_DELIVERY_MODE_FLAG;
-        props.content_type = amqp_cstring_bytes("application/octet-stream");
-        props.delivery_mode = 2; // persistent delivery mode
+        props.content_type = amqp_cstring_bytes(binary ? "application/octet-stream" : "application/json");
+        props.delivery_mode = deliveryModeFor(exchange);
 
         amqp_bytes_t message_bytes;
         message_bytes.len = size;
@@ -116,20 +211,215 @@ bool RabbitMQHandler::publishBinaryMessage(const std::string& exchange, const st
 
         int status = amqp_basic_publish(conn,
                                       1,
-                                      amqp_cstring_bytes(exchange.c_str()),
-                                      amqp_cstring_bytes(routingKey.c_str()),
+                                      amqp_cstring_bytes(exchange),
+                                      amqp_cstring_bytes(routingKey),
                                       0,
                                       0,
                                       &props,
                                       message_bytes);
 
         if (status != AMQP_STATUS_OK) {
-            throw std::runtime_error("Publishing binary message failed");
+            throw std::runtime_error(binary ? "Publishing binary message failed" : "Publishing message failed");
         }
 
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "Error publishing binary message: " << e.what() << std::endl;
+        LOG_RATE_LIMITED(1000, Error, binary ? "Error publishing binary message: {}" : "Error publishing message: {}",
+                         e.what());
         return false;
     }
-} 
\ No newline at end of file
+}
+
+void RabbitMQHandler::publisherLoop() {
+    logging::setThreadName("publisher");
+    while (publisher_running_.load(std::memory_order_acquire) || !queue_->empty()) {
+        if (connection_lost_) {
+            // Queued states are stale by the time the broker is back; consumers resync instead
+            for (; queue_->front(); queue_->pop()) {
+                lost_.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (!publisher_running_.load(std::memory_order_acquire)) break;
+            if (!reconnect()) {
+                const auto retry_at = std::chrono::steady_clock::now() + reconnect_wait_;
+                while (publisher_running_.load(std::memory_order_acquire) && std::chrono::steady_clock::now() < retry_at) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+                reconnect_wait_ = std::min<std::chrono::milliseconds>(reconnect_wait_ * 2, RECONNECT_MAX_WAIT);
+                continue;
+            }
+        }
+
+        publishBatch();
+        const bool idle = queue_->empty();
+
+        // Drain confirms; block briefly only when there is nothing to publish
+        pollConfirms(idle);
+
+        if (std::chrono::steady_clock::now() - last_stats_log_ >= STATS_LOG_INTERVAL) {
+            logStats();
+        }
+    }
+
+    // Give the broker a moment to confirm the tail before the connection closes
+    if (connection_lost_) return;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (confirmed_up_to_ + 1 < next_delivery_tag_ && std::chrono::steady_clock::now() < deadline) {
+        if (!pollConfirms(true)) break;
+    }
+}
+
+void RabbitMQHandler::publishBatch() {
+    for (size_t i = 0; i < PUBLISH_BATCH_SIZE; ++i) {
+        // Bound the confirm window; waiting here only backs up the queue, never the caller
+        while (next_delivery_tag_ - confirmed_up_to_ > MAX_UNCONFIRMED) {
+            if (!pollConfirms(true)) return;
+        }
+
+        PublishSlot* slot = queue_->front();
+        if (!slot || connection_lost_) return;
+
+        if (publishNow(slot->exchange, slot->routing_key, slot->data.data(), slot->size, slot->binary)) {
+            confirm_pending_[next_delivery_tag_ % MAX_UNCONFIRMED] = slot->enqueued_at;
+            ++next_delivery_tag_;
+            published_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            // librabbitmq only fails a publish on a broken socket
+            failed_.fetch_add(1, std::memory_order_relaxed);
+            markConnectionLost("publish failed");
+        }
+        queue_->pop();
+    }
+}
+
+bool RabbitMQHandler::pollConfirms(bool wait) {
+    // Idle waits are short so newly queued messages are picked up quickly
+    struct timeval timeout = {0, wait ? IDLE_POLL_TIMEOUT_US : 0};
+    bool received = false;
+    if (connection_lost_) return false;
+
+    while (true) {
+        amqp_frame_t frame;
+        int status = amqp_simple_wait_frame_noblock(conn, &frame, &timeout);
+        if (status == AMQP_STATUS_TIMEOUT) break;
+        if (status != AMQP_STATUS_OK) {
+            markConnectionLost(amqp_error_string2(status));
+            return false;
+        }
+
+        received = true;
+        timeout = {0, 0};  // Only the first frame is waited for
+
+        if (frame.frame_type != AMQP_FRAME_METHOD) continue;
+        switch (frame.payload.method.id) {
+            case AMQP_BASIC_ACK_METHOD: {
+                auto* ack = static_cast<amqp_basic_ack_t*>(frame.payload.method.decoded);
+                handleConfirm(ack->delivery_tag, ack->multiple, true);
+                break;
+            }
+            case AMQP_BASIC_NACK_METHOD: {
+                auto* nack = static_cast<amqp_basic_nack_t*>(frame.payload.method.decoded);
+                handleConfirm(nack->delivery_tag, nack->multiple, false);
+                break;
+            }
+            case AMQP_CHANNEL_CLOSE_METHOD: {
+                // Nothing more is confirmed or published on a closed channel; start over
+                auto* close = static_cast<amqp_channel_close_t*>(frame.payload.method.decoded);
+                LOG_ERROR("RabbitMQ closed the publish channel: {}",
+                          std::string_view(static_cast<const char*>(close->reply_text.bytes), close->reply_text.len));
+                markConnectionLost("channel closed");
+                return false;
+            }
+            case AMQP_CONNECTION_CLOSE_METHOD: {
+                auto* close = static_cast<amqp_connection_close_t*>(frame.payload.method.decoded);
+                LOG_ERROR("RabbitMQ closed the connection: {}",
+                          std::string_view(static_cast<const char*>(close->reply_text.bytes), close->reply_text.len));
+                markConnectionLost("connection closed");
+                return false;
+            }
+            default:
+                break;
+        }
+    }
+
+    amqp_maybe_release_buffers(conn);
+    return received;
+}
+
+void RabbitMQHandler::handleConfirm(uint64_t delivery_tag, bool multiple, bool ack) {
+    if (delivery_tag <= confirmed_up_to_ || delivery_tag >= next_delivery_tag_) return;
+
+    const auto now = std::chrono::steady_clock::now();
+    auto confirm = [&](uint64_t tag) {
+        const size_t idx = tag % MAX_UNCONFIRMED;
+        if (confirm_done_[idx]) return;
+        confirm_done_[idx] = true;
+
+        (ack ? acked_ : nacked_).fetch_add(1, std::memory_order_relaxed);
+        if (!ack) requestResync();  // The broker dropped a message consumers expected
+        const uint64_t latency_us = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(now - confirm_pending_[idx]).count());
+        confirm_latency_total_us_.fetch_add(latency_us, std::memory_order_relaxed);
+        confirm_latency_count_.fetch_add(1, std::memory_order_relaxed);
+        if (latency_us > confirm_latency_max_us_.load(std::memory_order_relaxed)) {
+            confirm_latency_max_us_.store(latency_us, std::memory_order_relaxed);
+        }
+    };
+
+    if (multiple) {
+        for (uint64_t tag = confirmed_up_to_ + 1; tag <= delivery_tag; ++tag) confirm(tag);
+    } else {
+        confirm(delivery_tag);
+    }
+
+    // Advance over the contiguous confirmed prefix
+    while (confirmed_up_to_ + 1 < next_delivery_tag_ && confirm_done_[(confirmed_up_to_ + 1) % MAX_UNCONFIRMED]) {
+        ++confirmed_up_to_;
+        confirm_done_[confirmed_up_to_ % MAX_UNCONFIRMED] = false;
+    }
+}
+
+PublisherStats RabbitMQHandler::getStats() const {
+    PublisherStats stats;
+    stats.queue_depth = queue_ ? queue_->size() : 0;
+    stats.enqueued = enqueued_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    stats.published = published_.load(std::memory_order_relaxed);
+    stats.failed = failed_.load(std::memory_order_relaxed);
+    stats.acked = acked_.load(std::memory_order_relaxed);
+    stats.nacked = nacked_.load(std::memory_order_relaxed);
+    stats.lost = lost_.load(std::memory_order_relaxed);
+    stats.reconnects = reconnects_.load(std::memory_order_relaxed);
+    stats.unconfirmed = stats.published - std::min(stats.published, stats.acked + stats.nacked + stats.lost);
+
+    const uint64_t count = confirm_latency_count_.load(std::memory_order_relaxed);
+    const uint64_t total = confirm_latency_total_us_.load(std::memory_order_relaxed);
+    stats.avg_confirm_latency_us = count ? static_cast<double>(total) / count : 0.0;
+    stats.max_confirm_latency_us = confirm_latency_max_us_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// Confirm latency since the previous call, starting a new window
+void RabbitMQHandler::takeConfirmLatency(PublisherStats& stats) {
+    const uint64_t count = confirm_latency_count_.exchange(0, std::memory_order_relaxed);
+    const uint64_t total = confirm_latency_total_us_.exchange(0, std::memory_order_relaxed);
+    stats.avg_confirm_latency_us = count ? static_cast<double>(total) / count : 0.0;
+    stats.max_confirm_latency_us = confirm_latency_max_us_.exchange(0, std::memory_order_relaxed);
+}
+
+void RabbitMQHandler::logStats() {
+    last_stats_log_ = std::chrono::steady_clock::now();
+    PublisherStats stats = getStats();
+    takeConfirmLatency(stats);
+    LOG_INFO("RabbitMQ publisher: queue depth {}, published {}, acked {}, nacked {}, unconfirmed {}, dropped {}, "
+             "failed {}, lost {}, reconnects {}, confirm latency avg {}µs max {}µs",
+             stats.queue_depth, stats.published, stats.acked, stats.nacked, stats.unconfirmed, stats.dropped,
+             stats.failed, stats.lost, stats.reconnects, static_cast<uint64_t>(stats.avg_confirm_latency_us),
+             stats.max_confirm_latency_us);
+}
+
+void RabbitMQHandler::stopPublisher() {
+    if (!publisher_thread_.joinable()) return;
+    publisher_running_.store(false, std::memory_order_release);
+    publisher_thread_.join();
+    logStats();
+}
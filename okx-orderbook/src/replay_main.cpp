@@ -0,0 +1,280 @@
+// Replays recorded orderbook segments (see market_recording.hpp) onto the orderbook exchange or
+// the shared-memory rings, so the PPO pipeline sees the recorded stream as if it were live:
+//
+//   orderbook_replay <segment file or directory>...
+//
+// REPLAY_SPEED: 1 replays at the recorded rate, N at N times it, 0 as fast as possible (default 1)
+// REPLAY_TRANSPORT: rabbitmq or shm (default rabbitmq)
+// REPLAY_LOOPS: passes over the recording (default 1); each pass continues the state IDs of the
+//   one before, so consumers see one unbroken stream rather than the same IDs again
+// RABBITMQ_HOST/PORT/USER/PASS, RABBITMQ_PUBLISH_MODE and ORDERBOOK_SHM_SLOTS as for okx_orderbook
+#include "../include/rabbitmq_handler.hpp"
+#include <market_recording.hpp>
+#include <orderbook_wire.hpp>
+#include <latency_histogram.hpp>
+#include <transport.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr auto MAX_GAP = std::chrono::seconds(5);  // Longest pause replayed, e.g. across recorder restarts
+constexpr auto PUBLISH_RETRY_WAIT = std::chrono::microseconds(50);  // While the async publish queue is full
+constexpr auto PUBLISH_RETRY_LIMIT = std::chrono::seconds(1);
+constexpr auto PROGRESS_INTERVAL = std::chrono::seconds(10);
+constexpr auto DRAIN_LIMIT = std::chrono::seconds(10);  // Wait for the broker to confirm the tail
+
+std::atomic<bool> running{true};
+
+std::string getEnvVar(const char* name, const std::string& defaultValue) {
+    const char* value = std::getenv(name);
+    return value ? value : defaultValue;
+}
+
+// The recording of one topic: its segments in time order and the next record to send
+struct Stream {
+    std::string topic;
+    std::vector<std::string> segments;
+    size_t segment = 0;
+    std::unique_ptr<recording::SegmentReader> reader;
+    recording::Record record;
+    bool has_record = false;
+    std::unique_ptr<transport::Publisher> publisher;
+
+    // State IDs of this pass as recorded, and the shift that puts them after the previous pass
+    uint16_t first_state_id = 0;
+    uint16_t last_state_id = 0;
+    bool has_state_id = false;
+    uint16_t state_offset = 0;
+
+    // Load the next record, moving on to the next segment at the end of one
+    void advance() {
+        has_record = false;
+        while (true) {
+            if (reader && reader->next(record)) {
+                has_record = true;
+                return;
+            }
+            if (segment >= segments.size()) {
+                reader.reset();
+                return;
+            }
+            reader = std::make_unique<recording::SegmentReader>(segments[segment++]);
+        }
+    }
+
+    void rewind() {
+        if (has_state_id) {
+            state_offset += static_cast<uint16_t>(last_state_id - first_state_id + 1);
+            has_state_id = false;
+        }
+        segment = 0;
+        reader.reset();
+        advance();
+    }
+};
+
+std::vector<std::string> collectSegments(int argc, char* argv[]) {
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i) {
+        const std::filesystem::path path(argv[i]);
+        if (std::filesystem::is_directory(path)) {
+            for (const auto& entry : std::filesystem::directory_iterator(path)) {
+                if (entry.is_regular_file() && entry.path().extension() == recording::SEGMENT_EXTENSION) {
+                    paths.push_back(entry.path().string());
+                }
+            }
+        } else {
+            paths.push_back(path.string());
+        }
+    }
+    return paths;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        if (argc < 2) {
+            std::cerr << "Usage: " << argv[0] << " <segment file or directory>..." << std::endl;
+            return 1;
+        }
+        std::signal(SIGINT, [](int) { running = false; });
+        std::signal(SIGTERM, [](int) { running = false; });
+
+        const double speed = std::stod(getEnvVar("REPLAY_SPEED", "1"));
+        const size_t loops = std::stoul(getEnvVar("REPLAY_LOOPS", "1"));
+        const std::string transportName = getEnvVar("REPLAY_TRANSPORT", "rabbitmq");
+        transport::Kind transportKind = transport::Kind::RabbitMQ;
+        if (!transport::parseKind(transportName, transportKind)) {
+            std::cerr << "Unknown REPLAY_TRANSPORT " << transportName << std::endl;
+            return 1;
+        }
+
+        // Group the segments by topic, each topic's in recording order
+        std::map<std::string, std::vector<std::pair<uint64_t, std::string>>> byTopic;
+        for (const auto& path : collectSegments(argc, argv)) {
+            recording::SegmentReader reader(path);
+            if (reader.records() == 0) continue;
+            byTopic[reader.topic()].emplace_back(reader.firstNanos(), path);
+        }
+        if (byTopic.empty()) {
+            std::cerr << "No recorded messages found" << std::endl;
+            return 1;
+        }
+
+        std::unique_ptr<RabbitMQHandler> rmq;
+        if (transportKind == transport::Kind::RabbitMQ) {
+            rmq = std::make_unique<RabbitMQHandler>(getEnvVar("RABBITMQ_HOST", "localhost"),
+                                                    std::stoi(getEnvVar("RABBITMQ_PORT", "5672")),
+                                                    getEnvVar("RABBITMQ_USER", "guest"),
+                                                    getEnvVar("RABBITMQ_PASS", "guest"));
+            if (getEnvVar("RABBITMQ_PUBLISH_MODE", "async") == "async") {
+                rmq->setPublishMode(RabbitMQHandler::PublishMode::Async);
+            }
+            if (!rmq->connect()) {
+                std::cerr << "Failed to connect to RabbitMQ" << std::endl;
+                return 1;
+            }
+        }
+        const size_t shmSlots = std::stoul(getEnvVar("ORDERBOOK_SHM_SLOTS", "64"));
+
+        std::vector<Stream> streams;
+        for (auto& [topic, segments] : byTopic) {
+            std::sort(segments.begin(), segments.end());
+            Stream stream;
+            stream.topic = topic;
+            for (const auto& segment : segments) {
+                stream.segments.push_back(segment.second);
+            }
+            if (rmq) {
+                stream.publisher = std::make_unique<RabbitMQPublisher>(rmq.get(), "orderbook", topic);
+            } else {
+                stream.publisher = std::make_unique<transport::ShmPublisher>(
+                    transport::ringName(topic),
+                    std::max(orderbook_wire::V2_MESSAGE_SIZE, orderbook_wire::MAX_V3_MESSAGE_SIZE), shmSlots);
+            }
+            std::cout << "Replaying " << stream.segments.size() << " segments of " << topic << std::endl;
+            streams.push_back(std::move(stream));
+        }
+        std::cout << "Replay speed: " << (speed > 0 ? std::to_string(speed) + "x" : std::string("maximum"))
+                  << ", transport: " << transportName << ", passes: " << loops << std::endl;
+
+        std::vector<char> buffer(std::max(orderbook_wire::V2_MESSAGE_SIZE, orderbook_wire::MAX_V3_MESSAGE_SIZE));
+        uint64_t sent = 0;
+        uint64_t bytes = 0;
+        uint64_t dropped = 0;
+        const auto start = std::chrono::steady_clock::now();
+        auto lastProgress = start;
+        auto printProgress = [&](const char* label) {
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << label << " " << sent << " messages (" << std::fixed << std::setprecision(1)
+                      << bytes / 1048576.0 << " MB) in " << seconds << " s: " << std::setprecision(0)
+                      << (seconds > 0 ? sent / seconds : 0.0) << " msg/s, " << dropped << " dropped" << std::endl;
+        };
+
+        // Recorded time replayed so far, with the pauses capped at MAX_GAP
+        std::chrono::nanoseconds timeline{0};
+        for (size_t pass = 0; pass < loops && running; ++pass) {
+            for (auto& stream : streams) {
+                stream.rewind();
+            }
+            uint64_t previous_ns = 0;
+
+            while (running) {
+                // The earliest pending record over all topics
+                Stream* next = nullptr;
+                for (auto& stream : streams) {
+                    if (stream.has_record && (!next || stream.record.receive_ns < next->record.receive_ns)) {
+                        next = &stream;
+                    }
+                }
+                if (!next) break;
+
+                const uint64_t receive_ns = next->record.receive_ns;
+                if (previous_ns != 0 && receive_ns > previous_ns) {
+                    timeline += std::min<std::chrono::nanoseconds>(std::chrono::nanoseconds(receive_ns - previous_ns),
+                                                                   MAX_GAP);
+                }
+                previous_ns = std::max(previous_ns, receive_ns);
+                if (speed > 0) {
+                    std::this_thread::sleep_until(
+                        start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeline / speed));
+                }
+
+                // Records larger than any message format are corrupt, not replayed
+                const std::string_view data = next->record.data;
+                if (data.size() > buffer.size() || data.size() < sizeof(uint16_t)) {
+                    std::cerr << "Skipping " << data.size() << " byte record of " << next->topic << std::endl;
+                    dropped++;
+                    next->advance();
+                    continue;
+                }
+                std::copy(data.begin(), data.end(), buffer.begin());
+
+                // v3 origins restart at the send, so the consumers' latencies cover this replay
+                orderbook_wire::setOrigin(buffer.data(), data.size(), latency::nowNanos());
+                const uint16_t state_id = orderbook_wire::stateIdOf(buffer.data(), data.size());
+                if (!next->has_state_id) {
+                    next->first_state_id = state_id;
+                    next->has_state_id = true;
+                }
+                next->last_state_id = state_id;
+                orderbook_wire::offsetStateId(buffer.data(), data.size(), next->state_offset);
+
+                const auto give_up = std::chrono::steady_clock::now() + PUBLISH_RETRY_LIMIT;
+                bool published = next->publisher->publish(buffer.data(), data.size());
+                while (!published && running && std::chrono::steady_clock::now() < give_up) {
+                    std::this_thread::sleep_for(PUBLISH_RETRY_WAIT);
+                    published = next->publisher->publish(buffer.data(), data.size());
+                }
+                if (published) {
+                    sent++;
+                    bytes += data.size();
+                } else {
+                    dropped++;
+                }
+                next->advance();
+
+                const auto now = std::chrono::steady_clock::now();
+                if (now - lastProgress >= PROGRESS_INTERVAL) {
+                    lastProgress = now;
+                    printProgress("Replayed");
+                }
+            }
+        }
+
+        printProgress("Finished: replayed");
+        if (rmq) {
+            // Let the async publisher drain and the broker confirm everything before the
+            // connection closes; unconfirmed messages are still in flight and may be lost
+            const auto deadline = std::chrono::steady_clock::now() + DRAIN_LIMIT;
+            PublisherStats stats = rmq->getStats();
+            while ((stats.queue_depth > 0 || stats.unconfirmed > 0) && std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                stats = rmq->getStats();
+            }
+            if (stats.queue_depth > 0 || stats.unconfirmed > 0) {
+                std::cerr << "Stopped waiting with " << stats.queue_depth << " queued and " << stats.unconfirmed
+                          << " unconfirmed messages" << std::endl;
+            }
+        }
+
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
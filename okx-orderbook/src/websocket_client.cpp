@@ -1,16 +1,15 @@
 #include "../include/websocket_client.hpp"
-#include <iostream>
+#include <async_logger.hpp>
 #include <openssl/ssl.h>
 #include <nlohmann/json.hpp>
 #include <chrono>
 #include <thread>
-
-WebSocketClient* WebSocketClient::instance_ = nullptr;
+#include <algorithm>
+#include <cstring>
 
 WebSocketClient::WebSocketClient(const std::string& url, const std::string& protocol)
-    : url_(url), protocol_(protocol), context_(nullptr), connection_(nullptr) {
-    instance_ = this;
-}
+    : url_(url), protocol_(protocol), context_(nullptr), connection_(nullptr),
+      rx_buffer_(RX_BUFFER_SIZE + RX_PADDING), rx_size_(0) {}
 
 WebSocketClient::~WebSocketClient() {
     if (context_) {
@@ -52,7 +51,7 @@ bool WebSocketClient::connect() {
 
     context_ = lws_create_context(&info);
     if (!context_) {
-        std::cerr << "Failed to create WebSocket context" << std::endl;
+        LOG_ERROR("Failed to create WebSocket context");
         return false;
     }
 
@@ -69,12 +68,13 @@ bool WebSocketClient::connect() {
     ccinfo.ssl_connection = LCCSCF_USE_SSL | LCCSCF_ALLOW_SELFSIGNED | LCCSCF_SKIP_SERVER_CERT_HOSTNAME_CHECK;
     ccinfo.alpn = "http/1.1";
     ccinfo.local_protocol_name = "wss";
+    ccinfo.userdata = this;  // Handed back as the callback's user pointer for this connection
 
-    std::cout << "Connecting to WebSocket server: " << ccinfo.address << ccinfo.path << std::endl;
+    LOG_INFO("Connecting to WebSocket server: {}{}", ccinfo.address, ccinfo.path);
     
     connection_ = lws_client_connect_via_info(&ccinfo);
     if (!connection_) {
-        std::cerr << "Failed to connect to WebSocket server" << std::endl;
+        LOG_ERROR("Failed to connect to WebSocket server");
         return false;
     }
 
@@ -98,65 +98,38 @@ void WebSocketClient::send(const std::string& message) {
     }
 }
 
-void WebSocketClient::setMessageCallback(std::function<void(const std::string&)> callback) {
-    message_callback_ = callback;
+void WebSocketClient::setMessageCallback(MessageCallback callback) {
+    message_callback_ = std::move(callback);
 }
 
 int WebSocketClient::callback_function(struct lws* wsi, enum lws_callback_reasons reason,
                                      void* user, void* in, size_t len) {
+    auto* self = static_cast<WebSocketClient*>(user);
+
     switch (reason) {
         case LWS_CALLBACK_CLIENT_ESTABLISHED: {
-            std::cout << "Connected to server" << std::endl;
-            if (instance_) {
-                instance_->message_buffer_.clear();
-                if (instance_->pending_subscribe_message_.length() > 0) {
-                    instance_->send(instance_->pending_subscribe_message_);
+            LOG_INFO("Connected to server");
+            if (self) {
+                self->rx_size_ = 0;
+                for (const auto& subscription : self->subscriptions_) {
+                    self->send(subscription);
                 }
             }
             break;
         }
         case LWS_CALLBACK_CLIENT_RECEIVE: {
-            if (instance_ && instance_->message_callback_) {
-                if (in && len > 0) {
-                    // Get final fragment flag
-                    bool is_final = lws_is_final_fragment(wsi);
-                    bool is_start = lws_is_first_fragment(wsi);
-                    
-                    // Append to buffer
-                    if (is_start) {
-                        instance_->message_buffer_.clear();
-                    }
-                    
-                    instance_->message_buffer_.append(static_cast<char*>(in), len);
-
-                    // Process complete message
-                    if (is_final) {
-                        std::string complete_message = instance_->message_buffer_;
-                        instance_->message_buffer_.clear();
-
-                        try {
-                            // Validate JSON before passing to callback
-                            auto j = nlohmann::json::parse(complete_message);
-                            instance_->message_callback_(complete_message);
-                        } catch (const std::exception& e) {
-                            std::cerr << "Invalid JSON in websocket message: " << e.what() << std::endl;
-                        }
-                    }
-                }
+            if (self && in && len > 0) {
+                self->handleReceive(wsi, in, len);
             }
             break;
         }
         case LWS_CALLBACK_CLIENT_CLOSED:
-            std::cout << "Connection closed" << std::endl;
+            LOG_WARN("Connection closed");
             break;
         case LWS_CALLBACK_CLIENT_CONNECTION_ERROR: {
-            std::string error_msg;
-            if (in) {
-                error_msg = std::string(static_cast<char*>(in), len);
-            } else {
-                error_msg = "Unknown error";
-            }
-            std::cerr << "Connection error: " << error_msg << std::endl;
+            const std::string_view error_msg = in ? std::string_view(static_cast<const char*>(in), len)
+                                                  : std::string_view("Unknown error");
+            LOG_ERROR("Connection error: {}", error_msg);
             break;
         }
         default:
@@ -165,6 +138,39 @@ int WebSocketClient::callback_function(struct lws* wsi, enum lws_callback_reason
     return 0;
 }
 
+void WebSocketClient::handleReceive(struct lws* wsi, const void* in, size_t len) {
+    if (!message_callback_) return;
+
+    // Get final fragment flag
+    bool is_final = lws_is_final_fragment(wsi);
+    bool is_start = lws_is_first_fragment(wsi);
+    
+    if (is_start) {
+        rx_size_ = 0;
+    }
+
+    // Append fragment in place, growing only for unusually large frames
+    const size_t required = rx_size_ + len + RX_PADDING;
+    if (required > rx_buffer_.size()) {
+        rx_buffer_.resize(std::max(required, rx_buffer_.size() * 2));
+    }
+    memcpy(rx_buffer_.data() + rx_size_, in, len);
+    rx_size_ += len;
+
+    // Process complete message
+    if (is_final) {
+        const size_t size = rx_size_;
+        memset(rx_buffer_.data() + size, 0, RX_PADDING);
+        rx_size_ = 0;
+
+        try {
+            message_callback_(rx_buffer_, size);
+        } catch (const std::exception& e) {
+            LOG_ERROR("Error handling websocket message: {}", e.what());
+        }
+    }
+}
+
 void WebSocketClient::schedulePing() {
     while (true) {
         std::this_thread::sleep_for(std::chrono::seconds(30));
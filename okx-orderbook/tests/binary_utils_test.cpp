@@ -0,0 +1,127 @@
+// Checks that every batch codec this CPU runs (scalar, AVX2, AVX-512) is bit-identical to the
+// scalar value functions, in both directions, on sizes around the vector widths. Codecs the CPU
+// lacks are reported as skipped. Exits non-zero on the first mismatch.
+#include <binary_utils.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace {
+
+using binary_utils::detail::BatchCodec;
+
+// A guard past the end of each output catches tails written beyond the requested count
+constexpr size_t GUARD_WORDS = 16;
+constexpr unsigned char GUARD_BYTE = 0xA5;
+
+// Levels or values per call: empty, one, each vector width (4 and 8 doubles) +-1, a full book
+constexpr size_t SIZES[] = {0, 1, 3, 4, 5, 7, 8, 9, 400};
+
+const double EDGE_CASES[] = {
+    0.0, -0.0, 1e-16, -1e-16, 1e-15, -1e-15, 0.25, -0.3, 0.999999, 1.0, 1.5, -1.75, 2.0, 65000.5,
+    -65000.5, 0.1, 1023.0, 1023.75, 1024.0, 5000.125, -7.5, 1e300,
+    std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+    std::numeric_limits<double>::quiet_NaN()};
+constexpr size_t NUM_EDGE_CASES = sizeof(EDGE_CASES) / sizeof(EDGE_CASES[0]);
+
+int failures = 0;
+
+uint64_t nextRandom(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// Edge cases first, then prices around +-1.5 and volumes and order counts up to +-1500
+std::vector<double> makeValues(size_t count, bool levels, uint64_t seed) {
+    std::vector<double> values(count);
+    for (size_t i = 0; i < count; ++i) {
+        const double unit = static_cast<double>(nextRandom(seed) >> 11) * (1.0 / 9007199254740992.0);
+        const bool price = !levels || i % 3 == 0;
+        values[i] = i < NUM_EDGE_CASES ? EDGE_CASES[i] : (unit - 0.5) * (price ? 3.0 : 3000.0);
+    }
+    return values;
+}
+
+template <typename T>
+std::vector<T> guarded(size_t count) {
+    std::vector<T> out(count + GUARD_WORDS);
+    std::memset(out.data(), GUARD_BYTE, out.size() * sizeof(T));
+    return out;
+}
+
+template <typename T>
+bool guardIntact(const std::vector<T>& out, size_t count) {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(out.data() + count);
+    for (size_t i = 0; i < GUARD_WORDS * sizeof(T); ++i) {
+        if (bytes[i] != GUARD_BYTE) return false;
+    }
+    return true;
+}
+
+void check(bool ok, const BatchCodec& codec, const char* what, size_t size) {
+    if (!ok) {
+        std::printf("FAIL %s: %s, size %zu\n", codec.name, what, size);
+        ++failures;
+    }
+}
+
+// Encode with the codec and the scalar one, then decode both the encoded words and arbitrary
+// words; everything must match bit for bit and stay within the requested count
+void checkCodec(const BatchCodec& codec, bool levels, size_t size) {
+    const BatchCodec scalar = binary_utils::detail::scalarCodec();
+    auto encode = levels ? &BatchCodec::encodeLevels : &BatchCodec::encodeChangeValues;
+    auto decode = levels ? &BatchCodec::decodeLevels : &BatchCodec::decodeChangeValues;
+    const size_t words = levels ? size * 3 : size;
+    const char* kind = levels ? "levels" : "change values";
+
+    const std::vector<double> values = makeValues(words, levels, 0x9E3779B97F4A7C15ULL + size);
+    auto expected = guarded<uint64_t>(words);
+    auto actual = guarded<uint64_t>(words);
+    (scalar.*encode)(values.data(), size, reinterpret_cast<char*>(expected.data()));
+    (codec.*encode)(values.data(), size, reinterpret_cast<char*>(actual.data()));
+    check(std::memcmp(expected.data(), actual.data(), words * sizeof(uint64_t)) == 0, codec, kind, size);
+    check(guardIntact(actual, words), codec, "encode wrote past the end", size);
+
+    std::vector<uint64_t> arbitrary(words);
+    uint64_t seed = 0xD1B54A32D192ED03ULL + size;
+    for (auto& word : arbitrary) word = nextRandom(seed);
+
+    for (const auto& input : {std::vector<uint64_t>(expected.begin(), expected.begin() + words), arbitrary}) {
+        auto decoded_expected = guarded<double>(words);
+        auto decoded_actual = guarded<double>(words);
+        (scalar.*decode)(reinterpret_cast<const char*>(input.data()), size, decoded_expected.data());
+        (codec.*decode)(reinterpret_cast<const char*>(input.data()), size, decoded_actual.data());
+        check(std::memcmp(decoded_expected.data(), decoded_actual.data(), words * sizeof(double)) == 0,
+              codec, kind, size);
+        check(guardIntact(decoded_actual, words), codec, "decode wrote past the end", size);
+    }
+}
+
+void checkAllSizes(const BatchCodec& codec) {
+    if (!binary_utils::detail::cpuSupports(codec.path)) {
+        std::printf("skip %s: not supported by this CPU\n", codec.name);
+        return;
+    }
+    const int before = failures;
+    for (const size_t size : SIZES) {
+        checkCodec(codec, true, size);
+        checkCodec(codec, false, size);
+    }
+    std::printf("%s %s\n", failures == before ? "ok" : "FAIL", codec.name);
+}
+
+} // namespace
+
+int main() {
+    checkAllSizes(binary_utils::detail::scalarCodec());
+#ifdef BINARY_UTILS_X86_SIMD
+    checkAllSizes(binary_utils::detail::avx2Codec());
+    checkAllSizes(binary_utils::detail::avx512Codec());
+#endif
+    std::printf("selected codec: %s\n", binary_utils::activeCodecName());
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+// Checks decimal::parse and decimal::parseWithTicks against strtod, bit for bit, on edge inputs
+// (exponents, long mantissas, trailing zeros, the 2^53 and 10^22 limits of the fast path,
+// malformed strings) and on random OKX-like prices. Ticks of plain decimals are checked
+// against exact integer arithmetic on the digits. Exits non-zero on any mismatch.
+#include <decimal_parser.hpp>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace {
+
+// Parsed by strtod to its full length
+const char* const VALID[] = {
+    "0", "0.0", "-0", "-0.0", "1", "-1", "17", "65432.1", "0.003", "12.0034", "0.1", "0.2", "0.3",
+    "5.", ".5", "-.5", "00012.5000",
+    // Trailing zeros, inside and past the 19 significant digits of the fast path
+    "65000.10000", "1.000000000", "1.0000000000000000000", "1.00000000000000000000000000",
+    "0.10000000000000000000000", "100000000000000000000", "65432.100000000000000000001",
+    // Long mantissas around 2^53 = 9007199254740992 and 19 digits
+    "9007199254740991", "9007199254740992", "9007199254740993", "9007199254740995",
+    "900719925474099.3", "0.9007199254740993", "1234567890123456789", "12345678901234567890",
+    "123456789012345678.9", "1.234567890123456789", "9999999999999999999", "18446744073709551615",
+    "18446744073709551616", "0.30000000000000000000000000000000004",
+    // Fractions around 10^22
+    "0.1234567890123456789012", "0.0000000000000000000001", "0.00000000000000000000001",
+    "1e-22", "0.00000000000000000000000000000000000001",
+    // Exponents
+    "1e5", "1E5", "1e-3", "-2.5e+2", "6.5432e4", "65432.1e0", "1.5e308", "1e-320", "4.9e-324", "0e10",
+    "inf", "-inf", "infinity"};
+
+// Rejected by the parser, which then reports 0. Overflowing values are rejected too, where
+// strtod would return infinity.
+const char* const INVALID[] = {
+    "", "-", ".", "-.", "1.2.3", "abc", "1x", "x1", "1 ", " 1", "+1", "1e", "1e+", "--1", "0x10", "1,5",
+    "1e400", "-1e400"};
+
+int failures = 0;
+
+uint64_t nextRandom(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+bool sameBits(double a, double b) { return std::memcmp(&a, &b, sizeof(double)) == 0; }
+
+void fail(const std::string& input, const char* what) {
+    std::printf("FAIL \"%s\": %s\n", input.c_str(), what);
+    ++failures;
+}
+
+// Exact ticks of a plain [-]digits[.digits] string, half away from zero past TICK_DECIMALS;
+// false when it is not plain or does not fit in int64
+bool exactTicks(const std::string& input, int64_t& ticks) {
+    size_t pos = 0;
+    const bool negative = !input.empty() && input[0] == '-';
+    if (negative) ++pos;
+    const size_t dot = input.find('.', pos);
+    const std::string whole = input.substr(pos, dot == std::string::npos ? std::string::npos : dot - pos);
+    const std::string frac = dot == std::string::npos ? "" : input.substr(dot + 1);
+    if (whole.empty() && frac.empty()) return false;
+    for (char c : whole + frac) {
+        if (c < '0' || c > '9') return false;
+    }
+
+    __int128 magnitude = 0;
+    const __int128 limit = static_cast<__int128>(INT64_MAX);
+    for (char c : whole) {
+        magnitude = magnitude * 10 + (c - '0');
+        if (magnitude > limit) return false;
+    }
+    for (int i = 0; i < decimal::TICK_DECIMALS; ++i) {
+        magnitude = magnitude * 10 + (i < static_cast<int>(frac.size()) ? frac[i] - '0' : 0);
+        if (magnitude > limit) return false;
+    }
+    if (static_cast<int>(frac.size()) > decimal::TICK_DECIMALS && frac[decimal::TICK_DECIMALS] >= '5') {
+        ++magnitude;
+    }
+    if (magnitude > limit) return false;
+    ticks = negative ? -static_cast<int64_t>(magnitude) : static_cast<int64_t>(magnitude);
+    return true;
+}
+
+// Significant digits as the fast path counts them, leading zeros excluded
+int significantDigits(const std::string& input) {
+    int count = 0;
+    for (char c : input) {
+        if (c >= '1' && c <= '9') ++count;
+        else if (c == '0' && count > 0) ++count;
+    }
+    return count;
+}
+
+void checkValid(const std::string& input) {
+    const double expected = std::strtod(input.c_str(), nullptr);
+
+    double value = -1.0;
+    if (!decimal::parse(input, value)) {
+        fail(input, "parse rejected it");
+        return;
+    }
+    if (!sameBits(expected, value)) {
+        std::printf("FAIL \"%s\": parse %.17g, strtod %.17g\n", input.c_str(), value, expected);
+        ++failures;
+    }
+
+    double ticks_value = -1.0;
+    int64_t ticks = 0;
+    if (!decimal::parseWithTicks(input, ticks_value, ticks)) {
+        fail(input, "parseWithTicks rejected it");
+        return;
+    }
+    if (!sameBits(expected, ticks_value)) fail(input, "parseWithTicks value differs from strtod");
+
+    // Plain decimals of up to 19 significant digits take the integer path and are exact;
+    // the rest are rounded from the double
+    int64_t exact = 0;
+    if (significantDigits(input) <= 19 && exactTicks(input, exact)) {
+        if (ticks != exact) {
+            std::printf("FAIL \"%s\": %lld ticks, expected %lld\n", input.c_str(), static_cast<long long>(ticks),
+                        static_cast<long long>(exact));
+            ++failures;
+        }
+    } else if (std::isfinite(expected) && std::fabs(expected) < 9e8) {
+        if (ticks != std::llround(expected * 1e10)) fail(input, "ticks differ from the rounded double");
+    }
+}
+
+void checkInvalid(const std::string& input) {
+    double value = -1.0;
+    int64_t ticks = 0;
+    if (decimal::parse(input, value) || value != 0.0) fail(input, "parse accepted it");
+    value = -1.0;
+    if (decimal::parseWithTicks(input, value, ticks) || value != 0.0) fail(input, "parseWithTicks accepted it");
+}
+
+// Prices and sizes as OKX formats them, with and without trailing zeros
+std::string randomDecimal(uint64_t& seed) {
+    std::string out;
+    if (nextRandom(seed) % 16 == 0) out += '-';
+    const int whole_digits = 1 + static_cast<int>(nextRandom(seed) % 8);
+    for (int i = 0; i < whole_digits; ++i) {
+        out += static_cast<char>('0' + (i == 0 && whole_digits > 1 ? 1 + nextRandom(seed) % 9 : nextRandom(seed) % 10));
+    }
+    const int frac_digits = static_cast<int>(nextRandom(seed) % 13);
+    if (frac_digits > 0) {
+        out += '.';
+        for (int i = 0; i < frac_digits; ++i) out += static_cast<char>('0' + nextRandom(seed) % 10);
+        if (nextRandom(seed) % 4 == 0) out.append(nextRandom(seed) % 6, '0');
+    }
+    return out;
+}
+
+} // namespace
+
+int main() {
+    for (const char* input : VALID) checkValid(input);
+    for (const char* input : INVALID) checkInvalid(input);
+
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0; i < 1000000 && failures < 20; ++i) {
+        checkValid(randomDecimal(seed));
+    }
+
+    std::printf("%s decimal parser\n", failures == 0 ? "ok" : "FAIL");
+    return failures == 0 ? 0 : 1;
+}
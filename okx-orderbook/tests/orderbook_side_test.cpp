@@ -0,0 +1,162 @@
+// Applies random inserts, updates and deletes to both book sides and checks them after every
+// step against a brute-force std::map book: every level in order, and each DepthAggregate
+// field summed afresh over its depth. Runs past the aggregate resync interval and past the
+// side's capacity. Exits non-zero on the first mismatch.
+#include <orderbook_side.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <type_traits>
+
+namespace {
+
+constexpr size_t STEPS = 20000;
+constexpr int64_t MID_TICKS = 650000;  // Keys are tenths, so prices around 65000.0
+constexpr int64_t KEY_RANGE = 2000;    // Each side spans 2000 ticks from the mid, beyond its capacity
+constexpr size_t PHASE_STEPS = 2500;   // Steps of each alternating growing and shrinking phase
+constexpr double TOLERANCE = 1e-9;     // Relative, for the running totals
+constexpr double ABS_TOLERANCE = 1e-3;  // Drift left once levels went away, ~1e-12 of a full side's notional
+
+int failures = 0;
+
+uint64_t nextRandom(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+bool close(double expected, double actual) {
+    return std::fabs(expected - actual) <= std::max(ABS_TOLERANCE, TOLERANCE * std::fabs(expected));
+}
+
+// The reference keeps every level it is given, best first; the side keeps the best CAPACITY
+template <bool IsBids>
+using Reference = std::map<int64_t, OrderBookLevel,
+                           std::conditional_t<IsBids, std::greater<int64_t>, std::less<int64_t>>>;
+
+template <bool IsBids>
+void trim(Reference<IsBids>& reference) {
+    while (reference.size() > OrderBookSide<IsBids>::CAPACITY) {
+        reference.erase(std::prev(reference.end()));
+    }
+}
+
+template <bool IsBids>
+bool matches(const OrderBookSide<IsBids>& side, const Reference<IsBids>& reference, size_t step) {
+    const char* name = IsBids ? "bids" : "asks";
+    if (side.size() != reference.size()) {
+        std::printf("FAIL %s step %zu: %zu levels, expected %zu\n", name, step, side.size(), reference.size());
+        return false;
+    }
+    size_t i = 0;
+    for (const auto& [key, level] : reference) {
+        if (side.key(i) != key || side[i].price != level.price || side[i].volume != level.volume ||
+            side[i].orders != level.orders) {
+            std::printf("FAIL %s step %zu: level %zu differs\n", name, step, i);
+            return false;
+        }
+        ++i;
+    }
+    for (size_t d = 0; d < NUM_BOOK_DEPTHS; ++d) {
+        DepthAggregate expected;
+        size_t n = 0;
+        for (auto it = reference.begin(); it != reference.end() && n < BOOK_DEPTH_LEVELS[d]; ++it, ++n) {
+            expected.add(it->second);
+        }
+        const DepthAggregate& actual = side.depthAggregate(d);
+        if (!close(expected.volume, actual.volume) || !close(expected.orders, actual.orders) ||
+            !close(expected.notional, actual.notional)) {
+            std::printf("FAIL %s step %zu: depth %zu aggregate %.12g/%.12g/%.12g, expected %.12g/%.12g/%.12g\n",
+                        name, step, BOOK_DEPTH_LEVELS[d], actual.volume, actual.orders, actual.notional,
+                        expected.volume, expected.orders, expected.notional);
+            return false;
+        }
+    }
+    return true;
+}
+
+template <bool IsBids>
+void checkSide(uint64_t seed) {
+    OrderBookSide<IsBids> side;
+    Reference<IsBids> reference;
+    const int64_t direction = IsBids ? -1 : 1;  // Away from the mid
+
+    auto randomKey = [&] {
+        return MID_TICKS + direction * (1 + static_cast<int64_t>(nextRandom(seed) % KEY_RANGE));
+    };
+    auto randomLevel = [&](int64_t key) {
+        const double volume = static_cast<double>(1 + nextRandom(seed) % 100000) / 1000.0;
+        const double orders = static_cast<double>(1 + nextRandom(seed) % 40);
+        return OrderBookLevel{static_cast<double>(key) / 10.0, volume, orders};
+    };
+
+    // Snapshot load: unordered appends, one sort
+    side.clear();
+    for (size_t i = 0; i < 400; ++i) {
+        const int64_t key = randomKey();
+        if (reference.count(key)) continue;
+        const OrderBookLevel level = randomLevel(key);
+        side.append(key, level.price, level.volume, level.orders);
+        reference[key] = level;
+    }
+    side.sort();
+    if (!matches(side, reference, 0)) {
+        ++failures;
+        return;
+    }
+
+    for (size_t step = 1; step <= STEPS; ++step) {
+        // Growing phases fill the side up to its capacity, shrinking ones thin it out again
+        const bool growing = (step / PHASE_STEPS) % 2 == 0;
+        const uint64_t op = nextRandom(seed) % 10;
+        const uint64_t update_below = growing ? 2 : 3;
+        const uint64_t delete_below = growing ? 4 : 8;
+        if (op < update_below && !reference.empty()) {
+            // Update a level in place
+            auto it = std::next(reference.begin(), static_cast<long>(nextRandom(seed) % reference.size()));
+            const OrderBookLevel level = randomLevel(it->first);
+            side.apply(it->first, level.price, level.volume, level.orders);
+            it->second.volume = level.volume;
+            it->second.orders = level.orders;
+        } else if (op < delete_below && !reference.empty()) {
+            // Delete a level, often among the best dozen
+            const size_t span = op == update_below ? std::min<size_t>(reference.size(), 12) : reference.size();
+            auto it = std::next(reference.begin(), static_cast<long>(nextRandom(seed) % span));
+            side.apply(it->first, it->second.price, 0.0, 0.0);
+            reference.erase(it);
+        } else {
+            // Insert at a random key; an existing key updates, a zero size on a missing one is ignored
+            const int64_t key = randomKey();
+            const bool remove = nextRandom(seed) % 8 == 0;
+            const OrderBookLevel level = randomLevel(key);
+            side.apply(key, level.price, remove ? 0.0 : level.volume, level.orders);
+            if (remove) {
+                reference.erase(key);
+            } else if (auto it = reference.find(key); it != reference.end()) {
+                it->second.volume = level.volume;
+                it->second.orders = level.orders;
+            } else {
+                reference[key] = level;
+                trim<IsBids>(reference);
+            }
+        }
+        if (!matches(side, reference, step)) {
+            ++failures;
+            return;
+        }
+    }
+    std::printf("ok %s\n", IsBids ? "bids" : "asks");
+}
+
+} // namespace
+
+int main() {
+    checkSide<true>(0x9E3779B97F4A7C15ULL);
+    checkSide<false>(0xD1B54A32D192ED03ULL);
+    return failures == 0 ? 0 : 1;
+}
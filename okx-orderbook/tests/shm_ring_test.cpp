@@ -0,0 +1,214 @@
+// Exercises the shared-memory rings (shm_ring.hpp) in /dev/shm. A writer thread overruns a
+// slower reader: every message the reader returns must be whole and newer than the last, and
+// the messages it lost must all be counted as skipped; a slot caught mid-overwrite is skipped
+// too. A second writer on a ring must be refused while the first holds it. A writer restarting
+// with the same layout keeps its readers; one with another layout retires the ring and the
+// reader re-attaches to the new one. Exits non-zero on any failure.
+#include <shm_ring.hpp>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr size_t SLOT_SIZE = 4096;  // Wide slots keep copies long enough to be overwritten mid-read
+constexpr size_t CAPACITY = 64;
+constexpr uint64_t MESSAGES = 200000;
+
+int failures = 0;
+
+bool check(bool ok, const char* test, const char* what) {
+    if (!ok) {
+        std::printf("FAIL %s: %s\n", test, what);
+        ++failures;
+    }
+    return ok;
+}
+
+std::string ringName(const char* test) { return "/rtdppo.test." + std::to_string(::getpid()) + "." + test; }
+
+// Message n: its index, then a length and a fill byte that both follow from n. The writer
+// only memsets, so it outruns the reader's checks and overwrites slots while they are copied.
+size_t messageSize(uint64_t n) { return sizeof(uint64_t) + 1 + (n * 2654435761ULL) % (SLOT_SIZE - sizeof(uint64_t)); }
+char messageByte(uint64_t n) { return static_cast<char>((n * 31 + 7) & 0xff); }
+
+void fillMessage(uint64_t n, std::vector<char>& message) {
+    const size_t size = messageSize(n);
+    std::memcpy(message.data(), &n, sizeof(n));
+    std::memset(message.data() + sizeof(n), messageByte(n), size - sizeof(n));
+}
+
+// The index of a whole message, or false when any byte does not belong to it
+bool wholeMessage(const char* data, size_t size, uint64_t& n) {
+    if (size < sizeof(n)) return false;
+    std::memcpy(&n, data, sizeof(n));
+    if (n >= MESSAGES || size != messageSize(n)) return false;
+    for (size_t i = sizeof(n); i < size; ++i) {
+        if (data[i] != messageByte(n)) return false;
+    }
+    return true;
+}
+
+bool readText(shm::RingReader& reader, std::string& text) {
+    const char* data = nullptr;
+    size_t size = 0;
+    if (!reader.read(data, size)) return false;
+    text.assign(data, size);
+    return true;
+}
+
+void testLappedReader() {
+    const char* name = "lapped reader";
+    const std::string ring = ringName("lap");
+    const int before = failures;
+    shm::RingWriter writer(ring, SLOT_SIZE, CAPACITY);
+    shm::RingReader reader(ring);
+    if (!check(reader.attach(), name, "reader did not attach")) return;
+
+    std::atomic<bool> done{false};
+    std::thread writing([&]() {
+        std::vector<char> message(SLOT_SIZE);
+        for (uint64_t n = 0; n < MESSAGES; ++n) {
+            fillMessage(n, message);
+            writer.write(message.data(), messageSize(n));
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+    uint64_t received = 0;
+    uint64_t last = 0;
+    bool torn = false;
+    bool reordered = false;
+    for (;;) {
+        const char* data = nullptr;
+        size_t size = 0;
+        if (!reader.read(data, size)) {
+            if (done.load(std::memory_order_acquire) && reader.pending() == 0) break;
+            continue;
+        }
+        uint64_t n = 0;
+        if (!wholeMessage(data, size, n)) {
+            torn = true;
+            continue;
+        }
+        if (received > 0 && n <= last) reordered = true;
+        last = n;
+        ++received;
+    }
+    writing.join();
+
+    check(!torn, name, "returned a torn message");
+    check(!reordered, name, "returned a message older than the one before");
+    check(last == MESSAGES - 1, name, "did not end on the newest message");
+    check(reader.skipped() > 0, name, "never lapped");
+    check(received + reader.skipped() == MESSAGES, name, "lost messages not counted as skipped");
+    if (failures == before) {
+        std::printf("ok %s: %llu read, %llu skipped\n", name, static_cast<unsigned long long>(received),
+                    static_cast<unsigned long long>(reader.skipped()));
+    }
+    ::shm_unlink(ring.c_str());
+}
+
+// The state a lapping writer leaves a slot in while it overwrites it, set up through a second
+// mapping: the reader must skip that message, not return the half-written one
+void testOverwrittenSlot() {
+    const char* name = "overwritten slot";
+    const std::string ring = ringName("overwritten");
+    const int before = failures;
+    shm::RingWriter writer(ring, 64, 8);
+    shm::RingReader reader(ring);
+    check(reader.attach(), name, "reader did not attach");
+    writer.write("first", 5);
+    writer.write("second", 6);
+
+    shm::Mapping view;
+    if (!check(view.open(ring), name, "second mapping did not open")) return;
+    shm::SlotHeader* slot = view.slot(0);
+    slot->sequence.store(2 * 8 + 1, std::memory_order_release);  // Message 8 half copied over message 0
+    std::memcpy(shm::Mapping::payload(slot), "ei", 2);
+
+    std::string text;
+    check(readText(reader, text) && text == "second", name, "did not skip to the next whole message");
+    check(reader.skipped() == 1, name, "overwritten message not counted as skipped");
+    if (failures == before) std::printf("ok %s\n", name);
+    ::shm_unlink(ring.c_str());
+}
+
+void testSecondWriter() {
+    const char* name = "second writer";
+    const std::string ring = ringName("writer");
+    const int before = failures;
+    {
+        shm::RingWriter first(ring, 64, 8);
+        for (const size_t slot_size : {size_t{64}, size_t{128}}) {  // Same layout, then one it would replace
+            try {
+                shm::RingWriter second(ring, slot_size, 8);
+                check(false, name, "second writer was not refused");
+            } catch (const std::runtime_error& e) {
+                check(std::strstr(e.what(), "already has a writer") != nullptr, name, "refused for the wrong reason");
+            }
+        }
+        const char message[] = "still mine";
+        check(first.write(message, sizeof(message)), name, "first writer lost the ring");
+    }
+    // The lock goes with the first writer
+    try {
+        shm::RingWriter next(ring, 64, 8);
+    } catch (const std::exception&) {
+        check(false, name, "ring stayed locked after its writer closed");
+    }
+    if (failures == before) std::printf("ok %s\n", name);
+    ::shm_unlink(ring.c_str());
+}
+
+
+void testRestart() {
+    const char* name = "restart";
+    const std::string ring = ringName("restart");
+    const int before = failures;
+    shm::RingReader reader(ring);
+    check(!reader.attach(), name, "attached before the ring existed");
+    std::string text;
+    {
+        shm::RingWriter writer(ring, 64, 8);
+        check(reader.attach(), name, "reader did not attach");
+        writer.write("first", 5);
+        check(readText(reader, text) && text == "first", name, "first message not read");
+    }
+
+    // Same layout: the ring and its head are kept, the reader carries on
+    {
+        shm::RingWriter writer(ring, 64, 8);
+        writer.write("second", 6);
+        check(readText(reader, text) && text == "second", name, "message after a compatible restart not read");
+    }
+
+    // Another layout: the old ring is retired and the reader moves to the new one
+    {
+        shm::RingWriter writer(ring, 256, 16);
+        check(!readText(reader, text), name, "read from a retired ring");
+        check(reader.attach(), name, "reader did not re-attach");  // At the new ring's head
+        const std::string wide(200, 'w');  // Only fits the new slots
+        writer.write(wide.data(), wide.size());
+        check(readText(reader, text) && text == wide, name, "message of the new layout not read");
+    }
+    if (failures == before) std::printf("ok %s\n", name);
+    ::shm_unlink(ring.c_str());
+}
+
+} // namespace
+
+int main() {
+    testLappedReader();
+    testOverwrittenSlot();
+    testSecondWriter();
+    testRestart();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,310 @@
+// Encodes random sequences of book states with DeltaEncoder in every packing and decodes each
+// message the way a consumer does, against the state it decoded last. Every decoded state is
+// checked against the v2 message of the same state: bit for bit for raw64, to float rounding for
+// float32 and to half a fixed-point step for fixed32. Also checks that a consumer that missed a
+// delta sees the base mismatch on the next one, that the forced keyframe after it resyncs the
+// consumer, and that a delta on the wrong base does not rebuild the state. Exits non-zero on the
+// first mismatch of each sequence.
+#include <orderbook_wire.hpp>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using namespace orderbook_wire;
+
+constexpr size_t STATES = 3000;
+constexpr size_t KEYFRAME_INTERVAL = 50;
+constexpr int64_t MID_TICKS = 650000;     // Keys are tenths, so prices around 65000.0
+constexpr size_t BOOK_LEVELS = 600;       // Levels each side starts with, beyond what the wire carries
+constexpr size_t MIN_BOOK_LEVELS = 450;   // Deletes stop here so each side keeps LEVELS levels
+constexpr size_t SHIFT_EVERY = 97;        // States between moves of the whole book, which need keyframes
+constexpr size_t DROP_EVERY = 211;        // States between deltas the consumer never receives
+
+int failures = 0;
+
+uint64_t nextRandom(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+double unitRandom(uint64_t& state) {
+    return static_cast<double>(nextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Volume and orders of a level, keyed by price in ticks
+using Side = std::map<int64_t, std::pair<double, double>>;
+
+struct Book {
+    Side bids;
+    Side asks;
+    std::vector<double> features = std::vector<double>(FEATURE_VALUES);
+};
+
+struct State {
+    std::vector<double> bids = std::vector<double>(SIDE_VALUES);
+    std::vector<double> asks = std::vector<double>(SIDE_VALUES);
+    std::vector<double> features = std::vector<double>(FEATURE_VALUES);
+};
+
+std::pair<double, double> randomLevel(uint64_t& seed) {
+    return {static_cast<double>(1 + nextRandom(seed) % 1000000) / 1000.0,
+            static_cast<double>(1 + nextRandom(seed) % 40)};
+}
+
+// Best LEVELS levels of a side as interleaved [price, volume, orders]
+template <typename It>
+void fillLevels(It it, double* levels) {
+    for (size_t i = 0; i < LEVELS; ++i, ++it) {
+        levels[i * VALUES_PER_LEVEL] = static_cast<double>(it->first) / 10.0;
+        levels[i * VALUES_PER_LEVEL + 1] = it->second.first;
+        levels[i * VALUES_PER_LEVEL + 2] = it->second.second;
+    }
+}
+
+// A few updates, inserts and deletes, near the top of the book more often than deep in it
+void mutateSide(Side& side, bool is_bids, uint64_t& seed) {
+    const size_t ops = nextRandom(seed) % 12;
+    for (size_t o = 0; o < ops; ++o) {
+        const int64_t depth = static_cast<int64_t>(nextRandom(seed) % 2 ? nextRandom(seed) % 30 : nextRandom(seed) % 900);
+        const int64_t key = is_bids ? MID_TICKS - 1 - depth : MID_TICKS + 1 + depth;
+        const uint64_t op = nextRandom(seed) % 3;
+        if (op == 0 && side.size() > MIN_BOOK_LEVELS) {
+            side.erase(key);
+        } else if (op == 1) {
+            if (auto it = side.find(key); it != side.end()) it->second.first = randomLevel(seed).first;
+        } else {
+            side[key] = randomLevel(seed);
+        }
+    }
+}
+
+// Every price moves, so a delta would carry every level
+void shiftSide(Side& side, int64_t by) {
+    Side shifted;
+    for (const auto& [key, level] : side) shifted.emplace(key + by, level);
+    side.swap(shifted);
+}
+
+void step(Book& book, size_t index, uint64_t& seed) {
+    if (index % SHIFT_EVERY == SHIFT_EVERY - 1) {
+        const int64_t by = static_cast<int64_t>(nextRandom(seed) % 5) - 2;
+        shiftSide(book.bids, by == 0 ? 1 : by);
+        shiftSide(book.asks, by == 0 ? 1 : by);
+    } else {
+        mutateSide(book.bids, true, seed);
+        mutateSide(book.asks, false, seed);
+    }
+    for (auto& value : book.features) value = unitRandom(seed) * 1.8 - 0.9;
+}
+
+// The v2 message of a state, built like the publisher's v2 path
+std::vector<char> encodeV2(const double* bids, const double* asks, const double* features,
+                           uint32_t mid_price_cents, uint16_t state_id) {
+    std::vector<char> message(V2_MESSAGE_SIZE);
+    char* data = message.data();
+    binary_utils::encodeLevels(bids, LEVELS, data);
+    data += SIDE_VALUES * sizeof(uint64_t);
+    binary_utils::encodeLevels(asks, LEVELS, data);
+    data += SIDE_VALUES * sizeof(uint64_t);
+    binary_utils::encodeChangeValues(features, FEATURE_VALUES, data);
+    data += FEATURE_VALUES * sizeof(uint64_t);
+    std::memcpy(data, &mid_price_cents, sizeof(uint32_t));
+    std::memcpy(data + sizeof(uint32_t), &state_id, sizeof(uint16_t));
+    return message;
+}
+
+// The state a v2 consumer decodes
+State decodeV2(const std::vector<char>& message) {
+    State state;
+    const char* data = message.data();
+    binary_utils::decodeLevels(data, LEVELS, state.bids.data());
+    binary_utils::decodeLevels(data + SIDE_VALUES * sizeof(uint64_t), LEVELS, state.asks.data());
+    binary_utils::decodeChangeValues(data + 2 * SIDE_VALUES * sizeof(uint64_t), FEATURE_VALUES,
+                                     state.features.data());
+    return state;
+}
+
+bool sameValue(double expected, double actual, bool change, Packing packing) {
+    switch (packing) {
+        case Packing::Raw64:
+            return std::memcmp(&expected, &actual, sizeof(double)) == 0;
+        case Packing::Float32:
+            return actual == static_cast<double>(static_cast<float>(expected));
+        case Packing::Fixed32: {
+            const double scale = change ? detail::FIXED_CHANGE_SCALE : detail::FIXED_BOOK_SCALE;
+            return std::fabs(actual - expected) <= 0.5 / scale;
+        }
+    }
+    return false;
+}
+
+bool sameState(const State& expected, const State& actual, Packing packing) {
+    for (size_t i = 0; i < SIDE_VALUES; ++i) {
+        const bool change = detail::isChangeValue(i % VALUES_PER_LEVEL);
+        if (!sameValue(expected.bids[i], actual.bids[i], change, packing) ||
+            !sameValue(expected.asks[i], actual.asks[i], change, packing)) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < FEATURE_VALUES; ++i) {
+        if (!sameValue(expected.features[i], actual.features[i], true, packing)) return false;
+    }
+    return true;
+}
+
+bool check(bool ok, Packing packing, size_t index, const char* what) {
+    if (!ok) {
+        std::printf("FAIL %s state %zu: %s\n", packingName(packing), index, what);
+        ++failures;
+    }
+    return ok;
+}
+
+bool throws(const std::function<void()>& fn) {
+    try {
+        fn();
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+void checkSequence(Packing packing, uint64_t seed) {
+    DeltaEncoder encoder(packing, KEYFRAME_INTERVAL);
+    Book book;
+    for (size_t i = 0; i < BOOK_LEVELS; ++i) {
+        book.bids[MID_TICKS - 1 - static_cast<int64_t>(i)] = randomLevel(seed);
+        book.asks[MID_TICKS + 1 + static_cast<int64_t>(i)] = randomLevel(seed);
+    }
+
+    // What the consumer holds: the newest decoded state and its ID
+    State consumer;
+    uint16_t consumer_state_id = 0;
+    bool lost = false;               // The consumer missed the last delta
+    bool awaiting_keyframe = false;  // The publisher was told and forced a keyframe
+    size_t keyframes = 0;
+    size_t deltas = 0;
+    size_t mismatches = 0;
+    std::vector<char> message;
+    State input;
+
+    for (size_t index = 0; index < STATES; ++index) {
+        step(book, index, seed);
+        fillLevels(book.bids.rbegin(), input.bids.data());
+        fillLevels(book.asks.begin(), input.asks.data());
+        input.features = book.features;
+        const uint16_t state_id = static_cast<uint16_t>(65000 + index);  // Wraps past 65535
+        const uint32_t mid_price_cents = static_cast<uint32_t>(6500000 + index % 1000);
+        const uint64_t origin_ns = 1000000007ULL * (index + 1);
+
+        const size_t size = encoder.encode(input.bids.data(), input.asks.data(), input.features.data(),
+                                           mid_price_cents, state_id, message, origin_ns);
+        const State expected = decodeV2(encodeV2(input.bids.data(), input.asks.data(), input.features.data(),
+                                                 mid_price_cents, state_id));
+
+        if (!check(size == message.size() && size != V2_MESSAGE_SIZE && size <= MAX_V3_MESSAGE_SIZE &&
+                       isV3Message(message.data(), size), packing, index, "message size")) return;
+        const MessageHeader header = parseHeader(message.data(), size);
+        if (!check(header.state_id == state_id && header.mid_price_cents == mid_price_cents &&
+                       header.origin_ns == origin_ns && header.packing == packing &&
+                       header.keyframe() == encoder.lastWasKeyframe(), packing, index, "header")) return;
+
+        if (header.keyframe()) {
+            ++keyframes;
+            if (!check(header.base_state_id == state_id, packing, index, "keyframe base ID")) return;
+        } else {
+            ++deltas;
+            if (!check(header.base_state_id == static_cast<uint16_t>(state_id - 1), packing, index,
+                       "delta base ID")) return;
+            if (!check(throws([&] {
+                    State out;
+                    decodeMessage(message.data(), size, header, nullptr, nullptr, out.bids.data(),
+                                  out.asks.data(), out.features.data());
+                }), packing, index, "delta decoded without a base")) return;
+            if (!check(throws([&] {
+                    State out;
+                    decodeMessage(message.data(), size - 1, header, consumer.bids.data(), consumer.asks.data(),
+                                  out.bids.data(), out.asks.data(), out.features.data());
+                }), packing, index, "truncated delta decoded")) return;
+        }
+
+        // The consumer never receives this delta
+        if (!header.keyframe() && !lost && !awaiting_keyframe && index % DROP_EVERY == DROP_EVERY - 1) {
+            lost = true;
+            continue;
+        }
+
+        if (awaiting_keyframe) {
+            // The first message after the forced keyframe is that keyframe
+            if (!check(header.keyframe(), packing, index, "forced keyframe missing")) return;
+            awaiting_keyframe = false;
+        }
+        if (!header.keyframe()) {
+            if (lost) {
+                // The next delta names the base the consumer lacks; it is skipped and the
+                // publisher resyncs it with a keyframe, as after a nacked publish
+                if (!check(header.base_state_id != consumer_state_id, packing, index, "base mismatch missed")) return;
+                ++mismatches;
+                lost = false;
+                awaiting_keyframe = true;
+                encoder.forceKeyframe();
+                continue;
+            }
+            if (!check(header.base_state_id == consumer_state_id, packing, index, "unexpected base mismatch")) return;
+        }
+        lost = false;
+
+        State decoded;
+        decodeMessage(message.data(), size, header, header.keyframe() ? nullptr : consumer.bids.data(),
+                      header.keyframe() ? nullptr : consumer.asks.data(), decoded.bids.data(),
+                      decoded.asks.data(), decoded.features.data());
+        if (!check(sameState(expected, decoded, packing), packing, index, "decoded state differs from v2")) return;
+
+        // Lossy packings rebuild deltas on the decoded base, as consumers do
+        consumer = std::move(decoded);
+        consumer_state_id = state_id;
+    }
+
+    // A delta decoded against the wrong base rebuilds a different state, which is why consumers
+    // compare base IDs: a level deep in the book differs between the held state and the base
+    const State stale = consumer;
+    std::next(book.bids.rbegin(), 300)->second.first += 1.0;
+    fillLevels(book.bids.rbegin(), input.bids.data());
+    encoder.forceKeyframe();
+    encoder.encode(input.bids.data(), input.asks.data(), input.features.data(), 0, 1, message);
+    book.bids.rbegin()->second.first += 1.0;
+    fillLevels(book.bids.rbegin(), input.bids.data());
+    const size_t size = encoder.encode(input.bids.data(), input.asks.data(), input.features.data(), 0, 2, message);
+    const MessageHeader header = parseHeader(message.data(), size);
+    if (!check(!header.keyframe() && header.base_state_id == 1, packing, STATES, "stale base delta")) return;
+    State decoded;
+    decodeMessage(message.data(), size, header, stale.bids.data(), stale.asks.data(), decoded.bids.data(),
+                  decoded.asks.data(), decoded.features.data());
+    const State expected = decodeV2(encodeV2(input.bids.data(), input.asks.data(), input.features.data(), 0, 2));
+    if (!check(!sameState(expected, decoded, packing), packing, STATES, "stale base rebuilt the new state")) return;
+
+    if (!check(keyframes > STATES / KEYFRAME_INTERVAL && deltas > STATES / 2 && mismatches > 0, packing, STATES,
+               "sequence lacks keyframes, deltas or base mismatches")) return;
+    std::printf("ok %s: %zu keyframes, %zu deltas, %zu base mismatches\n", packingName(packing), keyframes,
+                deltas, mismatches);
+}
+
+} // namespace
+
+int main() {
+    checkSequence(Packing::Raw64, 0x9E3779B97F4A7C15ULL);
+    checkSequence(Packing::Float32, 0xD1B54A32D192ED03ULL);
+    checkSequence(Packing::Fixed32, 0xA0761D6478BD642FULL);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+// Hot path benchmarks of the OMS service:
+//
+//   oms_bench --benchmark_out=oms.json --benchmark_out_format=json
+//
+// Actions as the PPO service encodes them, the order store at its MAX_ACTIVE_ORDERS bound and
+// OKX orders channel pushes in the shape OKX sends fills. --benchmark_perf_counters=CYCLES,INSTRUCTIONS
+// adds hardware counters when Google Benchmark is built with libpfm.
+#include "../include/okx_websocket.hpp"
+#include "../include/order_store.hpp"
+#include <binary_utils.hpp>
+#include <async_logger.hpp>
+#include <benchmark/benchmark.h>
+#include <array>
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Feeds orders channel pushes to the client as its service thread would, see the friend declaration
+struct OMSBenchAccess {
+    static void handleOrderUpdate(OKXWebSocket& ws, const std::string& message) { ws.handle_order_update(message); }
+};
+
+namespace {
+
+constexpr size_t ACTIONS = 1024;  // Distinct encoded actions, cycled through
+constexpr size_t FILLED_ORDERS = 256;  // Distinct order IDs of the fill pushes
+
+std::vector<std::array<char, binary_utils::OMS_ACTION_V3_SIZE>> encodedActions() {
+    std::vector<std::array<char, binary_utils::OMS_ACTION_V3_SIZE>> actions(ACTIONS);
+    for (size_t i = 0; i < ACTIONS; ++i) {
+        const double price = (static_cast<double>(i % 200) - 100.0) / 100.0;
+        const double volume = static_cast<double>(i % 97) / 97.0;
+        binary_utils::encodeOmsActionV3(actions[i].data(), 0, price, volume, 65000.0 + static_cast<double>(i) * 0.1,
+                                        static_cast<uint16_t>(i), 1700000000000000000ULL + i);
+    }
+    return actions;
+}
+
+// Action decode. Arg: format (2 or 3), v2 being the first 23 bytes of v3
+void BM_DecodeOmsAction(benchmark::State& state) {
+    const auto actions = encodedActions();
+    const bool v3 = state.range(0) == 3;
+    size_t next = 0;
+    uint8_t action_type;
+    double price, volume, mid_price;
+    uint16_t state_id;
+    uint64_t origin_ns = 0;
+    for (auto _ : state) {
+        const char* data = actions[next].data();
+        if (v3) {
+            binary_utils::decodeOmsActionV3(data, action_type, price, volume, mid_price, state_id, origin_ns);
+        } else {
+            binary_utils::decodeOmsActionV2(data, action_type, price, volume, mid_price, state_id);
+        }
+        benchmark::DoNotOptimize(price);
+        benchmark::DoNotOptimize(volume);
+        benchmark::DoNotOptimize(mid_price);
+        benchmark::DoNotOptimize(state_id);
+        benchmark::DoNotOptimize(origin_ns);
+        next = (next + 1) % ACTIONS;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DecodeOmsAction)->ArgName("format")->Arg(2)->Arg(3);
+
+void BM_EncodeOmsAction(benchmark::State& state) {
+    std::array<char, binary_utils::OMS_ACTION_V3_SIZE> buffer;
+    uint16_t state_id = 0;
+    for (auto _ : state) {
+        binary_utils::encodeOmsActionV3(buffer.data(), 0, -0.25, 0.5, 65000.12, state_id++, 1700000000000000000ULL);
+        benchmark::DoNotOptimize(buffer.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EncodeOmsAction);
+
+// An order's life in the store at its bound: insert, acknowledge, a fill lookup by OKX ID,
+// then the oldest order evicted
+void BM_OrderStoreChurn(benchmark::State& state) {
+    OrderStore store;
+    std::vector<std::string> okx_ids;
+    for (size_t i = 0; i < 65536; ++i) okx_ids.push_back(std::to_string(2000000000000000000ULL + i));
+
+    OrderInfo order;
+    order.volume = 1.0;
+    order.price = 65000.0;
+    order.side = "buy";
+    order.order_state = "pending";
+    uint32_t state_id = 0;
+    auto place = [&]() {
+        order.state_id = state_id & 0xFFFF;
+        const OrderStore::Handle handle = store.insert(order);
+        store.setOkxId(handle, okx_ids[order.state_id]);
+        state_id++;
+    };
+    while (store.size() < OKXWebSocket::MAX_ACTIVE_ORDERS) place();
+
+    for (auto _ : state) {
+        place();
+        const OrderStore::Handle filled = store.findByOkxId(okx_ids[(state_id - 150) & 0xFFFF]);
+        store.setFillTime(filled, static_cast<int64_t>(state_id));
+        benchmark::DoNotOptimize(store.findByStateId((state_id - 1) & 0xFFFF));
+        store.erase(store.oldest());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_OrderStoreChurn);
+
+// One orders channel push with a complete fill: JSON parse, fill delta and the reorder buffer.
+// Fills are released to the callback on the client's own thread, as in the service.
+void BM_HandleOrderUpdate(benchmark::State& state) {
+    std::vector<std::string> messages;
+    for (size_t i = 0; i < FILLED_ORDERS; ++i) {
+        const std::string id = std::to_string(2000000000000000000ULL + i);
+        messages.push_back(
+            R"({"arg":{"channel":"orders","instType":"SWAP","uid":"1"},"data":[{"instType":"SWAP",)"
+            R"("instId":"BTC-USDT-SWAP","ordId":")" + id + R"(","clOrdId":")" + std::to_string(i) +
+            R"(","px":"","sz":"1","pnl":"0.125","ordType":"market","side":"buy","posSide":"net",)"
+            R"("tdMode":"cross","accFillSz":"1","fillPx":"65000.1","tradeId":"1","fillSz":"1",)"
+            R"("fillTime":"1700000000123","avgPx":"65000.1","state":"filled","lever":"100","fee":"-0.0325",)"
+            R"("feeCcy":"USDT","uTime":"1700000000123","cTime":"1700000000100"}]})");
+    }
+
+    OKXWebSocket ws("", "", "");
+    std::atomic<uint64_t> released{0};
+    ws.set_order_fill_callback([&released](const std::string&, double, double, const std::string&,
+                                           const std::string&, double, int64_t) {
+        released.fetch_add(1, std::memory_order_relaxed);
+    });
+
+    size_t next = 0;
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        const std::string& message = messages[next];
+        OMSBenchAccess::handleOrderUpdate(ws, message);
+        bytes += static_cast<int64_t>(message.size());
+        next = (next + 1) % messages.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(bytes);
+    state.counters["released"] = benchmark::Counter(static_cast<double>(released.load()), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_HandleOrderUpdate);
+
+} // namespace
+
+int main(int argc, char** argv) {
+    logging::setLevel(logging::Level::Warn);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Structure to store buffered order updates
+struct BufferedOrderUpdate {
+    std::string okx_order_id;
+    double filled_size;
+    double avg_price;
+    std::string side;
+    std::string state;
+    double pnl;
+    int64_t timestamp;  // fillTime or uTime
+    double fill_delta{0.0};  // Track the actual fill delta for this update
+    double fill_size{-1.0};  // fillSz of this update, < 0 when OKX did not send it
+    uint64_t received_ns{0};  // latency::nowNanos() on arrival
+    uint64_t sequence{0};     // Arrival order, breaks fill time ties
+};
+
+// Reorder stage for fill updates: a min-heap by fill time. The earliest fill is released as
+// soon as its order's accumulated fill size shows no earlier fill is missing, or once it has
+// waited WINDOW_NS; later fills wait behind it. Duplicates of released fills pass straight
+// through, the OMS ignores fills that do not add to an order.
+//
+// Times are latency::nowNanos() values passed in by the caller. Not thread-safe: OKXWebSocket
+// holds its buffer_mutex_ around every call.
+class FillReorderBuffer {
+public:
+    static constexpr uint64_t WINDOW_NS = 2000ULL * 1000000ULL;  // Longest a fill is held back
+    static constexpr double FILL_EPSILON = 1e-8;
+    // Fill tracking of an order with no fill for this long is dropped; swept once a minute
+    static constexpr uint64_t TRACKING_IDLE_NS = 600ULL * 1000000000ULL;
+    static constexpr uint64_t TRACKING_SWEEP_NS = 60ULL * 1000000000ULL;
+
+    // Queue an update received at now_ns
+    void push(BufferedOrderUpdate update, uint64_t now_ns);
+
+    // Remove the updates that may be released at now_ns, in fill time order
+    std::vector<BufferedOrderUpdate> takeReleasable(uint64_t now_ns);
+
+    bool empty() const { return heap_.empty(); }
+    size_t size() const { return heap_.size(); }
+    size_t trackedOrders() const { return released_.size(); }
+
+    // When the held back fill is released by the window cap; only when !empty()
+    uint64_t deadlineNs() const { return heap_.front().received_ns + WINDOW_NS; }
+
+private:
+    struct LaterFill {
+        bool operator()(const BufferedOrderUpdate& a, const BufferedOrderUpdate& b) const {
+            return a.timestamp != b.timestamp ? a.timestamp > b.timestamp : a.sequence > b.sequence;
+        }
+    };
+    struct ReleasedFill {
+        double filled_size;    // Accumulated fill released
+        uint64_t released_ns;  // Time of the latest release
+    };
+
+    bool isContiguous(const BufferedOrderUpdate& update) const;
+
+    std::vector<BufferedOrderUpdate> heap_;  // Ordered by LaterFill
+    std::unordered_map<std::string, ReleasedFill> released_;
+    uint64_t next_sweep_ns_ = 0;
+    uint64_t next_sequence_ = 0;
+};
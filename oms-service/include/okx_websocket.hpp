@@ -5,44 +5,22 @@
 #include <memory>
 #include <libwebsockets.h>
 #include <nlohmann/json.hpp>
+#include <openssl/evp.h>
 #include <atomic>
 #include <mutex>
 #include <thread>
-#include <deque>
+#include <condition_variable>
 #include <vector>
 #include <iomanip>
 #include <chrono>
 #include <sstream>
-#include <queue>
-
-// Structure to store order information
-struct OrderInfo {
-    uint32_t state_id;  // Internal state ID from input
-    double volume;      // Original order volume
-    double price;       // Original order price
-    std::string okx_order_id;  // OKX order ID
-    bool has_okx_id{false};    // Flag indicating if OKX ID is set
-    double filled_size{0.0};   // Actual filled size
-    double cumulative_filled_size{0.0};  // Track total filled size across all fills
-    double avg_fill_price{0.0}; // Average fill price
-    bool is_filled{false};     // Whether the order is filled
-    double execution_percentage;  // Track percentage of order executed
-    std::string order_state;     // Track order state (filled, partially_filled, etc.)
-    std::string side;            // Order side (buy or sell)
-    std::string tradeId;         // ID of the trade this order belongs to
-    int64_t fill_time{0};        // Timestamp when order was filled (from OKX fillTime)
-    
-    // New fields for tracking fill portions
-    struct FillPortion {
-        std::string tradeId;     // ID of the trade this portion belongs to
-        double size;             // Size of this fill portion
-        double price;            // Price of this fill portion
-        int64_t timestamp;       // When this portion was filled
-        bool is_closing{false};  // Whether this portion was used to close a position
-        double execution_percentage;  // Added execution percentage field
-    };
-    std::vector<FillPortion> fill_portions;  // Track all fill portions and their associated trades
-};
+#include <array>
+#include <unordered_map>
+#include <random>
+#include <latency_histogram.hpp>
+#include <mpsc_queue.hpp>
+#include "order_store.hpp"
+#include "fill_reorder_buffer.hpp"
 
 // Structure to track cancellation requests
 struct CancellationInfo {
@@ -51,19 +29,6 @@ struct CancellationInfo {
     bool cancellation_confirmed{false};
 };
 
-// Structure to store buffered order updates
-struct BufferedOrderUpdate {
-    std::string okx_order_id;
-    double filled_size;
-    double avg_price;
-    std::string side;
-    std::string state;
-    double pnl;
-    int64_t timestamp;  // fillTime or uTime
-    nlohmann::json raw_data;
-    double fill_delta{0.0};  // Track the actual fill delta for this update
-};
-
 class OKXWebSocket {
 public:
     static OKXWebSocket* instance_;
@@ -71,11 +36,34 @@ public:
     OKXWebSocket(const std::string& api_key, 
                  const std::string& secret_key, 
                  const std::string& passphrase);
-    ~OKXWebSocket();
+    virtual ~OKXWebSocket();
+
+    // The venue: OKX itself here, a simulation in SimulatedExchange
+    virtual bool connect();
+    virtual void disconnect();
 
-    bool connect();
-    void disconnect();
+    // Spin the service thread on lws_service instead of sleeping in poll, optionally pinned to
+    // a CPU (-1: not pinned). Must be set before connect().
+    void set_busy_poll(bool enabled, int cpu = -1) {
+        busy_poll_ = enabled;
+        busy_poll_cpu_ = cpu;
+    }
+
+    // Keep a second session logged in next to the primary, which takes over the orders and
+    // subscriptions when the primary drops. Must be set before connect().
+    void set_standby(bool enabled) { standby_enabled_ = enabled; }
     bool fetch_balance();
+
+    // The one instrument this venue trades, and its base currency per contract. Actions carry
+    // no instrument, so the OMS places all of them here.
+    virtual const std::string& instrument() const { return inst_id_; }
+    virtual double contract_value() const { return CONTRACT_VALUE; }
+
+    // Cross margin leverage of the account: orders are sized with it and uplRatio is relative to
+    // the margin it implies. Orders are at least MIN_CONTRACT_SIZE contracts.
+    static constexpr double LEVERAGE = 100.0;
+    static constexpr double MIN_CONTRACT_SIZE = 0.1;
+
     double get_balance() const { return initial_balance_.load(); }
     bool is_balance_received() const { return balance_received_.load(); }
 
@@ -83,8 +71,9 @@ public:
     double get_maxdd() const { return maxdd_.load(); }
     void update_maxdd(double new_maxdd) { maxdd_.store(new_maxdd); }
 
-    // Method for sending orders
-    bool send_order(uint32_t state_id,
+    // Method for sending orders. origin_ns is the arrival of the orderbook state behind the
+    // order (latency::nowNanos(), 0 if unknown) for the tick-to-send and tick-to-ack latencies.
+    virtual bool send_order(uint32_t state_id,
                    const std::string& inst_id,
                    const std::string& td_mode,
                    const std::string& side,
@@ -92,7 +81,8 @@ public:
                    double size,
                    double price,
                    double original_volume,
-                   double original_price);
+                   double original_price,
+                   uint64_t origin_ns = 0);
 
     // Methods for subscribing to channels
     bool subscribe_to_orders();
@@ -122,45 +112,46 @@ public:
                           double filled_size, 
                           double avg_price,
                           const std::string& side,
-                          const std::string& state);
+                          const std::string& state,
+                          int64_t fill_time);
     void store_order(const OrderInfo& order);
     void process_old_orders();
-    bool send_cancel_order(const std::string& okx_order_id);
+    virtual bool send_cancel_order(const std::string& okx_order_id);
     void log_orders() const;
     
     // New methods for order cleanup
     void remove_filled_order(const std::string& okx_order_id);
     void move_to_old_orders(const OrderInfo& order);
     void cleanup_orders();
+    void trim_orders();  // Evict beyond MAX_ACTIVE_ORDERS, oldest first; orders_mutex_ held
 
-    // Deque access for testing/debugging
-    std::deque<OrderInfo> orders_;
+    // Active orders, indexed by OKX order ID and state ID; access under orders_mutex_
+    static constexpr size_t MAX_ACTIVE_ORDERS = 300;
+    OrderStore orders_;
     std::mutex orders_mutex_;
 
-    // Helper method for timestamps
-    std::string getCurrentTimestamp() const {
-        auto now = std::chrono::system_clock::now();
-        auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-            now.time_since_epoch()
-        );
-        auto now_sec = std::chrono::duration_cast<std::chrono::seconds>(now_ms);
-        auto ms = now_ms.count() % 1000;
-
-        std::time_t now_time = std::chrono::system_clock::to_time_t(now);
-        std::stringstream ss;
-        ss << std::put_time(std::localtime(&now_time), "%Y-%m-%d %H:%M:%S");
-        ss << '.' << std::setfill('0') << std::setw(3) << ms;
-        return ss.str();
-    }
+protected:
+    // For venues that deliver their own fills through the ordered release below
+    void add_to_buffer(const BufferedOrderUpdate& update);
+    int64_t get_current_timestamp_ms() const;
+
+    std::atomic<double> initial_balance_{0.0};
+    std::atomic<bool> balance_received_{false};
+    std::atomic<bool> connected_{false};
+    OrderIdCallback order_id_callback_;
+    OrderFillCallback order_fill_callback_;
 
 private:
+    friend struct OMSBenchAccess;  // bench/oms_bench.cpp feeds order updates without a connection
+
     static int callback_function(struct lws* wsi, 
                                enum lws_callback_reasons reason,
                                void* user, 
                                void* in, 
                                size_t len);
 
-    void handle_message(const std::string& message);
+    struct Link;
+    void handle_message(Link& link, const std::string& message);
     void handle_order_update(const std::string& message);
     void handle_position_update(const nlohmann::json& data);
     void handle_cancel_response(const nlohmann::json& data);
@@ -169,16 +160,14 @@ private:
                            const std::string& method,
                            const std::string& request_path,
                            const std::string& body = "") const;
-    bool send_ws_message(const std::string& message);
+    bool send_ws_message(const std::string& message, uint64_t origin_ns = 0);
+    void record_order_ack(const std::string& client_order_id);
 
     struct lws_context* context_;
-    struct lws* connection_;
+    std::atomic<struct lws*> connection_;  // The logged in primary session, null while there is none
     std::string api_key_;
     std::string secret_key_;
     std::string passphrase_;
-    std::atomic<double> initial_balance_{0.0};
-    std::atomic<bool> balance_received_{false};
-    std::atomic<bool> connected_{false};
     std::mutex mutex_;
     std::thread service_thread_;
 
@@ -192,30 +181,123 @@ private:
     static constexpr int WSS_PORT = 8443;
     static constexpr const char* WSS_PROTOCOL = "ws";
     static constexpr size_t RX_BUFFER_SIZE = 65536;
-    static constexpr int MAX_RETRIES = 50;
+    static constexpr int MAX_RETRIES = 50;  // Failed attempts of the primary in a row before giving up
+    static constexpr double CONTRACT_VALUE = 0.01;  // BTC per BTC-USDT-SWAP contract
+    const std::string inst_id_ = "BTC-USDT-SWAP";  // Subscribed orders and positions
 
-    // Callbacks for order updates
-    OrderIdCallback order_id_callback_;
-    OrderFillCallback order_fill_callback_;
+    // Reconnects wait a random time in the upper half of a ceiling that starts at
+    // RECONNECT_BASE_MS and doubles per failed attempt up to RECONNECT_MAX_MS
+    static constexpr int64_t RECONNECT_BASE_MS = 50;
+    static constexpr int64_t RECONNECT_MAX_MS = 2000;
+    static constexpr int64_t LOGIN_TIMEOUT_MS = 1500;  // Unanswered login replaces the socket
+    static constexpr int64_t KEEPALIVE_MS = 20000;     // OKX drops connections idle for 30 s
+
+    // A private WebSocket session. The primary carries the subscriptions and the orders, the
+    // standby only logs in and answers pings. Service thread only, as are the timers, which
+    // are lws_sul entries so the thread keeps sleeping in poll between them.
+    struct LinkTimer {
+        lws_sorted_usec_list_t sul{};  // First member: lws hands the callback this address
+        Link* link = nullptr;
+    };
+    struct Link {
+        enum class State { Idle, Connecting, LoggingIn, Ready };
+        State state = State::Idle;
+        struct lws* wsi = nullptr;
+        unsigned failures = 0;             // Attempts since the last login, for the backoff
+        bool closing = false;              // Closed from the next writeable callback
+        std::vector<std::string> control;  // Login and ping frames, written ahead of send_queue_
+        LinkTimer reconnect;
+        LinkTimer login_deadline;
+        LinkTimer keepalive;
+    };
+    std::array<Link, 2> links_;
+    Link* primary_ = &links_[0];
+    Link* standby_ = &links_[1];  // Opened only with set_standby
+    bool standby_enabled_ = false;
+    std::atomic<bool> session_ready_{false};  // Primary logged in and subscribed, orders may go out
+    // Bumped when the primary session ends. Senders read it before session_ready_ and stamp
+    // their slot with it, so the writer can drop a message committed after its session ended.
+    std::atomic<uint64_t> session_generation_{0};
+    uint64_t dropped_ns_ = 0;  // latency::nowNanos() when the primary was lost, 0 while it is up
+    struct lws_client_connect_info connect_info_{};
+    std::minstd_rand backoff_rng_{std::random_device{}()};
+    std::array<unsigned char, LWS_PRE + 1024> control_buffer_;
+
+    const char* role(const Link& link) const { return &link == primary_ ? "primary" : "standby"; }
+    void open_link(Link& link);
+    void close_link(Link& link);
+    void on_link_closed(Link& link);
+    void on_login(Link& link, bool success, const std::string& message);
+    void start_session();  // The primary is logged in: subscribe and resume orders
+    void queue_control(Link& link, std::string frame);
+    void schedule_reconnect(Link& link);
+    void schedule(LinkTimer& timer, sul_cb_t callback, int64_t delay_ms);
+    void cancel(LinkTimer& timer);
+    static void on_reconnect_due(lws_sorted_usec_list_t* sul);
+    static void on_login_timeout(lws_sorted_usec_list_t* sul);
+    static void on_keepalive(lws_sorted_usec_list_t* sul);
+
+    // Login signatures: HMAC-SHA256 keyed once with the secret key, re-initialised from the
+    // digested key for each signature
+    EVP_MAC* hmac_ = nullptr;
+    EVP_MAC_CTX* hmac_ctx_ = nullptr;
 
     std::atomic<double> maxdd_{0.0};  // Add maxdd atomic variable
 
-    // Message queue for sending WebSocket messages
-    std::queue<std::string> send_queue_;
-    std::mutex send_queue_mutex_;
+    // Outgoing WebSocket messages, written by any thread and sent by the service thread.
+    // Each slot holds the LWS_PRE header room so lws_write sends straight from it.
+    struct OutboundMessage {
+        static constexpr size_t MAX_SIZE = 1024;  // Longest message: the login request
+        std::array<unsigned char, LWS_PRE + MAX_SIZE> buffer;
+        size_t length = 0;     // 0 for a slot that was claimed but could not be filled
+        uint64_t queued_ns = 0;  // latency::nowNanos() when it was queued
+        uint64_t origin_ns = 0;  // Orderbook state behind an order message, 0 otherwise
+        uint64_t generation = 0;  // session_generation_ it was formatted for
+
+        unsigned char* data() { return buffer.data() + LWS_PRE; }
+    };
+    static constexpr size_t SEND_QUEUE_CAPACITY = 64;
+    MpscQueue<OutboundMessage, SEND_QUEUE_CAPACITY> send_queue_;
+    void commit_ws_message(OutboundMessage* slot, size_t ticket);
+    void drop_pending_messages();  // Service thread only
+    void end_session();            // Service thread only, or with it stopped
+
+    // Service thread mode
+    bool busy_poll_ = false;
+    int busy_poll_cpu_ = -1;
 
-    // Buffer for order updates
-    static constexpr int64_t BUFFER_WINDOW_MS = 2000;  // 2 second buffer window
-    std::vector<BufferedOrderUpdate> update_buffer_;
+    // Orders awaiting their "op":"order" response, by client order ID. State IDs wrap at
+    // 65536, which bounds entries of orders that are never answered.
+    struct PendingAck {
+        uint64_t sent_ns;
+        uint64_t origin_ns;
+    };
+    std::unordered_map<uint32_t, PendingAck> pending_acks_;
+    std::mutex pending_acks_mutex_;
+
+    // Stage latencies of the order path
+    latency::Histogram& send_order_latency_ = latency::registry().histogram(
+        "oms_send_order_seconds", "Building and queueing one order message");
+    latency::Histogram& write_wait_latency_ = latency::registry().histogram(
+        "oms_ws_write_wait_seconds", "Queued websocket message until it is written");
+    latency::Histogram& order_ack_latency_ = latency::registry().histogram(
+        "oms_order_ack_seconds", "Order queued until OKX answers it");
+    latency::Histogram& tick_to_send_latency_ = latency::registry().histogram(
+        "oms_tick_to_send_seconds", "Orderbook frame arrival until its order is written to OKX");
+    latency::Histogram& tick_to_ack_latency_ = latency::registry().histogram(
+        "oms_tick_to_ack_seconds", "Orderbook frame arrival until OKX answers its order");
+
+    // Fill updates in fill time order, released by buffer_processor_thread_
+    FillReorderBuffer update_buffer_;  // buffer_mutex_ held
     std::mutex buffer_mutex_;
+    std::condition_variable buffer_cv_;
     std::thread buffer_processor_thread_;
     std::atomic<bool> buffer_processor_running_{false};
+    latency::Histogram& fill_release_latency_ = latency::registry().histogram(
+        "oms_fill_release_seconds", "Fill update received until it is released to the OMS");
 
     // Buffer processing methods
     void start_buffer_processor();
     void stop_buffer_processor();
     void buffer_processor_loop();
-    void process_buffered_updates();
-    void add_to_buffer(const BufferedOrderUpdate& update);
-    int64_t get_current_timestamp_ms() const;
 }; 
\ No newline at end of file
@@ -10,7 +10,10 @@
 #include <vector>
 #include <unordered_set>
 #include <unordered_map>
+#include <amqp_consumer.hpp>
+#include <transport.hpp>
 #include "okx_websocket.hpp"
+#include "simulated_exchange.hpp"
 #include "possizehandler.hpp"
 
 struct Trade {
@@ -46,14 +49,36 @@ public:
               const std::string& okx_api_key,
               const std::string& okx_secret_key,
               const std::string& okx_passphrase);
+    // Places the orders on the given exchange, e.g. a SimulatedExchange for offline training
+    OMSHandler(const std::string& host, int port,
+              const std::string& username, const std::string& password,
+              std::unique_ptr<OKXWebSocket> exchange);
     ~OMSHandler();
 
     void start();
     void stop();
+
+    // Busy-poll the OKX WebSocket service thread (see OKXWebSocket::set_busy_poll); before start()
+    void setBusyPoll(bool enabled, int cpu = -1) { okx_ws_->set_busy_poll(enabled, cpu); }
+    // Keep a logged in standby OKX session (see OKXWebSocket::set_standby); before start()
+    void setStandbyConnection(bool enabled) { okx_ws_->set_standby(enabled); }
+    // Prefetch and ack batching of the action consumer; before start()
+    void setConsumerOptions(const amqp_consumer::Options& options) { consumer_options_ = options; }
+    // Take actions from the PPO service's shared-memory ring instead of its action queue; before start()
+    void setTransport(transport::Kind kind) { transport_ = kind; }
+    // Instruments whose PPO actions are taken; before start(). Actions carry no instrument and
+    // are all placed for instrument(), so any other throws std::invalid_argument.
+    void setActionInstruments(const std::vector<std::string>& instruments);
+    // The one instrument the exchange trades
+    const std::string& instrument() const { return okx_ws_->instrument(); }
     double get_balance() const { return okx_ws_ ? okx_ws_->get_balance() : 0.0; }
     bool is_balance_received() const { return okx_ws_ ? okx_ws_->is_balance_received() : false; }
 
 private:
+    static constexpr uint64_t ACTION_LOG_SAMPLE = 100;  // Log one received action in this many
+    static constexpr auto SHM_POLL_WAIT = std::chrono::milliseconds(1);  // Longest wait on the action ring
+    static constexpr amqp_channel_t SIM_BOOK_CHANNEL = 2;  // Orderbook states for the simulated exchange
+
     // RabbitMQ connection details
     std::string host_;
     int port_;
@@ -64,9 +89,16 @@ private:
     // RabbitMQ connection and channel
     amqp_connection_state_t conn_;
     amqp_socket_t* socket_;
+    amqp_consumer::Options consumer_options_;
+    bool sim_book_channel_open_ = false;
+    transport::Kind transport_ = transport::Kind::RabbitMQ;
+    std::string action_queue_;           // oms_action_queue.<instrument>
+    std::string action_routing_key_;     // oms.action.<instrument>
+    std::string execution_routing_key_;  // execution.update.<instrument>
 
     // OKX WebSocket client
     std::unique_ptr<OKXWebSocket> okx_ws_;
+    SimulatedExchange* simulated_ = nullptr;  // okx_ws_ when it is simulated, fed the orderbook states
 
     // Current trade state
     Trade current_trade_;
@@ -84,7 +116,8 @@ private:
     // Private methods
     void initializeRabbitMQ();
     void cleanupRabbitMQ();
-    void handleMessage(const std::string& message);
+    void handleMessage(std::string_view message);
+    void handleBookMessage(std::string_view message);  // Simulated execution only
     void declareExchangesAndQueues();
     bool initializeOKXWebSocket();
     void publishTradeUpdate(uint32_t state_id, const std::string& okx_id);
@@ -98,10 +131,14 @@ private:
     bool place_order(uint32_t state_id, const std::string& inst_id,
                     const std::string& td_mode, const std::string& side,
                     const std::string& ord_type, double size, double price,
-                    double original_volume, double original_price);
+                    double original_volume, double original_price, uint64_t origin_ns = 0);
     void printTradeOrders() const;
-    std::string getCurrentTimestamp() const;
-    void processAction(uint8_t action_type, double price, double volume, double mid_price, uint32_t state_id);
+    void processAction(uint8_t action_type, double price, double volume, double mid_price, uint32_t state_id,
+                       uint64_t origin_ns = 0);
+
+    // Decoding an action until its order is queued (or rejected)
+    latency::Histogram& decision_latency_ = latency::registry().histogram(
+        "oms_decision_seconds", "Decoding an action, sizing it and queueing its order");
 
     std::unique_ptr<PosSizeHandler> pos_size_handler_;
 }; 
\ No newline at end of file
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <set>
+#include <tuple>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Structure to store order information
+struct OrderInfo {
+    uint32_t state_id;  // Internal state ID from input
+    double volume;      // Original order volume
+    double price;       // Original order price
+    std::string okx_order_id;  // OKX order ID
+    bool has_okx_id{false};    // Flag indicating if OKX ID is set
+    double filled_size{0.0};   // Actual filled size
+    double cumulative_filled_size{0.0};  // Track total filled size across all fills
+    double avg_fill_price{0.0}; // Average fill price
+    bool is_filled{false};     // Whether the order is filled
+    double execution_percentage;  // Track percentage of order executed
+    std::string order_state;     // Track order state (filled, partially_filled, etc.)
+    std::string side;            // Order side (buy or sell)
+    std::string tradeId;         // ID of the trade this order belongs to
+    int64_t fill_time{0};        // Timestamp when order was filled (from OKX fillTime)
+    
+    // New fields for tracking fill portions
+    struct FillPortion {
+        std::string tradeId;     // ID of the trade this portion belongs to
+        double size;             // Size of this fill portion
+        double price;            // Price of this fill portion
+        int64_t timestamp;       // When this portion was filled
+        bool is_closing{false};  // Whether this portion was used to close a position
+        double execution_percentage;  // Added execution percentage field
+    };
+    std::vector<FillPortion> fill_portions;  // Track all fill portions and their associated trades
+};
+
+// Active orders, indexed by OKX order ID and by state ID, with the insertion order kept as an
+// intrusive list (oldest first) and a fill-time ordered index kept up to date on every change.
+//
+// Orders live in a slot pool and are addressed by stable handles. Both ID indexes are
+// open-addressing tables of handles (linear probing, backward-shift deletion) kept at most
+// half full, so ID lookups are O(1) and only allocate when the pool grows; the fill-time
+// index is an ordered set, O(log n) per insert or erase.
+// Not thread-safe: callers hold OKXWebSocket::orders_mutex_.
+//
+// Change okx_order_id and fill_time only through setOkxId/setFillTime, and never state_id,
+// or the indexes go stale.
+class OrderStore {
+public:
+    using Handle = uint32_t;
+    static constexpr Handle NONE = std::numeric_limits<Handle>::max();
+
+    explicit OrderStore(size_t capacity = 512);
+
+    // Append as the newest order
+    Handle insert(const OrderInfo& order);
+    void erase(Handle handle);
+    void clear();
+
+    OrderInfo* get(Handle handle) {
+        return handle < slots_.size() && slots_[handle].used ? &slots_[handle].order : nullptr;
+    }
+    const OrderInfo* get(Handle handle) const {
+        return handle < slots_.size() && slots_[handle].used ? &slots_[handle].order : nullptr;
+    }
+
+    // NONE when absent. State IDs wrap at 65536; the newest order with the ID wins.
+    Handle findByOkxId(std::string_view okx_order_id) const;
+    Handle findByStateId(uint32_t state_id) const;
+
+    void setOkxId(Handle handle, const std::string& okx_order_id);
+    void setFillTime(Handle handle, int64_t fill_time);
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    // Insertion order: for (h = oldest(); h != NONE; h = next(h))
+    Handle oldest() const { return head_; }
+    Handle next(Handle handle) const { return slots_[handle].next; }
+
+    // Orders by fill time, ties (and unfilled orders, fill time 0) in insertion order
+    void forEachByFillTime(const std::function<void(const OrderInfo&)>& fn) const;
+    std::vector<OrderInfo> snapshotByFillTime() const;
+
+    // Erase every order matching pred, returning how many were erased
+    size_t eraseIf(const std::function<bool(const OrderInfo&)>& pred);
+
+private:
+    struct Slot {
+        OrderInfo order{};
+        bool used = false;
+        uint64_t sequence = 0;  // Insertion counter, the fill-time tie break
+        Handle prev = NONE;     // Insertion list, or the free list through next
+        Handle next = NONE;
+    };
+
+    // Open-addressing table of handles; keys are read from the slots
+    struct Index {
+        std::vector<Handle> table;
+        size_t mask = 0;
+    };
+
+    static uint64_t hashOkxId(std::string_view id) { return std::hash<std::string_view>{}(id); }
+    static uint64_t hashStateId(uint32_t id) { return static_cast<uint64_t>(id) * 0x9E3779B97F4A7C15ULL; }
+
+    uint64_t hashOf(Handle handle, bool okx_index) const {
+        return okx_index ? hashOkxId(slots_[handle].order.okx_order_id) : hashStateId(slots_[handle].order.state_id);
+    }
+
+    void indexInsert(Index& index, Handle handle, bool okx_index);
+    void indexErase(Index& index, Handle handle, bool okx_index);
+    void grow();
+    void rebuildIndexes();
+
+    std::vector<Slot> slots_;
+    Handle free_ = NONE;
+    Handle head_ = NONE;
+    Handle tail_ = NONE;
+    size_t size_ = 0;
+    uint64_t next_sequence_ = 0;
+
+    Index by_okx_id_;    // Orders that have an OKX ID
+    Index by_state_id_;  // Every order
+    std::set<std::tuple<int64_t, uint64_t, Handle>> by_fill_time_;
+};
@@ -30,7 +30,7 @@ class PosSizeHandler {
 public:
     explicit PosSizeHandler(double margin_percentage) 
         : margin_percentage_(margin_percentage), 
-          leverage_(100.0) {
+          leverage_(OKXWebSocket::LEVERAGE) {
         if (margin_percentage <= 0 || margin_percentage > 100) {
             throw std::invalid_argument("Margin percentage must be between 0 and 100");
         }
@@ -47,7 +47,7 @@ public:
 private:
     double margin_percentage_;
     const double leverage_;
-    static constexpr double MIN_CONTRACT_SIZE = 0.1;  // Minimum contract size for OKX
+    static constexpr double MIN_CONTRACT_SIZE = OKXWebSocket::MIN_CONTRACT_SIZE;
 
     double calculateMaxAllowedContracts(double total_capital, double mid_price) const;
     
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include "okx_websocket.hpp"
+
+// Stand-in for OKX that fills the OMS's orders against the published orderbook states, so the
+// PPO service can be trained without live orders, e.g. on a replayed recording.
+//
+// The OMS reads the same states as the PPO service (on_book). Their level prices do not survive
+// the wire encoding, which keeps only change values below 2, but the level sizes, the exact mid
+// and the VWAP of the best 10/20/50/100/400 levels do. Each side is rebuilt from those: prices
+// climb linearly in depth from the touch (mid +- the half spread) and match every band's VWAP.
+// Market orders and marketable limits walk the levels and take their size until the next state,
+// so large orders pay for depth and a market order larger than the side fills partially. The
+// rest of a marketable limit rests; resting limits fill at their price against the size the
+// opposite side offers through it. Until a state arrives, the market is the actions' mid with
+// the half spread and any size fills at the touch.
+//
+// Fills go through the same ordered release and callbacks as OKX's, so the OMS trade and
+// reward accounting runs unchanged, and the drawdown follows the simulated position.
+//
+// One instrument is simulated, since the mids carry no instrument; orders for any other are
+// rejected.
+class SimulatedExchange : public OKXWebSocket {
+public:
+    struct Config {
+        double balance = 1000.0;        // Account equity in USDT
+        double half_spread_bps = 0.1;   // Best bid/ask distance from the mid
+        double fee_bps = 0.0;           // Charged on every fill's notional, deducted from its PnL
+        std::string inst_id = "BTC-USDT-SWAP";
+        double contract_value = 0.0;    // Base currency per contract, 0 looks up inst_id
+    };
+
+    // OKX contract value of a USDT swap (BTC-USDT-SWAP: 0.01 BTC), 0 if not in the table
+    static double contractValueOf(const std::string& inst_id);
+
+    // Routing key of the orderbook states on_book takes, e.g. orderbook.updates.BTC-USDT-SWAP
+    static std::string bookRoutingKey(const std::string& inst_id) { return "orderbook.updates." + inst_id; }
+
+    // Throws std::invalid_argument without a contract value for config.inst_id
+    explicit SimulatedExchange(const Config& config);
+
+    bool connect() override;
+    void disconnect() override;
+    bool send_order(uint32_t state_id,
+                    const std::string& inst_id,
+                    const std::string& td_mode,
+                    const std::string& side,
+                    const std::string& ord_type,
+                    double size,
+                    double price,
+                    double original_volume,
+                    double original_price,
+                    uint64_t origin_ns = 0) override;
+    bool send_cancel_order(const std::string& okx_order_id) override;
+
+    const std::string& instrument() const override { return config_.inst_id; }
+    double contract_value() const override { return contract_value_; }
+
+    // Take a v2 or v3 orderbook state of the instrument: rebuild the book from it and fill the
+    // resting orders it crosses. False for a delta whose base state was missed, skipped until
+    // the next keyframe. Throws on a malformed message.
+    bool on_book(std::string_view message);
+
+    // Move the market to the mid price of an action's state, filling the resting orders it
+    // crosses; ignored once on_book has a book
+    void on_market(double mid_price);
+
+private:
+    struct Order {
+        std::string okx_order_id;
+        bool is_buy;
+        double price;           // Limit price, 0 for market orders
+        double size;            // Contracts ordered
+        double filled = 0.0;    // Contracts filled so far
+        double notional = 0.0;  // sum(fill size * fill price), for the average fill price
+    };
+
+    // A rebuilt level: its price and the contracts still available until the next state
+    struct BookLevel {
+        double price;
+        double size;
+    };
+
+    static constexpr double SIZE_EPSILON = 1e-9;
+
+    // sim_mutex_ held for all of these
+    void rebuild_book(const double* bids, const double* asks, const double* feature_values);
+    void rebuild_side(const double* levels, const double* feature_values, bool is_bids,
+                      std::vector<BookLevel>& side) const;
+    // Walk the side an order takes from up to its limit, taking at most size contracts, filled at
+    // the levels' prices or, for a resting limit, at the limit
+    void take(Order& order, double size, std::vector<BookLevel>& side, bool at_limit);
+    void match_resting(double bid, double ask);  // Against the touch, without a book
+    void fill(Order& order, double size, double price);
+    double apply_to_position(bool is_buy, double size, double price);  // Realised PnL in USDT
+    void update_drawdown();
+
+    Config config_;
+    double contract_value_;
+    std::mutex sim_mutex_;
+    double mid_price_ = 0.0;
+    std::vector<Order> resting_;  // Oldest first, at most MAX_ACTIVE_ORDERS
+
+    // The book of the newest state, and the decoded states a v3 delta builds on
+    bool has_book_ = false;
+    std::vector<BookLevel> bids_;  // Best first
+    std::vector<BookLevel> asks_;
+    std::vector<double> decoded_[2];  // [bids, asks] interleaved [price, volume, orders] per level
+    size_t newest_decoded_ = 0;
+    bool v3_synced_ = false;
+    uint16_t newest_state_id_ = 0;
+    uint64_t next_order_id_ = 1;
+    double position_ = 0.0;        // Net contracts, negative when short
+    double position_price_ = 0.0;  // Average entry price of the position
+    uint64_t fills_ = 0;
+};
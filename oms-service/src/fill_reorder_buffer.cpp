@@ -0,0 +1,57 @@
+#include "../include/fill_reorder_buffer.hpp"
+#include <algorithm>
+#include <utility>
+
+void FillReorderBuffer::push(BufferedOrderUpdate update, uint64_t now_ns) {
+    update.received_ns = now_ns;
+    update.sequence = next_sequence_++;
+    heap_.push_back(std::move(update));
+    std::push_heap(heap_.begin(), heap_.end(), LaterFill{});
+}
+
+bool FillReorderBuffer::isContiguous(const BufferedOrderUpdate& update) const {
+    // Continuous when the fill starts where the released fills of its order end
+    if (update.fill_size < 0.0) return false;
+    auto it = released_.find(update.okx_order_id);
+    const double released = it != released_.end() ? it->second.filled_size : 0.0;
+    return update.filled_size - update.fill_size <= released + FILL_EPSILON;
+}
+
+std::vector<BufferedOrderUpdate> FillReorderBuffer::takeReleasable(uint64_t now_ns) {
+    std::vector<BufferedOrderUpdate> ready;
+
+    while (!heap_.empty()) {
+        const BufferedOrderUpdate& earliest = heap_.front();
+        const bool expired = now_ns - earliest.received_ns >= WINDOW_NS;
+        if (!expired && !isContiguous(earliest)) {
+            break;  // An earlier fill of this order may still arrive
+        }
+        std::pop_heap(heap_.begin(), heap_.end(), LaterFill{});
+        BufferedOrderUpdate update = std::move(heap_.back());
+        heap_.pop_back();
+
+        // Final states end the order's sequence
+        if (update.state == "filled" || update.state == "canceled") {
+            released_.erase(update.okx_order_id);
+        } else {
+            ReleasedFill& released = released_[update.okx_order_id];
+            released.filled_size = std::max(released.filled_size, update.filled_size);
+            released.released_ns = now_ns;
+        }
+        ready.push_back(std::move(update));
+    }
+
+    // Orders cancelled after a partial fill never send a final fill; forget those idle long
+    // enough. A live order that fills again after that only waits out the window once.
+    if (now_ns >= next_sweep_ns_) {
+        next_sweep_ns_ = now_ns + TRACKING_SWEEP_NS;
+        for (auto it = released_.begin(); it != released_.end();) {
+            if (now_ns - it->second.released_ns >= TRACKING_IDLE_NS) {
+                it = released_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    return ready;
+}
@@ -1,7 +1,11 @@
 #include "../include/oms_handler.hpp"
+#include <metrics_server.hpp>
 #include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <vector>
 
 int main() {
     try {
@@ -11,25 +15,93 @@ int main() {
         std::string username = std::getenv("RABBITMQ_USERNAME") ? std::getenv("RABBITMQ_USERNAME") : "guest";
         std::string password = std::getenv("RABBITMQ_PASSWORD") ? std::getenv("RABBITMQ_PASSWORD") : "guest";
 
-        // Get OKX API credentials from environment variables
-        const char* okx_api_key = std::getenv("OKX_API_KEY");
-        const char* okx_secret_key = std::getenv("OKX_SECRET_KEY");
-        const char* okx_passphrase = std::getenv("OKX_PASSPHRASE");
+        // OMS_EXECUTION=sim fills the orders against the incoming states instead of OKX (default live),
+        // with OMS_SIM_BALANCE, OMS_SIM_HALF_SPREAD_BPS and OMS_SIM_FEE_BPS (1000 USDT, 0.1, 0), for
+        // OMS_SIM_INSTRUMENT (BTC-USDT-SWAP) at OMS_SIM_CONTRACT_VALUE (looked up when unset or 0)
+        const std::string execution = std::getenv("OMS_EXECUTION") ? std::getenv("OMS_EXECUTION") : "live";
+        std::unique_ptr<OKXWebSocket> exchange;
+        if (execution == "sim") {
+            SimulatedExchange::Config sim_config;
+            sim_config.balance = std::getenv("OMS_SIM_BALANCE") ?
+                std::stod(std::getenv("OMS_SIM_BALANCE")) : sim_config.balance;
+            sim_config.half_spread_bps = std::getenv("OMS_SIM_HALF_SPREAD_BPS") ?
+                std::stod(std::getenv("OMS_SIM_HALF_SPREAD_BPS")) : sim_config.half_spread_bps;
+            sim_config.fee_bps = std::getenv("OMS_SIM_FEE_BPS") ?
+                std::stod(std::getenv("OMS_SIM_FEE_BPS")) : sim_config.fee_bps;
+            sim_config.inst_id = std::getenv("OMS_SIM_INSTRUMENT") ?
+                std::getenv("OMS_SIM_INSTRUMENT") : sim_config.inst_id;
+            sim_config.contract_value = std::getenv("OMS_SIM_CONTRACT_VALUE") ?
+                std::stod(std::getenv("OMS_SIM_CONTRACT_VALUE")) : sim_config.contract_value;
+            exchange = std::make_unique<SimulatedExchange>(sim_config);
+        } else if (execution == "live") {
+            // Get OKX API credentials from environment variables
+            const char* okx_api_key = std::getenv("OKX_API_KEY");
+            const char* okx_secret_key = std::getenv("OKX_SECRET_KEY");
+            const char* okx_passphrase = std::getenv("OKX_PASSPHRASE");
 
-        if (!okx_api_key || !okx_secret_key || !okx_passphrase) {
-            throw std::runtime_error("Missing required OKX credentials in environment variables");
+            if (!okx_api_key || !okx_secret_key || !okx_passphrase) {
+                throw std::runtime_error("Missing required OKX credentials in environment variables");
+            }
+            exchange = std::make_unique<OKXWebSocket>(okx_api_key, okx_secret_key, okx_passphrase);
+        } else {
+            std::cerr << "Unknown OMS_EXECUTION " << execution << std::endl;
+            return 1;
         }
 
         // Create and start OMS handler
-        OMSHandler handler(host, port, username, password,
-                         okx_api_key, okx_secret_key, okx_passphrase);
+        OMSHandler handler(host, port, username, password, std::move(exchange));
         
+        // OMS_METRICS_PORT serves the stage latencies for Prometheus (default 9103, 0 disables)
+        const int metrics_port = std::getenv("OMS_METRICS_PORT") ? std::stoi(std::getenv("OMS_METRICS_PORT")) : 9103;
+        latency::MetricsServer metrics(static_cast<uint16_t>(metrics_port));
+        if (metrics_port > 0) {
+            metrics.start();
+        }
+        
+        // OMS_PREFETCH, OMS_ACK_BATCH and OMS_ACK_INTERVAL_MS tune the action consumer (256, 64, 20)
+        handler.setConsumerOptions(amqp_consumer::optionsFromEnv("OMS"));
+
+        // OMS_TRANSPORT=shm reads actions from the PPO service's shared-memory ring (default rabbitmq)
+        if (const char* name = std::getenv("OMS_TRANSPORT")) {
+            transport::Kind kind;
+            if (!transport::parseKind(name, kind)) {
+                std::cerr << "Unknown OMS_TRANSPORT " << name << std::endl;
+                return 1;
+            }
+            handler.setTransport(kind);
+        }
+
+        // OMS_INSTRUMENTS: comma separated PPO_INSTRUMENTs whose actions are taken; actions carry no
+        // instrument yet, so only the one the exchange trades is accepted
+        if (const char* list = std::getenv("OMS_INSTRUMENTS")) {
+            std::vector<std::string> instruments;
+            std::stringstream stream(list);
+            std::string instrument;
+            while (std::getline(stream, instrument, ',')) {
+                if (!instrument.empty()) instruments.push_back(instrument);
+            }
+            handler.setActionInstruments(instruments);
+        }
+
+        // OMS_BUSY_POLL=1 spins the OKX WebSocket thread instead of sleeping in poll,
+        // pinned to OMS_BUSY_POLL_CPU when set
+        if (std::getenv("OMS_BUSY_POLL") && std::string(std::getenv("OMS_BUSY_POLL")) == "1") {
+            const int cpu = std::getenv("OMS_BUSY_POLL_CPU") ? std::stoi(std::getenv("OMS_BUSY_POLL_CPU")) : -1;
+            handler.setBusyPoll(true, cpu);
+        }
+
+        // OMS_WS_STANDBY=1 keeps a second OKX session logged in to take over a dropped one
+        if (std::getenv("OMS_WS_STANDBY") && std::string(std::getenv("OMS_WS_STANDBY")) == "1") {
+            handler.setStandbyConnection(true);
+        }
+
         std::cout << "Starting OMS service..." << std::endl;
         std::cout << "RabbitMQ connection details:" << std::endl;
         std::cout << "  Host: " << host << std::endl;
         std::cout << "  Port: " << port << std::endl;
         std::cout << "  Username: " << username << std::endl;
-        std::cout << "OKX WebSocket connection initialized." << std::endl;
+        std::cout << (execution == "sim" ? "Simulated exchange initialized." : "OKX WebSocket connection initialized.")
+                  << std::endl;
         
         handler.start();
         
@@ -1,15 +1,18 @@
 #include "../include/okx_websocket.hpp"
 #include <iostream>
-#include <openssl/hmac.h>
-#include <openssl/sha.h>
 #include <openssl/evp.h>
-#include <openssl/bio.h>
-#include <openssl/buffer.h>
+#include <openssl/core_names.h>
 #include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
 #include <iomanip>
 #include <sstream>
 #include <thread>
+#include <pthread.h>
+#include <sched.h>
 #include <binary_utils.hpp>
+#include <async_logger.hpp>
 #include <stdexcept>
 #include <nlohmann/json.hpp>
 
@@ -17,24 +20,24 @@ using json = nlohmann::json;
 
 OKXWebSocket* OKXWebSocket::instance_ = nullptr;
 
-// Helper function for base64 encoding using OpenSSL
-std::string base64_encode(const unsigned char* input, int length) {
-    BIO *bio, *b64;
-    BUF_MEM *bufferPtr;
-
-    b64 = BIO_new(BIO_f_base64());
-    bio = BIO_new(BIO_s_mem());
-    bio = BIO_push(b64, bio);
+namespace {
 
-    BIO_set_flags(b64, BIO_FLAGS_BASE64_NO_NL);
-    BIO_write(bio, input, length);
-    BIO_flush(bio);
-    BIO_get_mem_ptr(bio, &bufferPtr);
+// Order request templates, filled with snprintf straight into a send slot. The string fields
+// are our own identifiers and side/mode names, which never need JSON escaping. %f matches the
+// std::to_string formatting the JSON builder used.
+constexpr const char* ORDER_TEMPLATE =
+    "{\"id\":\"%u\",\"op\":\"order\",\"args\":[{\"instId\":\"%s\",\"tdMode\":\"%s\","
+    "\"side\":\"%s\",\"ordType\":\"%s\",\"sz\":\"%f\",\"clOrdId\":\"%u\"}]}";
+constexpr const char* LIMIT_ORDER_TEMPLATE =
+    "{\"id\":\"%u\",\"op\":\"order\",\"args\":[{\"instId\":\"%s\",\"tdMode\":\"%s\","
+    "\"side\":\"%s\",\"ordType\":\"%s\",\"sz\":\"%f\",\"clOrdId\":\"%u\",\"px\":\"%f\"}]}";
 
-    std::string result(bufferPtr->data, bufferPtr->length);
-
-    BIO_free_all(bio);
+} // namespace
 
+// Helper function for base64 encoding using OpenSSL, without line breaks
+std::string base64_encode(const unsigned char* input, int length) {
+    std::string result(4 * ((static_cast<size_t>(length) + 2) / 3), '\0');
+    EVP_EncodeBlock(reinterpret_cast<unsigned char*>(result.data()), input, length);  // NUL lands on the terminator
     return result;
 }
 
@@ -45,18 +48,35 @@ OKXWebSocket::OKXWebSocket(const std::string& api_key,
     , secret_key_(secret_key)
     , passphrase_(passphrase)
     , context_(nullptr)
-    , connection_(nullptr)
-    , initial_balance_(0.0)
-    , balance_received_(false)
-    , connected_(false)
-    , send_queue_() {
+    , connection_(nullptr) {
     instance_ = this;
+    for (Link& link : links_) {
+        link.reconnect.link = &link;
+        link.login_deadline.link = &link;
+        link.keepalive.link = &link;
+    }
+
+    char digest[] = "SHA256";
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+        OSSL_PARAM_construct_end()
+    };
+    hmac_ = EVP_MAC_fetch(nullptr, "HMAC", nullptr);
+    hmac_ctx_ = hmac_ ? EVP_MAC_CTX_new(hmac_) : nullptr;
+    if (!hmac_ctx_ || !EVP_MAC_init(hmac_ctx_, reinterpret_cast<const unsigned char*>(secret_key_.data()),
+                                    secret_key_.size(), params)) {
+        EVP_MAC_CTX_free(hmac_ctx_);
+        EVP_MAC_free(hmac_);
+        throw std::runtime_error("Failed to set up HMAC-SHA256 signing");
+    }
     start_buffer_processor();
 }
 
 OKXWebSocket::~OKXWebSocket() {
     stop_buffer_processor();
     disconnect();
+    EVP_MAC_CTX_free(hmac_ctx_);
+    EVP_MAC_free(hmac_);
 }
 
 void OKXWebSocket::start_buffer_processor() {
@@ -65,16 +85,50 @@ void OKXWebSocket::start_buffer_processor() {
 }
 
 void OKXWebSocket::stop_buffer_processor() {
-    buffer_processor_running_ = false;
+    {
+        std::lock_guard<std::mutex> lock(buffer_mutex_);
+        buffer_processor_running_ = false;
+    }
+    buffer_cv_.notify_all();
     if (buffer_processor_thread_.joinable()) {
         buffer_processor_thread_.join();
     }
 }
 
 void OKXWebSocket::buffer_processor_loop() {
+    logging::setThreadName("fills");
+    std::unique_lock<std::mutex> lock(buffer_mutex_);
     while (buffer_processor_running_) {
-        process_buffered_updates();
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));  // Check every 100ms
+        std::vector<BufferedOrderUpdate> ready = update_buffer_.takeReleasable(latency::nowNanos());
+        if (!ready.empty()) {
+            // Process updates in fill time order, outside the buffer lock
+            lock.unlock();
+            for (const auto& update : ready) {
+                fill_release_latency_.recordSince(update.received_ns);
+                if (order_fill_callback_) {
+                    order_fill_callback_(
+                        update.okx_order_id,
+                        update.filled_size,
+                        update.avg_price,
+                        update.side,
+                        update.state,
+                        update.pnl,
+                        update.timestamp
+                    );
+                }
+            }
+            lock.lock();
+            continue;
+        }
+
+        // Sleep until a new update arrives or the held back fill reaches the window cap
+        if (update_buffer_.empty()) {
+            buffer_cv_.wait(lock);
+        } else {
+            const uint64_t deadline_ns = update_buffer_.deadlineNs();
+            buffer_cv_.wait_until(lock, std::chrono::steady_clock::time_point(
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(deadline_ns))));
+        }
     }
 }
 
@@ -85,68 +139,22 @@ int64_t OKXWebSocket::get_current_timestamp_ms() const {
 }
 
 void OKXWebSocket::add_to_buffer(const BufferedOrderUpdate& update) {
-    std::lock_guard<std::mutex> lock(buffer_mutex_);
-    update_buffer_.push_back(update);
-    
-    // Sort buffer by timestamp
-    std::sort(update_buffer_.begin(), update_buffer_.end(),
-              [](const BufferedOrderUpdate& a, const BufferedOrderUpdate& b) {
-                  return a.timestamp < b.timestamp;
-              });
-}
-
-void OKXWebSocket::process_buffered_updates() {
-    std::vector<BufferedOrderUpdate> updates_to_process;
-    
     {
         std::lock_guard<std::mutex> lock(buffer_mutex_);
-        if (update_buffer_.empty()) {
-            return;
-        }
-
-        int64_t current_time = get_current_timestamp_ms();
-        
-        // Process updates older than buffer window
-        auto split_point = std::partition(update_buffer_.begin(), update_buffer_.end(),
-            [current_time, this](const BufferedOrderUpdate& update) {
-                return (current_time - update.timestamp) > BUFFER_WINDOW_MS;
-            });
-        
-        updates_to_process.insert(
-            updates_to_process.end(),
-            std::make_move_iterator(update_buffer_.begin()),
-            std::make_move_iterator(split_point)
-        );
-        
-        update_buffer_.erase(update_buffer_.begin(), split_point);
-    }
-    
-    // Sort updates by timestamp
-    std::sort(updates_to_process.begin(), updates_to_process.end(),
-              [](const BufferedOrderUpdate& a, const BufferedOrderUpdate& b) {
-                  return a.timestamp < b.timestamp;
-              });
-    
-    // Process updates in timestamp order
-    for (const auto& update : updates_to_process) {
-        if (order_fill_callback_) {
-            order_fill_callback_(
-                update.okx_order_id,
-                update.filled_size,
-                update.avg_price,
-                update.side,
-                update.state,
-                update.pnl,
-                update.timestamp
-            );
-        }
+        update_buffer_.push(update, latency::nowNanos());
     }
+    buffer_cv_.notify_one();
 }
 
 void OKXWebSocket::disconnect() {
     connected_ = false;
     balance_received_ = false;
+    end_session();
     
+    // Wake the service thread if it is waiting in poll
+    if (context_) {
+        lws_cancel_service(context_);
+    }
     if (service_thread_.joinable()) {
         service_thread_.join();
     }
@@ -155,6 +163,20 @@ void OKXWebSocket::disconnect() {
         lws_callback_on_writable(connection_);
         connection_ = nullptr;
     }
+
+    // Forgotten before the context closes their sockets, so the close callbacks neither
+    // reconnect nor touch the timers of a context being destroyed
+    for (Link& link : links_) {
+        link.state = Link::State::Idle;
+        link.wsi = nullptr;
+        link.failures = 0;
+        link.closing = false;
+        link.control.clear();
+    }
+    primary_ = &links_[0];
+    standby_ = &links_[1];
+    dropped_ns_ = 0;
+
     if (context_) {
         lws_context_destroy(context_);
         context_ = nullptr;
@@ -166,11 +188,17 @@ std::string OKXWebSocket::sign_message(const std::string& timestamp,
                                     const std::string& request_path,
                                     const std::string& body) const {
     std::string pre_hash = timestamp + method + request_path + body;
-    unsigned char* digest = HMAC(EVP_sha256(),
-                               secret_key_.c_str(), secret_key_.length(),
-                               reinterpret_cast<const unsigned char*>(pre_hash.c_str()),
-                               pre_hash.length(), nullptr, nullptr);
-    return base64_encode(digest, 32);
+
+    // A null key restarts from the key digested in the constructor
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    size_t digest_length = 0;
+    if (!EVP_MAC_init(hmac_ctx_, nullptr, 0, nullptr) ||
+        !EVP_MAC_update(hmac_ctx_, reinterpret_cast<const unsigned char*>(pre_hash.data()), pre_hash.size()) ||
+        !EVP_MAC_final(hmac_ctx_, digest, &digest_length, sizeof(digest))) {
+        LOG_ERROR("HMAC-SHA256 signing failed");
+        return {};
+    }
+    return base64_encode(digest, static_cast<int>(digest_length));
 }
 
 std::string OKXWebSocket::generate_auth_message() const {
@@ -214,22 +242,18 @@ bool OKXWebSocket::fetch_balance() {
     return send_ws_message(message);
 }
 
-void OKXWebSocket::handle_message(const std::string& message) {
+void OKXWebSocket::handle_message(Link& link, const std::string& message) {
     try {
         auto j = nlohmann::json::parse(message);
 
         // Handle authentication response
         if (j.contains("event") && j["event"] == "login") {
-            if (j.contains("code") && j["code"] == "0") {
-                fetch_balance();
-                subscribe_to_orders();
-                subscribe_to_positions();
-            } else {
-                std::cerr << "\033[1;31mAuthentication failed: " << message << "\033[0m" << std::endl;
-                connection_ = nullptr;  // Reset connection on auth failure
-            }
+            on_login(link, j.contains("code") && j["code"] == "0", message);
             return;
         }
+        if (&link != primary_) {
+            return;  // A standby has no subscriptions or orders
+        }
 
         // Handle order creation response
         if (j.contains("op") && j["op"] == "order" && j.contains("data")) {
@@ -237,6 +261,7 @@ void OKXWebSocket::handle_message(const std::string& message) {
             if (data.is_array() && !data.empty()) {
                 const auto& order = data[0];
                 std::string client_order_id = order.contains("clOrdId") ? order["clOrdId"].get<std::string>() : "";
+                record_order_ack(client_order_id);
                 
                 // Check for error in order placement
                 if (j.contains("code") && j["code"] != "0" || 
@@ -245,28 +270,22 @@ void OKXWebSocket::handle_message(const std::string& message) {
                     std::string error_msg = order.contains("sMsg") ? order["sMsg"].get<std::string>() : 
                                           (j.contains("msg") ? j["msg"].get<std::string>() : "Unknown error");
                     
-                    // Remove the failed order from deque
+                    // Remove the failed order from the store
                     if (!client_order_id.empty()) {
                         try {
                             uint32_t state_id = std::stoul(client_order_id);
                             std::lock_guard<std::mutex> lock(orders_mutex_);
-                            orders_.erase(
-                                std::remove_if(
-                                    orders_.begin(),
-                                    orders_.end(),
-                                    [state_id](const OrderInfo& order) {
-                                        return order.state_id == state_id && !order.has_okx_id;
-                                    }
-                                ),
-                                orders_.end()
-                            );
+                            const OrderStore::Handle handle = orders_.findByStateId(state_id);
+                            const OrderInfo* failed = orders_.get(handle);
+                            if (failed && !failed->has_okx_id) {
+                                orders_.erase(handle);
+                            }
                         } catch (const std::exception& e) {
-                            std::cerr << "\033[1;31mError processing failed order state ID: " << e.what() << "\033[0m" << std::endl;
+                            LOG_ERROR("\033[1;31mError processing failed order state ID: {}\033[0m", e.what());
                         }
                     }
                     
-                    std::cerr << "\033[1;31m[" << getCurrentTimestamp() << "] Order placement failed for ID " 
-                              << client_order_id << ": " << error_msg << "\033[0m" << std::endl;
+                    LOG_ERROR("\033[1;31mOrder placement failed for ID {}: {}\033[0m", client_order_id, error_msg);
                     return;
                 }
 
@@ -279,7 +298,7 @@ void OKXWebSocket::handle_message(const std::string& message) {
                             order_id_callback_(state_id, okx_order_id);
                         }
                     } catch (const std::exception& e) {
-                        std::cerr << "\033[1;31mError processing order ID: " << e.what() << "\033[0m" << std::endl;
+                        LOG_ERROR("\033[1;31mError processing order ID: {}\033[0m", e.what());
                     }
                 }
             }
@@ -312,7 +331,7 @@ void OKXWebSocket::handle_message(const std::string& message) {
             }
         }
     } catch (const std::exception& e) {
-        std::cerr << "Error parsing message: " << e.what() << "\nMessage: " << message << std::endl;
+        LOG_ERROR("Error parsing message: {}\nMessage: {}", e.what(), message);
     }
 }
 
@@ -322,61 +341,99 @@ int OKXWebSocket::callback_function(struct lws* wsi,
                                  void* in,
                                  size_t len) {
     if (!instance_) return 0;
+    Link* link = static_cast<Link*>(user);  // The connect info's userdata, null outside client sockets
 
     switch (reason) {
         case LWS_CALLBACK_CLIENT_ESTABLISHED: {
-            std::cout << "WebSocket connection established, authenticating..." << std::endl;
-            instance_->connected_ = true;
-            
-            // Send authentication message immediately after connection
-            std::string auth_message = instance_->generate_auth_message();
-            if (!instance_->send_ws_message(auth_message)) {
-                std::cerr << "Failed to send authentication message" << std::endl;
-                return -1;
-            }
+            if (!link) break;
+            LOG_INFO("WebSocket {} connection established, authenticating...", instance_->role(*link));
+            link->wsi = wsi;
+            link->state = Link::State::LoggingIn;
+            instance_->queue_control(*link, instance_->generate_auth_message());
+            instance_->schedule(link->login_deadline, on_login_timeout, LOGIN_TIMEOUT_MS);
             break;
         }
         case LWS_CALLBACK_CLIENT_RECEIVE: {
-            if (len > 0) {
+            if (link && len > 0) {
                 // Log raw message
-                std::cout << "[" << instance_->getCurrentTimestamp() << "] Raw WS Message Received (" << len << " bytes): "
-                          << std::string(static_cast<char*>(in), len) << std::endl;
+                LOG_DEBUG("Raw WS Message Received ({} bytes): {}", len, std::string_view(static_cast<char*>(in), len));
+                if (len == 4 && std::memcmp(in, "pong", 4) == 0) {
+                    break;  // Keepalive answer
+                }
                 
                 // Process message
-                instance_->handle_message(std::string(static_cast<char*>(in), len));
+                instance_->handle_message(*link, std::string(static_cast<char*>(in), len));
             }
             break;
         }
         case LWS_CALLBACK_CLIENT_CONNECTION_ERROR: {
             std::string error = in ? std::string(static_cast<char*>(in), len) : "Unknown error";
-            std::cerr << "WebSocket connection error: " << error << std::endl;
-            instance_->connection_ = nullptr;
+            LOG_ERROR("WebSocket connection error: {}", error);
+            if (link) instance_->on_link_closed(*link);
             break;
         }
         case LWS_CALLBACK_CLIENT_CLOSED: {
-            std::cerr << "WebSocket connection closed, will retry..." << std::endl;
-            instance_->connection_ = nullptr;
-            instance_->balance_received_ = false;
+            if (!link || link->state == Link::State::Idle) break;  // Also closed by disconnect()
+            LOG_WARN("WebSocket {} connection closed, will retry...", instance_->role(*link));
+            instance_->on_link_closed(*link);
             break;
         }
         case LWS_CALLBACK_WSI_DESTROY: {
-            instance_->connection_ = nullptr;
-            instance_->balance_received_ = false;
+            if (link && link->wsi == wsi) {
+                instance_->on_link_closed(*link);
+            }
+            break;
+        }
+        case LWS_CALLBACK_EVENT_WAIT_CANCELLED: {
+            // Woken by lws_cancel_service from a thread that queued a message
+            if (instance_->connection_ && !instance_->send_queue_.empty()) {
+                lws_callback_on_writable(instance_->connection_);
+            }
             break;
         }
         case LWS_CALLBACK_CLIENT_WRITEABLE: {
-            std::lock_guard<std::mutex> lock(instance_->send_queue_mutex_);
+            if (!link) break;
+            if (link->closing) {
+                return -1;
+            }
+
+            // The session's own login and pings go first
+            if (!link->control.empty()) {
+                const std::string frame = std::move(link->control.front());
+                link->control.erase(link->control.begin());
+                if (frame.size() <= instance_->control_buffer_.size() - LWS_PRE) {
+                    unsigned char* data = instance_->control_buffer_.data() + LWS_PRE;
+                    std::memcpy(data, frame.data(), frame.size());
+                    lws_write(wsi, data, frame.size(), LWS_WRITE_TEXT);
+                } else {
+                    LOG_ERROR("WebSocket control frame of {} bytes too long", frame.size());
+                }
+                if (!link->control.empty() || (wsi == instance_->connection_ && !instance_->send_queue_.empty())) {
+                    lws_callback_on_writable(wsi);
+                }
+                break;
+            }
+            if (wsi != instance_->connection_) break;  // Orders only go out on the primary
+
+            OutboundMessage* msg = instance_->send_queue_.front();
+            if (!msg) break;
+
+            // Send straight from the slot, then log once the message is on the wire. A message
+            // committed after its session ended is dropped: it would go out ahead of the new
+            // session's subscriptions.
+            if (msg->length > 0 && msg->generation != instance_->session_generation_.load()) {
+                LOG_ERROR("Dropped a WebSocket message queued for a lost session");
+            } else if (msg->length > 0) {
+                instance_->write_wait_latency_.recordSince(msg->queued_ns);
+                lws_write(wsi, msg->data(), msg->length, LWS_WRITE_TEXT);
+                instance_->tick_to_send_latency_.recordSince(msg->origin_ns);
+                LOG_DEBUG("Raw WS Message Sent: {}", std::string_view(reinterpret_cast<const char*>(msg->data()), msg->length));
+            }
+            instance_->send_queue_.pop();
+
+            // One frame per callback; ask again while messages are waiting
             if (!instance_->send_queue_.empty()) {
-                std::string msg = instance_->send_queue_.front();
-                instance_->send_queue_.pop();
-                
-                // Log raw outgoing message
-                std::cout << "[" << instance_->getCurrentTimestamp() << "] Raw WS Message Sending: " << msg << std::endl;
-                
-                // Prepare and send the message
-                std::vector<unsigned char> buf(LWS_PRE + msg.length());
-                memcpy(buf.data() + LWS_PRE, msg.c_str(), msg.length());
-                lws_write(wsi, buf.data() + LWS_PRE, msg.length(), LWS_WRITE_TEXT);
+                lws_callback_on_writable(wsi);
             }
             break;
         }
@@ -386,6 +443,149 @@ int OKXWebSocket::callback_function(struct lws* wsi,
     return 0;
 }
 
+void OKXWebSocket::open_link(Link& link) {
+    if (!connected_ || link.state != Link::State::Idle) return;
+
+    struct lws_client_connect_info ccinfo = connect_info_;
+    ccinfo.userdata = &link;
+    link.state = Link::State::Connecting;
+    struct lws* wsi = lws_client_connect_via_info(&ccinfo);
+    if (!wsi) {
+        LOG_ERROR("WebSocket {} connection attempt failed", role(link));
+        on_link_closed(link);  // Nothing left to do if lws already reported the error
+    } else if (link.state == Link::State::Connecting) {
+        link.wsi = wsi;
+    }
+}
+
+void OKXWebSocket::close_link(Link& link) {
+    link.closing = true;
+    if (link.wsi) {
+        lws_callback_on_writable(link.wsi);
+    }
+}
+
+void OKXWebSocket::on_link_closed(Link& link) {
+    if (link.state == Link::State::Idle) return;  // Already handled, e.g. by the close before the destroy
+    const bool was_ready = link.state == Link::State::Ready;
+    link.state = Link::State::Idle;
+    link.wsi = nullptr;
+    link.closing = false;
+    link.control.clear();
+    cancel(link.login_deadline);
+    cancel(link.keepalive);
+    if (!was_ready) {
+        link.failures++;
+    }
+
+    if (&link == primary_) {
+        end_session();
+        connection_ = nullptr;
+        drop_pending_messages();
+        if (was_ready) {
+            dropped_ns_ = latency::nowNanos();
+        }
+
+        // A logged in standby takes over at once; the dropped session reconnects as the standby
+        if (connected_ && standby_enabled_ && standby_->state == Link::State::Ready) {
+            std::swap(primary_, standby_);
+            LOG_WARN("WebSocket primary lost, switching to the standby");
+            start_session();
+        }
+    }
+    schedule_reconnect(link);
+}
+
+void OKXWebSocket::on_login(Link& link, bool success, const std::string& message) {
+    cancel(link.login_deadline);
+    if (!success) {
+        LOG_ERROR("\033[1;31mAuthentication failed: {}\033[0m", message);
+        close_link(link);
+        return;
+    }
+
+    link.state = Link::State::Ready;
+    link.failures = 0;
+    schedule(link.keepalive, on_keepalive, KEEPALIVE_MS);
+    if (&link == primary_) {
+        start_session();
+    } else {
+        LOG_INFO("WebSocket standby logged in");
+    }
+}
+
+void OKXWebSocket::start_session() {
+    // The subscriptions are queued before any order, so no fill of an order goes unreported.
+    // The last balance stays in use until the account channel pushes the current one.
+    connection_ = primary_->wsi;
+    fetch_balance();
+    subscribe_to_orders();
+    subscribe_to_positions();
+    session_ready_ = true;
+
+    if (dropped_ns_ != 0) {
+        LOG_WARN("WebSocket session resumed {:.1f} ms after the primary was lost",
+                 static_cast<double>(latency::nowNanos() - dropped_ns_) / 1e6);
+        dropped_ns_ = 0;
+    }
+}
+
+void OKXWebSocket::end_session() {
+    // Not ready first, so a sender that still sees the session ready read the old generation
+    session_ready_ = false;
+    session_generation_.fetch_add(1);
+}
+
+void OKXWebSocket::queue_control(Link& link, std::string frame) {
+    link.control.push_back(std::move(frame));
+    if (link.wsi) {
+        lws_callback_on_writable(link.wsi);
+    }
+}
+
+void OKXWebSocket::schedule_reconnect(Link& link) {
+    if (!connected_) return;
+    if (&link == primary_ && link.failures >= static_cast<unsigned>(MAX_RETRIES)) {
+        LOG_ERROR("Max retry attempts reached");
+        connected_ = false;
+        lws_cancel_service(context_);  // Let the service loop see it
+        return;
+    }
+
+    const int64_t ceiling = std::min(RECONNECT_MAX_MS, RECONNECT_BASE_MS << std::min(link.failures, 10u));
+    const int64_t delay_ms = std::uniform_int_distribution<int64_t>(ceiling / 2, ceiling)(backoff_rng_);
+    if (link.failures > 0) {
+        LOG_INFO("WebSocket {} reconnecting in {} ms (attempt {})", role(link), delay_ms, link.failures + 1);
+    }
+    schedule(link.reconnect, on_reconnect_due, delay_ms);
+}
+
+void OKXWebSocket::schedule(LinkTimer& timer, sul_cb_t callback, int64_t delay_ms) {
+    lws_sul_schedule(context_, 0, &timer.sul, callback, delay_ms * LWS_US_PER_MS);
+}
+
+void OKXWebSocket::cancel(LinkTimer& timer) {
+    lws_sul_schedule(context_, 0, &timer.sul, nullptr, LWS_SET_TIMER_USEC_CANCEL);
+}
+
+void OKXWebSocket::on_reconnect_due(lws_sorted_usec_list_t* sul) {
+    instance_->open_link(*reinterpret_cast<LinkTimer*>(sul)->link);
+}
+
+void OKXWebSocket::on_login_timeout(lws_sorted_usec_list_t* sul) {
+    Link& link = *reinterpret_cast<LinkTimer*>(sul)->link;
+    if (link.state != Link::State::LoggingIn) return;
+    LOG_WARN("WebSocket {} login unanswered after {} ms, reconnecting", instance_->role(link), LOGIN_TIMEOUT_MS);
+    instance_->close_link(link);
+}
+
+void OKXWebSocket::on_keepalive(lws_sorted_usec_list_t* sul) {
+    Link& link = *reinterpret_cast<LinkTimer*>(sul)->link;
+    if (link.state != Link::State::Ready) return;
+    instance_->queue_control(link, "ping");
+    instance_->schedule(link.keepalive, on_keepalive, KEEPALIVE_MS);
+}
+
 bool OKXWebSocket::connect() {
     struct lws_context_creation_info info;
     memset(&info, 0, sizeof(info));
@@ -407,7 +607,7 @@ bool OKXWebSocket::connect() {
     info.gid = -1;
     info.uid = -1;
     info.options = LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT;
-    info.fd_limit_per_thread = 1 + 1 + 1;
+    info.fd_limit_per_thread = 1 + 1 + 1 + (standby_enabled_ ? 1 : 0);
     info.retry_and_idle_policy = nullptr;
     info.client_ssl_private_key_password = nullptr;
     info.client_ssl_cert_filepath = nullptr;
@@ -416,84 +616,67 @@ bool OKXWebSocket::connect() {
     
     context_ = lws_create_context(&info);
     if (!context_) {
-        std::cerr << "Failed to create WebSocket context" << std::endl;
+        LOG_ERROR("Failed to create WebSocket context");
         return false;
     }
 
-    // Initialize connection info
-    struct lws_client_connect_info ccinfo;
-    memset(&ccinfo, 0, sizeof(ccinfo));
-    ccinfo.context = context_;
-    ccinfo.port = WSS_PORT;
-    ccinfo.address = WSS_HOST;
-    ccinfo.path = WSS_PATH;
-    ccinfo.host = WSS_HOST;
-    ccinfo.origin = WSS_HOST;
-    ccinfo.protocol = WSS_PROTOCOL;
-    ccinfo.ssl_connection = LCCSCF_USE_SSL | LCCSCF_ALLOW_SELFSIGNED | 
-                           LCCSCF_SKIP_SERVER_CERT_HOSTNAME_CHECK |
-                           LCCSCF_ALLOW_EXPIRED;
-    ccinfo.userdata = this;
+    // Initialize connection info, shared by both sessions
+    memset(&connect_info_, 0, sizeof(connect_info_));
+    connect_info_.context = context_;
+    connect_info_.port = WSS_PORT;
+    connect_info_.address = WSS_HOST;
+    connect_info_.path = WSS_PATH;
+    connect_info_.host = WSS_HOST;
+    connect_info_.origin = WSS_HOST;
+    connect_info_.protocol = WSS_PROTOCOL;
+    connect_info_.ssl_connection = LCCSCF_USE_SSL | LCCSCF_ALLOW_SELFSIGNED | 
+                                   LCCSCF_SKIP_SERVER_CERT_HOSTNAME_CHECK |
+                                   LCCSCF_ALLOW_EXPIRED;
     
     // Start WebSocket service thread
     connected_ = true;
-    service_thread_ = std::thread([this, ccinfo]() mutable {
-        int retry_count = 0;
-        auto start_time = std::chrono::steady_clock::now();
-        
-        while (connected_ && retry_count < MAX_RETRIES) {
-            if (!connection_) {
-                connection_ = lws_client_connect_via_info(&ccinfo);
-                if (!connection_) {
-                    retry_count++;
-                    std::this_thread::sleep_for(std::chrono::seconds(2));
-                    continue;
-                }
-            }
-            
-            // Process events continuously
-            lws_service(context_, 0);
-            
-            // Check if we've successfully received the balance
-            if (balance_received_) {
-                if (retry_count > 0) {  // Only print on initial connection or after retry
-                    retry_count = 0;  // Reset retry count on success
-                }
-                start_time = std::chrono::steady_clock::now();
-            } else {
-                // Check if we've been trying too long without success
-                auto current_time = std::chrono::steady_clock::now();
-                auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
-                    current_time - start_time).count();
-                
-                if (elapsed > 5) {  // Reduced timeout to 5 seconds
-                    if (connection_) {
-                        std::string auth_message = generate_auth_message();
-                        send_ws_message(auth_message);
-                    }
-                    start_time = current_time;
-                }
-            }
-            
-            // Small sleep to prevent CPU spinning
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if (busy_poll_) {
+        if (busy_poll_cpu_ >= 0) {
+            LOG_INFO("WebSocket service thread busy-polling on CPU {}", busy_poll_cpu_);
+        } else {
+            LOG_INFO("WebSocket service thread busy-polling");
         }
-        
-        if (retry_count >= MAX_RETRIES) {
-            std::cerr << "Max retry attempts reached" << std::endl;
-            connected_ = false;
+    }
+    if (standby_enabled_) {
+        LOG_INFO("WebSocket standby session enabled");
+    }
+    service_thread_ = std::thread([this]() {
+        logging::setThreadName("ws");
+        open_link(*primary_);
+        if (standby_enabled_) {
+            open_link(*standby_);
+        }
+
+        // Sleep in poll until socket activity, a queued message (lws_cancel_service) or a
+        // reconnect, login or keepalive timer wakes the loop; busy-poll never blocks
+        while (connected_) {
+            lws_service(context_, busy_poll_ ? -1 : 0);
         }
     });
+
+    if (busy_poll_ && busy_poll_cpu_ >= 0) {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(busy_poll_cpu_, &cpuset);
+        int rc = pthread_setaffinity_np(service_thread_.native_handle(), sizeof(cpu_set_t), &cpuset);
+        if (rc != 0) {
+            LOG_ERROR("Failed to pin WebSocket service thread to CPU {}: {}", busy_poll_cpu_, std::strerror(rc));
+        }
+    }
     
     // Wait for initial connection and authentication
-    int wait_seconds = 0;
-    while (!balance_received_ && wait_seconds < 30 && connected_) {  // Wait up to 30 seconds
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-        wait_seconds++;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (!balance_received_ && connected_ && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
     
     if (!balance_received_) {
-        std::cerr << "Failed to establish connection with OKX after " << wait_seconds << " seconds" << std::endl;
+        LOG_ERROR("Failed to establish connection with OKX within 30 seconds");
         disconnect();
         return false;
     }
@@ -509,79 +692,142 @@ bool OKXWebSocket::send_order(uint32_t state_id,
                             double size,
                             double price,
                             double original_volume,
-                            double original_price) {
-    if (!connected_ || !connection_) {
-        std::cerr << "\033[1;31m[ERROR] Cannot send order: WebSocket not connected\033[0m" << std::endl;
+                            double original_price,
+                            uint64_t origin_ns) {
+    const uint64_t generation = session_generation_.load();
+    if (!connected_ || !connection_ || !session_ready_) {
+        LOG_ERROR("\033[1;31mCannot send order: WebSocket not connected\033[0m");
         return false;
     }
+    const uint64_t start_ns = latency::nowNanos();
 
     try {
-        // Store initial order info in deque
-        OrderInfo order;
-        order.state_id = state_id;
-        order.volume = size;  // Store the actual calculated size instead of original_volume
-        order.price = price;
-        order.has_okx_id = false;
-        order.is_filled = false;
-        order.filled_size = 0;
-        order.avg_fill_price = 0;
-        order.side = side;  // Set the side when creating the order
-        order.order_state = "pending";  // Set initial state
-        
-        store_order(order);
-
-        // Create order message with calculated trading values
-        nlohmann::json order_args = {
-            {"instId", inst_id},
-            {"tdMode", td_mode},
-            {"side", side},
-            {"ordType", ord_type},
-            {"sz", std::to_string(size)},
-            {"clOrdId", std::to_string(state_id)}  // Add client order ID
-        };
-
-        // Add price for limit orders
-        if (ord_type == "limit") {
-            order_args["px"] = std::to_string(price);
+        // Serialize the order straight into a send slot, the state ID doubling as request
+        // and client order ID (price only for limit orders)
+        size_t ticket;
+        OutboundMessage* slot = send_queue_.tryAcquire(ticket);
+        if (!slot) {
+            LOG_ERROR("\033[1;31mSend queue full, dropping order {}\033[0m", state_id);
+            return false;
+        }
+        const unsigned id = static_cast<unsigned>(state_id);
+        char* out = reinterpret_cast<char*>(slot->data());
+        const int length = ord_type == "limit"
+            ? std::snprintf(out, OutboundMessage::MAX_SIZE, LIMIT_ORDER_TEMPLATE, id, inst_id.c_str(),
+                            td_mode.c_str(), side.c_str(), ord_type.c_str(), size, id, price)
+            : std::snprintf(out, OutboundMessage::MAX_SIZE, ORDER_TEMPLATE, id, inst_id.c_str(),
+                            td_mode.c_str(), side.c_str(), ord_type.c_str(), size, id);
+        const bool fits = length > 0 && static_cast<size_t>(length) < OutboundMessage::MAX_SIZE;
+        slot->length = fits ? static_cast<size_t>(length) : 0;  // A claimed slot must be committed
+        slot->origin_ns = origin_ns;
+        slot->generation = generation;
+        if (!fits) {
+            commit_ws_message(slot, ticket);
+            LOG_ERROR("\033[1;31mOrder message for {} too long\033[0m", state_id);
+            return false;
         }
 
-        nlohmann::json order_message = {
-            {"id", std::to_string(state_id)},  // Use state_id as the request ID
-            {"op", "order"},
-            {"args", {order_args}}
-        };
+        // Track the order only once it is sent, and before its ack can arrive
+        try {
+            OrderInfo order;
+            order.state_id = state_id;
+            order.volume = size;  // Store the actual calculated size instead of original_volume
+            order.price = price;
+            order.has_okx_id = false;
+            order.is_filled = false;
+            order.filled_size = 0;
+            order.avg_fill_price = 0;
+            order.side = side;  // Set the side when creating the order
+            order.order_state = "pending";  // Set initial state
+
+            store_order(order);
+        } catch (...) {
+            slot->length = 0;
+            commit_ws_message(slot, ticket);
+            throw;
+        }
+        commit_ws_message(slot, ticket);
 
-        // Send the order message
-        std::string message = order_message.dump();
-        bool send_result = send_ws_message(message);
-        
-        return send_result;
+        const uint64_t queued_ns = latency::nowNanos();
+        send_order_latency_.record(queued_ns - start_ns);
+        {
+            std::lock_guard<std::mutex> lock(pending_acks_mutex_);
+            pending_acks_[state_id] = PendingAck{queued_ns, origin_ns};
+        }
+        return true;
 
     } catch (const std::exception& e) {
-        std::cerr << "\033[1;31m[ERROR] Exception while sending order: " << e.what() << "\033[0m" << std::endl;
+        LOG_ERROR("\033[1;31mException while sending order: {}\033[0m", e.what());
         return false;
     }
 }
 
-bool OKXWebSocket::send_ws_message(const std::string& message) {
+bool OKXWebSocket::send_ws_message(const std::string& message, uint64_t origin_ns) {
+    const uint64_t generation = session_generation_.load();
     if (!connected_ || !connection_) {
         return false;
     }
+    if (message.size() > OutboundMessage::MAX_SIZE) {
+        LOG_ERROR("WebSocket message of {} bytes exceeds the send slot", message.size());
+        return false;
+    }
 
-    // Log raw message being queued
-    std::cout << "[" << getCurrentTimestamp() << "] Raw WS Message Queued: " << message << std::endl;
-    
-    {
-        std::lock_guard<std::mutex> lock(send_queue_mutex_);
-        send_queue_.push(message);
+    size_t ticket;
+    OutboundMessage* slot = send_queue_.tryAcquire(ticket);
+    if (!slot) {
+        LOG_ERROR("WebSocket send queue full, dropping message: {}", message);
+        return false;
     }
-    lws_callback_on_writable(connection_);
+    std::memcpy(slot->data(), message.data(), message.size());
+    slot->length = message.size();
+    slot->origin_ns = origin_ns;
+    slot->generation = generation;
+    commit_ws_message(slot, ticket);
     return true;
 }
 
+void OKXWebSocket::commit_ws_message(OutboundMessage* slot, size_t ticket) {
+    // lws_callback_on_writable must run on the service thread, which lws_cancel_service wakes
+    // from any thread
+    slot->queued_ns = latency::nowNanos();
+    send_queue_.commit(ticket);
+    if (context_) {
+        lws_cancel_service(context_);
+    }
+}
+
+void OKXWebSocket::drop_pending_messages() {
+    // Messages for a connection that is gone; the next one logs in before anything else
+    size_t dropped = 0;
+    while (OutboundMessage* msg = send_queue_.front()) {
+        if (msg->length > 0) ++dropped;
+        send_queue_.pop();
+    }
+    if (dropped > 0) {
+        LOG_ERROR("Dropped {} unsent WebSocket messages", dropped);
+    }
+}
+
+void OKXWebSocket::record_order_ack(const std::string& client_order_id) {
+    if (client_order_id.empty()) return;
+    PendingAck pending;
+    try {
+        const uint32_t state_id = std::stoul(client_order_id);
+        std::lock_guard<std::mutex> lock(pending_acks_mutex_);
+        auto it = pending_acks_.find(state_id);
+        if (it == pending_acks_.end()) return;
+        pending = it->second;
+        pending_acks_.erase(it);
+    } catch (const std::exception&) {
+        return;  // Not one of our state IDs
+    }
+    order_ack_latency_.recordSince(pending.sent_ns);
+    tick_to_ack_latency_.recordSince(pending.origin_ns);
+}
+
 bool OKXWebSocket::subscribe_to_orders() {
     if (!connected_ || !connection_) {
-        std::cerr << "WebSocket not connected" << std::endl;
+        LOG_ERROR("WebSocket not connected");
         return false;
     }
 
@@ -591,7 +837,7 @@ bool OKXWebSocket::subscribe_to_orders() {
             {
                 {"channel", "orders"},
                 {"instType", "SWAP"},
-                {"instId", "BTC-USDT-SWAP"}
+                {"instId", inst_id_}
             }
         }}
     };
@@ -602,7 +848,7 @@ bool OKXWebSocket::subscribe_to_orders() {
 
 bool OKXWebSocket::subscribe_to_positions() {
     if (!connected_ || !connection_) {
-        std::cerr << "WebSocket not connected" << std::endl;
+        LOG_ERROR("WebSocket not connected");
         return false;
     }
 
@@ -612,7 +858,7 @@ bool OKXWebSocket::subscribe_to_positions() {
             {
                 {"channel", "positions"},
                 {"instType", "SWAP"},
-                {"instId", "BTC-USDT-SWAP"}
+                {"instId", inst_id_}
             }
         }}
     };
@@ -645,22 +891,19 @@ void OKXWebSocket::handle_order_update(const std::string& message) {
                         timestamp = std::stoll(data["cTime"].get<std::string>());
                     } else {
                         timestamp = get_current_timestamp_ms();
-                        std::cerr << "Warning: No valid timestamp found in order update, using current time" << std::endl;
+                        LOG_WARN("No valid timestamp found in order update, using current time");
                     }
                 } catch (const std::exception& e) {
                     timestamp = get_current_timestamp_ms();
-                    std::cerr << "Warning: Failed to convert timestamp: " << e.what() << ", using current time" << std::endl;
+                    LOG_WARN("Failed to convert timestamp: {}, using current time", e.what());
                 }
 
                 // Find previous accumulated fill size
                 double prev_acc_filled_size = 0.0;
                 {
                     std::lock_guard<std::mutex> lock(orders_mutex_);
-                    for (const auto& order : orders_) {
-                        if (order.okx_order_id == okx_order_id) {
-                            prev_acc_filled_size = order.cumulative_filled_size;  // Track cumulative fills
-                            break;
-                        }
+                    if (const OrderInfo* order = orders_.get(orders_.findByOkxId(okx_order_id))) {
+                        prev_acc_filled_size = order->cumulative_filled_size;  // Track cumulative fills
                     }
                 }
 
@@ -677,30 +920,36 @@ void OKXWebSocket::handle_order_update(const std::string& message) {
                         side,
                         state,
                         pnl,
-                        timestamp,
-                        data
+                        timestamp
                     };
                     update.fill_delta = fill_delta;  // Store the actual fill delta
+                    try {
+                        if (data.contains("fillSz") && !data["fillSz"].get<std::string>().empty()) {
+                            update.fill_size = std::stod(data["fillSz"].get<std::string>());
+                        }
+                    } catch (const std::exception&) {
+                        // Without it the update is released at the window cap
+                    }
                     
                     // Add to buffer
                     add_to_buffer(update);
                 }
 
             } catch (const std::exception& e) {
-                std::cerr << "Error processing order: " << e.what() << "\nData: " << data.dump() << std::endl;
+                LOG_ERROR("Error processing order: {}\nData: {}", e.what(), data.dump());
                 continue;
             }
         }
 
     } catch (const std::exception& e) {
-        std::cerr << "Error handling order update: " << e.what() << "\nMessage: " << message << std::endl;
+        LOG_ERROR("Error handling order update: {}\nMessage: {}", e.what(), message);
     }
 }
 
 void OKXWebSocket::handle_position_update(const nlohmann::json& data) {
     try {
         for (const auto& position : data) {
-            if (position.contains("instId") && position["instId"] == "BTC-USDT-SWAP") {
+            if (position.contains("instId") && position["instId"] == inst_id_) {
                 // Extract uplRatio and convert to double with robust error handling
                 if (position.contains("uplRatio")) {
                     try {
@@ -723,14 +972,14 @@ void OKXWebSocket::handle_position_update(const nlohmann::json& data) {
                         }
                     } catch (const std::exception& e) {
                         // Log the error but continue processing
-                        std::cerr << "Error converting uplRatio: " << e.what() 
-                                  << ", Value: " << position["uplRatio"].dump() << std::endl;
+                        LOG_ERROR("Error converting uplRatio: {}, Value: {}", e.what(),
+                                  position["uplRatio"].dump());
                     }
                 }
             }
         }
     } catch (const std::exception& e) {
-        std::cerr << "Error handling position update: " << e.what() << std::endl;
+        LOG_ERROR("Error handling position update: {}", e.what());
     }
 }
 
@@ -750,17 +999,22 @@ void OKXWebSocket::store_order(const OrderInfo& order) {
         new_order.execution_percentage = (new_order.volume > 0) ? (new_order.filled_size / new_order.volume) : 0.0;
     }
     
-    orders_.push_back(new_order);
+    orders_.insert(new_order);
 
     // If we exceed 300 orders, move oldest orders to cancellation queue
-    if (orders_.size() > 300) {
-        while (orders_.size() > 300) {
-            // Only move to cancellation queue if the order has an OKX ID and isn't already filled
-            if (orders_.front().has_okx_id && !orders_.front().is_filled) {
-                move_to_old_orders(orders_.front());
-            }
-            orders_.pop_front();  // Remove oldest order after potentially moving to cancellation
+    trim_orders();
+}
+
+void OKXWebSocket::trim_orders() {
+    // Note: orders_mutex_ should already be locked when this is called
+    while (orders_.size() > MAX_ACTIVE_ORDERS) {
+        const OrderStore::Handle oldest = orders_.oldest();
+        const OrderInfo& order = *orders_.get(oldest);
+        // Only move to cancellation queue if the order has an OKX ID and isn't already filled
+        if (order.has_okx_id && !order.is_filled) {
+            move_to_old_orders(order);
         }
+        orders_.erase(oldest);  // Remove oldest order after potentially moving to cancellation
     }
 }
 
@@ -800,7 +1054,7 @@ bool OKXWebSocket::send_cancel_order(const std::string& okx_order_id) {
             {"id", std::to_string(std::time(nullptr))},  // Use timestamp as unique ID
             {"op", "cancel-order"},
             {"args", {{
-                {"instId", "BTC-USDT-SWAP"},
+                {"instId", inst_id_},
                 {"ordId", okx_order_id}
             }}}
         };
@@ -809,7 +1063,7 @@ bool OKXWebSocket::send_cancel_order(const std::string& okx_order_id) {
         return send_ws_message(message);
 
     } catch (const std::exception& e) {
-        std::cerr << "Error creating cancel order message: " << e.what() << std::endl;
+        LOG_ERROR("Error creating cancel order message: {}", e.what());
         return false;
     }
 }
@@ -827,22 +1081,12 @@ void OKXWebSocket::cleanup_orders() {
     std::lock_guard<std::mutex> lock(orders_mutex_);
     
     // Only remove filled orders that have been processed (execution update sent)
-    auto it = orders_.begin();
-    while (it != orders_.end()) {
-        if (it->is_filled && it->execution_percentage > 0.0) {  // Only remove if execution % was calculated
-            it = orders_.erase(it);
-        } else {
-            ++it;
-        }
-    }
+    orders_.eraseIf([](const OrderInfo& order) {
+        return order.is_filled && order.execution_percentage > 0.0;  // Only remove if execution % was calculated
+    });
     
-    // Limit deque size to 300 by removing oldest orders if necessary
-    while (orders_.size() > 300) {
-        if (orders_.front().has_okx_id && !orders_.front().is_filled) {
-            move_to_old_orders(orders_.front());
-        }
-        orders_.pop_front();
-    }
+    // Limit the store to 300 orders by removing the oldest if necessary
+    trim_orders();
 }
 
 void OKXWebSocket::handle_cancel_response(const nlohmann::json& j) {
@@ -869,19 +1113,18 @@ void OKXWebSocket::handle_cancel_response(const nlohmann::json& j) {
             }
         }
     } catch (const std::exception& e) {
-        std::cerr << "Error handling cancel response: " << e.what() << std::endl;
+        LOG_ERROR("Error handling cancel response: {}", e.what());
     }
 }
 
 void OKXWebSocket::update_order_id(uint32_t state_id, const std::string& okx_order_id, bool has_okx_id) {
     std::lock_guard<std::mutex> lock(orders_mutex_);
-    for (auto& order : orders_) {
-        if (order.state_id == state_id && !order.has_okx_id) {
-            order.okx_order_id = okx_order_id;
-            order.has_okx_id = has_okx_id;
-            order.order_state = "live";  // Set initial state to live when we get OKX ID
-            break;
-        }
+    const OrderStore::Handle handle = orders_.findByStateId(state_id);
+    OrderInfo* order = orders_.get(handle);
+    if (order && !order->has_okx_id) {
+        orders_.setOkxId(handle, okx_order_id);
+        order->has_okx_id = has_okx_id;
+        order->order_state = "live";  // Set initial state to live when we get OKX ID
     }
 }
 
@@ -889,96 +1132,86 @@ void OKXWebSocket::update_order_fill(const std::string& okx_order_id,
                                    double filled_size, 
                                    double avg_price,
                                    const std::string& side,
-                                   const std::string& state) {
+                                   const std::string& state,
+                                   int64_t fill_time) {
     std::lock_guard<std::mutex> lock(orders_mutex_);
-    for (auto& order : orders_) {
-        if (order.okx_order_id == okx_order_id) {
-            // Store previous values for comparison
-            double prev_cumulative_filled = order.cumulative_filled_size;
+    const OrderStore::Handle handle = orders_.findByOkxId(okx_order_id);
+    OrderInfo* found = orders_.get(handle);
+    if (!found) return;
+    OrderInfo& order = *found;
+
+    // Store previous values for comparison
+    double prev_cumulative_filled = order.cumulative_filled_size;
+    
+    // If order is filled, use the original volume as the filled size
+    if (state == "filled") {
+        filled_size = order.volume;
+    }
+    
+    // Calculate fill delta (new fills since last update)
+    double fill_delta = filled_size - prev_cumulative_filled;
+    
+    // Only update if we have new fills
+    if (fill_delta > 0) {
+        // Update order fields atomically
+        order.filled_size = fill_delta;  // Store this fill's size
+        order.cumulative_filled_size = filled_size;  // Update cumulative filled size
+        order.avg_fill_price = avg_price;
+        order.order_state = state;
+        order.side = side;
+        orders_.setFillTime(handle, fill_time);  // Re-keys the order in the fill-time index
+        
+        // Only add new fill portion if we have a real fill
+        if (fill_delta > 0) {
+            OrderInfo::FillPortion new_portion;
+            new_portion.tradeId = order.tradeId;
+            new_portion.size = fill_delta;  // Use the actual fill delta
+            new_portion.price = avg_price;
+            new_portion.timestamp = order.fill_time;
             
-            // If order is filled, use the original volume as the filled size
-            if (state == "filled") {
-                filled_size = order.volume;
+            // Check if this exact fill portion already exists
+            bool duplicate = false;
+            for (const auto& existing : order.fill_portions) {
+                if (existing.size == new_portion.size && 
+                    existing.price == new_portion.price &&
+                    existing.timestamp == new_portion.timestamp) {
+                    duplicate = true;
+                    break;
+                }
             }
             
-            // Calculate fill delta (new fills since last update)
-            double fill_delta = filled_size - prev_cumulative_filled;
-            
-            // Only update if we have new fills
-            if (fill_delta > 0) {
-                // Update order fields atomically
-                order.filled_size = fill_delta;  // Store this fill's size
-                order.cumulative_filled_size = filled_size;  // Update cumulative filled size
-                order.avg_fill_price = avg_price;
-                order.order_state = state;
-                order.side = side;
-                
-                // Only add new fill portion if we have a real fill
-                if (fill_delta > 0) {
-                    OrderInfo::FillPortion new_portion;
-                    new_portion.tradeId = order.tradeId;
-                    new_portion.size = fill_delta;  // Use the actual fill delta
-                    new_portion.price = avg_price;
-                    new_portion.timestamp = order.fill_time;
-                    
-                    // Check if this exact fill portion already exists
-                    bool duplicate = false;
-                    for (const auto& existing : order.fill_portions) {
-                        if (existing.size == new_portion.size && 
-                            existing.price == new_portion.price &&
-                            existing.timestamp == new_portion.timestamp) {
-                            duplicate = true;
-                            break;
-                        }
-                    }
-                    
-                    if (!duplicate) {
-                        order.fill_portions.push_back(new_portion);
-                    }
-                }
-                
-                // Update execution percentage based on state first
-                if (state == "filled") {
-                    order.execution_percentage = 1.0;  // If order is filled, it's 100%
-                    order.is_filled = true;
-                } else {
-                    // Calculate execution percentage based on filled size and original volume
-                    // Make sure we have valid volume
-                    if (order.volume > 0) {
-                        order.execution_percentage = order.cumulative_filled_size / order.volume;
-                    } else {
-                        // If volume is 0, use filled size to determine if filled
-                        order.execution_percentage = order.cumulative_filled_size > 0 ? 1.0 : 0.0;
-                    }
-                    order.is_filled = (order.execution_percentage >= 1.0);
-                }
-                
-                std::cout << "[" << getCurrentTimestamp() << "] Updated order fill: "
-                          << "OKX ID=" << okx_order_id
-                          << " State ID=" << order.state_id
-                          << " Side=" << order.side
-                          << " Filled=" << order.cumulative_filled_size
-                          << "/" << order.volume
-                          << " (+" << fill_delta << " new)"
-                          << " (" << std::fixed << std::setprecision(2) << order.execution_percentage * 100.0 << "%)"
-                          << " State=" << state 
-                          << " Volume=" << order.volume << std::endl;
+            if (!duplicate) {
+                order.fill_portions.push_back(new_portion);
             }
-            break;
         }
+        
+        // Update execution percentage based on state first
+        if (state == "filled") {
+            order.execution_percentage = 1.0;  // If order is filled, it's 100%
+            order.is_filled = true;
+        } else {
+            // Calculate execution percentage based on filled size and original volume
+            // Make sure we have valid volume
+            if (order.volume > 0) {
+                order.execution_percentage = order.cumulative_filled_size / order.volume;
+            } else {
+                // If volume is 0, use filled size to determine if filled
+                order.execution_percentage = order.cumulative_filled_size > 0 ? 1.0 : 0.0;
+            }
+            order.is_filled = (order.execution_percentage >= 1.0);
+        }
+        
+        LOG_INFO("Updated order fill: OKX ID={} State ID={} Side={} Filled={}/{} (+{} new) ({:.2f}%) State={} Volume={:.2f}",
+                 okx_order_id, order.state_id, order.side, order.cumulative_filled_size, order.volume, fill_delta,
+                 order.execution_percentage * 100.0, state, order.volume);
     }
 }
 
 void OKXWebSocket::remove_filled_order(const std::string& okx_order_id) {
     // Note: orders_mutex_ should already be locked when this is called
-    orders_.erase(
-        std::remove_if(
-            orders_.begin(), 
-            orders_.end(),
-            [&okx_order_id](const OrderInfo& order) {
-                return order.okx_order_id == okx_order_id && order.is_filled;
-            }
-        ),
-        orders_.end()
-    );
+    const OrderStore::Handle handle = orders_.findByOkxId(okx_order_id);
+    const OrderInfo* order = orders_.get(handle);
+    if (order && order->is_filled) {
+        orders_.erase(handle);
+    }
 } 
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "../include/oms_handler.hpp"
 #include <binary_utils.hpp>
+#include <async_logger.hpp>
 #include <stdexcept>
 #include <thread>
 #include <nlohmann/json.hpp>
@@ -9,11 +10,18 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                      const std::string& okx_api_key,
                      const std::string& okx_secret_key,
                      const std::string& okx_passphrase)
+    : OMSHandler(host, port, username, password,
+                 std::make_unique<OKXWebSocket>(okx_api_key, okx_secret_key, okx_passphrase)) {}
+
+OMSHandler::OMSHandler(const std::string& host, int port,
+                     const std::string& username, const std::string& password,
+                     std::unique_ptr<OKXWebSocket> exchange)
     : host_(host), port_(port), username_(username), password_(password),
-      is_running_(false), conn_(nullptr), socket_(nullptr) {
-    
-    // Initialize OKX WebSocket client
-    okx_ws_ = std::make_unique<OKXWebSocket>(okx_api_key, okx_secret_key, okx_passphrase);
+      is_running_(false), conn_(nullptr), socket_(nullptr), okx_ws_(std::move(exchange)) {
+    simulated_ = dynamic_cast<SimulatedExchange*>(okx_ws_.get());
+    action_queue_ = "oms_action_queue." + instrument();
+    action_routing_key_ = "oms.action." + instrument();
+    execution_routing_key_ = "execution.update." + instrument();
     
     // Initialize position size handler
     pos_size_handler_ = std::make_unique<PosSizeHandler>(20.0);  // 20% margin limit
@@ -26,10 +34,10 @@ OMSHandler::OMSHandler(const std::string& host, int port,
     current_trade_.cumulative_reward = 0.0;
     current_trade_.total_size = 0.0;
 
-    // Set up the order ID callback for deque management
+    // Set up the order ID callback for order store management
     okx_ws_->set_order_id_callback([this](uint32_t state_id, const std::string& okx_order_id) {
         okx_ws_->update_order_id(state_id, okx_order_id, true);
-        std::cout << "Updated order ID for state " << state_id << ": " << okx_order_id << std::endl;
+        LOG_INFO("Updated order ID for state {}: {}", state_id, okx_order_id);
         known_orders_[okx_order_id] = state_id;
     });
 
@@ -41,14 +49,14 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                                           const std::string& state,
                                           double pnl,
                                           int64_t fill_time) {
-        std::cout << "\n[DEBUG] ========== Order Fill Callback Start ==========\n"
-                  << "OKX Order ID: " << okx_order_id << "\n"
-                  << "Filled Size: " << filled_size << "\n"
-                  << "Avg Price: " << avg_price << "\n"
-                  << "Side: " << side << "\n"
-                  << "State: " << state << "\n"
-                  << "PnL: " << pnl << "\n"
-                  << "Fill Time: " << fill_time << std::endl;
+        LOG_DEBUG_STREAM << "========== Order Fill Callback Start ==========\n"
+                         << "OKX Order ID: " << okx_order_id << "\n"
+                         << "Filled Size: " << filled_size << "\n"
+                         << "Avg Price: " << avg_price << "\n"
+                         << "Side: " << side << "\n"
+                         << "State: " << state << "\n"
+                         << "PnL: " << pnl << "\n"
+                         << "Fill Time: " << fill_time;
 
         // First check if this order exists in our tracking
         bool order_exists = false;
@@ -62,23 +70,17 @@ OMSHandler::OMSHandler(const std::string& host, int port,
             if (known_it != known_orders_.end()) {
                 order_exists = true;
                 state_id = known_it->second;
-                std::cout << "[DEBUG] Found order in known_orders_ map with state ID: " << state_id 
-                          << " (may be in cancellation queue)" << std::endl;
+                LOG_DEBUG_STREAM << "Found order in known_orders_ map with state ID: " << state_id 
+                                 << " (may be in cancellation queue)";
                 
                 // If order was in cancellation queue but got filled, we need to handle it
-                bool in_active_deque = false;
-                for (const auto& order : okx_ws_->orders_) {
-                    if (order.okx_order_id == okx_order_id) {
-                        in_active_deque = true;
-                        break;
-                    }
-                }
+                const bool in_active_store = okx_ws_->orders_.findByOkxId(okx_order_id) != OrderStore::NONE;
                 
-                if (!in_active_deque && filled_size > 0) {
-                    std::cout << "[INFO] Order " << okx_order_id << " was in cancellation queue but got filled. "
-                              << "Moving back to active tracking." << std::endl;
+                if (!in_active_store && filled_size > 0) {
+                    LOG_INFO("Order {} was in cancellation queue but got filled. Moving back to active tracking.",
+                             okx_order_id);
                     
-                    // Create new order info and add back to deque
+                    // Create new order info and add it back to the store
                     OrderInfo recovered_order;
                     recovered_order.state_id = state_id;
                     recovered_order.okx_order_id = okx_order_id;
@@ -93,78 +95,66 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                     recovered_order.execution_percentage = 1.0;  // Assume full execution for recovered orders
                     recovered_order.fill_time = fill_time;  // Track fill timestamp for execution sequence
                     
-                    // Sort orders by fill time to maintain execution sequence
-                    okx_ws_->orders_.push_back(recovered_order);
-                    std::sort(okx_ws_->orders_.begin(), okx_ws_->orders_.end(),
-                             [](const OrderInfo& a, const OrderInfo& b) {
-                                 return a.fill_time < b.fill_time;
-                             });
+                    // The store's fill-time index keeps the execution sequence
+                    okx_ws_->orders_.insert(recovered_order);
                     
-                    std::cout << "[DEBUG] Recovered order details:\n"
-                              << "  Volume: " << recovered_order.volume << "\n"
-                              << "  Price: " << recovered_order.price << "\n"
-                              << "  Filled Size: " << recovered_order.filled_size << "\n"
-                              << "  Fill Time: " << recovered_order.fill_time << "\n"
-                              << "  Execution %: " << (recovered_order.execution_percentage * 100.0) << "%" << std::endl;
+                    LOG_DEBUG_STREAM << "Recovered order details:\n"
+                                     << "  Volume: " << recovered_order.volume << "\n"
+                                     << "  Price: " << recovered_order.price << "\n"
+                                     << "  Filled Size: " << recovered_order.filled_size << "\n"
+                                     << "  Fill Time: " << recovered_order.fill_time << "\n"
+                                     << "  Execution %: " << (recovered_order.execution_percentage * 100.0) << "%";
                 }
             }
             
-            // If not found in known_orders_, check the deque
+            // If not found in known_orders_, check the active orders
             if (!order_exists) {
-                std::cout << "[DEBUG] Current orders in deque:" << std::endl;
-                for (const auto& order : okx_ws_->orders_) {
-                    std::cout << "  - Order ID: " << order.okx_order_id 
-                              << ", State ID: " << order.state_id 
-                              << ", State: " << order.order_state 
-                              << ", Has OKX ID: " << (order.has_okx_id ? "Yes" : "No") << std::endl;
-                    if (order.okx_order_id == okx_order_id) {
-                        order_exists = true;
-                        state_id = order.state_id;
-                        known_orders_[okx_order_id] = state_id;  // Add to known orders
-                        std::cout << "[DEBUG] Found order in deque with state ID: " << state_id << std::endl;
-                        break;
-                    }
+                if (const OrderInfo* order = okx_ws_->orders_.get(okx_ws_->orders_.findByOkxId(okx_order_id))) {
+                    order_exists = true;
+                    state_id = order->state_id;
+                    known_orders_[okx_order_id] = state_id;  // Add to known orders
+                    LOG_DEBUG_STREAM << "Found order in store with state ID: " << state_id;
+                } else {
+                    LOG_DEBUG_STREAM << "No active order with ID " << okx_order_id << " among "
+                                     << okx_ws_->orders_.size();
                 }
             }
         }
 
         // If we don't know about this order at all, ignore it
         if (!order_exists) {
-            std::cout << "[WARNING] Order " << okx_order_id << " not found in tracking. This fill will be ignored." << std::endl;
+            LOG_WARN("Order {} not found in tracking. This fill will be ignored.", okx_order_id);
             return;
         }
 
-        // Update order in deque
-        okx_ws_->update_order_fill(okx_order_id, filled_size, avg_price, side, state);
+        // Update order in the store
+        okx_ws_->update_order_fill(okx_order_id, filled_size, avg_price, side, state, fill_time);
 
-        // Get order details from deque
+        // Get order details from the store
         bool was_partially_filled = false;
         double intended_volume = 0.0;
         double intended_price = 0.0;
         {
             std::lock_guard<std::mutex> lock(okx_ws_->orders_mutex_);
-            for (const auto& order : okx_ws_->orders_) {
-                if (order.okx_order_id == okx_order_id) {
-                    was_partially_filled = (order.order_state == "partially_filled");
-                    intended_volume = order.volume;
-                    intended_price = order.price;
-                    break;
-                }
+            if (const OrderInfo* order = okx_ws_->orders_.get(okx_ws_->orders_.findByOkxId(okx_order_id))) {
+                was_partially_filled = (order->order_state == "partially_filled");
+                intended_volume = order->volume;
+                intended_price = order->price;
             }
         }
 
-        std::cout << "[DEBUG] Order Details from Deque:\n"
-                  << "Was Partially Filled: " << (was_partially_filled ? "Yes" : "No") << "\n"
-                  << "Intended Volume: " << intended_volume << "\n"
-                  << "Intended Price: " << intended_price << std::endl;
+        LOG_DEBUG_STREAM << "Order Details from Store:\n"
+                         << "Was Partially Filled: " << (was_partially_filled ? "Yes" : "No") << "\n"
+                         << "Intended Volume: " << intended_volume << "\n"
+                         << "Intended Price: " << intended_price;
 
-        std::cout << "[DEBUG] Current Orders in Trade:" << std::endl;
+        LOG_DEBUG("Current Orders in Trade:");
         for (const auto& order : current_trade_.orders) {
-            std::cout << "  Order ID: " << order.okx_order_id 
-                      << ", State ID: " << order.state_id
-                      << ", Filled Size: " << order.filled_size
-                      << ", Is Filled: " << (order.is_filled ? "Yes" : "No")
-                      << ", Order State: " << order.order_state << std::endl;
+            LOG_DEBUG_STREAM << "  Order ID: " << order.okx_order_id 
+                             << ", State ID: " << order.state_id
+                             << ", Filled Size: " << order.filled_size
+                             << ", Is Filled: " << (order.is_filled ? "Yes" : "No")
+                             << ", Order State: " << order.order_state;
         }
 
         bool need_balance_update = false;
@@ -214,19 +204,18 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                 // Only publish after adding to trade struct
                 publishTradeUpdate(state_id, okx_order_id);
                 
-                std::cout << "[" << getCurrentTimestamp() << "] New trade opened: " 
-                          << (current_trade_.is_long ? "LONG" : "SHORT") 
-                          << " Size: " << current_trade_.size << std::endl;
+                LOG_INFO("New trade opened: {} Size: {}", current_trade_.is_long ? "LONG" : "SHORT",
+                         current_trade_.size);
                 need_balance_update = true;
             }
         } else {
             bool is_same_direction = (current_trade_.is_long && side == "buy") || 
                                    (!current_trade_.is_long && side == "sell");
             
-            std::cout << "[DEBUG] Processing order for existing trade:\n"
-                      << "  Trade ID: " << current_trade_.tradeId << "\n"
-                      << "  Order ID: " << okx_order_id << "\n"
-                      << "  Is Same Direction: " << (is_same_direction ? "Yes" : "No") << std::endl;
+            LOG_DEBUG_STREAM << "Processing order for existing trade:\n"
+                             << "  Trade ID: " << current_trade_.tradeId << "\n"
+                             << "  Order ID: " << okx_order_id << "\n"
+                             << "  Is Same Direction: " << (is_same_direction ? "Yes" : "No");
             
             if (is_same_direction) {
                 // Find previous filled size for this order
@@ -247,20 +236,20 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                     previous_size + fill_delta : 
                     -(std::abs(previous_size) + fill_delta);  // Ensure proper sign for SHORT
                 
-                std::cout << "[DEBUG] Processing Same Direction Order\n"
-                          << "Previous Filled Size Found: " << previous_filled_size << "\n"
-                          << "Current Filled Size: " << filled_size << "\n"
-                          << "Calculated Fill Delta: " << fill_delta << std::endl;
+                LOG_DEBUG_STREAM << "Processing Same Direction Order\n"
+                                 << "Previous Filled Size Found: " << previous_filled_size << "\n"
+                                 << "Current Filled Size: " << filled_size << "\n"
+                                 << "Calculated Fill Delta: " << fill_delta;
                 
                 // Add or update order in trade struct first
                 bool order_found = false;
                 for (auto& order : current_trade_.orders) {
                     if (order.okx_order_id == okx_order_id) {
-                        std::cout << "[DEBUG] Updating existing order in trade:\n"
-                                  << "  Trade ID: " << order.tradeId << "\n"
-                                  << "  Order ID: " << order.okx_order_id << "\n"
-                                  << "  Previous Fill: " << order.filled_size << "\n"
-                                  << "  New Fill: " << filled_size << std::endl;
+                        LOG_DEBUG_STREAM << "Updating existing order in trade:\n"
+                                         << "  Trade ID: " << order.tradeId << "\n"
+                                         << "  Order ID: " << order.okx_order_id << "\n"
+                                         << "  Previous Fill: " << order.filled_size << "\n"
+                                         << "  New Fill: " << filled_size;
                         
                         // If this is the first fill for this order, add the initial portion
                         if (order.fill_portions.empty() && previous_filled_size > 0) {
@@ -296,15 +285,15 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                             order.is_filled = false;
                         }
                         
-                        std::cout << "[DEBUG] After update:\n"
-                                  << "  Filled Size: " << order.filled_size
-                                  << ", State: " << order.order_state
-                                  << ", Execution %: " << order.execution_percentage
-                                  << "\n  Fill Portions:" << std::endl;
+                        LOG_DEBUG_STREAM << "After update:\n"
+                                         << "  Filled Size: " << order.filled_size
+                                         << ", State: " << order.order_state
+                                         << ", Execution %: " << order.execution_percentage
+                                         << "\n  Fill Portions:";
                         for (const auto& portion : order.fill_portions) {
-                            std::cout << "    Trade ID: " << portion.tradeId
-                                      << ", Size: " << portion.size
-                                      << ", Price: " << portion.price << std::endl;
+                            LOG_DEBUG_STREAM << "    Trade ID: " << portion.tradeId
+                                             << ", Size: " << portion.size
+                                             << ", Price: " << portion.price;
                         }
                         order_found = true;
                         break;
@@ -335,32 +324,32 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                     new_portion.is_closing = false;  // Same direction orders are never closing
                     order.fill_portions.push_back(new_portion);
                     
-                    std::cout << "[DEBUG] Adding new order to trade struct:\n"
-                              << "  Trade ID: " << order.tradeId << "\n"
-                              << "  Order ID: " << order.okx_order_id << "\n"
-                              << "  State ID: " << order.state_id << "\n"
-                              << "  Side: " << order.side << "\n"
-                              << "  Filled Size: " << order.filled_size << "\n"
-                              << "  Price: " << order.price << "\n"
-                              << "  Fill Portions:" << std::endl;
+                    LOG_DEBUG_STREAM << "Adding new order to trade struct:\n"
+                                     << "  Trade ID: " << order.tradeId << "\n"
+                                     << "  Order ID: " << order.okx_order_id << "\n"
+                                     << "  State ID: " << order.state_id << "\n"
+                                     << "  Side: " << order.side << "\n"
+                                     << "  Filled Size: " << order.filled_size << "\n"
+                                     << "  Price: " << order.price << "\n"
+                                     << "  Fill Portions:";
                     for (const auto& portion : order.fill_portions) {
-                        std::cout << "    Trade ID: " << portion.tradeId
-                                  << ", Size: " << portion.size
-                                  << ", Price: " << portion.price
-                                  << ", Is Closing: " << (portion.is_closing ? "Yes" : "No") << std::endl;
+                        LOG_DEBUG_STREAM << "    Trade ID: " << portion.tradeId
+                                         << ", Size: " << portion.size
+                                         << ", Price: " << portion.price
+                                         << ", Is Closing: " << (portion.is_closing ? "Yes" : "No");
                     }
                     current_trade_.orders.push_back(order);
                 }
                 
                 // After updating orders, verify the state
-                std::cout << "[DEBUG] After Order Update:\n"
-                          << "Order Found: " << (order_found ? "Yes" : "No") << "\n"
-                          << "Current Size: " << current_trade_.size << "\n"
-                          << "Updated Orders:" << std::endl;
+                LOG_DEBUG_STREAM << "After Order Update:\n"
+                                 << "Order Found: " << (order_found ? "Yes" : "No") << "\n"
+                                 << "Current Size: " << current_trade_.size << "\n"
+                                 << "Updated Orders:";
                 for (const auto& order : current_trade_.orders) {
-                    std::cout << "  Order ID: " << order.okx_order_id 
-                              << ", Filled Size: " << order.filled_size
-                              << ", Execution %: " << order.execution_percentage << std::endl;
+                    LOG_DEBUG_STREAM << "  Order ID: " << order.okx_order_id 
+                                     << ", Filled Size: " << order.filled_size
+                                     << ", Execution %: " << order.execution_percentage;
                 }
                 
                 // Recalculate current size based on orders
@@ -385,10 +374,10 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                 // Calculate net position
                 sum_of_orders = total_buy_size - total_sell_size;
                 
-                std::cout << "[DEBUG] Position calculation details:\n"
-                          << "  Total buy size: " << total_buy_size << "\n"
-                          << "  Total sell size: " << total_sell_size << "\n"
-                          << "  Net position (sum_of_orders): " << sum_of_orders << std::endl;
+                LOG_DEBUG_STREAM << "Position calculation details:\n"
+                                 << "  Total buy size: " << total_buy_size << "\n"
+                                 << "  Total sell size: " << total_sell_size << "\n"
+                                 << "  Net position (sum_of_orders): " << sum_of_orders;
                 
                 // Only consider the trade closed if the net position is effectively zero
                 if (std::abs(sum_of_orders) < 1e-8) {
@@ -400,10 +389,10 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                     is_trade_closed = false;
                 }
 
-                std::cout << "[DEBUG] Trade status after calculation:\n"
-                          << "  Is trade closed: " << (is_trade_closed ? "Yes" : "No") << "\n"
-                          << "  Current size: " << current_trade_.size << "\n"
-                          << "  Is long: " << (current_trade_.is_long ? "Yes" : "No") << std::endl;
+                LOG_DEBUG_STREAM << "Trade status after calculation:\n"
+                                 << "  Is trade closed: " << (is_trade_closed ? "Yes" : "No") << "\n"
+                                 << "  Current size: " << current_trade_.size << "\n"
+                                 << "  Is long: " << (current_trade_.is_long ? "Yes" : "No");
                 
                 // Only update size if there's a significant difference and we're not closing the position
                 if (std::abs(current_trade_.size) >= 1e-8 && 
@@ -416,27 +405,27 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                         corrected_size = -corrected_size;
                     }
                     
-                    std::cout << "[DEBUG] Size calculation details:\n"
-                              << "  Current size: " << current_trade_.size << "\n"
-                              << "  Calculated sum: " << sum_of_orders << "\n"
-                              << "  Is position flip: " << (is_same_direction ? "Yes" : "No") << std::endl;
+                    LOG_DEBUG_STREAM << "Size calculation details:\n"
+                                     << "  Current size: " << current_trade_.size << "\n"
+                                     << "  Calculated sum: " << sum_of_orders << "\n"
+                                     << "  Is position flip: " << (is_same_direction ? "Yes" : "No");
                     
                     if (std::abs(current_trade_.size - corrected_size) > 1e-8) {
-                    std::cout << "[WARNING] Size mismatch detected. Correcting size from " 
-                                  << current_trade_.size << " to " << corrected_size << std::endl;
+                    LOG_WARN("Size mismatch detected. Correcting size from {} to {}", current_trade_.size,
+                             corrected_size);
                         current_trade_.size = corrected_size;
                     }
                 }
 
                 // Update cumulative reward and total size for position reduction
                 if (pnl != 0.0 && filled_size > 0 && avg_price > 0) {
-                    std::cout << "\033[1;36m[REWARD DEBUG] Starting reward calculation:\033[0m\n"
-                              << "  PnL: " << pnl << " USDT\n"
-                              << "  Filled Size: " << filled_size << " contracts\n"
-                              << "  Avg Price: " << avg_price << " USDT\n"
-                              << "  Previous Filled: " << previous_filled_size << " contracts\n"
-                              << "  Current Cumulative Reward: " << current_trade_.cumulative_reward << "\n"
-                              << "  Current Total Size: " << current_trade_.total_size << std::endl;
+                    LOG_DEBUG_STREAM << "\033[1;36m[REWARD DEBUG] Starting reward calculation:\033[0m\n"
+                                     << "  PnL: " << pnl << " USDT\n"
+                                     << "  Filled Size: " << filled_size << " contracts\n"
+                                     << "  Avg Price: " << avg_price << " USDT\n"
+                                     << "  Previous Filled: " << previous_filled_size << " contracts\n"
+                                     << "  Current Cumulative Reward: " << current_trade_.cumulative_reward << "\n"
+                                     << "  Current Total Size: " << current_trade_.total_size;
 
                     double pnl_percentage = pnl / (filled_size * avg_price);
                     if (std::isfinite(pnl_percentage)) {
@@ -451,23 +440,24 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                         double new_fill_amount = filled_size - previous_filled;
                         double reward_increment = new_fill_amount * pnl_percentage;
                         
-                        std::cout << "\033[1;36m[REWARD DEBUG] Calculation details:\033[0m\n"
-                                  << "  PnL Percentage: " << (pnl_percentage * 100.0) << "%\n"
-                                  << "  New Fill Amount: " << new_fill_amount << " contracts\n"
-                                  << "  Reward Increment: " << reward_increment << "\n"
-                                  << "  MaxDD: " << okx_ws_->get_maxdd() << std::endl;
+                        LOG_DEBUG_STREAM << "\033[1;36m[REWARD DEBUG] Calculation details:\033[0m\n"
+                                         << "  PnL Percentage: " << (pnl_percentage * 100.0) << "%\n"
+                                         << "  New Fill Amount: " << new_fill_amount << " contracts\n"
+                                         << "  Reward Increment: " << reward_increment << "\n"
+                                         << "  MaxDD: " << okx_ws_->get_maxdd();
 
                         current_trade_.cumulative_reward += reward_increment;
                         current_trade_.total_size += new_fill_amount;
 
-                        std::cout << "\033[1;36m[REWARD DEBUG] Updated values:\033[0m\n"
-                                  << "  New Cumulative Reward: " << current_trade_.cumulative_reward << "\n"
-                                  << "  New Total Size: " << current_trade_.total_size << std::endl;
+                        LOG_DEBUG_STREAM << "\033[1;36m[REWARD DEBUG] Updated values:\033[0m\n"
+                                         << "  New Cumulative Reward: " << current_trade_.cumulative_reward << "\n"
+                                         << "  New Total Size: " << current_trade_.total_size;
                     } else {
-                        std::cout << "\033[1;31m[REWARD DEBUG] Warning: Invalid PnL percentage calculation\033[0m\n"
-                                  << "  PnL: " << pnl << "\n"
-                                  << "  Filled Size: " << filled_size << "\n"
-                                  << "  Avg Price: " << avg_price << std::endl;
+                        LOG_WARN("\033[1;31m[REWARD DEBUG] Warning: Invalid PnL percentage calculation\033[0m\n"
+                                 "  PnL: {}\n"
+                                 "  Filled Size: {}\n"
+                                 "  Avg Price: {}",
+                                 pnl, filled_size, avg_price);
                     }
                 }
 
@@ -480,20 +470,20 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                             current_trade_.buy_side_cumulative_price += filled_size * avg_price;
                             current_trade_.buy_side_total_size += filled_size;
                             
-                            std::cout << "\033[1;36m[PRICE DEBUG] Updated buy side averages:\033[0m\n"
-                                      << "  New fill: " << filled_size << " @ " << avg_price << "\n"
-                                      << "  Cumulative price sum: " << current_trade_.buy_side_cumulative_price << "\n"
-                                      << "  Total buy size: " << current_trade_.buy_side_total_size << "\n"
-                                      << "  Average buy price: " << current_trade_.get_avg_buy_price() << std::endl;
+                            LOG_DEBUG_STREAM << "\033[1;36m[PRICE DEBUG] Updated buy side averages:\033[0m\n"
+                                             << "  New fill: " << filled_size << " @ " << avg_price << "\n"
+                                             << "  Cumulative price sum: " << current_trade_.buy_side_cumulative_price << "\n"
+                                             << "  Total buy size: " << current_trade_.buy_side_total_size << "\n"
+                                             << "  Average buy price: " << current_trade_.get_avg_buy_price();
                         } else {
                             current_trade_.sell_side_cumulative_price += filled_size * avg_price;
                             current_trade_.sell_side_total_size += filled_size;
                             
-                            std::cout << "\033[1;36m[PRICE DEBUG] Updated sell side averages:\033[0m\n"
-                                      << "  New fill: " << filled_size << " @ " << avg_price << "\n"
-                                      << "  Cumulative price sum: " << current_trade_.sell_side_cumulative_price << "\n"
-                                      << "  Total sell size: " << current_trade_.sell_side_total_size << "\n"
-                                      << "  Average sell price: " << current_trade_.get_avg_sell_price() << std::endl;
+                            LOG_DEBUG_STREAM << "\033[1;36m[PRICE DEBUG] Updated sell side averages:\033[0m\n"
+                                             << "  New fill: " << filled_size << " @ " << avg_price << "\n"
+                                             << "  Cumulative price sum: " << current_trade_.sell_side_cumulative_price << "\n"
+                                             << "  Total sell size: " << current_trade_.sell_side_total_size << "\n"
+                                             << "  Average sell price: " << current_trade_.get_avg_sell_price();
                         }
                         break;
                     }
@@ -508,11 +498,11 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                     double avg_buy_price = current_trade_.get_avg_buy_price();
                     double avg_sell_price = current_trade_.get_avg_sell_price();
                     
-                    std::cout << "\033[1;36m[REWARD DEBUG] Calculating final reward for closed trade:\033[0m\n"
-                              << "  Average Buy Price: " << avg_buy_price << "\n"
-                              << "  Average Sell Price: " << avg_sell_price << "\n"
-                              << "  Trade Direction: " << (current_trade_.is_long ? "LONG" : "SHORT") << "\n"
-                              << "  MaxDD: " << okx_ws_->get_maxdd() << std::endl;
+                    LOG_DEBUG_STREAM << "\033[1;36m[REWARD DEBUG] Calculating final reward for closed trade:\033[0m\n"
+                                     << "  Average Buy Price: " << avg_buy_price << "\n"
+                                     << "  Average Sell Price: " << avg_sell_price << "\n"
+                                     << "  Trade Direction: " << (current_trade_.is_long ? "LONG" : "SHORT") << "\n"
+                                     << "  MaxDD: " << okx_ws_->get_maxdd();
                     
                     if (avg_buy_price > 0 && avg_sell_price > 0) {
                         if (current_trade_.is_long) {
@@ -523,31 +513,31 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                             final_reward = ((avg_buy_price - avg_sell_price) / avg_sell_price) * 100.0 * 100.0;
                         }
                         
-                        std::cout << "\033[1;36m[REWARD DEBUG] Base reward calculated:\033[0m\n"
-                                  << "  Base Reward: " << final_reward << "%" << std::endl;
+                        LOG_DEBUG_STREAM << "\033[1;36m[REWARD DEBUG] Base reward calculated:\033[0m\n"
+                                         << "  Base Reward: " << final_reward << "%";
                         
                         // Apply MaxDD adjustment
                         if (final_reward > 0) {
                             final_reward *= (1.0 - 2.0 * std::abs(okx_ws_->get_maxdd()));
-                            std::cout << "\033[1;36m[REWARD DEBUG] Positive reward adjusted for MaxDD:\033[0m\n"
-                                      << "  MaxDD Multiplier: " << (1.0 - 2.0 * std::abs(okx_ws_->get_maxdd())) << "\n"
-                                      << "  Final Reward: " << final_reward << "%" << std::endl;
+                            LOG_DEBUG_STREAM << "\033[1;36m[REWARD DEBUG] Positive reward adjusted for MaxDD:\033[0m\n"
+                                             << "  MaxDD Multiplier: " << (1.0 - 2.0 * std::abs(okx_ws_->get_maxdd())) << "\n"
+                                             << "  Final Reward: " << final_reward << "%";
                         } else if (final_reward < 0) {
                             final_reward *= (1.0 + 2.0 * std::abs(okx_ws_->get_maxdd()));
-                            std::cout << "\033[1;36m[REWARD DEBUG] Negative reward adjusted for MaxDD:\033[0m\n"
-                                      << "  MaxDD Multiplier: " << (1.0 + 2.0 * std::abs(okx_ws_->get_maxdd())) << "\n"
-                                      << "  Final Reward: " << final_reward << "%" << std::endl;
+                            LOG_DEBUG_STREAM << "\033[1;36m[REWARD DEBUG] Negative reward adjusted for MaxDD:\033[0m\n"
+                                             << "  MaxDD Multiplier: " << (1.0 + 2.0 * std::abs(okx_ws_->get_maxdd())) << "\n"
+                                             << "  Final Reward: " << final_reward << "%";
                         }
                     }
                     
-                    std::cout << "\033[1;36m[REWARD DEBUG] Trade closure summary:\033[0m\n"
-                              << "  Initial Size: " << previous_size << "\n"
-                              << "  Total Buy Size: " << current_trade_.buy_side_total_size << "\n"
-                              << "  Total Sell Size: " << current_trade_.sell_side_total_size << "\n"
-                              << "  Average Buy Price: " << avg_buy_price << "\n"
-                              << "  Average Sell Price: " << avg_sell_price << "\n"
-                              << "  Final Reward: " << final_reward << "%\n"
-                              << "  Maximum Drawdown: " << okx_ws_->get_maxdd() << std::endl;
+                    LOG_DEBUG_STREAM << "\033[1;36m[REWARD DEBUG] Trade closure summary:\033[0m\n"
+                                     << "  Initial Size: " << previous_size << "\n"
+                                     << "  Total Buy Size: " << current_trade_.buy_side_total_size << "\n"
+                                     << "  Total Sell Size: " << current_trade_.sell_side_total_size << "\n"
+                                     << "  Average Buy Price: " << avg_buy_price << "\n"
+                                     << "  Average Sell Price: " << avg_sell_price << "\n"
+                                     << "  Final Reward: " << final_reward << "%\n"
+                                     << "  Maximum Drawdown: " << okx_ws_->get_maxdd();
                     
                     // First ensure the closing order is in current_trade_.orders
                     bool closing_order_found = false;
@@ -648,21 +638,21 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                             publishTradeUpdate(state_id, okx_order_id, opening_order.execution_percentage);
                         }
                         
-                        std::cout << "[DEBUG] Processed dual-purpose order:\n"
-                                  << "  Order ID: " << okx_order_id 
-                                  << ", Total Size: " << filled_size 
-                                  << ", Side: " << side << "\n"
-                                  << "  Closing Portion: " << closing_size 
-                                  << " (Trade ID: " << current_trade_.tradeId 
-                                  << ", Execution: " << std::fixed << std::setprecision(2) 
-                                  << (closing_size / intended_volume * 100.0) << "%)\n";  // Convert to percentage only for display
+                        LOG_DEBUG_STREAM << "Processed dual-purpose order:\n"
+                                         << "  Order ID: " << okx_order_id 
+                                         << ", Total Size: " << filled_size 
+                                         << ", Side: " << side << "\n"
+                                         << "  Closing Portion: " << closing_size 
+                                         << " (Trade ID: " << current_trade_.tradeId 
+                                         << ", Execution: " << std::fixed << std::setprecision(2) 
+                                         << (closing_size / intended_volume * 100.0) << "%)";  // Convert to percentage only for display
                         
                         if (opening_size >= 0.001) {
-                            std::cout << "  Opening Portion: " << opening_size 
-                                      << " (Trade ID: " << okx_order_id 
-                                      << ", Execution: " << std::fixed << std::setprecision(2)
-                                      << (opening_size / intended_volume * 100.0) << "%)\n"  // Convert to percentage only for display
-                                      << "  New Trade Created: Yes (Size: " << opening_size << ")" << std::endl;
+                            LOG_DEBUG_STREAM << "  Opening Portion: " << opening_size 
+                                             << " (Trade ID: " << okx_order_id 
+                                             << ", Execution: " << std::fixed << std::setprecision(2)
+                                             << (opening_size / intended_volume * 100.0) << "%)\n"  // Convert to percentage only for display
+                                             << "  New Trade Created: Yes (Size: " << opening_size << ")";
                         }
                     }
                     
@@ -706,10 +696,10 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                         current_trade_ = Trade();
                     }
                     
-                    std::cout << "[DEBUG] Trade transition completed:\n"
-                              << "  Previous Trade ID: " << prev_trade_id << "\n"
-                              << "  New Trade ID: " << current_trade_.tradeId << "\n"
-                              << "  New Position Size: " << current_trade_.size << std::endl;
+                    LOG_DEBUG_STREAM << "Trade transition completed:\n"
+                                     << "  Previous Trade ID: " << prev_trade_id << "\n"
+                                     << "  New Trade ID: " << current_trade_.tradeId << "\n"
+                                     << "  New Position Size: " << current_trade_.size;
                     
                     need_balance_update = true;
                     return;  // Exit immediately after trade closure
@@ -739,12 +729,12 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                 double closing_size = std::min(fill_delta, std::abs(previous_size));
                 double opening_size = fill_delta - closing_size;
                 
-                std::cout << "\n[DEBUG] Position Flip/Close Analysis:\n"
-                          << "  Previous Position Size: " << previous_size << "\n"
-                          << "  Fill Delta: " << fill_delta << "\n"
-                          << "  Closing Size: " << closing_size << "\n"
-                          << "  Opening Size: " << opening_size << "\n"
-                          << "  Is Exact Close: " << (std::abs(closing_size - fill_delta) < 1e-8 ? "Yes" : "No") << std::endl;
+                LOG_DEBUG_STREAM << "Position Flip/Close Analysis:\n"
+                                 << "  Previous Position Size: " << previous_size << "\n"
+                                 << "  Fill Delta: " << fill_delta << "\n"
+                                 << "  Closing Size: " << closing_size << "\n"
+                                 << "  Opening Size: " << opening_size << "\n"
+                                 << "  Is Exact Close: " << (std::abs(closing_size - fill_delta) < 1e-8 ? "Yes" : "No");
                 
                 // Detect if this order will flip the position
                 bool is_position_flip = (opening_size >= 0.001) && 
@@ -755,20 +745,20 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                     std::max(0.0, previous_size - closing_size) : 
                     std::min(0.0, previous_size + closing_size);
                 
-                std::cout << "[DEBUG] After Position Close:\n"
-                          << "  New Position Size: " << current_trade_.size << "\n"
-                          << "  Is Position Flip: " << (is_position_flip ? "Yes" : "No") << std::endl;
+                LOG_DEBUG_STREAM << "After Position Close:\n"
+                                 << "  New Position Size: " << current_trade_.size << "\n"
+                                 << "  Is Position Flip: " << (is_position_flip ? "Yes" : "No");
 
                 // Update total reduced size with closing portion
                 current_trade_.total_size += closing_size;
                 
                 // If we closed the entire position, trigger position closure
                 if (std::abs(current_trade_.size) < 1e-8) {
-                    std::cout << "[DEBUG] Position Closure Detected:\n"
-                              << "  Opening Size: " << opening_size << "\n"
-                              << "  Intended Volume: " << intended_volume << "\n"
-                              << "  Closing Size: " << closing_size << "\n"
-                              << "  Should Create New Trade: " << (opening_size >= 0.001 && std::abs(closing_size - intended_volume) > 1e-8 ? "Yes" : "No") << std::endl;
+                    LOG_DEBUG_STREAM << "Position Closure Detected:\n"
+                                     << "  Opening Size: " << opening_size << "\n"
+                                     << "  Intended Volume: " << intended_volume << "\n"
+                                     << "  Closing Size: " << closing_size << "\n"
+                                     << "  Should Create New Trade: " << (opening_size >= 0.001 && std::abs(closing_size - intended_volume) > 1e-8 ? "Yes" : "No");
                     
                     // First add the closing portion to the current trade
                     bool closing_order_found = false;
@@ -869,21 +859,21 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                             publishTradeUpdate(state_id, okx_order_id, opening_order.execution_percentage);
                         }
                         
-                        std::cout << "[DEBUG] Processed dual-purpose order:\n"
-                                  << "  Order ID: " << okx_order_id 
-                                  << ", Total Size: " << filled_size 
-                                  << ", Side: " << side << "\n"
-                                  << "  Closing Portion: " << closing_size 
-                                  << " (Trade ID: " << current_trade_.tradeId 
-                                  << ", Execution: " << std::fixed << std::setprecision(2) 
-                                  << (closing_size / intended_volume * 100.0) << "%)\n";  // Convert to percentage only for display
+                        LOG_DEBUG_STREAM << "Processed dual-purpose order:\n"
+                                         << "  Order ID: " << okx_order_id 
+                                         << ", Total Size: " << filled_size 
+                                         << ", Side: " << side << "\n"
+                                         << "  Closing Portion: " << closing_size 
+                                         << " (Trade ID: " << current_trade_.tradeId 
+                                         << ", Execution: " << std::fixed << std::setprecision(2) 
+                                         << (closing_size / intended_volume * 100.0) << "%)";  // Convert to percentage only for display
                         
                         if (opening_size >= 0.001) {
-                            std::cout << "  Opening Portion: " << opening_size 
-                                      << " (Trade ID: " << okx_order_id 
-                                      << ", Execution: " << std::fixed << std::setprecision(2)
-                                      << (opening_size / intended_volume * 100.0) << "%)\n"  // Convert to percentage only for display
-                                      << "  New Trade Created: Yes (Size: " << opening_size << ")" << std::endl;
+                            LOG_DEBUG_STREAM << "  Opening Portion: " << opening_size 
+                                             << " (Trade ID: " << okx_order_id 
+                                             << ", Execution: " << std::fixed << std::setprecision(2)
+                                             << (opening_size / intended_volume * 100.0) << "%)\n"  // Convert to percentage only for display
+                                             << "  New Trade Created: Yes (Size: " << opening_size << ")";
                         }
                     }
                     
@@ -927,10 +917,10 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                         current_trade_ = Trade();
                     }
                     
-                    std::cout << "[DEBUG] Trade transition completed:\n"
-                              << "  Previous Trade ID: " << prev_trade_id << "\n"
-                              << "  New Trade ID: " << current_trade_.tradeId << "\n"
-                              << "  New Position Size: " << current_trade_.size << std::endl;
+                    LOG_DEBUG_STREAM << "Trade transition completed:\n"
+                                     << "  Previous Trade ID: " << prev_trade_id << "\n"
+                                     << "  New Trade ID: " << current_trade_.tradeId << "\n"
+                                     << "  New Position Size: " << current_trade_.size;
                     
                     need_balance_update = true;
                     return;  // Exit immediately after trade closure
@@ -941,14 +931,14 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                 }
                 
                 // Debug logging for size verification
-                std::cout << "[DEBUG] Position Size Update:\n"
-                          << "  Previous Size: " << previous_size << "\n"
-                          << "  Previous Filled: " << previous_filled << "\n"
-                          << "  New Fill Delta: " << fill_delta << "\n"
-                          << "  Closing Size: " << closing_size << "\n"
-                          << "  Opening Size: " << opening_size << "\n"
-                          << "  New Size: " << current_trade_.size << "\n"
-                          << "  New Direction: " << (current_trade_.is_long ? "LONG" : "SHORT") << std::endl;
+                LOG_DEBUG_STREAM << "Position Size Update:\n"
+                                 << "  Previous Size: " << previous_size << "\n"
+                                 << "  Previous Filled: " << previous_filled << "\n"
+                                 << "  New Fill Delta: " << fill_delta << "\n"
+                                 << "  Closing Size: " << closing_size << "\n"
+                                 << "  Opening Size: " << opening_size << "\n"
+                                 << "  New Size: " << current_trade_.size << "\n"
+                                 << "  New Direction: " << (current_trade_.is_long ? "LONG" : "SHORT");
                 
                 // Add or update order in trade struct first
                 bool order_found = false;
@@ -1019,10 +1009,10 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                         closing_order.fill_portions.push_back(closing_portion);
                         
                         current_trade_.orders.push_back(closing_order);
-                        std::cout << "[DEBUG] Added pure closing order to trade struct:\n"
-                                  << "  Order ID: " << closing_order.okx_order_id 
-                                  << ", Size: " << closing_order.filled_size 
-                                  << ", Side: " << closing_order.side << std::endl;
+                        LOG_DEBUG_STREAM << "Added pure closing order to trade struct:\n"
+                                         << "  Order ID: " << closing_order.okx_order_id 
+                                         << ", Size: " << closing_order.filled_size 
+                                         << ", Side: " << closing_order.side;
                     }
                 }
                 
@@ -1031,15 +1021,15 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                 double total_buy_size = 0.0;
                 double total_sell_size = 0.0;
                 
-                std::cout << "[DEBUG] Fill Portions Analysis:" << std::endl;
+                LOG_DEBUG("Fill Portions Analysis:");
                 // Calculate total buy and sell sizes from all portions
                 for (const auto& order : current_trade_.orders) {
-                    std::cout << "  Order " << order.okx_order_id << " Fill Portions:" << std::endl;
+                    LOG_DEBUG_STREAM << "  Order " << order.okx_order_id << " Fill Portions:";
                     for (const auto& portion : order.fill_portions) {
-                        std::cout << "    - Trade ID: " << portion.tradeId 
-                                  << ", Size: " << portion.size 
-                                  << ", Side: " << order.side
-                                  << ", Is Closing: " << (portion.is_closing ? "Yes" : "No") << std::endl;
+                        LOG_DEBUG_STREAM << "    - Trade ID: " << portion.tradeId 
+                                         << ", Size: " << portion.size 
+                                         << ", Side: " << order.side
+                                         << ", Is Closing: " << (portion.is_closing ? "Yes" : "No");
                         
                         if (portion.tradeId == current_trade_.tradeId) {
                             if (order.side == "buy") {
@@ -1054,11 +1044,11 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                 // Calculate net position
                 sum_of_orders = total_buy_size - total_sell_size;
                 
-                std::cout << "[DEBUG] Position Size Calculation:\n"
-                          << "  Total Buy Size: " << total_buy_size << "\n"
-                          << "  Total Sell Size: " << total_sell_size << "\n"
-                          << "  Net Position: " << sum_of_orders << "\n"
-                          << "  Current Trade ID: " << current_trade_.tradeId << std::endl;
+                LOG_DEBUG_STREAM << "Position Size Calculation:\n"
+                                 << "  Total Buy Size: " << total_buy_size << "\n"
+                                 << "  Total Sell Size: " << total_sell_size << "\n"
+                                 << "  Net Position: " << sum_of_orders << "\n"
+                                 << "  Current Trade ID: " << current_trade_.tradeId;
                 
                 // Update current trade size and direction
                 current_trade_.size = sum_of_orders;
@@ -1067,20 +1057,20 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                 // Only consider the trade closed if the net position is effectively zero
                 is_trade_closed = std::abs(sum_of_orders) < 1e-8;
 
-                std::cout << "[DEBUG] Trade status after calculation:\n"
-                          << "  Is trade closed: " << (is_trade_closed ? "Yes" : "No") << "\n"
-                          << "  Current size: " << current_trade_.size << "\n"
-                          << "  Is long: " << (current_trade_.is_long ? "Yes" : "No") << std::endl;
+                LOG_DEBUG_STREAM << "Trade status after calculation:\n"
+                                 << "  Is trade closed: " << (is_trade_closed ? "Yes" : "No") << "\n"
+                                 << "  Current size: " << current_trade_.size << "\n"
+                                 << "  Is long: " << (current_trade_.is_long ? "Yes" : "No");
 
                 // Update cumulative reward and total size for position reduction
                 if (pnl != 0.0 && filled_size > 0 && avg_price > 0) {
-                    std::cout << "\033[1;36m[REWARD DEBUG] Starting reward calculation:\033[0m\n"
-                              << "  PnL: " << pnl << " USDT\n"
-                              << "  Filled Size: " << filled_size << " contracts\n"
-                              << "  Avg Price: " << avg_price << " USDT\n"
-                              << "  Previous Filled: " << previous_filled << " contracts\n"
-                              << "  Current Cumulative Reward: " << current_trade_.cumulative_reward << "\n"
-                              << "  Current Total Size: " << current_trade_.total_size << std::endl;
+                    LOG_DEBUG_STREAM << "\033[1;36m[REWARD DEBUG] Starting reward calculation:\033[0m\n"
+                                     << "  PnL: " << pnl << " USDT\n"
+                                     << "  Filled Size: " << filled_size << " contracts\n"
+                                     << "  Avg Price: " << avg_price << " USDT\n"
+                                     << "  Previous Filled: " << previous_filled << " contracts\n"
+                                     << "  Current Cumulative Reward: " << current_trade_.cumulative_reward << "\n"
+                                     << "  Current Total Size: " << current_trade_.total_size;
 
                     double pnl_percentage = pnl / (filled_size * avg_price);
                     if (std::isfinite(pnl_percentage)) {
@@ -1095,23 +1085,24 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                         double new_fill_amount = filled_size - previous_filled;
                         double reward_increment = new_fill_amount * pnl_percentage;
                         
-                        std::cout << "\033[1;36m[REWARD DEBUG] Calculation details:\033[0m\n"
-                                  << "  PnL Percentage: " << (pnl_percentage * 100.0) << "%\n"
-                                  << "  New Fill Amount: " << new_fill_amount << " contracts\n"
-                                  << "  Reward Increment: " << reward_increment << "\n"
-                                  << "  MaxDD: " << okx_ws_->get_maxdd() << std::endl;
+                        LOG_DEBUG_STREAM << "\033[1;36m[REWARD DEBUG] Calculation details:\033[0m\n"
+                                         << "  PnL Percentage: " << (pnl_percentage * 100.0) << "%\n"
+                                         << "  New Fill Amount: " << new_fill_amount << " contracts\n"
+                                         << "  Reward Increment: " << reward_increment << "\n"
+                                         << "  MaxDD: " << okx_ws_->get_maxdd();
 
                         current_trade_.cumulative_reward += reward_increment;
                         current_trade_.total_size += new_fill_amount;
 
-                        std::cout << "\033[1;36m[REWARD DEBUG] Updated values:\033[0m\n"
-                                  << "  New Cumulative Reward: " << current_trade_.cumulative_reward << "\n"
-                                  << "  New Total Size: " << current_trade_.total_size << std::endl;
+                        LOG_DEBUG_STREAM << "\033[1;36m[REWARD DEBUG] Updated values:\033[0m\n"
+                                         << "  New Cumulative Reward: " << current_trade_.cumulative_reward << "\n"
+                                         << "  New Total Size: " << current_trade_.total_size;
                     } else {
-                        std::cout << "\033[1;31m[REWARD DEBUG] Warning: Invalid PnL percentage calculation\033[0m\n"
-                                  << "  PnL: " << pnl << "\n"
-                                  << "  Filled Size: " << filled_size << "\n"
-                                  << "  Avg Price: " << avg_price << std::endl;
+                        LOG_WARN("\033[1;31m[REWARD DEBUG] Warning: Invalid PnL percentage calculation\033[0m\n"
+                                 "  PnL: {}\n"
+                                 "  Filled Size: {}\n"
+                                 "  Avg Price: {}",
+                                 pnl, filled_size, avg_price);
                     }
                 }
 
@@ -1124,20 +1115,20 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                             current_trade_.buy_side_cumulative_price += filled_size * avg_price;
                             current_trade_.buy_side_total_size += filled_size;
                             
-                            std::cout << "\033[1;36m[PRICE DEBUG] Updated buy side averages:\033[0m\n"
-                                      << "  New fill: " << filled_size << " @ " << avg_price << "\n"
-                                      << "  Cumulative price sum: " << current_trade_.buy_side_cumulative_price << "\n"
-                                      << "  Total buy size: " << current_trade_.buy_side_total_size << "\n"
-                                      << "  Average buy price: " << current_trade_.get_avg_buy_price() << std::endl;
+                            LOG_DEBUG_STREAM << "\033[1;36m[PRICE DEBUG] Updated buy side averages:\033[0m\n"
+                                             << "  New fill: " << filled_size << " @ " << avg_price << "\n"
+                                             << "  Cumulative price sum: " << current_trade_.buy_side_cumulative_price << "\n"
+                                             << "  Total buy size: " << current_trade_.buy_side_total_size << "\n"
+                                             << "  Average buy price: " << current_trade_.get_avg_buy_price();
                         } else {
                             current_trade_.sell_side_cumulative_price += filled_size * avg_price;
                             current_trade_.sell_side_total_size += filled_size;
                             
-                            std::cout << "\033[1;36m[PRICE DEBUG] Updated sell side averages:\033[0m\n"
-                                      << "  New fill: " << filled_size << " @ " << avg_price << "\n"
-                                      << "  Cumulative price sum: " << current_trade_.sell_side_cumulative_price << "\n"
-                                      << "  Total sell size: " << current_trade_.sell_side_total_size << "\n"
-                                      << "  Average sell price: " << current_trade_.get_avg_sell_price() << std::endl;
+                            LOG_DEBUG_STREAM << "\033[1;36m[PRICE DEBUG] Updated sell side averages:\033[0m\n"
+                                             << "  New fill: " << filled_size << " @ " << avg_price << "\n"
+                                             << "  Cumulative price sum: " << current_trade_.sell_side_cumulative_price << "\n"
+                                             << "  Total sell size: " << current_trade_.sell_side_total_size << "\n"
+                                             << "  Average sell price: " << current_trade_.get_avg_sell_price();
                         }
                         break;
                     }
@@ -1152,11 +1143,11 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                     double avg_buy_price = current_trade_.get_avg_buy_price();
                     double avg_sell_price = current_trade_.get_avg_sell_price();
                     
-                    std::cout << "\033[1;36m[REWARD DEBUG] Calculating final reward for closed trade:\033[0m\n"
-                              << "  Average Buy Price: " << avg_buy_price << "\n"
-                              << "  Average Sell Price: " << avg_sell_price << "\n"
-                              << "  Trade Direction: " << (current_trade_.is_long ? "LONG" : "SHORT") << "\n"
-                              << "  MaxDD: " << okx_ws_->get_maxdd() << std::endl;
+                    LOG_DEBUG_STREAM << "\033[1;36m[REWARD DEBUG] Calculating final reward for closed trade:\033[0m\n"
+                                     << "  Average Buy Price: " << avg_buy_price << "\n"
+                                     << "  Average Sell Price: " << avg_sell_price << "\n"
+                                     << "  Trade Direction: " << (current_trade_.is_long ? "LONG" : "SHORT") << "\n"
+                                     << "  MaxDD: " << okx_ws_->get_maxdd();
                     
                     if (avg_buy_price > 0 && avg_sell_price > 0) {
                         if (current_trade_.is_long) {
@@ -1167,31 +1158,31 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                             final_reward = ((avg_buy_price - avg_sell_price) / avg_sell_price) * 100.0 * 100.0;
                         }
                         
-                        std::cout << "\033[1;36m[REWARD DEBUG] Base reward calculated:\033[0m\n"
-                                  << "  Base Reward: " << final_reward << "%" << std::endl;
+                        LOG_DEBUG_STREAM << "\033[1;36m[REWARD DEBUG] Base reward calculated:\033[0m\n"
+                                         << "  Base Reward: " << final_reward << "%";
                         
                         // Apply MaxDD adjustment
                         if (final_reward > 0) {
                             final_reward *= (1.0 - 2.0 * std::abs(okx_ws_->get_maxdd()));
-                            std::cout << "\033[1;36m[REWARD DEBUG] Positive reward adjusted for MaxDD:\033[0m\n"
-                                      << "  MaxDD Multiplier: " << (1.0 - 2.0 * std::abs(okx_ws_->get_maxdd())) << "\n"
-                                      << "  Final Reward: " << final_reward << "%" << std::endl;
+                            LOG_DEBUG_STREAM << "\033[1;36m[REWARD DEBUG] Positive reward adjusted for MaxDD:\033[0m\n"
+                                             << "  MaxDD Multiplier: " << (1.0 - 2.0 * std::abs(okx_ws_->get_maxdd())) << "\n"
+                                             << "  Final Reward: " << final_reward << "%";
                         } else if (final_reward < 0) {
                             final_reward *= (1.0 + 2.0 * std::abs(okx_ws_->get_maxdd()));
-                            std::cout << "\033[1;36m[REWARD DEBUG] Negative reward adjusted for MaxDD:\033[0m\n"
-                                      << "  MaxDD Multiplier: " << (1.0 + 2.0 * std::abs(okx_ws_->get_maxdd())) << "\n"
-                                      << "  Final Reward: " << final_reward << "%" << std::endl;
+                            LOG_DEBUG_STREAM << "\033[1;36m[REWARD DEBUG] Negative reward adjusted for MaxDD:\033[0m\n"
+                                             << "  MaxDD Multiplier: " << (1.0 + 2.0 * std::abs(okx_ws_->get_maxdd())) << "\n"
+                                             << "  Final Reward: " << final_reward << "%";
                         }
                     }
                     
-                    std::cout << "\033[1;36m[REWARD DEBUG] Trade closure summary:\033[0m\n"
-                              << "  Initial Size: " << previous_size << "\n"
-                              << "  Total Buy Size: " << current_trade_.buy_side_total_size << "\n"
-                              << "  Total Sell Size: " << current_trade_.sell_side_total_size << "\n"
-                              << "  Average Buy Price: " << avg_buy_price << "\n"
-                              << "  Average Sell Price: " << avg_sell_price << "\n"
-                              << "  Final Reward: " << final_reward << "%\n"
-                              << "  Maximum Drawdown: " << okx_ws_->get_maxdd() << std::endl;
+                    LOG_DEBUG_STREAM << "\033[1;36m[REWARD DEBUG] Trade closure summary:\033[0m\n"
+                                     << "  Initial Size: " << previous_size << "\n"
+                                     << "  Total Buy Size: " << current_trade_.buy_side_total_size << "\n"
+                                     << "  Total Sell Size: " << current_trade_.sell_side_total_size << "\n"
+                                     << "  Average Buy Price: " << avg_buy_price << "\n"
+                                     << "  Average Sell Price: " << avg_sell_price << "\n"
+                                     << "  Final Reward: " << final_reward << "%\n"
+                                     << "  Maximum Drawdown: " << okx_ws_->get_maxdd();
                     
                     // First ensure the closing order is in current_trade_.orders
                     bool closing_order_found = false;
@@ -1292,21 +1283,21 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                             publishTradeUpdate(state_id, okx_order_id, opening_order.execution_percentage);
                         }
                         
-                        std::cout << "[DEBUG] Processed dual-purpose order:\n"
-                                  << "  Order ID: " << okx_order_id 
-                                  << ", Total Size: " << filled_size 
-                                  << ", Side: " << side << "\n"
-                                  << "  Closing Portion: " << closing_size 
-                                  << " (Trade ID: " << current_trade_.tradeId 
-                                  << ", Execution: " << std::fixed << std::setprecision(2) 
-                                  << (closing_size / intended_volume * 100.0) << "%)\n";  // Convert to percentage only for display
+                        LOG_DEBUG_STREAM << "Processed dual-purpose order:\n"
+                                         << "  Order ID: " << okx_order_id 
+                                         << ", Total Size: " << filled_size 
+                                         << ", Side: " << side << "\n"
+                                         << "  Closing Portion: " << closing_size 
+                                         << " (Trade ID: " << current_trade_.tradeId 
+                                         << ", Execution: " << std::fixed << std::setprecision(2) 
+                                         << (closing_size / intended_volume * 100.0) << "%)";  // Convert to percentage only for display
                         
                         if (opening_size >= 0.001) {
-                            std::cout << "  Opening Portion: " << opening_size 
-                                      << " (Trade ID: " << okx_order_id 
-                                      << ", Execution: " << std::fixed << std::setprecision(2)
-                                      << (opening_size / intended_volume * 100.0) << "%)\n"  // Convert to percentage only for display
-                                      << "  New Trade Created: Yes (Size: " << opening_size << ")" << std::endl;
+                            LOG_DEBUG_STREAM << "  Opening Portion: " << opening_size 
+                                             << " (Trade ID: " << okx_order_id 
+                                             << ", Execution: " << std::fixed << std::setprecision(2)
+                                             << (opening_size / intended_volume * 100.0) << "%)\n"  // Convert to percentage only for display
+                                             << "  New Trade Created: Yes (Size: " << opening_size << ")";
                         }
                     }
                     
@@ -1350,10 +1341,10 @@ OMSHandler::OMSHandler(const std::string& host, int port,
                         current_trade_ = Trade();
                     }
                     
-                    std::cout << "[DEBUG] Trade transition completed:\n"
-                              << "  Previous Trade ID: " << prev_trade_id << "\n"
-                              << "  New Trade ID: " << current_trade_.tradeId << "\n"
-                              << "  New Position Size: " << current_trade_.size << std::endl;
+                    LOG_DEBUG_STREAM << "Trade transition completed:\n"
+                                     << "  Previous Trade ID: " << prev_trade_id << "\n"
+                                     << "  New Trade ID: " << current_trade_.tradeId << "\n"
+                                     << "  New Position Size: " << current_trade_.size;
                     
                     need_balance_update = true;
                     return;  // Exit immediately after trade closure
@@ -1366,56 +1357,52 @@ OMSHandler::OMSHandler(const std::string& host, int port,
             }
         }
 
-        // Update order state in deque
+        // Update order state in the store
         {
             std::lock_guard<std::mutex> lock(okx_ws_->orders_mutex_);
-            auto it = okx_ws_->orders_.begin();
-            while (it != okx_ws_->orders_.end()) {
-                if (it->okx_order_id == okx_order_id) {
-                    it->filled_size = filled_size;
-                    it->avg_fill_price = avg_price;
-                    it->order_state = state;
-                    
-                    // Update execution percentage based on state first
-                    if (state == "filled") {
-                        it->execution_percentage = 1.0;  // If order is filled, it's 100%
-                        it->is_filled = true;
-                    } else {
-                        // Only update execution percentage if not filled
-                        it->execution_percentage = (it->volume > 0) ? (filled_size / it->volume) : 0.0;
-                        it->is_filled = false;
-                    }
-                    
-                    // Remove the order if it's fully filled
-                    if (state == "filled" || it->execution_percentage >= 1.0) {
-                        // Ensure the order is in known_orders_ before removing from deque
-                        known_orders_[it->okx_order_id] = it->state_id;
-                        it = okx_ws_->orders_.erase(it);
-                    } else {
-                        ++it;
-                    }
+            OrderStore& orders = okx_ws_->orders_;
+            const OrderStore::Handle handle = orders.findByOkxId(okx_order_id);
+            if (OrderInfo* order = orders.get(handle)) {
+                order->filled_size = filled_size;
+                order->avg_fill_price = avg_price;
+                order->order_state = state;
+                
+                // Update execution percentage based on state first
+                if (state == "filled") {
+                    order->execution_percentage = 1.0;  // If order is filled, it's 100%
+                    order->is_filled = true;
                 } else {
-                    ++it;
+                    // Only update execution percentage if not filled
+                    order->execution_percentage = (order->volume > 0) ? (filled_size / order->volume) : 0.0;
+                    order->is_filled = false;
+                }
+                
+                // Remove the order if it's fully filled
+                if (state == "filled" || order->execution_percentage >= 1.0) {
+                    // Ensure the order is in known_orders_ before removing it from the store
+                    known_orders_[order->okx_order_id] = order->state_id;
+                    orders.erase(handle);
                 }
             }
 
-            // Limit deque size to 300 by removing oldest orders if necessary
-            while (okx_ws_->orders_.size() > 300) {
-                // Ensure the order is in known_orders_ before removing from deque
-                if (!okx_ws_->orders_.front().okx_order_id.empty()) {
-                    known_orders_[okx_ws_->orders_.front().okx_order_id] = okx_ws_->orders_.front().state_id;
+            // Limit the store to 300 orders by removing the oldest if necessary
+            while (orders.size() > OKXWebSocket::MAX_ACTIVE_ORDERS) {
+                // Ensure the order is in known_orders_ before removing it from the store
+                const OrderInfo& oldest = *orders.get(orders.oldest());
+                if (!oldest.okx_order_id.empty()) {
+                    known_orders_[oldest.okx_order_id] = oldest.state_id;
                 }
-                okx_ws_->orders_.pop_front();  // Remove oldest order
+                orders.erase(orders.oldest());  // Remove oldest order
             }
         }
 
         printTradeOrders();
 
         if (need_balance_update) {
-            std::cout << "[" << getCurrentTimestamp() << "] Waiting for balance update from WebSocket..." << std::endl;
+            LOG_INFO("Waiting for balance update from WebSocket...");
         }
 
-        std::cout << "[DEBUG] ========== Order Fill Callback End ==========\n" << std::endl;
+        LOG_DEBUG("========== Order Fill Callback End ==========");
     });
 }
 
@@ -1454,46 +1441,76 @@ void OMSHandler::start() {
         
         is_running_ = true;
 
-        // Start consuming messages
-        amqp_basic_consume(conn_, 1,
-            amqp_cstring_bytes("oms_action_queue"),
-            amqp_empty_bytes, 0, 1, 0,
-            amqp_empty_table);
+        // Start consuming messages with a bounded prefetch and batched acks. A failed action is
+        // acked anyway: replaying a stale action would place an order for an old state.
+        amqp_consumer::Consumer consumer(conn_, consumer_options_);
+        std::unique_ptr<transport::ShmSubscriber> actions;
+        if (transport_ == transport::Kind::Shm) {
+            // The ring of the PPO process for our instrument; RabbitMQ then only carries the
+            // execution updates back
+            actions = std::make_unique<transport::ShmSubscriber>(transport::actionRingName(instrument()));
+        } else {
+            consumer.subscribe(1, action_queue_, false);
+        }
+
+        // The simulated exchange matches against the states of its instrument, taken over the
+        // same transport as the actions
+        std::unique_ptr<transport::ShmSubscriber> book;
+        if (simulated_ && actions) {
+            book = std::make_unique<transport::ShmSubscriber>(
+                transport::ringName(SimulatedExchange::bookRoutingKey(simulated_->instrument())));
+        } else if (simulated_) {
+            consumer.subscribe(SIM_BOOK_CHANNEL, "oms_sim_book_queue");
+            sim_book_channel_open_ = true;
+        }
 
-        std::cout << "OMS service started. Listening for PPO actions..." << std::endl;
+        LOG_INFO("OMS service started. Listening for PPO actions...");
 
         // Message consumption loop
+        auto handle = [this](const amqp_consumer::Delivery& delivery) {
+            if (delivery.channel == SIM_BOOK_CHANNEL) {
+                handleBookMessage(delivery.body);
+                return amqp_consumer::Outcome::Ack;
+            }
+            try {
+                handleMessage(delivery.body);
+            } catch (const std::exception& e) {
+                LOG_ERROR("Error processing message: {}", e.what());
+            }
+            return amqp_consumer::Outcome::Ack;
+        };
+        std::string_view message;
         while (is_running_) {
-            amqp_envelope_t envelope;
-            amqp_maybe_release_buffers(conn_);
-            
-            struct timeval timeout;
-            timeout.tv_sec = 1;
-            timeout.tv_usec = 0;
-            
-            auto result = amqp_consume_message(conn_, &envelope, &timeout, 0);
-            
-            if (result.reply_type == AMQP_RESPONSE_NORMAL) {
-                std::string message(static_cast<char*>(envelope.message.body.bytes),
-                                  envelope.message.body.len);
-                
+            while (book && book->read(message)) {
+                handleBookMessage(message);
+            }
+            if (!actions) {
+                consumer.poll(handle, std::chrono::seconds(1));
+            } else if (actions->poll(message, SHM_POLL_WAIT)) {
                 try {
                     handleMessage(message);
                 } catch (const std::exception& e) {
-                    std::cerr << "Error processing message: " << e.what() << std::endl;
+                    LOG_ERROR("Error processing message: {}", e.what());
                 }
-                
-                amqp_destroy_envelope(&envelope);
             }
         }
 
     } catch (const std::exception& e) {
-        std::cerr << "Error in OMS service: " << e.what() << std::endl;
+        LOG_ERROR("Error in OMS service: {}", e.what());
         stop();
         throw;
     }
 }
 
+void OMSHandler::setActionInstruments(const std::vector<std::string>& instruments) {
+    for (const auto& action_instrument : instruments) {
+        if (action_instrument != instrument()) {
+            throw std::invalid_argument("Cannot take actions for " + action_instrument + ": the OMS only trades " +
+                                        instrument());
+        }
+    }
+}
+
 void OMSHandler::stop() {
     if (!is_running_) return;
     
@@ -1533,6 +1550,10 @@ void OMSHandler::initializeRabbitMQ() {
 void OMSHandler::cleanupRabbitMQ() {
     if (conn_) {
         try {
+            if (sim_book_channel_open_) {
+                amqp_channel_close(conn_, SIM_BOOK_CHANNEL, AMQP_REPLY_SUCCESS);
+                sim_book_channel_open_ = false;
+            }
             amqp_channel_close(conn_, 1, AMQP_REPLY_SUCCESS);
             amqp_connection_close(conn_, AMQP_REPLY_SUCCESS);
             amqp_destroy_connection(conn_);
@@ -1555,26 +1576,46 @@ void OMSHandler::declareExchangesAndQueues() {
         amqp_cstring_bytes("execution-exchange"), amqp_cstring_bytes("topic"),
         0, 1, 0, 0, amqp_empty_table);
 
-    // Declare and bind queue for PPO actions
+    // Declare and bind queue for the actions of our instrument's PPO service
     amqp_queue_declare(conn_, 1,
-        amqp_cstring_bytes("oms_action_queue"),
+        amqp_cstring_bytes(action_queue_.c_str()),
         0, 1, 0, 0,
         amqp_empty_table);
     
     amqp_queue_bind(conn_, 1,
-        amqp_cstring_bytes("oms_action_queue"),
+        amqp_cstring_bytes(action_queue_.c_str()),
         amqp_cstring_bytes("oms"),
-        amqp_cstring_bytes("oms.action"),
+        amqp_cstring_bytes(action_routing_key_.c_str()),
         amqp_empty_table);
+
+    // The simulated exchange's own copy of its instrument's orderbook states, dropped with the
+    // connection so it never piles up while the OMS trades live
+    if (simulated_) {
+        const std::string routing_key = SimulatedExchange::bookRoutingKey(simulated_->instrument());
+        amqp_queue_declare(conn_, 1,
+            amqp_cstring_bytes("oms_sim_book_queue"),
+            0, 0, 1, 1,
+            amqp_empty_table);
+
+        amqp_queue_bind(conn_, 1,
+            amqp_cstring_bytes("oms_sim_book_queue"),
+            amqp_cstring_bytes("orderbook"),
+            amqp_cstring_bytes(routing_key.c_str()),
+            amqp_empty_table);
+    }
 }
 
 bool OMSHandler::place_order(uint32_t state_id, const std::string& inst_id,
                            const std::string& td_mode, const std::string& side,
                            const std::string& ord_type, double size, double price,
-                           double original_volume, double original_price) {
+                           double original_volume, double original_price, uint64_t origin_ns) {
     
     // Validate and adjust order size
-    std::vector<OrderInfo> orders_vec(okx_ws_->orders_.begin(), okx_ws_->orders_.end());
+    std::vector<OrderInfo> orders_vec;
+    {
+        std::lock_guard<std::mutex> lock(okx_ws_->orders_mutex_);
+        orders_vec = okx_ws_->orders_.snapshotByFillTime();
+    }
     auto size_result = pos_size_handler_->validateAndAdjustSize(
         size,
         side,
@@ -1585,59 +1626,73 @@ bool OMSHandler::place_order(uint32_t state_id, const std::string& inst_id,
     );
 
     if (!size_result.can_place_order) {
-        std::cout << "[" << getCurrentTimestamp() << "] Order rejected: " 
-                  << size_result.reason << "\n" 
-                  << size_result.calculation_log;
+        LOG_WARN("Order rejected: {}\n{}", size_result.reason, size_result.calculation_log);
         return false;
     }
 
     // Use adjusted size if necessary
     double final_size = size_result.adjusted_size;
     if (size_result.was_adjusted) {
-        std::cout << "[" << getCurrentTimestamp() << "] Order size adjusted from " 
-                  << size << " to " << final_size << "\n" 
-                  << size_result.calculation_log;
+        LOG_INFO("Order size adjusted from {} to {}\n{}", size, final_size, size_result.calculation_log);
     }
 
     // Place order with validated/adjusted size
     return okx_ws_->send_order(state_id, inst_id, td_mode, side, 
                               ord_type, final_size, price,
-                              original_volume, original_price);
+                              original_volume, original_price, origin_ns);
 }
 
-void OMSHandler::handleMessage(const std::string& message) {
+void OMSHandler::handleMessage(std::string_view message) {
+    const uint64_t start_ns = latency::nowNanos();
     try {
-        // Expected size for V2 format: 23 bytes
+        // V2 format: 23 bytes
         // (1 byte action type + 8 bytes price + 8 bytes volume + 4 bytes mid-price + 2 bytes state ID)
-        if (message.size() != 23) {
-            throw std::runtime_error("Invalid message size for V2 format");
-        }
-
+        // V3 format: 31 bytes, V2 followed by 8 bytes origin of the orderbook state
         uint8_t action_type;
         double price, volume, mid_price;
         uint16_t state_id;
-        binary_utils::decodeOmsActionV2(message.data(), action_type, price, volume, mid_price, state_id);
+        uint64_t origin_ns = 0;
+        if (message.size() == binary_utils::OMS_ACTION_V3_SIZE) {
+            binary_utils::decodeOmsActionV3(message.data(), action_type, price, volume, mid_price, state_id, origin_ns);
+        } else if (message.size() == binary_utils::OMS_ACTION_V2_SIZE) {
+            binary_utils::decodeOmsActionV2(message.data(), action_type, price, volume, mid_price, state_id);
+        } else {
+            throw std::runtime_error("Invalid message size " + std::to_string(message.size()) +
+                                     " for V2 or V3 format");
+        }
 
-        std::cout << "[" << getCurrentTimestamp() << "] Received action: "
-                  << "Type=" << static_cast<int>(action_type)
-                  << " Price=" << price
-                  << " Volume=" << volume
-                  << " MidPrice=" << mid_price
-                  << " StateID=" << state_id << std::endl;
+        // One action per orderbook update, so only a sample is logged
+        LOG_SAMPLED(ACTION_LOG_SAMPLE, Info, "Received action: Type={} Price={} Volume={} MidPrice={} StateID={}",
+                    static_cast<int>(action_type), price, volume, mid_price, state_id);
+
+        // Without orderbook states yet, the simulated market follows the actions' mids
+        if (simulated_) {
+            simulated_->on_market(mid_price);
+        }
 
         // Process the action based on mid-price
-        processAction(action_type, price, volume, mid_price, state_id);
+        processAction(action_type, price, volume, mid_price, state_id, origin_ns);
+        decision_latency_.recordSince(start_ns);
 
     } catch (const std::exception& e) {
-        std::cerr << "Error processing binary message: " << e.what() << std::endl;
+        LOG_ERROR("Error processing binary message: {}", e.what());
     }
 }
 
-void OMSHandler::processAction(uint8_t action_type, double price, double volume, double mid_price, uint32_t state_id) {
+void OMSHandler::handleBookMessage(std::string_view message) {
+    try {
+        if (!simulated_->on_book(message)) {
+            LOG_RATE_LIMITED(1000, Warn, "Simulated exchange missed the base of an orderbook delta, waiting for a keyframe");
+        }
+    } catch (const std::exception& e) {
+        LOG_RATE_LIMITED(1000, Error, "Error processing orderbook state: {}", e.what());
+    }
+}
+
+void OMSHandler::processAction(uint8_t action_type, double price, double volume, double mid_price, uint32_t state_id,
+                               uint64_t origin_ns) {
     try {
         // Calculate trading parameters
-        constexpr double LEVERAGE = 100.0;
-        constexpr double MIN_CONTRACT_SIZE = 0.1;  // Minimum contract size
         const double balance = okx_ws_->get_balance();
         
         // Calculate order parameters
@@ -1645,92 +1700,76 @@ void OMSHandler::processAction(uint8_t action_type, double price, double volume,
         const std::string side = price < 0 ? "buy" : "sell";
         const std::string order_type = action_type == 0 ? "limit" : "market";
         const double margin = balance * 0.001 * volume;
-        double size = LEVERAGE * margin / (order_price / 100.0);
+        double size = OKXWebSocket::LEVERAGE * margin / (order_price * okx_ws_->contract_value());
         
         // Round size to one decimal place (ceiling)
         size = std::ceil(size * 10.0) / 10.0;
         
         // Ignore orders with size less than minimum contract size
-        if (size < MIN_CONTRACT_SIZE) {
-            std::cout << "Calculated size " << size << " is below minimum. Ignoring order." << std::endl;
+        if (size < OKXWebSocket::MIN_CONTRACT_SIZE) {
+            LOG_INFO("Calculated size {} is below minimum. Ignoring order.", size);
             return;
         }
 
-        // Place the order using cross mode instead of isolated
-        place_order(state_id, "BTC-USDT-SWAP", "cross", side, order_type, size, order_price, volume, price);
+        // Place the order for the traded instrument using cross mode instead of isolated
+        place_order(state_id, instrument(), "cross", side, order_type, size, order_price, volume, price, origin_ns);
 
         // Log the calculated parameters
-        std::cout << "[" << getCurrentTimestamp() << "] Trading Parameters:\n"
-                  << "  Side: " << side << "\n"
-                  << "  Order Type: " << order_type << "\n"
-                  << "  Mid Price: " << std::fixed << std::setprecision(2) << mid_price << " USD\n"
-                  << "  Order Price: " << order_price << " USD\n"
-                  << "  Balance: " << balance << " USDT\n"
-                  << "  Margin: " << margin << " USDT\n"
-                  << "  Leverage: " << LEVERAGE << "x\n"
-                  << "  Size: " << size << " contracts" << std::endl;
+        LOG_DEBUG("Trading Parameters: Side: {} Order Type: {} Mid Price: {:.2f} USD Order Price: {:.2f} USD "
+                  "Balance: {:.2f} USDT Margin: {:.2f} USDT Leverage: {:.2f}x Size: {:.2f} contracts",
+                  side, order_type, mid_price, order_price, balance, margin, OKXWebSocket::LEVERAGE, size);
 
     } catch (const std::exception& e) {
-        std::cerr << "Error processing action: " << e.what() << std::endl;
+        LOG_ERROR("Error processing action: {}", e.what());
     }
 }
 
 void OMSHandler::printTradeOrders() const {
-    std::cout << "\n============== Trade Orders ==============\n";
-    std::cout << "Active: " << (current_trade_.has_active_trade ? "Yes" : "No") << "\n";
-    std::cout << "Direction: " << (current_trade_.is_long ? "LONG" : "SHORT") << "\n";
-    std::cout << std::fixed << std::setprecision(8);  // Set fixed precision for all numeric output
-    std::cout << "Current Size: " << current_trade_.size << " contracts\n";
-    std::cout << "Total Reduced Size: " << current_trade_.total_size << " contracts\n";
-    std::cout << "Cumulative Reward: " << current_trade_.cumulative_reward << "\n";
-    std::cout << "Trade ID: " << current_trade_.tradeId << "\n";
+    // Runs on every fill; the table is only built when debug logging is on
+    if (!logging::enabled(logging::Level::Debug)) return;
+
+    std::ostringstream out;
+    out << "\n============== Trade Orders ==============\n";
+    out << "Active: " << (current_trade_.has_active_trade ? "Yes" : "No") << "\n";
+    out << "Direction: " << (current_trade_.is_long ? "LONG" : "SHORT") << "\n";
+    out << std::fixed << std::setprecision(8);  // Set fixed precision for all numeric output
+    out << "Current Size: " << current_trade_.size << " contracts\n";
+    out << "Total Reduced Size: " << current_trade_.total_size << " contracts\n";
+    out << "Cumulative Reward: " << current_trade_.cumulative_reward << "\n";
+    out << "Trade ID: " << current_trade_.tradeId << "\n";
     
     // Only calculate and print average reward if total_size is non-zero
     if (current_trade_.total_size > 0) {
         double avg_reward = current_trade_.cumulative_reward / current_trade_.total_size;
-        std::cout << "Average Reward: " << avg_reward << "\n";
+        out << "Average Reward: " << avg_reward << "\n";
     }
     
-    std::cout << "Orders:\n";
-    std::cout << "  State ID    Filled Size      Avg Price             OKX Order ID      Side     Executed %    Status                Trade ID" << std::endl;
-    std::cout << "=============================================================================================================================" << std::endl;
+    out << "Orders:\n";
+    out << "  State ID    Filled Size      Avg Price             OKX Order ID      Side     Executed %    Status                Trade ID" << "\n";
+    out << "=============================================================================================================================" << "\n";
     
     for (const auto& order : current_trade_.orders) {
-        std::cout << std::setw(10) << order.state_id
+        out << std::setw(10) << order.state_id
                   << std::setw(14) << order.filled_size
                   << std::setw(14) << order.avg_fill_price
                   << std::setw(25) << order.okx_order_id
                   << std::setw(10) << order.side
                   << std::setw(12) << (order.execution_percentage * 100.0) << "%"  // Convert to percentage for display
                   << std::setw(20) << order.order_state
-                  << std::setw(25) << order.tradeId << std::endl;
+                  << std::setw(25) << order.tradeId << "\n";
         
         if (!order.fill_portions.empty()) {
-            std::cout << "    Fill Portions:" << std::endl;
+            out << "    Fill Portions:" << "\n";
             for (const auto& portion : order.fill_portions) {
-                std::cout << "      Trade ID: " << portion.tradeId
+                out << "      Trade ID: " << portion.tradeId
                           << ", Size: " << std::fixed << std::setprecision(8) << portion.size
-                          << ", Price: " << std::fixed << std::setprecision(8) << portion.price << std::endl;
+                          << ", Price: " << std::fixed << std::setprecision(8) << portion.price << "\n";
             }
         }
     }
-    std::cout << "=============================================================================================================================" << std::endl;
-    std::cout << "=========================================\n\n";
-}
-
-std::string OMSHandler::getCurrentTimestamp() const {
-    auto now = std::chrono::system_clock::now();
-    auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-        now.time_since_epoch()
-    );
-    auto now_sec = std::chrono::duration_cast<std::chrono::seconds>(now_ms);
-    auto ms = now_ms.count() % 1000;
-
-    std::time_t now_time = std::chrono::system_clock::to_time_t(now);
-    std::stringstream ss;
-    ss << std::put_time(std::localtime(&now_time), "%Y-%m-%d %H:%M:%S");
-    ss << '.' << std::setfill('0') << std::setw(3) << ms;
-    return ss.str();
+    out << "=============================================================================================================================" << "\n";
+    out << "=========================================";
+    LOG_DEBUG_STREAM << out.str();  // Longer than one record, so streamed
 }
 
 void OMSHandler::publishTradeUpdate(uint32_t state_id, const std::string& okx_id) {
@@ -1771,21 +1810,21 @@ void OMSHandler::publishTradeUpdate(uint32_t state_id, const std::string& okx_id
         int status = amqp_basic_publish(conn_,
                                       1,
                                       amqp_cstring_bytes("execution-exchange"),
-                                      amqp_cstring_bytes("execution.update"),
+                                      amqp_cstring_bytes(execution_routing_key_.c_str()),
                                       0,
                                       0,
                                       &props,
                                       amqp_cstring_bytes(message.c_str()));
 
         if (status != AMQP_STATUS_OK) {
-            std::cerr << "Failed to publish execution update" << std::endl;
+            LOG_ERROR("Failed to publish execution update");
         } else {
             // Mark this state_id as published
             published_state_ids_.insert(state_id);
         }
 
     } catch (const std::exception& e) {
-        std::cerr << "Error publishing execution update: " << e.what() << std::endl;
+        LOG_ERROR("Error publishing execution update: {}", e.what());
     }
 }
 
@@ -1866,18 +1905,18 @@ void OMSHandler::publishTradeUpdate(uint32_t state_id,
         int status = amqp_basic_publish(conn_,
                                       1,
                                       amqp_cstring_bytes("execution-exchange"),
-                                      amqp_cstring_bytes("execution.update"),
+                                      amqp_cstring_bytes(execution_routing_key_.c_str()),
                                       0,
                                       0,
                                       &props,
                                       amqp_cstring_bytes(message.c_str()));
 
         if (status != AMQP_STATUS_OK) {
-            std::cerr << "Failed to publish trade closure update" << std::endl;
+            LOG_ERROR("Failed to publish trade closure update");
         }
 
     } catch (const std::exception& e) {
-        std::cerr << "Error publishing trade closure update: " << e.what() << std::endl;
+        LOG_ERROR("Error publishing trade closure update: {}", e.what());
     }
 }
 
@@ -1913,20 +1952,20 @@ void OMSHandler::publishTradeUpdate(uint32_t state_id,
         int status = amqp_basic_publish(conn_,
                                       1,
                                       amqp_cstring_bytes("execution-exchange"),
-                                      amqp_cstring_bytes("execution.update"),
+                                      amqp_cstring_bytes(execution_routing_key_.c_str()),
                                       0,
                                       0,
                                       &props,
                                       amqp_cstring_bytes(message.c_str()));
 
         if (status != AMQP_STATUS_OK) {
-            std::cerr << "Failed to publish execution update" << std::endl;
+            LOG_ERROR("Failed to publish execution update");
         } else {
             // Mark this state_id as published
             published_state_ids_.insert(state_id);
         }
 
     } catch (const std::exception& e) {
-        std::cerr << "Error publishing execution update: " << e.what() << std::endl;
+        LOG_ERROR("Error publishing execution update: {}", e.what());
     }
 } 
\ No newline at end of file
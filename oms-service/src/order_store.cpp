@@ -0,0 +1,206 @@
+#include "../include/order_store.hpp"
+#include <algorithm>
+
+namespace {
+
+size_t tableSizeFor(size_t capacity) {
+    size_t size = 16;
+    while (size < 2 * capacity) size <<= 1;
+    return size;
+}
+
+} // namespace
+
+OrderStore::OrderStore(size_t capacity) {
+    slots_.resize(std::max<size_t>(capacity, 1));
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        slots_[i].next = i + 1 < slots_.size() ? static_cast<Handle>(i + 1) : NONE;
+    }
+    free_ = 0;
+    rebuildIndexes();
+}
+
+OrderStore::Handle OrderStore::insert(const OrderInfo& order) {
+    if (free_ == NONE) {
+        grow();
+    }
+    const Handle handle = free_;
+    Slot& slot = slots_[handle];
+    free_ = slot.next;
+
+    slot.order = order;
+    slot.used = true;
+    slot.sequence = next_sequence_++;
+    slot.prev = tail_;
+    slot.next = NONE;
+    if (tail_ != NONE) {
+        slots_[tail_].next = handle;
+    } else {
+        head_ = handle;
+    }
+    tail_ = handle;
+    ++size_;
+
+    indexInsert(by_state_id_, handle, false);
+    if (!slot.order.okx_order_id.empty()) {
+        indexInsert(by_okx_id_, handle, true);
+    }
+    by_fill_time_.emplace(slot.order.fill_time, slot.sequence, handle);
+    return handle;
+}
+
+void OrderStore::erase(Handle handle) {
+    if (!get(handle)) return;
+    Slot& slot = slots_[handle];
+
+    indexErase(by_state_id_, handle, false);
+    if (!slot.order.okx_order_id.empty()) {
+        indexErase(by_okx_id_, handle, true);
+    }
+    by_fill_time_.erase(std::make_tuple(slot.order.fill_time, slot.sequence, handle));
+
+    if (slot.prev != NONE) {
+        slots_[slot.prev].next = slot.next;
+    } else {
+        head_ = slot.next;
+    }
+    if (slot.next != NONE) {
+        slots_[slot.next].prev = slot.prev;
+    } else {
+        tail_ = slot.prev;
+    }
+
+    slot.order = OrderInfo{};  // Release the strings and fill portions
+    slot.used = false;
+    slot.prev = NONE;
+    slot.next = free_;
+    free_ = handle;
+    --size_;
+}
+
+void OrderStore::clear() {
+    while (head_ != NONE) {
+        erase(head_);
+    }
+}
+
+OrderStore::Handle OrderStore::findByOkxId(std::string_view okx_order_id) const {
+    if (okx_order_id.empty()) return NONE;
+    const Index& index = by_okx_id_;
+    for (size_t pos = hashOkxId(okx_order_id) & index.mask;; pos = (pos + 1) & index.mask) {
+        const Handle handle = index.table[pos];
+        if (handle == NONE) return NONE;
+        if (slots_[handle].order.okx_order_id == okx_order_id) return handle;
+    }
+}
+
+OrderStore::Handle OrderStore::findByStateId(uint32_t state_id) const {
+    const Index& index = by_state_id_;
+    Handle found = NONE;
+    for (size_t pos = hashStateId(state_id) & index.mask;; pos = (pos + 1) & index.mask) {
+        const Handle handle = index.table[pos];
+        if (handle == NONE) return found;
+        if (slots_[handle].order.state_id == state_id &&
+            (found == NONE || slots_[handle].sequence > slots_[found].sequence)) {
+            found = handle;
+        }
+    }
+}
+
+void OrderStore::setOkxId(Handle handle, const std::string& okx_order_id) {
+    OrderInfo* order = get(handle);
+    if (!order || order->okx_order_id == okx_order_id) return;
+    if (!order->okx_order_id.empty()) {
+        indexErase(by_okx_id_, handle, true);
+    }
+    order->okx_order_id = okx_order_id;
+    if (!okx_order_id.empty()) {
+        indexInsert(by_okx_id_, handle, true);
+    }
+}
+
+void OrderStore::setFillTime(Handle handle, int64_t fill_time) {
+    OrderInfo* order = get(handle);
+    if (!order || order->fill_time == fill_time) return;
+    const uint64_t sequence = slots_[handle].sequence;
+    by_fill_time_.erase(std::make_tuple(order->fill_time, sequence, handle));
+    order->fill_time = fill_time;
+    by_fill_time_.emplace(fill_time, sequence, handle);
+}
+
+void OrderStore::forEachByFillTime(const std::function<void(const OrderInfo&)>& fn) const {
+    for (const auto& entry : by_fill_time_) {
+        fn(slots_[std::get<2>(entry)].order);
+    }
+}
+
+std::vector<OrderInfo> OrderStore::snapshotByFillTime() const {
+    std::vector<OrderInfo> orders;
+    orders.reserve(size_);
+    forEachByFillTime([&orders](const OrderInfo& order) { orders.push_back(order); });
+    return orders;
+}
+
+size_t OrderStore::eraseIf(const std::function<bool(const OrderInfo&)>& pred) {
+    size_t erased = 0;
+    for (Handle handle = head_; handle != NONE;) {
+        const Handle following = slots_[handle].next;
+        if (pred(slots_[handle].order)) {
+            erase(handle);
+            ++erased;
+        }
+        handle = following;
+    }
+    return erased;
+}
+
+void OrderStore::indexInsert(Index& index, Handle handle, bool okx_index) {
+    size_t pos = hashOf(handle, okx_index) & index.mask;
+    while (index.table[pos] != NONE) {
+        pos = (pos + 1) & index.mask;
+    }
+    index.table[pos] = handle;
+}
+
+void OrderStore::indexErase(Index& index, Handle handle, bool okx_index) {
+    size_t pos = hashOf(handle, okx_index) & index.mask;
+    while (index.table[pos] != handle) {
+        if (index.table[pos] == NONE) return;
+        pos = (pos + 1) & index.mask;
+    }
+
+    // Backward-shift the entries behind the hole that probed past it
+    for (size_t next = (pos + 1) & index.mask; index.table[next] != NONE; next = (next + 1) & index.mask) {
+        const size_t home = hashOf(index.table[next], okx_index) & index.mask;
+        const bool reachable = pos <= next ? (home <= pos || home > next) : (home <= pos && home > next);
+        if (reachable) {
+            index.table[pos] = index.table[next];
+            pos = next;
+        }
+    }
+    index.table[pos] = NONE;
+}
+
+void OrderStore::grow() {
+    const size_t old_size = slots_.size();
+    slots_.resize(old_size * 2);
+    for (size_t i = old_size; i < slots_.size(); ++i) {
+        slots_[i].next = i + 1 < slots_.size() ? static_cast<Handle>(i + 1) : free_;
+    }
+    free_ = static_cast<Handle>(old_size);
+    rebuildIndexes();
+}
+
+void OrderStore::rebuildIndexes() {
+    const size_t table_size = tableSizeFor(slots_.size());
+    for (Index* index : {&by_okx_id_, &by_state_id_}) {
+        index->table.assign(table_size, NONE);
+        index->mask = table_size - 1;
+    }
+    for (Handle handle = head_; handle != NONE; handle = slots_[handle].next) {
+        indexInsert(by_state_id_, handle, false);
+        if (!slots_[handle].order.okx_order_id.empty()) {
+            indexInsert(by_okx_id_, handle, true);
+        }
+    }
+}
@@ -0,0 +1,361 @@
+#include "../include/simulated_exchange.hpp"
+#include <async_logger.hpp>
+#include <binary_utils.hpp>
+#include <orderbook_wire.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+// ctVal of OKX's USDT-margined swaps; others need OMS_SIM_CONTRACT_VALUE
+const std::pair<const char*, double> CONTRACT_VALUES[] = {
+    {"BTC-USDT-SWAP", 0.01},
+    {"ETH-USDT-SWAP", 0.1},
+    {"SOL-USDT-SWAP", 1.0},
+};
+
+// Levels behind each VWAP feature of the published states (BOOK_DEPTH_LEVELS of the orderbook
+// service), and where each side's VWAP offset from the mid sits in the features
+constexpr size_t VWAP_DEPTHS[] = {10, 20, 50, 100, 400};
+constexpr size_t VWAP_FEATURE_STRIDE = 4;  // Volume imbalance, order imbalance, bid VWAP, ask VWAP
+constexpr size_t BID_VWAP_FEATURE = 3;
+constexpr size_t ASK_VWAP_FEATURE = 4;
+static_assert(1 + VWAP_FEATURE_STRIDE * (sizeof(VWAP_DEPTHS) / sizeof(VWAP_DEPTHS[0])) ==
+                  orderbook_wire::FEATURE_VALUES,
+              "VWAP depths out of sync with the wire format");
+
+} // namespace
+
+double SimulatedExchange::contractValueOf(const std::string& inst_id) {
+    for (const auto& [name, value] : CONTRACT_VALUES) {
+        if (inst_id == name) return value;
+    }
+    return 0.0;
+}
+
+SimulatedExchange::SimulatedExchange(const Config& config)
+    : OKXWebSocket("", "", ""), config_(config),
+      contract_value_(config.contract_value > 0.0 ? config.contract_value : contractValueOf(config.inst_id)) {
+    if (!(contract_value_ > 0.0)) {
+        throw std::invalid_argument("No contract value for simulated instrument " + config.inst_id +
+                                    ", set OMS_SIM_CONTRACT_VALUE");
+    }
+    for (auto& decoded : decoded_) {
+        decoded.resize(2 * orderbook_wire::SIDE_VALUES);
+    }
+    bids_.reserve(orderbook_wire::LEVELS);
+    asks_.reserve(orderbook_wire::LEVELS);
+}
+
+bool SimulatedExchange::connect() {
+    initial_balance_ = config_.balance;
+    balance_received_ = true;
+    connected_ = true;
+    LOG_INFO("Simulated exchange: {} ({} per contract), balance {:.2f} USDT, half spread {} bps, fee {} bps",
+             config_.inst_id, contract_value_, config_.balance, config_.half_spread_bps, config_.fee_bps);
+    return true;
+}
+
+void SimulatedExchange::disconnect() {
+    connected_ = false;
+    balance_received_ = false;
+    std::lock_guard<std::mutex> lock(sim_mutex_);
+    if (fills_ > 0) {
+        LOG_INFO("Simulated exchange: {} fills, {} resting orders, position {} contracts", fills_,
+                 resting_.size(), position_);
+    }
+    resting_.clear();
+}
+
+bool SimulatedExchange::send_order(uint32_t state_id,
+                                   const std::string& inst_id,
+                                   const std::string& /*td_mode*/,
+                                   const std::string& side,
+                                   const std::string& ord_type,
+                                   double size,
+                                   double price,
+                                   double /*original_volume*/,
+                                   double /*original_price*/,
+                                   uint64_t /*origin_ns*/) {
+    if (!connected_) {
+        LOG_ERROR("Cannot send order: simulated exchange not connected");
+        return false;
+    }
+    if (inst_id != config_.inst_id) {
+        LOG_RATE_LIMITED(1000, Error, "Rejecting order for {}: the simulated exchange only trades {}", inst_id,
+                         config_.inst_id);
+        return false;
+    }
+
+    OrderInfo order;
+    order.state_id = state_id;
+    order.volume = size;
+    order.price = price;
+    order.has_okx_id = false;
+    order.is_filled = false;
+    order.filled_size = 0;
+    order.avg_fill_price = 0;
+    order.side = side;
+    order.order_state = "pending";
+    store_order(order);
+
+    std::lock_guard<std::mutex> lock(sim_mutex_);
+    const std::string okx_order_id = "sim-" + std::to_string(next_order_id_++);
+
+    // Acknowledged at once, as OKX would answer the order op
+    if (order_id_callback_) {
+        order_id_callback_(state_id, okx_order_id);
+    }
+
+    Order sim_order{okx_order_id, side == "buy", ord_type == "limit" ? price : 0.0, size};
+
+    if (has_book_) {
+        // Take what the book offers up to the limit; a market order's remainder is dropped
+        take(sim_order, size, sim_order.is_buy ? asks_ : bids_, false);
+        if (sim_order.price <= 0.0) {
+            if (sim_order.filled + SIZE_EPSILON < size) {
+                LOG_RATE_LIMITED(1000, Warn, "Simulated market order {} filled {} of {} contracts, the book ran out",
+                                 okx_order_id, sim_order.filled, size);
+            }
+            return true;
+        }
+    } else {
+        const double mid = mid_price_ > 0.0 ? mid_price_ : price;
+        const double half_spread = mid * config_.half_spread_bps / 10000.0;
+        const double touch = sim_order.is_buy ? mid + half_spread : mid - half_spread;
+
+        // Market orders and limits through the touch take liquidity at the touch
+        if (ord_type != "limit" || (sim_order.is_buy ? price >= touch : price <= touch)) {
+            fill(sim_order, size, touch);
+            return true;
+        }
+    }
+
+    if (sim_order.filled + SIZE_EPSILON >= size) return true;
+    if (resting_.size() >= MAX_ACTIVE_ORDERS) {
+        resting_.erase(resting_.begin());  // The OMS stops tracking these as well
+    }
+    resting_.push_back(std::move(sim_order));
+    return true;
+}
+
+bool SimulatedExchange::send_cancel_order(const std::string& okx_order_id) {
+    std::lock_guard<std::mutex> lock(sim_mutex_);
+    resting_.erase(std::remove_if(resting_.begin(), resting_.end(),
+                                  [&](const Order& order) { return order.okx_order_id == okx_order_id; }),
+                   resting_.end());
+    return true;
+}
+
+bool SimulatedExchange::on_book(std::string_view message) {
+    std::lock_guard<std::mutex> lock(sim_mutex_);
+    const size_t next = 1 - newest_decoded_;
+    double* bids = decoded_[next].data();
+    double* asks = bids + orderbook_wire::SIDE_VALUES;
+    double feature_values[orderbook_wire::FEATURE_VALUES];
+    double mid_price = 0.0;
+    uint16_t state_id = 0;
+
+    if (message.size() == orderbook_wire::V2_MESSAGE_SIZE) {
+        constexpr size_t SIDE_BYTES = orderbook_wire::SIDE_VALUES * sizeof(uint64_t);
+        binary_utils::decodeLevels(message.data(), orderbook_wire::LEVELS, bids);
+        binary_utils::decodeLevels(message.data() + SIDE_BYTES, orderbook_wire::LEVELS, asks);
+        binary_utils::decodeChangeValues(message.data() + 2 * SIDE_BYTES, orderbook_wire::FEATURE_VALUES,
+                                         feature_values);
+        uint32_t mid_price_cents;
+        std::memcpy(&mid_price_cents, message.data() + message.size() - sizeof(uint16_t) - sizeof(uint32_t),
+                    sizeof(mid_price_cents));
+        mid_price = static_cast<double>(mid_price_cents) / binary_utils::CENTS_MULTIPLIER;
+        state_id = orderbook_wire::stateIdOf(message.data(), message.size());
+    } else if (orderbook_wire::isV3Message(message.data(), message.size())) {
+        const auto header = orderbook_wire::parseHeader(message.data(), message.size());
+        const double* base = nullptr;
+        if (!header.keyframe()) {
+            if (!v3_synced_ || newest_state_id_ != header.base_state_id) {
+                v3_synced_ = false;
+                return false;
+            }
+            base = decoded_[newest_decoded_].data();
+        }
+        orderbook_wire::decodeMessage(message.data(), message.size(), header, base,
+                                      base ? base + orderbook_wire::SIDE_VALUES : nullptr, bids, asks,
+                                      feature_values);
+        mid_price = static_cast<double>(header.mid_price_cents) / binary_utils::CENTS_MULTIPLIER;
+        state_id = header.state_id;
+        v3_synced_ = true;
+    } else {
+        throw std::runtime_error("Orderbook state of " + std::to_string(message.size()) + " bytes is neither v2 nor v3");
+    }
+    newest_decoded_ = next;
+    newest_state_id_ = state_id;
+    if (!(mid_price > 0.0)) return true;
+
+    if (!has_book_) {
+        LOG_INFO("Simulated exchange: matching against the {} orderbook from state {}", config_.inst_id, state_id);
+        has_book_ = true;
+    }
+    mid_price_ = mid_price;
+    rebuild_book(bids, asks, feature_values);
+
+    // Resting limits, oldest first, take what the opposite side offers through their price
+    for (auto& order : resting_) {
+        take(order, order.size - order.filled, order.is_buy ? asks_ : bids_, true);
+    }
+    resting_.erase(std::remove_if(resting_.begin(), resting_.end(),
+                                  [](const Order& order) { return order.filled + SIZE_EPSILON >= order.size; }),
+                   resting_.end());
+
+    update_drawdown();
+    return true;
+}
+
+void SimulatedExchange::on_market(double mid_price) {
+    if (!(mid_price > 0.0)) return;
+    std::lock_guard<std::mutex> lock(sim_mutex_);
+    if (has_book_) return;  // The states move the market
+    mid_price_ = mid_price;
+    const double half_spread = mid_price * config_.half_spread_bps / 10000.0;
+    match_resting(mid_price - half_spread, mid_price + half_spread);
+    update_drawdown();
+}
+
+void SimulatedExchange::match_resting(double bid, double ask) {
+    // Resting limits fill in full at their own price once the opposite touch reaches it
+    for (auto& order : resting_) {
+        if (order.is_buy ? ask <= order.price : bid >= order.price) {
+            fill(order, order.size - order.filled, order.price);
+        }
+    }
+    resting_.erase(std::remove_if(resting_.begin(), resting_.end(),
+                                  [](const Order& order) { return order.filled + SIZE_EPSILON >= order.size; }),
+                   resting_.end());
+}
+
+void SimulatedExchange::rebuild_book(const double* bids, const double* asks, const double* feature_values) {
+    rebuild_side(bids, feature_values, true, bids_);
+    rebuild_side(asks, feature_values, false, asks_);
+}
+
+void SimulatedExchange::rebuild_side(const double* levels, const double* feature_values, bool is_bids,
+                                     std::vector<BookLevel>& side) const {
+    // Level sizes, best first; the prices are filled in band by band below
+    side.clear();
+    for (size_t i = 0; i < orderbook_wire::LEVELS; ++i) {
+        side.push_back(BookLevel{0.0, std::max(0.0, levels[i * orderbook_wire::VALUES_PER_LEVEL + 1])});
+    }
+
+    // Within each band of levels the price moves linearly in the cumulative size, from where the
+    // band before it ended, so that the band's size-weighted price makes up the published VWAP
+    const double direction = is_bids ? -1.0 : 1.0;
+    const double touch = mid_price_ * (1.0 + direction * config_.half_spread_bps / 10000.0);
+    double start = touch;
+    double size_before = 0.0;      // Size of the levels in earlier bands
+    double notional_before = 0.0;  // Their notional at the published VWAPs
+    size_t level = 0;
+    for (size_t band = 0; band < sizeof(VWAP_DEPTHS) / sizeof(VWAP_DEPTHS[0]); ++band) {
+        const size_t end = std::min(VWAP_DEPTHS[band], orderbook_wire::LEVELS);
+        double band_size = 0.0;
+        for (size_t i = level; i < end; ++i) band_size += side[i].size;
+
+        const double vwap_offset = feature_values[band * VWAP_FEATURE_STRIDE + (is_bids ? BID_VWAP_FEATURE
+                                                                                        : ASK_VWAP_FEATURE)];
+        const double vwap = mid_price_ * (1.0 + vwap_offset);
+        const double size_through = size_before + band_size;
+        double band_price = band_size > 0.0 ? (vwap * size_through - notional_before) / band_size : start;
+        // Never better than where the band starts, e.g. when wide for the configured spread
+        band_price = is_bids ? std::min(band_price, start) : std::max(band_price, start);
+        const double finish = 2.0 * band_price - start;
+
+        double size_into_band = 0.0;
+        for (; level < end; ++level) {
+            const double middle = size_into_band + side[level].size / 2.0;
+            side[level].price = band_size > 0.0 ? start + (finish - start) * middle / band_size : start;
+            size_into_band += side[level].size;
+        }
+        start = finish;
+        size_before = size_through;
+        notional_before += band_price * band_size;
+    }
+}
+
+void SimulatedExchange::take(Order& order, double size, std::vector<BookLevel>& side, bool at_limit) {
+    double size_taken = 0.0;
+    double notional = 0.0;
+    for (auto& level : side) {
+        if (size_taken + SIZE_EPSILON >= size) break;
+        if (order.price > 0.0 && (order.is_buy ? level.price > order.price : level.price < order.price)) break;
+        const double taken = std::min(level.size, size - size_taken);
+        level.size -= taken;
+        size_taken += taken;
+        notional += taken * level.price;
+    }
+    if (size_taken <= SIZE_EPSILON) return;
+
+    fill(order, size_taken, at_limit ? order.price : notional / size_taken);
+}
+
+void SimulatedExchange::fill(Order& order, double size, double price) {
+    double pnl = apply_to_position(order.is_buy, size, price);
+    pnl -= size * contract_value_ * price * config_.fee_bps / 10000.0;
+    initial_balance_ = initial_balance_.load() + pnl;  // As OKX's account updates would report
+
+    order.filled += size;
+    order.notional += size * price;
+    const bool complete = order.filled + SIZE_EPSILON >= order.size;
+
+    // Shaped like OKX's order updates: accumulated fill and average price, plus this fill's
+    // size, so the release passes each in sequence without waiting for it
+    BufferedOrderUpdate update{
+        order.okx_order_id,
+        order.filled,
+        order.notional / order.filled,
+        order.is_buy ? "buy" : "sell",
+        complete ? "filled" : "partially_filled",
+        pnl,
+        get_current_timestamp_ms()
+    };
+    update.fill_delta = size;
+    update.fill_size = size;
+    add_to_buffer(update);
+    fills_++;
+}
+
+double SimulatedExchange::apply_to_position(bool is_buy, double size, double price) {
+    const double signed_size = is_buy ? size : -size;
+    double realised = 0.0;
+
+    if (position_ == 0.0 || (position_ > 0.0) == is_buy) {
+        // Opening or adding: volume weighted entry
+        const double total = std::abs(position_) + size;
+        position_price_ = (position_price_ * std::abs(position_) + price * size) / total;
+        position_ += signed_size;
+        return 0.0;
+    }
+
+    // Reducing, closing or flipping
+    const double closed = std::min(size, std::abs(position_));
+    const double direction = position_ > 0.0 ? 1.0 : -1.0;
+    realised = closed * contract_value_ * (price - position_price_) * direction;
+    position_ += signed_size;
+    if (std::abs(position_) < 1e-9) {
+        position_ = 0.0;
+        position_price_ = 0.0;
+    } else if ((position_ > 0.0) == is_buy) {
+        position_price_ = price;  // Flipped, the rest opened at this price
+    }
+    return realised;
+}
+
+void SimulatedExchange::update_drawdown() {
+    if (position_ == 0.0 || position_price_ <= 0.0) return;
+
+    // OKX's uplRatio: unrealised PnL over the position's margin
+    const double direction = position_ > 0.0 ? 1.0 : -1.0;
+    const double upl_ratio = direction * (mid_price_ - position_price_) / position_price_ * LEVERAGE;
+    if (upl_ratio < 0.0 && upl_ratio < get_maxdd()) {
+        update_maxdd(upl_ratio);
+    }
+}
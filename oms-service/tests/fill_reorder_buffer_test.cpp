@@ -0,0 +1,152 @@
+// Drives FillReorderBuffer with explicit receive times: fills arriving out of order are released
+// in fill time order as soon as the sequence is complete, duplicates pass without holding
+// anything back, a gap holds the fills behind it until the 2 s window expires, and tracking of
+// idle orders is swept. Exits non-zero on the first mismatch.
+#include "../include/fill_reorder_buffer.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t MS = 1000000ULL;
+constexpr uint64_t T0 = 1000000000000ULL;  // Receive times start here
+constexpr int64_t FILL_TIME = 1700000000000;
+
+int failures = 0;
+
+bool check(bool ok, const char* test, const char* what) {
+    if (!ok) {
+        std::printf("FAIL %s: %s\n", test, what);
+        ++failures;
+    }
+    return ok;
+}
+
+// A fill of size fill_size taking the order's accumulated fill to filled_size
+BufferedOrderUpdate fill(const std::string& order, double filled_size, double fill_size, int64_t fill_time,
+                         const char* state = "partially_filled") {
+    BufferedOrderUpdate update{order, filled_size, 65000.0, "buy", state, 0.0, fill_time};
+    update.fill_delta = fill_size;
+    update.fill_size = fill_size;
+    return update;
+}
+
+// Accumulated fill sizes of the released updates, in release order
+std::vector<double> filledSizes(const std::vector<BufferedOrderUpdate>& updates) {
+    std::vector<double> sizes;
+    for (const auto& update : updates) sizes.push_back(update.filled_size);
+    return sizes;
+}
+
+void testInSequence() {
+    const char* name = "in sequence";
+    FillReorderBuffer buffer;
+    buffer.push(fill("A", 1.0, 1.0, FILL_TIME), T0);
+    check(filledSizes(buffer.takeReleasable(T0)) == std::vector<double>{1.0}, name, "first fill held back");
+    buffer.push(fill("A", 3.0, 2.0, FILL_TIME + 1), T0 + MS);
+    check(filledSizes(buffer.takeReleasable(T0 + MS)) == std::vector<double>{3.0}, name, "second fill held back");
+    check(buffer.empty(), name, "buffer not empty");
+}
+
+void testOutOfOrder() {
+    const char* name = "out of order";
+    FillReorderBuffer buffer;
+    // The third and second fill arrive before the first
+    buffer.push(fill("A", 6.0, 3.0, FILL_TIME + 2), T0);
+    buffer.push(fill("A", 3.0, 2.0, FILL_TIME + 1), T0 + MS);
+    check(buffer.takeReleasable(T0 + MS).empty(), name, "released before the first fill arrived");
+    check(buffer.deadlineNs() == T0 + MS + FillReorderBuffer::WINDOW_NS, name,
+          "deadline is not the held back fill's");
+    buffer.push(fill("A", 1.0, 1.0, FILL_TIME), T0 + 2 * MS);
+    check(filledSizes(buffer.takeReleasable(T0 + 2 * MS)) == (std::vector<double>{1.0, 3.0, 6.0}), name,
+          "not released in fill time order once complete");
+
+    // Orders are independent: a gap in B does not hold back A
+    buffer.push(fill("B", 4.0, 2.0, FILL_TIME + 3), T0 + 3 * MS);
+    buffer.push(fill("A", 7.0, 1.0, FILL_TIME + 4), T0 + 3 * MS);
+    check(buffer.takeReleasable(T0 + 3 * MS).empty(), name, "released past the earlier gap in B");
+    buffer.push(fill("B", 2.0, 2.0, FILL_TIME + 1), T0 + 4 * MS);
+    check(filledSizes(buffer.takeReleasable(T0 + 4 * MS)) == (std::vector<double>{2.0, 4.0, 7.0}), name,
+          "not released once B was complete");
+    check(buffer.empty(), name, "buffer not empty");
+}
+
+void testDuplicate() {
+    const char* name = "duplicate";
+    FillReorderBuffer buffer;
+    buffer.push(fill("A", 1.0, 1.0, FILL_TIME), T0);
+    buffer.push(fill("A", 1.0, 1.0, FILL_TIME), T0);
+    check(filledSizes(buffer.takeReleasable(T0)) == (std::vector<double>{1.0, 1.0}), name,
+          "both copies are released, arrival order breaking the fill time tie");
+
+    // A copy of a released fill arriving later neither waits nor blocks the next fill
+    buffer.push(fill("A", 1.0, 1.0, FILL_TIME), T0 + MS);
+    buffer.push(fill("A", 2.5, 1.5, FILL_TIME + 1), T0 + MS);
+    check(filledSizes(buffer.takeReleasable(T0 + MS)) == (std::vector<double>{1.0, 2.5}), name,
+          "late copy held back");
+
+    // Released fill sizes only grow
+    buffer.push(fill("A", 4.0, 1.5, FILL_TIME + 2), T0 + 2 * MS);
+    check(filledSizes(buffer.takeReleasable(T0 + 2 * MS)) == std::vector<double>{4.0}, name,
+          "fill after the copies held back");
+}
+
+void testGapTimeout() {
+    const char* name = "gap timeout";
+    FillReorderBuffer buffer;
+    buffer.push(fill("A", 1.0, 1.0, FILL_TIME), T0);
+    buffer.takeReleasable(T0);
+
+    // The fill from 1.0 to 2.0 never arrives
+    buffer.push(fill("A", 3.0, 1.0, FILL_TIME + 2), T0 + 10 * MS);
+    buffer.push(fill("A", 4.0, 1.0, FILL_TIME + 3), T0 + 20 * MS);
+    check(buffer.takeReleasable(T0 + 10 * MS + FillReorderBuffer::WINDOW_NS - 1).empty(), name,
+          "released before the window expired");
+    check(buffer.deadlineNs() == T0 + 10 * MS + FillReorderBuffer::WINDOW_NS, name, "wrong deadline");
+
+    // The expired fill goes out and the one behind it is now contiguous
+    check(filledSizes(buffer.takeReleasable(T0 + 10 * MS + FillReorderBuffer::WINDOW_NS)) ==
+              (std::vector<double>{3.0, 4.0}), name, "not released at the window cap");
+
+    // A fill without fillSz can never be shown contiguous and waits out the window
+    BufferedOrderUpdate unsized = fill("C", 1.0, 1.0, FILL_TIME + 4);
+    unsized.fill_size = -1.0;
+    const uint64_t at = T0 + 5000 * MS;
+    buffer.push(unsized, at);
+    check(buffer.takeReleasable(at + FillReorderBuffer::WINDOW_NS - 1).empty(), name, "unsized fill released early");
+    check(buffer.takeReleasable(at + FillReorderBuffer::WINDOW_NS).size() == 1, name, "unsized fill not released");
+}
+
+void testTracking() {
+    const char* name = "tracking";
+    FillReorderBuffer buffer;
+    buffer.push(fill("A", 1.0, 1.0, FILL_TIME), T0);
+    buffer.push(fill("B", 1.0, 1.0, FILL_TIME), T0);
+    buffer.takeReleasable(T0);
+    check(buffer.trackedOrders() == 2, name, "partially filled orders not tracked");
+
+    // A final state ends the order's tracking
+    buffer.push(fill("A", 2.0, 1.0, FILL_TIME + 1, "filled"), T0 + MS);
+    buffer.takeReleasable(T0 + MS);
+    check(buffer.trackedOrders() == 1, name, "filled order still tracked");
+
+    // B was cancelled after its partial fill and is swept once idle long enough
+    buffer.takeReleasable(T0 + FillReorderBuffer::TRACKING_IDLE_NS - MS);
+    check(buffer.trackedOrders() == 1, name, "swept before it was idle");
+    buffer.takeReleasable(T0 + FillReorderBuffer::TRACKING_IDLE_NS + FillReorderBuffer::TRACKING_SWEEP_NS);
+    check(buffer.trackedOrders() == 0, name, "idle order not swept");
+}
+
+} // namespace
+
+int main() {
+    testInSequence();
+    testOutOfOrder();
+    testDuplicate();
+    testGapTimeout();
+    testTracking();
+    std::printf("%s fill reorder buffer\n", failures == 0 ? "ok" : "FAIL");
+    return failures == 0 ? 0 : 1;
+}
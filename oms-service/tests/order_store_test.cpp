@@ -0,0 +1,243 @@
+// Runs random inserts, erases, OKX ID and fill-time changes against OrderStore and checks every
+// lookup after each step against a plain reference of the live orders: findByOkxId, the newest
+// order in findByStateId, the insertion list and the fill-time order. The first phase keeps the
+// store at its initial capacity and draws IDs whose home buckets are the last two of the table,
+// so probes collide, wrap around the table end and backward-shift erases move entries across
+// it. The second phase grows the store. Exits non-zero on the first mismatch.
+#include "../include/order_store.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+constexpr size_t CAPACITY = 8;       // Index tables of 16 buckets
+constexpr size_t TABLE_MASK = 15;
+constexpr size_t COLLIDING_KEYS = 12;  // IDs of each index homed in the last two buckets
+constexpr size_t CHURN_STEPS = 20000;
+constexpr size_t GROWTH_STEPS = 20000;
+constexpr size_t GROWTH_MAX_ORDERS = 3000;
+
+int failures = 0;
+
+uint64_t nextRandom(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// The store's bucket functions, to pick IDs that collide near the table end
+size_t stateIdBucket(uint32_t id) { return (static_cast<uint64_t>(id) * 0x9E3779B97F4A7C15ULL) & TABLE_MASK; }
+size_t okxIdBucket(std::string_view id) { return std::hash<std::string_view>{}(id) & TABLE_MASK; }
+
+std::vector<uint32_t> collidingStateIds() {
+    std::vector<uint32_t> ids;
+    for (uint32_t id = 0; ids.size() < COLLIDING_KEYS; ++id) {
+        if (stateIdBucket(id) >= TABLE_MASK - 1) ids.push_back(id);
+    }
+    return ids;
+}
+
+std::vector<std::string> collidingOkxIds() {
+    std::vector<std::string> ids;
+    for (uint64_t n = 1; ids.size() < COLLIDING_KEYS; ++n) {
+        const std::string id = std::to_string(600000000000000000ULL + n);
+        if (okxIdBucket(id) >= TABLE_MASK - 1) ids.push_back(id);
+    }
+    return ids;
+}
+
+struct Expected {
+    uint32_t state_id;
+    std::string okx_order_id;
+    int64_t fill_time;
+    uint64_t sequence;  // Insertion order
+};
+
+class Checker {
+public:
+    explicit Checker(const char* phase) : phase_(phase), store_(CAPACITY) {}
+
+    OrderStore& store() { return store_; }
+    size_t size() const { return live_.size(); }
+    const std::vector<OrderStore::Handle>& handles() const { return order_; }
+
+    void insert(uint32_t state_id, const std::string& okx_order_id) {
+        OrderInfo order{};
+        order.state_id = state_id;
+        order.okx_order_id = okx_order_id;
+        order.has_okx_id = !okx_order_id.empty();
+        const OrderStore::Handle handle = store_.insert(order);
+        if (live_.count(handle)) fail("insert reused a live handle");
+        live_[handle] = {state_id, okx_order_id, 0, sequence_++};
+        order_.push_back(handle);
+    }
+
+    void erase(OrderStore::Handle handle) {
+        store_.erase(handle);
+        live_.erase(handle);
+        order_.erase(std::find(order_.begin(), order_.end(), handle));
+    }
+
+    void setOkxId(OrderStore::Handle handle, const std::string& okx_order_id) {
+        store_.setOkxId(handle, okx_order_id);
+        live_[handle].okx_order_id = okx_order_id;
+    }
+
+    void setFillTime(OrderStore::Handle handle, int64_t fill_time) {
+        store_.setFillTime(handle, fill_time);
+        live_[handle].fill_time = fill_time;
+    }
+
+    // An OKX ID no live order holds
+    bool okxIdTaken(const std::string& okx_order_id) const {
+        for (const auto& [handle, order] : live_) {
+            if (order.okx_order_id == okx_order_id) return true;
+        }
+        return false;
+    }
+
+    bool check(size_t step, const std::vector<uint32_t>& state_ids, const std::vector<std::string>& okx_ids) {
+        step_ = step;
+        if (store_.size() != live_.size()) return fail("size differs");
+
+        for (const auto& [handle, order] : live_) {
+            const OrderInfo* stored = store_.get(handle);
+            if (!stored || stored->state_id != order.state_id || stored->okx_order_id != order.okx_order_id ||
+                stored->fill_time != order.fill_time) {
+                return fail("stored order differs");
+            }
+            if (!order.okx_order_id.empty() && store_.findByOkxId(order.okx_order_id) != handle) {
+                return fail("findByOkxId missed a live order");
+            }
+        }
+
+        // Every ID drawn from, live or not
+        for (const uint32_t state_id : state_ids) {
+            if (store_.findByStateId(state_id) != newestWithStateId(state_id)) {
+                return fail("findByStateId is not the newest order with the ID");
+            }
+        }
+        for (const std::string& okx_order_id : okx_ids) {
+            if (!okxIdTaken(okx_order_id) && store_.findByOkxId(okx_order_id) != OrderStore::NONE) {
+                return fail("findByOkxId found an erased ID");
+            }
+        }
+        if (store_.findByOkxId("") != OrderStore::NONE) return fail("findByOkxId found the empty ID");
+
+        std::vector<OrderStore::Handle> listed;
+        for (OrderStore::Handle h = store_.oldest(); h != OrderStore::NONE && listed.size() <= live_.size();
+             h = store_.next(h)) {
+            listed.push_back(h);
+        }
+        if (listed != order_) return fail("insertion list differs");
+
+        // Fill time, ties in insertion order
+        std::vector<std::tuple<int64_t, uint64_t, uint32_t>> expected;
+        for (const auto& [handle, order] : live_) expected.emplace_back(order.fill_time, order.sequence, order.state_id);
+        std::sort(expected.begin(), expected.end());
+        std::vector<std::pair<int64_t, uint32_t>> by_fill_time;
+        store_.forEachByFillTime([&](const OrderInfo& order) { by_fill_time.emplace_back(order.fill_time, order.state_id); });
+        if (by_fill_time.size() != expected.size()) return fail("fill-time order has the wrong size");
+        for (size_t i = 0; i < expected.size(); ++i) {
+            if (by_fill_time[i] != std::make_pair(std::get<0>(expected[i]), std::get<2>(expected[i]))) {
+                return fail("fill-time order differs");
+            }
+        }
+        return true;
+    }
+
+private:
+    OrderStore::Handle newestWithStateId(uint32_t state_id) const {
+        OrderStore::Handle newest = OrderStore::NONE;
+        uint64_t newest_sequence = 0;
+        for (const auto& [handle, order] : live_) {
+            if (order.state_id == state_id && (newest == OrderStore::NONE || order.sequence > newest_sequence)) {
+                newest = handle;
+                newest_sequence = order.sequence;
+            }
+        }
+        return newest;
+    }
+
+    bool fail(const char* what) {
+        std::printf("FAIL %s step %zu: %s\n", phase_, step_, what);
+        ++failures;
+        return false;
+    }
+
+    const char* phase_;
+    size_t step_ = 0;
+    OrderStore store_;
+    std::unordered_map<OrderStore::Handle, Expected> live_;
+    std::vector<OrderStore::Handle> order_;  // Live handles, oldest first
+    uint64_t sequence_ = 0;
+};
+
+// One random operation. Colliding IDs repeat, so several live orders share a state ID.
+void randomStep(Checker& checker, uint64_t& seed, size_t max_orders, const std::vector<uint32_t>& state_ids,
+                const std::vector<std::string>& okx_ids, bool growing) {
+    const uint64_t op = nextRandom(seed) % 10;
+    auto randomOkxId = [&]() -> std::string {
+        const std::string& id = okx_ids[nextRandom(seed) % okx_ids.size()];
+        return checker.okxIdTaken(id) ? std::string() : id;  // OKX IDs are unique
+    };
+
+    if (checker.size() == 0 || (op < (growing ? 6u : 4u) && checker.size() < max_orders)) {
+        checker.insert(state_ids[nextRandom(seed) % state_ids.size()], nextRandom(seed) % 3 ? randomOkxId() : "");
+        return;
+    }
+    const OrderStore::Handle handle = checker.handles()[nextRandom(seed) % checker.size()];
+    if (op < 7) {
+        checker.erase(handle);
+    } else if (op < 8) {
+        checker.setOkxId(handle, nextRandom(seed) % 4 ? randomOkxId() : "");
+    } else {
+        // Few distinct fill times, so ties are common
+        checker.setFillTime(handle, static_cast<int64_t>(nextRandom(seed) % 6) * 1000);
+    }
+}
+
+void checkCollisions() {
+    const std::vector<uint32_t> state_ids = collidingStateIds();
+    const std::vector<std::string> okx_ids = collidingOkxIds();
+    Checker checker("collisions");
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    for (size_t step = 0; step < CHURN_STEPS; ++step) {
+        randomStep(checker, seed, CAPACITY, state_ids, okx_ids, false);
+        if (!checker.check(step, state_ids, okx_ids)) return;
+    }
+    std::printf("ok collisions\n");
+}
+
+void checkGrowth() {
+    std::vector<uint32_t> state_ids;
+    for (uint32_t id = 0; id < 4000; ++id) state_ids.push_back(id * 7 % 65536);
+    std::vector<std::string> okx_ids;
+    for (uint64_t n = 0; n < 4000; ++n) okx_ids.push_back(std::to_string(700000000000000000ULL + n * 31));
+
+    Checker checker("growth");
+    uint64_t seed = 0xD1B54A32D192ED03ULL;
+    for (size_t step = 0; step < GROWTH_STEPS; ++step) {
+        randomStep(checker, seed, GROWTH_MAX_ORDERS, state_ids, okx_ids, step < GROWTH_STEPS / 2);
+        // The full scan is quadratic, so only the first steps and every 500th are checked fully
+        if ((step < 200 || step % 500 == 0) && !checker.check(step, state_ids, okx_ids)) return;
+    }
+    if (!checker.check(GROWTH_STEPS, state_ids, okx_ids)) return;
+    std::printf("ok growth\n");
+}
+
+} // namespace
+
+int main() {
+    checkCollisions();
+    checkGrowth();
+    return failures == 0 ? 0 : 1;
+}
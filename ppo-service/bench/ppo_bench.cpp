@@ -0,0 +1,234 @@
+// Hot path benchmarks of the PPO service on synthetic orderbook states:
+//
+//   ppo_bench --benchmark_out=ppo.json --benchmark_out_format=json
+//
+// The states are generated from a fixed seed in the v2 and v3 wire formats the orderbook
+// service publishes, each changing a few levels of the previous book. The networks start from
+// fresh weights; no checkpoint is loaded or written. --benchmark_perf_counters=CYCLES,INSTRUCTIONS
+// adds hardware counters when Google Benchmark is built with libpfm.
+#include "../include/ppo_handler.hpp"
+#include <binary_utils.hpp>
+#include <orderbook_wire.hpp>
+#include <async_logger.hpp>
+#include <benchmark/benchmark.h>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+// Reaches the handler's decode, decision and training stages on their own, see the friend
+// declaration
+struct PPOBenchAccess {
+    static void handleMessage(PPOHandler& handler, std::string_view message) { handler.handleMessage(message); }
+    static torch::Tensor preprocessState(PPOHandler& handler) { return handler.preprocessState(); }
+
+    // The actor forward of forwardPass(), without the exploration and the publish
+    static std::tuple<torch::Tensor, torch::Tensor> decide(PPOHandler& handler) {
+        torch::NoGradGuard no_grad;
+        if (handler.incremental_inference_) {
+            return handler.incremental_actors_[0].forward(handler.state_ring_);
+        }
+        return handler.inference_actors_.buffer(0)->forward(
+            handler.preprocessState().to(precisionDtype(handler.inference_precision_)));
+    }
+
+    // A completed trade of orders orders, each on the newest window
+    static LearnerJob job(PPOHandler& handler, size_t orders) {
+        LearnerJob job;
+        job.trade.reward = 0.5;
+        for (size_t i = 0; i < orders; ++i) {
+            job.states.push_back(handler.state_ring_.window().clone());
+            job.coefficients.push_back(1.0 / static_cast<double>(orders));
+        }
+        return job;
+    }
+
+    // Fill the replay, so every update trains on the full MAX_REPLAY_SAMPLES as in steady state
+    static void fillReplay(PPOHandler& handler) {
+        const int64_t samples = static_cast<int64_t>(PPOHandler::MAX_REPLAY_SAMPLES);
+        auto options = torch::TensorOptions().dtype(torch::kFloat64).device(handler.device_);
+        auto states = handler.state_ring_.window().repeat({samples, 1, 1});
+        auto probabilities = torch::full({samples}, 0.5, options);
+        handler.replay_.add(states, torch::full({samples}, 0.1, options), torch::ones({samples}, options),
+                            probabilities, probabilities);
+    }
+
+    static void updateNetworks(PPOHandler& handler, const LearnerJob& job) { handler.updateNetworks(job); }
+};
+
+namespace {
+
+constexpr size_t STATES = 1024;          // Messages per stream, replayed in a loop
+constexpr size_t CHANGED_LEVELS = 10;    // Levels per side that differ from the previous state
+constexpr uint64_t SEED = 20240101;
+
+// The same sequence of books as v2 and v3 messages, state IDs 0 to STATES - 1
+struct Streams {
+    std::vector<std::vector<char>> v2;
+    std::vector<std::vector<char>> v3;
+
+    static const Streams& get() {
+        static const Streams streams;
+        return streams;
+    }
+
+private:
+    Streams() {
+        using namespace orderbook_wire;
+        std::mt19937_64 rng(SEED);
+        std::uniform_real_distribution<double> volume(0.01, 500.0);
+        std::uniform_int_distribution<size_t> level(0, LEVELS - 1);
+
+        // [price, volume, orders] per level, best first, around 65000 in 0.1 ticks
+        std::vector<double> bids(SIDE_VALUES), asks(SIDE_VALUES);
+        for (size_t i = 0; i < LEVELS; ++i) {
+            bids[i * 3] = 65000.0 - 0.1 * static_cast<double>(i + 1);
+            asks[i * 3] = 65000.0 + 0.1 * static_cast<double>(i + 1);
+            bids[i * 3 + 1] = volume(rng);
+            asks[i * 3 + 1] = volume(rng);
+            bids[i * 3 + 2] = asks[i * 3 + 2] = static_cast<double>(1 + i % 40);
+        }
+        std::array<double, FEATURE_VALUES> features{};
+        std::uniform_real_distribution<double> feature(-0.5, 0.5);
+        const uint32_t mid_price_cents = 6500000;
+
+        DeltaEncoder encoder;
+        std::vector<char> encoded;
+        for (size_t s = 0; s < STATES; ++s) {
+            for (size_t c = 0; c < CHANGED_LEVELS; ++c) {
+                bids[level(rng) * 3 + 1] = volume(rng);
+                asks[level(rng) * 3 + 1] = volume(rng);
+            }
+            for (double& value : features) value = feature(rng);
+            const auto state_id = static_cast<uint16_t>(s);
+
+            // v2: both sides, the features, the mid price in cents and the state ID
+            std::vector<char> message(V2_MESSAGE_SIZE);
+            char* out = message.data();
+            binary_utils::encodeLevels(bids.data(), LEVELS, out);
+            binary_utils::encodeLevels(asks.data(), LEVELS, out + SIDE_VALUES * sizeof(uint64_t));
+            out += 2 * SIDE_VALUES * sizeof(uint64_t);
+            binary_utils::encodeChangeValues(features.data(), FEATURE_VALUES, out);
+            out += FEATURE_VALUES * sizeof(uint64_t);
+            std::memcpy(out, &mid_price_cents, sizeof(mid_price_cents));
+            std::memcpy(out + sizeof(mid_price_cents), &state_id, sizeof(state_id));
+            v2.push_back(std::move(message));
+
+            // v3: the first state and every DEFAULT_KEYFRAME_INTERVAL-th are keyframes
+            const size_t size = encoder.encode(bids.data(), asks.data(), features.data(), mid_price_cents,
+                                               state_id, encoded);
+            v3.emplace_back(encoded.begin(), encoded.begin() + static_cast<std::ptrdiff_t>(size));
+        }
+    }
+};
+
+std::string_view view(const std::vector<char>& message) { return {message.data(), message.size()}; }
+
+// One handler for the whole run, with a full window of states. Never destroyed: its destructor
+// would checkpoint the benchmark's weights.
+PPOHandler& handler() {
+    static PPOHandler* handler = [] {
+        // Constructed away from the working directory so no models/ checkpoint there is loaded
+        const auto cwd = std::filesystem::current_path();
+        const auto scratch = std::filesystem::temp_directory_path() / "ppo_bench";
+        std::filesystem::create_directories(scratch);
+        std::filesystem::current_path(scratch);
+        auto* created = new PPOHandler("localhost", 5672, "guest", "guest");
+        std::filesystem::current_path(cwd);
+
+        for (size_t s = 0; s < PPOHandler::NETWORK_INPUT_SIZE; ++s) {
+            PPOBenchAccess::handleMessage(*created, view(Streams::get().v2[s]));
+        }
+        return created;
+    }();
+    return *handler;
+}
+
+// Decoding one state into the history ring. Arg: wire format (2 or 3)
+void BM_DecodeMessage(benchmark::State& state) {
+    const auto& stream = state.range(0) == 3 ? Streams::get().v3 : Streams::get().v2;
+    PPOHandler& ppo = handler();
+    size_t next = 0;
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        const auto& message = stream[next];
+        PPOBenchAccess::handleMessage(ppo, view(message));
+        bytes += static_cast<int64_t>(message.size());
+        next = (next + 1) % stream.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(bytes);
+}
+BENCHMARK(BM_DecodeMessage)->ArgName("wire")->Arg(2)->Arg(3);
+
+// The [1, 80, 2421] network input view of the newest states
+void BM_PreprocessState(benchmark::State& state) {
+    PPOHandler& ppo = handler();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(PPOBenchAccess::preprocessState(ppo));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PreprocessState);
+
+// One decision after a new state, the state's decode excluded.
+// Args: inference precision (0 float64, 1 float32, 2 bfloat16, 3 int8), incremental conv1 (0/1)
+void BM_ActorForward(benchmark::State& state) {
+    const auto precision = static_cast<InferencePrecision>(state.range(0));
+    const bool incremental = state.range(1) != 0;
+    PPOHandler& ppo = handler();
+    ppo.setInferencePrecision(precision);
+    ppo.setIncrementalInference(incremental);
+
+    const auto& stream = Streams::get().v2;
+    size_t next = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        PPOBenchAccess::handleMessage(ppo, view(stream[next]));
+        next = (next + 1) % stream.size();
+        state.ResumeTiming();
+
+        auto [price, volume] = PPOBenchAccess::decide(ppo);
+        benchmark::DoNotOptimize(price.item<double>());
+        benchmark::DoNotOptimize(volume.item<double>());
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(precisionName(precision));
+
+    ppo.setInferencePrecision(InferencePrecision::Float64);
+    ppo.setIncrementalInference(true);
+}
+BENCHMARK(BM_ActorForward)
+    ->ArgNames({"precision", "incremental"})
+    ->ArgsProduct({{0, 1, 2, 3}, {0, 1}})
+    ->Unit(benchmark::kMicrosecond);
+
+// One learner step on a completed trade: the PPO epochs over the full replay.
+// Arg: orders in the trade
+void BM_UpdateNetworks(benchmark::State& state) {
+    PPOHandler& ppo = handler();
+    PPOBenchAccess::fillReplay(ppo);
+    const LearnerJob job = PPOBenchAccess::job(ppo, static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        PPOBenchAccess::updateNetworks(ppo, job);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_UpdateNetworks)->ArgName("orders")->Arg(1)->Arg(8)->Unit(benchmark::kMillisecond);
+
+} // namespace
+
+int main(int argc, char** argv) {
+    logging::setLevel(logging::Level::Warn);
+    torch::manual_seed(SEED);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::AddCustomContext("torch_threads", std::to_string(torch::get_num_threads()));
+    benchmark::AddCustomContext("binary_utils_codec", binary_utils::activeCodecName());
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
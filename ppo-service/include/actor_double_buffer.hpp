@@ -0,0 +1,56 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include "inference_precision.hpp"
+#include "device.hpp"
+
+// Two decision copies of the master actor, so the learner can refresh weights while the
+// inference thread keeps deciding. The learner only ever writes the copy that is neither
+// published nor in use, and publishes it with a single atomic store; neither side locks.
+class ActorDoubleBuffer {
+public:
+    ActorDoubleBuffer() = default;  // Empty until reset()
+
+    ActorDoubleBuffer(const ActorDoubleBuffer&) = delete;
+    ActorDoubleBuffer& operator=(const ActorDoubleBuffer&) = delete;
+
+    // Rebuild both copies; only while no learner is running
+    void reset(const Actor& master, InferencePrecision precision) {
+        precision_ = precision;
+        buffers_ = {makeInferenceActor(master, precision), makeInferenceActor(master, precision)};
+        published_.store(0);
+        in_use_.store(0);
+    }
+
+    InferencePrecision precision() const { return precision_; }
+    Actor& buffer(size_t idx) { return buffers_[idx]; }
+
+    // Inference thread: index of the newest published copy, which it then holds until the next call
+    size_t acquire() {
+        const size_t idx = published_.load();
+        if (in_use_.load(std::memory_order_relaxed) != idx) {
+            in_use_.store(idx);
+        }
+        return idx;
+    }
+
+    // Learner thread: copy the master weights into the spare copy and publish it. False when the
+    // inference thread has not picked up the previous publish yet, so the spare is still in use.
+    bool publish(const Actor& master) {
+        const size_t target = 1 - published_.load();
+        if (in_use_.load() == target) {
+            return false;
+        }
+        syncInferenceActor(master, buffers_[target], precision_);
+        synchronizeDevice(master->parameters().front().device());  // Copies may still be queued on the learner's stream
+        published_.store(target);
+        return true;
+    }
+
+private:
+    std::array<Actor, 2> buffers_{Actor(nullptr), Actor(nullptr)};
+    InferencePrecision precision_ = InferencePrecision::Float64;
+    std::atomic<size_t> published_{0};  // Copy with the newest weights
+    std::atomic<size_t> in_use_{0};     // Copy the inference thread decides with
+};
@@ -0,0 +1,115 @@
+#pragma once
+#include <torch/torch.h>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "networks.hpp"
+
+// Several actors of the same architecture evaluated on one shared window in a single batched
+// forward. conv1 is one convolution over the stacked output channels of every member, which
+// turns K matvecs over the 2421 input features into one; conv2 is a grouped convolution and the
+// dense layers are batched matmuls. Only the LSTMs, which have no grouped form, run per member.
+// Row k of every output belongs to member k.
+class ActorEnsembleImpl : public torch::nn::Module {
+public:
+    explicit ActorEnsembleImpl(const std::vector<Actor>& members)
+        : members_(static_cast<int64_t>(members.size())) {
+        torch::NoGradGuard no_grad;
+        auto collect = [&members](const std::string& name) {
+            std::vector<torch::Tensor> tensors;
+            for (const auto& member : members) {
+                tensors.push_back(member->named_parameters()[name].detach());
+            }
+            return tensors;
+        };
+
+        const auto conv1_weight = torch::cat(collect("conv1.weight"));  // [K * 128, 2421, 3]
+        const auto conv2_weight = torch::cat(collect("conv2.weight"));  // [K * 64, 128, 3]
+        const int64_t kernel = conv1_weight.size(2);
+        conv1 = register_module("conv1", torch::nn::Conv1d(
+            torch::nn::Conv1dOptions(conv1_weight.size(1), conv1_weight.size(0), kernel).padding(kernel / 2)));
+        conv2 = register_module("conv2", torch::nn::Conv1d(
+            torch::nn::Conv1dOptions(conv1_weight.size(0), conv2_weight.size(0), kernel)
+                .padding(kernel / 2).groups(members_)));
+
+        // LSTM shape read off the first member's weights
+        const auto reference_params = members.front()->named_parameters();
+        int64_t lstm_layers = 0;
+        while (reference_params.contains("lstm.weight_ih_l" + std::to_string(lstm_layers))) {
+            ++lstm_layers;
+        }
+        const auto lstm_options = torch::nn::LSTMOptions(reference_params["lstm.weight_ih_l0"].size(1),
+                                                         reference_params["lstm.weight_hh_l0"].size(1))
+                                      .num_layers(lstm_layers).batch_first(true);
+        for (int64_t k = 0; k < members_; ++k) {
+            lstms_.push_back(register_module("lstm" + std::to_string(k), torch::nn::LSTM(lstm_options)));
+        }
+
+        // Nothing trains here, and the copies below convert to the members' dtype and device
+        const auto& reference = conv1_weight;
+        this->to(reference.device(), reference.scalar_type());
+        for (auto& parameter : this->parameters()) {
+            parameter.set_requires_grad(false);
+        }
+
+        conv1->weight.copy_(conv1_weight);
+        conv1->bias.copy_(torch::cat(collect("conv1.bias")));
+        conv2->weight.copy_(conv2_weight);
+        conv2->bias.copy_(torch::cat(collect("conv2.bias")));
+        for (int64_t k = 0; k < members_; ++k) {
+            auto member = members[k]->named_parameters();
+            for (auto& parameter : lstms_[k]->named_parameters()) {
+                parameter.value().copy_(member["lstm." + parameter.key()]);
+            }
+        }
+
+        // Linear weights as [K, in, out] for baddbmm, biases as [K, 1, out]
+        auto dense = [&](const std::string& layer, torch::Tensor& weight, torch::Tensor& bias) {
+            weight = register_buffer(layer + "_weight", torch::stack(collect(layer + ".weight")).transpose(1, 2).contiguous());
+            bias = register_buffer(layer + "_bias", torch::stack(collect(layer + ".bias")).unsqueeze(1));
+        };
+        dense("fc1", fc1_weight_, fc1_bias_);
+        dense("fc2", fc2_weight_, fc2_bias_);
+        dense("price_head", price_weight_, price_bias_);
+        dense("volume_head", volume_weight_, volume_bias_);
+    }
+
+    int64_t size() const { return members_; }
+
+    // x: one shared [1, 80, 2421] window; returns price and volume as [K, 1]
+    std::tuple<torch::Tensor, torch::Tensor> forward(torch::Tensor x) {
+        x = x.transpose(1, 2);  // [1, 2421, 80]
+        x = torch::relu(conv1->forward(x));  // [1, K * 128, 80]
+        return forwardFromConv1(x);
+    }
+
+    // Remainder of forward() from the activated conv1 output [1, K * 128, 80]
+    std::tuple<torch::Tensor, torch::Tensor> forwardFromConv1(torch::Tensor x) {
+        x = torch::relu(conv2->forward(x));  // [1, K * 64, 80]
+        x = x.view({members_, -1, x.size(2)}).transpose(1, 2);  // [K, 80, 64]
+
+        std::vector<torch::Tensor> sequences;
+        sequences.reserve(members_);
+        for (int64_t k = 0; k < members_; ++k) {
+            sequences.push_back(std::get<0>(lstms_[k]->forward(x.narrow(0, k, 1))));  // [1, 80, 32]
+        }
+        x = torch::cat(sequences).reshape({members_, 1, -1});  // [K, 1, 80 * 32]
+
+        x = torch::relu(torch::baddbmm(fc1_bias_, x, fc1_weight_));  // [K, 1, 128]
+        x = torch::relu(torch::baddbmm(fc2_bias_, x, fc2_weight_));  // [K, 1, 64]
+        auto price = torch::tanh(torch::baddbmm(price_bias_, x, price_weight_)).view({members_, 1});
+        auto volume = torch::sigmoid(torch::baddbmm(volume_bias_, x, volume_weight_)).view({members_, 1});
+        return std::make_tuple(price, volume);
+    }
+
+    // Stacked first convolution, for incremental inference
+    const torch::nn::Conv1d& firstConv() const { return conv1; }
+
+private:
+    int64_t members_;
+    torch::nn::Conv1d conv1{nullptr}, conv2{nullptr};
+    std::vector<torch::nn::LSTM> lstms_;
+    torch::Tensor fc1_weight_, fc1_bias_, fc2_weight_, fc2_bias_;
+    torch::Tensor price_weight_, price_bias_, volume_weight_, volume_bias_;
+};
+TORCH_MODULE(ActorEnsemble);
@@ -0,0 +1,77 @@
+#pragma once
+#include <torch/torch.h>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Host copy of one network's parameters and Adam state, in optimizer parameter order
+struct NetworkSnapshot {
+    std::vector<torch::Tensor> parameters;
+    std::vector<torch::Tensor> exp_avg;     // Empty until the optimizer has stepped
+    std::vector<torch::Tensor> exp_avg_sq;
+    std::vector<int64_t> steps;
+};
+
+struct CheckpointSnapshot {
+    NetworkSnapshot actor;
+    NetworkSnapshot critic;
+    std::string reason;  // Logged once the checkpoint is on disk
+};
+
+// Copy the optimizer's parameters and Adam moments to the host; only while nothing trains
+NetworkSnapshot snapshotNetwork(torch::optim::Adam& optimizer);
+
+// Copy a snapshot back into the optimizer's parameters and Adam state; throws if it does not fit
+void restoreNetwork(const NetworkSnapshot& snapshot, torch::optim::Adam& optimizer);
+
+// Copy snapshot parameters into a network without an optimizer, e.g. a frozen shadow policy
+void restoreParameters(const NetworkSnapshot& snapshot, torch::nn::Module& module);
+
+// Move Adam state to the device its parameters were moved to
+void moveOptimizerState(torch::optim::Adam& optimizer, const torch::Device& device);
+
+// Writes checkpoints on a thread of its own, so a save costs the caller only the snapshot copy.
+// Every checkpoint goes to a temporary file that is synced and then renamed into place, so a
+// crash leaves the previous versions intact; the newest `versions` files are kept.
+class Checkpointer {
+public:
+    Checkpointer(const std::string& directory, const std::string& name, size_t versions);
+    ~Checkpointer();  // Writes a snapshot still waiting before returning
+
+    Checkpointer(const Checkpointer&) = delete;
+    Checkpointer& operator=(const Checkpointer&) = delete;
+
+    // Queue a snapshot for writing. It replaces one that is still waiting, so a slow disk
+    // never backs up the caller.
+    void write(CheckpointSnapshot snapshot);
+
+    // Newest checkpoint that reads back completely, trying older versions after a bad one
+    std::optional<CheckpointSnapshot> loadNewest() const;
+
+    // One checkpoint file, onto the CPU; throws if it cannot be read completely
+    static CheckpointSnapshot read(const std::filesystem::path& path);
+
+private:
+    void run();
+    void writeFile(const CheckpointSnapshot& snapshot);
+    void prune() const;
+    std::vector<std::filesystem::path> versionFiles() const;  // Newest first
+    std::filesystem::path versionPath(uint64_t version) const;
+    std::optional<uint64_t> versionOf(const std::filesystem::path& path) const;
+
+    std::filesystem::path directory_;
+    std::string name_;  // Files are <name>-<version>.pt
+    size_t versions_;
+    uint64_t next_version_ = 0;  // Writer thread only after construction
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::optional<CheckpointSnapshot> pending_;  // Guarded by mutex_
+    bool running_ = true;                        // Guarded by mutex_
+};
@@ -0,0 +1,63 @@
+#pragma once
+#ifdef PPO_WITH_CUDA
+#include <torch/torch.h>
+#include <ATen/cuda/CUDAGraph.h>
+#include <c10/cuda/CUDAGuard.h>
+#include <c10/cuda/CUDAStream.h>
+#include <tuple>
+#include "networks.hpp"
+
+// Replays one captured actor forward for the fixed [1, Window, 2421] decision input, so a
+// decision costs one graph launch instead of a launch per kernel. The graph reads the actor's
+// weights in place, so it stays valid across syncInferenceActor() refreshes of the same copy.
+class CudaGraphActor {
+public:
+    static constexpr int WARMUP_RUNS = 3;  // Lazily initialised kernels (cuDNN, cuBLAS) must not be captured
+
+    explicit CudaGraphActor(Actor actor) : actor_(std::move(actor)) {}
+
+    CudaGraphActor(const CudaGraphActor&) = delete;
+    CudaGraphActor& operator=(const CudaGraphActor&) = delete;
+
+    // Captures on the first call. The outputs are overwritten by the next call, read them first.
+    std::tuple<torch::Tensor, torch::Tensor> forward(const torch::Tensor& window) {
+        if (!captured_) {
+            capture(window);
+        }
+        static_input_.copy_(window);
+        graph_.replay();
+        return {static_price_, static_volume_};
+    }
+
+private:
+    void capture(const torch::Tensor& window) {
+        torch::NoGradGuard no_grad;
+        static_input_ = window.clone();
+
+        // Capture is not allowed on the default stream; replays then run on the caller's stream
+        const auto index = window.device().index();
+        c10::cuda::getCurrentCUDAStream(index).synchronize();
+        auto stream = c10::cuda::getStreamFromPool(/*isHighPriority=*/false, index);
+        {
+            c10::cuda::CUDAStreamGuard guard(stream);
+            for (int i = 0; i < WARMUP_RUNS; ++i) {
+                actor_->forward(static_input_);
+            }
+            stream.synchronize();
+
+            graph_.capture_begin();
+            std::tie(static_price_, static_volume_) = actor_->forward(static_input_);
+            graph_.capture_end();
+        }
+        stream.synchronize();
+        captured_ = true;
+    }
+
+    Actor actor_;
+    at::cuda::CUDAGraph graph_;
+    bool captured_ = false;
+    torch::Tensor static_input_;  // Graph input; every replay first copies the window into it
+    torch::Tensor static_price_;
+    torch::Tensor static_volume_;
+};
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+#include <torch/torch.h>
+#include <memory>
+#include <string>
+
+// Device the networks run on. Selecting a CUDA device works with any LibTorch build that has
+// CUDA; the learner side stream and CUDA graph capture additionally need the CUDA headers and
+// are compiled in with the PPO_WITH_CUDA CMake option.
+
+// auto (CUDA when available, otherwise CPU), cpu, cuda or cuda:<index>; throws when the name is
+// unknown or the device is not available
+torch::Device resolveDevice(const std::string& name);
+
+// Wait for the work this thread queued on the device, before its results go to another thread
+void synchronizeDevice(const torch::Device& device);
+
+// For its lifetime, runs the calling thread's kernels on a stream of their own, so training
+// neither queues behind nor delays decision kernels. A no-op on CPU or without PPO_WITH_CUDA.
+class SideStreamScope {
+public:
+    explicit SideStreamScope(const torch::Device& device);
+    ~SideStreamScope();
+
+    SideStreamScope(const SideStreamScope&) = delete;
+    SideStreamScope& operator=(const SideStreamScope&) = delete;
+
+private:
+    struct Guard;
+    std::unique_ptr<Guard> guard_;
+};
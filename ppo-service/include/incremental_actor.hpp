@@ -0,0 +1,132 @@
+#pragma once
+#include <torch/torch.h>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <tuple>
+#include <async_logger.hpp>
+#include "networks.hpp"
+#include "state_ring.hpp"
+
+// Actor inference over the sliding state window that runs conv1 only on states it has not seen.
+//
+// conv1 (2421 -> 128, kernel 3, padding 1) is nearly all of the actor's FLOPs. Output column j
+// is b + W0 x[j-1] + W1 x[j] + W2 x[j+1], with zeros past either end of the window. Caching output
+// columns would not survive a slide, since the edge columns change with the padding, so the three
+// tap products Wk x are cached per state instead: a new state costs one [384 x 2421] matvec and
+// every column, edges included, is reassembled from the cache with a few additions.
+//
+// Everything after conv1 is recomputed. conv2 is cheap, and the LSTM cannot be advanced by a
+// single step: each window runs it from a zero state at its oldest state, so once the window
+// slides all 80 hidden states differ, and fc1 reads every one of them.
+//
+// Network is an Actor or anything with the same firstConv()/forwardFromConv1() split, such as
+// an ActorEnsemble, whose stacked conv1 is cached the same way.
+template <size_t Window, typename Network = Actor>
+class IncrementalActor {
+public:
+    static constexpr int64_t TAPS = 3;              // conv1 kernel size
+    static constexpr size_t VERIFY_INTERVAL = 500;  // Decisions between checks against the full forward
+
+    explicit IncrementalActor(Network actor) : actor_(std::move(actor)) {
+        cached_seq_.fill(NONE);
+    }
+
+    // Drop all cached taps; required whenever the actor's weights change
+    void invalidate() {
+        cached_seq_.fill(NONE);
+        tap_weights_ = torch::Tensor();
+    }
+
+    // Same result as actor->forward(ring.window()) in the actor's dtype; needs ring.size() >= Window
+    template <size_t Capacity>
+    std::tuple<torch::Tensor, torch::Tensor> forward(const StateRing<Capacity, Window>& ring) {
+        torch::NoGradGuard no_grad;
+        if (!tap_weights_.defined()) {
+            loadWeights();
+        }
+
+        // Compute taps for the window states not cached yet, usually the one or two newest
+        const uint64_t first = ring.sequence() - Window;
+        const torch::Tensor window = ring.window()[0];  // [Window, 2421]
+        std::array<int64_t, Window> positions;
+        std::array<int64_t, Window> slots;
+        int64_t missing = 0;
+        for (size_t n = 0; n < Window; ++n) {
+            const uint64_t seq = first + n;
+            if (cached_seq_[seq % Window] != seq) {
+                positions[missing] = static_cast<int64_t>(n);
+                slots[missing] = static_cast<int64_t>(seq % Window);
+                cached_seq_[seq % Window] = seq;
+                ++missing;
+            }
+        }
+        if (missing > 0) {
+            auto index_options = torch::TensorOptions().dtype(torch::kInt64);
+            auto position_index = torch::from_blob(positions.data(), {missing}, index_options).to(window.device());
+            auto slot_index = torch::from_blob(slots.data(), {missing}, index_options).to(window.device());
+            auto states = window.index_select(0, position_index).to(tap_weights_.scalar_type());
+            auto taps = torch::matmul(states, tap_weights_.t()).view({missing, TAPS, channels_});
+            taps_.index_copy_(0, slot_index, taps);
+        }
+
+        // The cache is keyed by sequence % Window, so window order is a rotation of it
+        auto ordered = torch::roll(taps_, -static_cast<int64_t>(first % Window), 0);  // [Window, 3, 128]
+        auto pre = ordered.select(1, 1) + bias_;
+        pre.narrow(0, 1, Window - 1).add_(ordered.select(1, 0).narrow(0, 0, Window - 1));
+        pre.narrow(0, 0, Window - 1).add_(ordered.select(1, 2).narrow(0, 1, Window - 1));
+        auto conv1_out = torch::relu(pre).t().unsqueeze(0);  // [1, 128, Window]
+
+        auto result = actor_->forwardFromConv1(conv1_out);
+        if (++decisions_ % VERIFY_INTERVAL == 0) {
+            return verify(window.unsqueeze(0), result);
+        }
+        return result;
+    }
+
+private:
+    static constexpr uint64_t NONE = std::numeric_limits<uint64_t>::max();
+
+    void loadWeights() {
+        const auto& conv1 = actor_->firstConv();
+        channels_ = conv1->weight.size(0);
+        // [128, 2421, 3] -> [3 * 128, 2421], row k * 128 + o holding tap k of output channel o
+        tap_weights_ = conv1->weight.detach().permute({2, 0, 1}).reshape({TAPS * channels_, conv1->weight.size(1)}).contiguous();
+        bias_ = conv1->bias.detach().clone();
+        taps_ = torch::zeros({static_cast<int64_t>(Window), TAPS, channels_}, tap_weights_.options());
+        cached_seq_.fill(NONE);
+    }
+
+    // Compare against the full forward; on divergence rebuild the cache and return the full result
+    std::tuple<torch::Tensor, torch::Tensor> verify(const torch::Tensor& input,
+                                                    const std::tuple<torch::Tensor, torch::Tensor>& result) {
+        auto full = actor_->forward(input.to(tap_weights_.scalar_type()));
+        const double diff = std::max(
+            (std::get<0>(full) - std::get<0>(result)).abs().max().item<double>(),
+            (std::get<1>(full) - std::get<1>(result)).abs().max().item<double>());
+        if (diff > verifyTolerance(tap_weights_.scalar_type())) {
+            LOG_RATE_LIMITED(10000, Warn, "Incremental actor differs from the full forward by {}, rebuilding its conv1 cache",
+                             diff);
+            invalidate();
+            return full;
+        }
+        return result;
+    }
+
+    // Summation order differs from the convolution kernel, so allow for the dtype's rounding
+    static double verifyTolerance(torch::ScalarType dtype) {
+        switch (dtype) {
+            case torch::kFloat64: return 1e-9;
+            case torch::kFloat32: return 1e-4;
+            default: return 5e-2;
+        }
+    }
+
+    Network actor_;
+    torch::Tensor tap_weights_;  // Undefined until the first forward after invalidate()
+    torch::Tensor bias_;
+    torch::Tensor taps_;         // [Window, 3, 128] tap products, slot = sequence % Window
+    int64_t channels_ = 0;
+    std::array<uint64_t, Window> cached_seq_;  // Sequence whose taps each slot holds
+    uint64_t decisions_ = 0;
+};
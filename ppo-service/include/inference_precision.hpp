@@ -0,0 +1,30 @@
+#pragma once
+#include <torch/torch.h>
+#include <ostream>
+#include <string>
+#include "networks.hpp"
+
+// Precision of the actor copy used for decisions. Training always runs on the float64 master.
+enum class InferencePrecision {
+    Float64,   // The master weights themselves
+    Float32,
+    BFloat16,  // Only faster on CPUs with native bf16 (AVX512-BF16, AMX)
+    Int8,      // Float32 convolutions and LSTM, int8 fc1/fc2 with dynamic activation quantization; CPU only
+};
+
+const char* precisionName(InferencePrecision precision);
+bool parsePrecision(const std::string& name, InferencePrecision& precision);
+
+// Floating point type the inference copy computes in
+torch::ScalarType precisionDtype(InferencePrecision precision);
+
+// Copy of the master actor for decisions at this precision, in eval mode and on the master's
+// device. Float64 is copied too, since the learner keeps training the master while decisions
+// are made. Throws for Int8 on a CUDA master.
+Actor makeInferenceActor(const Actor& master, InferencePrecision precision);
+
+// Refresh an inference copy from updated master weights
+void syncInferenceActor(const Actor& master, Actor& inference, InferencePrecision precision);
+
+// Decision latency and action divergence from float64 for every precision, on random windows
+void benchmarkPrecisions(const Actor& master, size_t iterations, std::ostream& out);
@@ -0,0 +1,122 @@
+#pragma once
+#include <torch/torch.h>
+#include <cmath>
+#include <tuple>
+#include "quantized_linear.hpp"
+
+// Actor network architecture (using float64/double precision)
+class ActorImpl : public torch::nn::Module {
+public:
+    ActorImpl(int input_size)
+        : conv1(register_module("conv1", torch::nn::Conv1d(torch::nn::Conv1dOptions(2421, 128, 3).padding(1)))),
+          conv2(register_module("conv2", torch::nn::Conv1d(torch::nn::Conv1dOptions(128, 64, 3).padding(1)))),
+          lstm(register_module("lstm", torch::nn::LSTM(torch::nn::LSTMOptions(64, 32).num_layers(2).batch_first(true)))),
+          fc1(register_module("fc1", torch::nn::Linear(32 * 80, 128))),
+          fc2(register_module("fc2", torch::nn::Linear(128, 64))),
+          price_head(register_module("price_head", torch::nn::Linear(64, 1))),
+          volume_head(register_module("volume_head", torch::nn::Linear(64, 1))) {
+        
+        // Initialize price_head with smaller weights
+        double k = 1.0 / std::sqrt(64.0);  // Xavier/Glorot initialization scale
+        torch::nn::init::uniform_(price_head->weight, -k, k);
+        torch::nn::init::zeros_(price_head->bias);
+        
+        // Convert the entire module to double precision
+        this->to(torch::kFloat64);
+    }
+
+    std::tuple<torch::Tensor, torch::Tensor> forward(torch::Tensor x) {
+        // x shape: [batch_size, sequence_length=80, features=2421]
+        x = x.transpose(1, 2);  // [batch_size, features=2421, sequence_length=80]
+        
+        // Apply 1D convolutions
+        x = torch::relu(conv1->forward(x));  // [batch_size, 128, 80]
+        return forwardFromConv1(x);
+    }
+
+    // Remainder of forward() from the activated conv1 output [batch_size, 128, 80]
+    std::tuple<torch::Tensor, torch::Tensor> forwardFromConv1(torch::Tensor x) {
+        x = torch::relu(conv2->forward(x));  // [batch_size, 64, 80]
+        
+        // Prepare for LSTM
+        x = x.transpose(1, 2);  // [batch_size, 80, 64]
+        
+        // Apply LSTM
+        auto lstm_out = std::get<0>(lstm->forward(x));  // [batch_size, 80, 32]
+        
+        // Flatten the sequence
+        x = lstm_out.reshape({lstm_out.size(0), -1});  // [batch_size, 80 * 32]
+        
+        // Dense layers
+        x = torch::relu(quantized_fc1_.defined() ? quantized_fc1_.forward(x) : fc1->forward(x));
+        x = torch::relu(quantized_fc2_.defined() ? quantized_fc2_.forward(x) : fc2->forward(x));
+        
+        auto price = torch::tanh(price_head->forward(x));
+        auto volume = torch::sigmoid(volume_head->forward(x));
+        
+        return std::make_tuple(price, volume);
+    }
+
+    // Run fc1 and fc2 with int8 weights from now on; only for a float32 inference copy.
+    // Call again after the float weights change.
+    void quantizeDense() {
+        quantized_fc1_ = DynamicQuantizedLinear(fc1);
+        quantized_fc2_ = DynamicQuantizedLinear(fc2);
+    }
+
+    // First convolution, for incremental inference
+    const torch::nn::Conv1d& firstConv() const { return conv1; }
+
+private:
+    torch::nn::Conv1d conv1, conv2;
+    torch::nn::LSTM lstm;
+    torch::nn::Linear fc1, fc2, price_head, volume_head;
+    DynamicQuantizedLinear quantized_fc1_, quantized_fc2_;  // Unset for float inference and training
+};
+TORCH_MODULE(Actor);
+
+// Critic network architecture (using float64/double precision)
+class CriticImpl : public torch::nn::Module {
+public:
+    CriticImpl(int input_size)
+        : conv1(register_module("conv1", torch::nn::Conv1d(torch::nn::Conv1dOptions(2421, 128, 3).padding(1)))),
+          conv2(register_module("conv2", torch::nn::Conv1d(torch::nn::Conv1dOptions(128, 64, 3).padding(1)))),
+          lstm(register_module("lstm", torch::nn::LSTM(torch::nn::LSTMOptions(64, 32).num_layers(2).batch_first(true)))),
+          fc1(register_module("fc1", torch::nn::Linear(32 * 80, 128))),
+          fc2(register_module("fc2", torch::nn::Linear(128, 64))),
+          value_head(register_module("value_head", torch::nn::Linear(64, 1))) {
+        
+        // Convert the entire module to double precision
+        this->to(torch::kFloat64);
+    }
+
+    torch::Tensor forward(torch::Tensor x) {
+        // x shape: [batch_size, sequence_length=80, features=2421]
+        x = x.transpose(1, 2);  // [batch_size, features=2421, sequence_length=80]
+        
+        // Apply 1D convolutions
+        x = torch::relu(conv1->forward(x));  // [batch_size, 128, 80]
+        x = torch::relu(conv2->forward(x));  // [batch_size, 64, 80]
+        
+        // Prepare for LSTM
+        x = x.transpose(1, 2);  // [batch_size, 80, 64]
+        
+        // Apply LSTM
+        auto lstm_out = std::get<0>(lstm->forward(x));  // [batch_size, 80, 32]
+        
+        // Flatten the sequence
+        x = lstm_out.reshape({lstm_out.size(0), -1});  // [batch_size, 80 * 32]
+        
+        // Dense layers
+        x = torch::relu(fc1->forward(x));
+        x = torch::relu(fc2->forward(x));
+        
+        return value_head->forward(x);
+    }
+
+private:
+    torch::nn::Conv1d conv1, conv2;
+    torch::nn::LSTM lstm;
+    torch::nn::Linear fc1, fc2, value_head;
+};
+TORCH_MODULE(Critic);
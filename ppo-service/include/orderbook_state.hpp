@@ -1,41 +1,37 @@
 #pragma once
 #include <array>
 #include <cstddef>
+#include <cstdint>
 
+// Layout of one state as a network input row. States are stored as rows of the
+// StateRing tensor, so this only describes where each field lives in a row.
 struct OrderBookState {
     static constexpr size_t LEVELS = 400;
     static constexpr size_t VALUES_PER_LEVEL = 3;  // price, volume, orders
     static constexpr size_t NUM_DEPTHS = 5;        // 10, 20, 50, 100, 400
     static constexpr size_t NUM_FEATURES = 4;      // volume imbalance, order imbalance, bid/ask VWAP
 
-    // Main orderbook data
-    std::array<double, LEVELS * VALUES_PER_LEVEL> bids;  // 1200 values
-    std::array<double, LEVELS * VALUES_PER_LEVEL> asks;  // 1200 values
-    
-    // Market features
-    double mid_price_change;
-    double mid_price;  // Actual mid-price value (not used as a feature)
-    std::array<double, NUM_DEPTHS * NUM_FEATURES> features;  // 20 values
+    static constexpr size_t SIDE_VALUES = LEVELS * VALUES_PER_LEVEL;  // 1200 values per side
+    static constexpr size_t NUM_MARKET_FEATURES = NUM_DEPTHS * NUM_FEATURES;  // 20 values
 
-    // State identification
-    uint16_t state_id;  // ID from orderbook service (0-65535)
+    // Offsets within a row: bids, asks, mid price change, then the [depth][feature] market features
+    static constexpr size_t BIDS_OFFSET = 0;
+    static constexpr size_t ASKS_OFFSET = BIDS_OFFSET + SIDE_VALUES;
+    static constexpr size_t MID_PRICE_CHANGE_OFFSET = ASKS_OFFSET + SIDE_VALUES;
+    static constexpr size_t FEATURES_OFFSET = MID_PRICE_CHANGE_OFFSET + 1;
 
-    // Helper methods for accessing data
-    inline double* bid_level(size_t level) {
-        return &bids[level * VALUES_PER_LEVEL];
-    }
-    
-    inline double* ask_level(size_t level) {
-        return &asks[level * VALUES_PER_LEVEL];
-    }
-    
-    inline double& feature_at(size_t depth, size_t feature) {
-        return features[depth * NUM_FEATURES + feature];
-    }
-    
     // Total number of features for tensor creation (mid_price is not included)
     static constexpr size_t TOTAL_FEATURES = 
         LEVELS * VALUES_PER_LEVEL * 2 +  // bids and asks
         1 +                              // mid price change
         NUM_DEPTHS * NUM_FEATURES;       // market features
-}; 
\ No newline at end of file
+
+    static_assert(FEATURES_OFFSET + NUM_MARKET_FEATURES == TOTAL_FEATURES, "Row layout out of sync");
+};
+
+// Values carried with each state that are not network inputs
+struct StateInfo {
+    uint16_t state_id = 0;  // ID from orderbook service (0-65535)
+    double mid_price = 0.0;  // Actual mid-price value (not used as a feature)
+    uint64_t origin_ns = 0;  // Arrival at the orderbook service (v3 only, 0 if unknown)
+};
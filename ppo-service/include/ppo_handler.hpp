@@ -7,109 +7,27 @@
 #include <torch/torch.h>
 #include <memory>
 #include <iomanip>
+#include <array>
+#include <thread>
+#include <optional>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
 #include <nlohmann/json.hpp>
+#include <latency_histogram.hpp>
+#include <amqp_consumer.hpp>
+#include <transport.hpp>
 #include "orderbook_state.hpp"
-
-// Actor network architecture (using float64/double precision)
-class ActorImpl : public torch::nn::Module {
-public:
-    ActorImpl(int input_size)
-        : conv1(register_module("conv1", torch::nn::Conv1d(torch::nn::Conv1dOptions(2421, 128, 3).padding(1)))),
-          conv2(register_module("conv2", torch::nn::Conv1d(torch::nn::Conv1dOptions(128, 64, 3).padding(1)))),
-          lstm(register_module("lstm", torch::nn::LSTM(torch::nn::LSTMOptions(64, 32).num_layers(2).batch_first(true)))),
-          fc1(register_module("fc1", torch::nn::Linear(32 * 80, 128))),
-          fc2(register_module("fc2", torch::nn::Linear(128, 64))),
-          price_head(register_module("price_head", torch::nn::Linear(64, 1))),
-          volume_head(register_module("volume_head", torch::nn::Linear(64, 1))) {
-        
-        // Initialize price_head with smaller weights
-        double k = 1.0 / std::sqrt(64.0);  // Xavier/Glorot initialization scale
-        torch::nn::init::uniform_(price_head->weight, -k, k);
-        torch::nn::init::zeros_(price_head->bias);
-        
-        // Convert the entire module to double precision
-        this->to(torch::kFloat64);
-    }
-
-    std::tuple<torch::Tensor, torch::Tensor> forward(torch::Tensor x) {
-        // x shape: [batch_size, sequence_length=80, features=2421]
-        x = x.transpose(1, 2);  // [batch_size, features=2421, sequence_length=80]
-        
-        // Apply 1D convolutions
-        x = torch::relu(conv1->forward(x));  // [batch_size, 128, 80]
-        x = torch::relu(conv2->forward(x));  // [batch_size, 64, 80]
-        
-        // Prepare for LSTM
-        x = x.transpose(1, 2);  // [batch_size, 80, 64]
-        
-        // Apply LSTM
-        auto lstm_out = std::get<0>(lstm->forward(x));  // [batch_size, 80, 32]
-        
-        // Flatten the sequence
-        x = lstm_out.reshape({lstm_out.size(0), -1});  // [batch_size, 80 * 32]
-        
-        // Dense layers
-        x = torch::relu(fc1->forward(x));
-        x = torch::relu(fc2->forward(x));
-        
-        auto price = torch::tanh(price_head->forward(x));
-        auto volume = torch::sigmoid(volume_head->forward(x));
-        
-        return std::make_tuple(price, volume);
-    }
-
-private:
-    torch::nn::Conv1d conv1, conv2;
-    torch::nn::LSTM lstm;
-    torch::nn::Linear fc1, fc2, price_head, volume_head;
-};
-TORCH_MODULE(Actor);
-
-// Critic network architecture (using float64/double precision)
-class CriticImpl : public torch::nn::Module {
-public:
-    CriticImpl(int input_size)
-        : conv1(register_module("conv1", torch::nn::Conv1d(torch::nn::Conv1dOptions(2421, 128, 3).padding(1)))),
-          conv2(register_module("conv2", torch::nn::Conv1d(torch::nn::Conv1dOptions(128, 64, 3).padding(1)))),
-          lstm(register_module("lstm", torch::nn::LSTM(torch::nn::LSTMOptions(64, 32).num_layers(2).batch_first(true)))),
-          fc1(register_module("fc1", torch::nn::Linear(32 * 80, 128))),
-          fc2(register_module("fc2", torch::nn::Linear(128, 64))),
-          value_head(register_module("value_head", torch::nn::Linear(64, 1))) {
-        
-        // Convert the entire module to double precision
-        this->to(torch::kFloat64);
-    }
-
-    torch::Tensor forward(torch::Tensor x) {
-        // x shape: [batch_size, sequence_length=80, features=2421]
-        x = x.transpose(1, 2);  // [batch_size, features=2421, sequence_length=80]
-        
-        // Apply 1D convolutions
-        x = torch::relu(conv1->forward(x));  // [batch_size, 128, 80]
-        x = torch::relu(conv2->forward(x));  // [batch_size, 64, 80]
-        
-        // Prepare for LSTM
-        x = x.transpose(1, 2);  // [batch_size, 80, 64]
-        
-        // Apply LSTM
-        auto lstm_out = std::get<0>(lstm->forward(x));  // [batch_size, 80, 32]
-        
-        // Flatten the sequence
-        x = lstm_out.reshape({lstm_out.size(0), -1});  // [batch_size, 80 * 32]
-        
-        // Dense layers
-        x = torch::relu(fc1->forward(x));
-        x = torch::relu(fc2->forward(x));
-        
-        return value_head->forward(x);
-    }
-
-private:
-    torch::nn::Conv1d conv1, conv2;
-    torch::nn::LSTM lstm;
-    torch::nn::Linear fc1, fc2, value_head;
-};
-TORCH_MODULE(Critic);
+#include "state_ring.hpp"
+#include "networks.hpp"
+#include "incremental_actor.hpp"
+#include "inference_precision.hpp"
+#include "actor_double_buffer.hpp"
+#include "replay_buffer.hpp"
+#include "device.hpp"
+#include "checkpointer.hpp"
+#include "actor_ensemble.hpp"
+#include "cuda_graph_actor.hpp"
 
 // Action storage structure
 struct ActionInfo {
@@ -132,40 +50,136 @@ struct TradeInfo {
     std::vector<OrderInfo> orders;    // Array of orders in this trade
 };
 
+// Completed trade handed to the learner thread, with its state windows already gathered
+struct LearnerJob {
+    TradeInfo trade;
+    std::vector<torch::Tensor> states;  // One [1, 80, 2421] window per order found in the buffer
+    std::vector<double> coefficients;   // Coefficient of the order each window belongs to
+};
+
 class PPOHandler {
 public:
     static constexpr size_t NETWORK_INPUT_SIZE = 80;  // Use 80 newest states for network input
     static constexpr size_t HISTORY_BUFFER_SIZE = 1000;  // Store last 1000 states
     static constexpr size_t ACTION_BUFFER_SIZE = 1000;  // Store last 1000 actions
+    static constexpr uint64_t ACTION_LOG_SAMPLE = 100;  // Log one stored action in this many
     static constexpr size_t INPUT_SIZE = OrderBookState::TOTAL_FEATURES * NETWORK_INPUT_SIZE;
     static constexpr size_t SAVE_INTERVAL = 9000;  // Save model every 9000 states
+    static constexpr size_t MAX_PENDING_TRADES = 8;  // Completed trades queued for the learner
+    static constexpr auto LEARNER_IDLE_WAIT = std::chrono::milliseconds(100);  // Retry interval for a pending weight publish
+    static constexpr auto SHM_POLL_WAIT = std::chrono::microseconds(200);  // State wait between execution update checks
+    static constexpr size_t ACTION_RING_SLOTS = 1024;  // Actions the shared-memory ring holds
+    static constexpr size_t ACTION_RING_SLOT_SIZE = 64;  // Room for one encoded action
 
     PPOHandler(const std::string& host, int port, 
-               const std::string& username, const std::string& password);
+               const std::string& username, const std::string& password,
+               const std::string& instrument = "BTC-USDT-SWAP");
     ~PPOHandler();
 
     void start();
     void stop();
 
+    // Device for the networks, the replay and the state ring's device copy (CPU by default); set
+    // before the precision and before start()
+    void setDevice(const torch::Device& device);
+
+    // Prefetch and ack batching of the orderbook and execution consumers; set before start()
+    void setConsumerOptions(const amqp_consumer::Options& options) { consumer_options_ = options; }
+
+    // Read states from the orderbook service's shared-memory ring and publish actions to the OMS
+    // ring instead of RabbitMQ, which then only carries execution updates; set before start()
+    void setTransport(transport::Kind kind) { transport_ = kind; }
+
+    // Decide only on the newest state while newer ones are already buffered (on by default).
+    // Every state is still decoded into the history; only the stale decisions are skipped, and
+    // decisions stay on even state IDs either way.
+    void setConflation(bool enabled) { conflate_ = enabled; }
+
+    // Recompute conv1 only for new states when deciding (on by default)
+    void setIncrementalInference(bool enabled) { incremental_inference_ = enabled; }
+
+    // Replay a captured CUDA graph of the full actor forward for every decision instead of the
+    // incremental path; needs a CUDA device and a PPO_WITH_CUDA build
+    void setCudaGraphs(bool enabled);
+
+    // Precision of the actor copy used for decisions (float64 by default); set before start()
+    void setInferencePrecision(InferencePrecision precision);
+
+    // Frozen policies evaluated on every decision next to the champion, batched into one forward
+    // over the same window. Only the champion publishes; shadow actions are appended to log_path
+    // as CSV. Each path is a checkpoint file; set after the device and precision.
+    void addShadowModels(const std::vector<std::string>& paths, const std::string& log_path);
+
+    // Print decision latency and action divergence for every precision, then return
+    void runPrecisionBenchmark(size_t iterations);
+
 private:
+    friend struct PPOBenchAccess;  // bench/ppo_bench.cpp times the stages on their own
+
     // RabbitMQ connection details
     std::string host_;
     int port_;
     std::string username_;
     std::string password_;
+    std::string instrument_;             // The instrument this model trades
+    std::string orderbook_routing_key_;  // orderbook.updates.<instrument>
+    std::string execution_routing_key_;  // execution.update.<instrument>
+    std::string action_routing_key_;     // oms.action.<instrument>
+    std::string orderbook_queue_;        // ppo_queue.<instrument>
+    std::string execution_queue_;        // ppo_execution_queue.<instrument>
     bool is_running_;
 
-    // RabbitMQ connection and channel
+    // RabbitMQ connection and channels: orderbook states and publishing on 1, execution
+    // updates on 2
     amqp_connection_state_t conn_;
     amqp_socket_t* socket_;
+    static constexpr amqp_channel_t ORDERBOOK_CHANNEL = 1;
+    static constexpr amqp_channel_t EXECUTION_CHANNEL = 2;
+    bool execution_channel_open_ = false;  // Opened by the consumer in start()
+    amqp_consumer::Options consumer_options_;
+    transport::Kind transport_ = transport::Kind::RabbitMQ;
+    std::unique_ptr<transport::Publisher> action_publisher_;  // Created by start()
+    bool conflate_ = true;
+    bool decision_pending_ = false;  // A state due for a decision arrived since the last one
+    uint64_t conflated_decisions_ = 0;  // Decisions skipped because a newer state was buffered
 
-    // Optimized state buffer (using double precision)
-    std::deque<OrderBookState> state_buffer_;
+    // History of network input rows, decoded into in place (using double precision)
+    StateRing<HISTORY_BUFFER_SIZE, NETWORK_INPUT_SIZE> state_ring_;
     uint16_t trigger_state_id_;  // ID of the state that triggered action
+    bool v3_synced_ = false;  // Whether v3 deltas currently apply to the newest state
 
-    // PPO Networks and optimizers (using float64/double precision)
+    // PPO Networks and optimizers (using float64/double precision).
+    // Once start() runs, the master networks belong to the learner thread.
+    torch::Device device_{torch::kCPU};
     Actor actor_;
     Critic critic_;
+
+    // Decision copies of actor_, refreshed by the learner after every update
+    InferencePrecision inference_precision_ = InferencePrecision::Float64;
+    ActorDoubleBuffer inference_actors_;
+    std::array<IncrementalActor<NETWORK_INPUT_SIZE>, 2> incremental_actors_;  // One per copy
+    size_t active_inference_ = 0;  // Copy the last decision used
+    bool incremental_inference_ = true;
+    bool cuda_graphs_ = false;
+#ifdef PPO_WITH_CUDA
+    std::array<std::unique_ptr<CudaGraphActor>, 2> graph_actors_;  // One per copy, captured lazily
+#endif
+    // Shadow policies (consume thread only), none unless addShadowModels() was called
+    ActorEnsemble shadow_ensemble_{nullptr};
+    std::unique_ptr<IncrementalActor<NETWORK_INPUT_SIZE, ActorEnsemble>> shadow_incremental_;
+    std::vector<std::string> shadow_names_;
+    std::ofstream shadow_log_;
+
+    // Stage latencies of the decision path
+    latency::Histogram& decode_latency_ = latency::registry().histogram(
+        "ppo_decode_seconds", "Decoding an orderbook message into the state ring");
+    latency::Histogram& forward_latency_ = latency::registry().histogram(
+        "ppo_forward_seconds", "Actor forward pass of one decision");
+    latency::Histogram& publish_latency_ = latency::registry().histogram(
+        "ppo_publish_seconds", "Encoding and publishing one action");
+    latency::Histogram& tick_to_action_latency_ = latency::registry().histogram(
+        "ppo_tick_to_action_seconds", "Orderbook frame arrival until its action is published");
+
     std::unique_ptr<torch::optim::Adam> actor_optimizer_;
     std::unique_ptr<torch::optim::Adam> critic_optimizer_;
 
@@ -183,54 +197,73 @@ private:
     // Trade tracking
     TradeInfo current_trade_;
 
+    // Learner thread: trains on completed trades off the consume loop
+    std::thread learner_thread_;
+    std::mutex learner_mutex_;
+    std::condition_variable learner_cv_;
+    std::deque<LearnerJob> learner_jobs_;  // Guarded by learner_mutex_
+    bool learner_running_ = false;         // Guarded by learner_mutex_
+    std::string save_request_;             // Guarded by learner_mutex_; save reason, empty if none
+    bool weights_pending_ = false;         // Learner only: master updated but not yet published
+
     // Private methods
     void initializeRabbitMQ();
     void cleanupRabbitMQ();
-    void handleMessage(const std::string& message);
-    void handleExecutionUpdate(const std::string& message);
+    void handleMessage(std::string_view message);
+    void decodeV2Message(std::string_view message, double* row, StateInfo& info);
+    bool decodeV3Message(std::string_view message, double* row, StateInfo& info);  // False if the delta base is missing
+    void decidePending();  // Decide on the newest state
+    void handleExecutionUpdate(std::string_view message);
     std::string getCurrentTimestamp() const;
-    void processOrderBookState(const OrderBookState& state);
     
     // PPO methods (all operating in double precision)
     torch::Tensor preprocessState();
     void forwardPass();
     void publishAction(const torch::Tensor& price, const torch::Tensor& volume);
+    void evaluateShadows(double champion_price, double champion_volume);
     
     // Helper methods
     void initializeNetworks();
+    void resetInferenceActors();
     void declareExchangesAndQueues();
 
+    // Learner thread
+    void startLearner();
+    void stopLearner();
+    void learnerLoop();
+    void enqueueTraining(const TradeInfo& trade);
+    void requestSave(const std::string& reason);
+
     // PPO Training methods
-    void updateNetworks(const TradeInfo& completed_trade);
-    torch::Tensor computeAdvantages(const std::vector<torch::Tensor>& states,
-                                   const std::vector<torch::Tensor>& values,
-                                   const std::vector<double>& coefficients,
-                                   double reward);
+    // All per-sample tensors below are [B]; states are [B, 80, 2421]
+    void updateNetworks(const LearnerJob& job);
+    torch::Tensor computeAdvantages(const torch::Tensor& values, const torch::Tensor& targets);
     torch::Tensor computePPOLoss(const torch::Tensor& advantages,
                                 const torch::Tensor& old_price_probs,
                                 const torch::Tensor& old_volume_probs,
                                 const torch::Tensor& new_price_probs,
                                 const torch::Tensor& new_volume_probs,
-                                const std::vector<double>& coefficients);
+                                const torch::Tensor& coefficients);
     torch::Tensor computeValueLoss(const torch::Tensor& values,
                                   const torch::Tensor& returns,
-                                  const std::vector<double>& coefficients);
+                                  const torch::Tensor& coefficients);
     torch::Tensor computeEntropyLoss(const torch::Tensor& price_probs,
                                     const torch::Tensor& volume_probs,
-                                    const std::vector<double>& coefficients);
-    std::vector<torch::Tensor> getStatesFromTrade(const TradeInfo& trade);
+                                    const torch::Tensor& coefficients);
+    std::vector<torch::Tensor> getStatesFromTrade(const TradeInfo& trade, std::vector<double>& coefficients);
     std::tuple<torch::Tensor, torch::Tensor> getActionsFromTrade(const TradeInfo& trade);
-    std::vector<torch::Tensor> getValuesFromStates(const std::vector<torch::Tensor>& states);
-    std::tuple<torch::Tensor, torch::Tensor> getProbabilitiesFromStates(const std::vector<torch::Tensor>& states);
+    torch::Tensor getValuesFromStates(const torch::Tensor& states);
+    std::tuple<torch::Tensor, torch::Tensor> getProbabilitiesFromStates(const torch::Tensor& states);
     
-    // Training buffers
-    std::vector<TradeInfo> training_buffer_;
-    const size_t MAX_TRAINING_BUFFER_SIZE = 100;  // Store last 100 trades for training
+    // Replay of recent order samples, trained on in shuffled minibatches (learner only)
+    static constexpr size_t MAX_REPLAY_SAMPLES = 128;  // ~200MB of float64 windows
+    ReplayBuffer replay_{MAX_REPLAY_SAMPLES};
 
-    // Model saving/loading
+    // Model saving/loading. saveModel only snapshots; the checkpointer writes in the background.
+    static constexpr size_t CHECKPOINT_VERSIONS = 3;  // Newest checkpoint files kept
     void saveModel(const std::string& reason = "interval");
     bool loadModel();
-    std::string getModelPath() const;
     size_t state_counter_;  // Count processed states for save interval
     const std::string MODEL_DIR = "models";  // Directory for model storage
+    Checkpointer checkpointer_{MODEL_DIR, "ppo_model", CHECKPOINT_VERSIONS};
 }; 
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+#include <torch/torch.h>
+#include <ATen/core/dispatch/Dispatcher.h>
+#include <algorithm>
+#include <vector>
+
+// Linear layer with int8 weights and dynamically quantized float32 activations, run through
+// the quantized::linear_dynamic kernel of the active quantized engine (fbgemm on x86).
+// The packed weights are a snapshot: rebuild it from the float layer whenever that changes.
+class DynamicQuantizedLinear {
+public:
+    DynamicQuantizedLinear() = default;
+
+    explicit DynamicQuantizedLinear(const torch::nn::Linear& linear) {
+        torch::NoGradGuard no_grad;
+        auto weight = linear->weight.detach().to(torch::kFloat32).contiguous();
+        auto bias = linear->bias.detach().to(torch::kFloat32).contiguous();
+
+        // Symmetric per-tensor int8 weights
+        const double scale = std::max(weight.abs().max().item<double>(), 1e-12) / 127.0;
+        auto qweight = torch::quantize_per_tensor(weight, scale, 0, torch::kQInt8);
+
+        std::vector<c10::IValue> stack{qweight, bias};
+        prepackOp().callBoxed(&stack);
+        packed_ = std::move(stack[0]);
+    }
+
+    bool defined() const { return !packed_.isNone(); }
+
+    // x: float32 [batch, in_features]
+    torch::Tensor forward(const torch::Tensor& x) const {
+        std::vector<c10::IValue> stack{x.contiguous(), packed_, false};
+        linearOp().callBoxed(&stack);
+        return stack[0].toTensor();
+    }
+
+private:
+    static const c10::OperatorHandle& prepackOp() {
+        static const auto op = c10::Dispatcher::singleton().findSchemaOrThrow("quantized::linear_prepack", "");
+        return op;
+    }
+    static const c10::OperatorHandle& linearOp() {
+        static const auto op = c10::Dispatcher::singleton().findSchemaOrThrow("quantized::linear_dynamic", "");
+        return op;
+    }
+
+    c10::IValue packed_;  // LinearPackedParamsBase, None until built
+};
@@ -0,0 +1,71 @@
+#pragma once
+#include <torch/torch.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Training samples (one per order) from recent trades, kept in preallocated batch tensors so
+// minibatches are a single index_select. Once full, new samples overwrite the oldest.
+class ReplayBuffer {
+public:
+    explicit ReplayBuffer(size_t capacity) : capacity_(capacity) {}
+
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+
+    // Add n samples: states [n, 80, 2421] and [n] targets (reward * coefficient), coefficients and
+    // the policy outputs the samples are clipped against
+    void add(const torch::Tensor& states, const torch::Tensor& targets, const torch::Tensor& coefficients,
+             const torch::Tensor& old_price, const torch::Tensor& old_volume) {
+        int64_t count = states.size(0);
+        int64_t first = 0;
+        if (count > static_cast<int64_t>(capacity_)) {
+            first = count - static_cast<int64_t>(capacity_);  // Only the newest capacity samples survive
+            count = static_cast<int64_t>(capacity_);
+        }
+        if (!states_.defined()) {
+            allocate(states);
+        }
+
+        std::vector<int64_t> slots(count);
+        for (auto& slot : slots) {
+            slot = static_cast<int64_t>(next_);
+            next_ = (next_ + 1) % capacity_;
+        }
+        auto index = torch::tensor(slots, torch::TensorOptions().dtype(torch::kInt64).device(states_.device()));
+        states_.index_copy_(0, index, states.narrow(0, first, count));
+        targets_.index_copy_(0, index, targets.narrow(0, first, count));
+        coefficients_.index_copy_(0, index, coefficients.narrow(0, first, count));
+        old_price_.index_copy_(0, index, old_price.narrow(0, first, count));
+        old_volume_.index_copy_(0, index, old_volume.narrow(0, first, count));
+        size_ = std::min(capacity_, size_ + static_cast<size_t>(count));
+    }
+
+    // Views over the size() valid samples; slots fill from 0, so they are always a prefix
+    torch::Tensor states() const { return states_.narrow(0, 0, static_cast<int64_t>(size_)); }
+    torch::Tensor targets() const { return targets_.narrow(0, 0, static_cast<int64_t>(size_)); }
+    torch::Tensor coefficients() const { return coefficients_.narrow(0, 0, static_cast<int64_t>(size_)); }
+    torch::Tensor oldPrice() const { return old_price_.narrow(0, 0, static_cast<int64_t>(size_)); }
+    torch::Tensor oldVolume() const { return old_volume_.narrow(0, 0, static_cast<int64_t>(size_)); }
+
+private:
+    void allocate(const torch::Tensor& like) {
+        auto sizes = like.sizes().vec();
+        sizes[0] = static_cast<int64_t>(capacity_);
+        states_ = torch::zeros(sizes, like.options());
+        targets_ = torch::zeros({static_cast<int64_t>(capacity_)}, like.options());
+        coefficients_ = torch::zeros_like(targets_);
+        old_price_ = torch::zeros_like(targets_);
+        old_volume_ = torch::zeros_like(targets_);
+    }
+
+    size_t capacity_;
+    size_t size_ = 0;
+    size_t next_ = 0;
+    torch::Tensor states_;  // Allocated on the first add
+    torch::Tensor targets_;
+    torch::Tensor coefficients_;
+    torch::Tensor old_price_;
+    torch::Tensor old_volume_;
+};
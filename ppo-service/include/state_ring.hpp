@@ -0,0 +1,170 @@
+#pragma once
+#include <torch/torch.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include "orderbook_state.hpp"
+
+// The last Capacity states as the rows of one persistent float64 tensor, decoded into in place.
+// The first Window - 1 rows are mirrored past the end of the ring, so any Window consecutive
+// states are one contiguous slice and the network input is a view rather than a copy.
+// States are found by ID in O(1) through a table of the sequence each ID was last committed as;
+// the sequence doubles as a generation tag, so IDs reused after the uint16 wraparound never
+// resolve to an evicted state.
+template <size_t Capacity, size_t Window>
+class StateRing {
+public:
+    static constexpr size_t CAPACITY = Capacity;
+    static constexpr size_t WINDOW = Window;
+    static constexpr size_t ROW_SIZE = OrderBookState::TOTAL_FEATURES;
+    static constexpr size_t MIRROR_ROWS = Window - 1;
+
+    static_assert(Window >= 1 && Window <= Capacity, "Window must fit in the ring");
+
+    StateRing() : sequence_by_id_(ID_SPACE, 0) {
+        auto options = torch::TensorOptions().dtype(torch::kFloat64);
+        if (torch::cuda::is_available()) {
+            options = options.pinned_memory(true);  // Page-locked so device copies can be asynchronous
+        }
+        rows_ = torch::zeros({static_cast<int64_t>(Capacity + MIRROR_ROWS), static_cast<int64_t>(ROW_SIZE)}, options);
+        data_ = rows_.data_ptr<double>();
+    }
+
+    StateRing(const StateRing&) = delete;
+    StateRing& operator=(const StateRing&) = delete;
+
+    // Mirror the ring on an accelerator: each commit then copies only its new row, asynchronously
+    // from the pinned host ring, and window() views the device copy. The host ring stays the one
+    // decoded into, and the one training windows are copied from.
+    void setDevice(const torch::Device& device) {
+        device_rows_ = device.is_cpu() ? torch::Tensor() : rows_.to(device);
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    // States committed so far; the newest state is number sequence() - 1
+    uint64_t sequence() const { return sequence_; }
+
+    // Row the next state is decoded into. When the ring is full this is the oldest state,
+    // which is evicted here so a decode that fails halfway never leaves a corrupt state behind.
+    double* acquire() {
+        if (!writing_ && size_ == Capacity) {
+            --size_;
+        }
+        writing_ = true;
+        return row(next_);
+    }
+
+    // Publish the acquired row as the newest state
+    void commit(const StateInfo& info) {
+        const size_t slot = next_;
+        if (slot < MIRROR_ROWS) {
+            std::memcpy(row(Capacity + slot), row(slot), ROW_SIZE * sizeof(double));
+        }
+        if (device_rows_.defined()) {
+            auto host_row = rows_.narrow(0, static_cast<int64_t>(slot), 1);
+            device_rows_.narrow(0, static_cast<int64_t>(slot), 1).copy_(host_row, /*non_blocking=*/true);
+            if (slot < MIRROR_ROWS) {
+                device_rows_.narrow(0, static_cast<int64_t>(Capacity + slot), 1).copy_(host_row, /*non_blocking=*/true);
+            }
+        }
+        info_[slot] = info;
+        sequence_by_id_[info.state_id] = sequence_ + 1;
+        newest_ = slot;
+        next_ = (slot + 1) % Capacity;
+        ++size_;
+        ++sequence_;
+        writing_ = false;
+    }
+
+    // Newest state; only valid when not empty
+    const double* newest() const { return row(newest_); }
+    const StateInfo& newestInfo() const { return info_[newest_]; }
+
+    // [1, Window, ROW_SIZE] view of the newest Window states, oldest first, on the ring's device;
+    // needs size() >= Window. The view aliases the ring, so copy it before the ring is written
+    // again if it must outlive that.
+    torch::Tensor window() const {
+        const size_t start = newest_ >= MIRROR_ROWS ? newest_ - MIRROR_ROWS : newest_ + Capacity - MIRROR_ROWS;
+        const torch::Tensor& source = device_rows_.defined() ? device_rows_ : rows_;
+        return source.narrow(0, static_cast<int64_t>(start), static_cast<int64_t>(Window)).unsqueeze(0);
+    }
+
+    // Row index in rows() of the newest buffered state with this ID, or -1
+    int64_t find(uint16_t state_id) const {
+        uint64_t sequence;
+        return findSequence(state_id, sequence) ? static_cast<int64_t>(sequence % Capacity) : -1;
+    }
+
+    // Copy of the Window states ending at state_id, [1, Window, ROW_SIZE]; undefined if any is missing.
+    // When the IDs were committed back to back this is a single slice of the ring.
+    torch::Tensor windowEndingAt(uint16_t state_id) const {
+        uint64_t last;
+        if (!findSequence(state_id, last) || last + 1 < Window) {
+            return {};
+        }
+
+        const uint64_t first = last - (Window - 1);
+        const uint16_t first_id = static_cast<uint16_t>(state_id - (Window - 1));
+        if (sequence_ - first <= size_ && consecutive(first, first_id)) {
+            return rows_.narrow(0, static_cast<int64_t>(first % Capacity), static_cast<int64_t>(Window))
+                .unsqueeze(0).clone();
+        }
+
+        // A gap in the sequence: gather the states one ID at a time
+        std::array<int64_t, Window> slots;
+        for (size_t n = 0; n < Window; ++n) {
+            const int64_t slot = find(static_cast<uint16_t>(first_id + n));
+            if (slot < 0) {
+                return {};
+            }
+            slots[n] = slot;
+        }
+        auto index = torch::from_blob(slots.data(), {static_cast<int64_t>(Window)},
+                                      torch::TensorOptions().dtype(torch::kInt64));
+        return rows_.index_select(0, index).unsqueeze(0);
+    }
+
+    // Backing host [Capacity + Window - 1, ROW_SIZE] tensor, for gathering rows by index
+    const torch::Tensor& rows() const { return rows_; }
+
+private:
+    static constexpr size_t ID_SPACE = size_t(std::numeric_limits<uint16_t>::max()) + 1;
+
+    bool findSequence(uint16_t state_id, uint64_t& sequence) const {
+        const uint64_t tag = sequence_by_id_[state_id];
+        if (tag == 0) {
+            return false;  // Never committed
+        }
+        sequence = tag - 1;
+        return sequence_ - sequence <= size_;  // Still buffered, not evicted or being overwritten
+    }
+
+    // Whether the Window states from sequence first carry the IDs first_id, first_id + 1, ...
+    bool consecutive(uint64_t first, uint16_t first_id) const {
+        for (size_t n = 0; n < Window; ++n) {
+            if (info_[(first + n) % Capacity].state_id != static_cast<uint16_t>(first_id + n)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    double* row(size_t slot) { return data_ + slot * ROW_SIZE; }
+    const double* row(size_t slot) const { return data_ + slot * ROW_SIZE; }
+
+    torch::Tensor rows_;
+    torch::Tensor device_rows_;  // Accelerator copy of rows_, undefined on CPU
+    double* data_ = nullptr;
+    std::array<StateInfo, Capacity> info_{};
+    size_t size_ = 0;
+    size_t newest_ = Capacity - 1;
+    size_t next_ = 0;
+    uint64_t sequence_ = 0;
+    std::vector<uint64_t> sequence_by_id_;  // Last sequence + 1 each ID was committed as, 0 if never
+    bool writing_ = false;
+};
@@ -0,0 +1,308 @@
+#include "../include/checkpointer.hpp"
+#include <async_logger.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+torch::Tensor toHost(const torch::Tensor& tensor) {
+    return tensor.detach().to(torch::kCPU, tensor.scalar_type(), /*non_blocking=*/false, /*copy=*/true);
+}
+
+std::vector<torch::Tensor> optimizerParameters(torch::optim::Adam& optimizer) {
+    std::vector<torch::Tensor> parameters;
+    for (auto& group : optimizer.param_groups()) {
+        for (auto& p : group.params()) {
+            parameters.push_back(p);
+        }
+    }
+    return parameters;
+}
+
+void checkShapes(const std::vector<torch::Tensor>& stored, const std::vector<torch::Tensor>& parameters,
+                 const char* what) {
+    if (stored.size() != parameters.size()) {
+        throw std::runtime_error(std::string("Checkpoint has ") + std::to_string(stored.size()) + " " + what +
+                                 " tensors, the network has " + std::to_string(parameters.size()));
+    }
+    for (size_t i = 0; i < stored.size(); ++i) {
+        if (stored[i].sizes() != parameters[i].sizes()) {
+            throw std::runtime_error(std::string("Checkpoint ") + what + " tensor " + std::to_string(i) +
+                                     " does not match the network");
+        }
+    }
+}
+
+void writeNetwork(torch::serialize::OutputArchive& archive, const std::string& key, const NetworkSnapshot& network) {
+    archive.write(key, network.parameters);
+    if (!network.exp_avg.empty()) {
+        archive.write(key + "_exp_avg", network.exp_avg);
+        archive.write(key + "_exp_avg_sq", network.exp_avg_sq);
+        archive.write(key + "_steps", torch::tensor(network.steps, torch::TensorOptions().dtype(torch::kInt64)));
+    }
+}
+
+// Checkpoints written before Adam state was stored only have the parameters
+NetworkSnapshot readNetwork(torch::serialize::InputArchive& archive, const std::string& key) {
+    NetworkSnapshot network;
+    c10::IValue value;
+    archive.read(key, value);
+    network.parameters = value.toTensorVector();
+
+    c10::IValue exp_avg;
+    c10::IValue exp_avg_sq;
+    torch::Tensor steps;
+    if (archive.try_read(key + "_exp_avg", exp_avg) && archive.try_read(key + "_exp_avg_sq", exp_avg_sq) &&
+        archive.try_read(key + "_steps", steps)) {
+        network.exp_avg = exp_avg.toTensorVector();
+        network.exp_avg_sq = exp_avg_sq.toTensorVector();
+        steps = steps.contiguous();
+        network.steps.assign(steps.data_ptr<int64_t>(), steps.data_ptr<int64_t>() + steps.numel());
+    }
+    return network;
+}
+
+// fsync a file, or a directory to make a rename in it durable
+void syncPath(const std::filesystem::path& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Opening " + path.string() + " failed: " + std::strerror(errno));
+    }
+    const int rc = ::fsync(fd);
+    const int fsync_errno = errno;
+    ::close(fd);
+    if (rc != 0) {
+        throw std::runtime_error("Syncing " + path.string() + " failed: " + std::strerror(fsync_errno));
+    }
+}
+
+} // namespace
+
+NetworkSnapshot snapshotNetwork(torch::optim::Adam& optimizer) {
+    torch::NoGradGuard no_grad;
+    NetworkSnapshot snapshot;
+    auto& state = optimizer.state();
+    for (const auto& p : optimizerParameters(optimizer)) {
+        snapshot.parameters.push_back(toHost(p));
+        auto it = state.find(p.unsafeGetTensorImpl());
+        if (it != state.end()) {
+            auto& adam = static_cast<torch::optim::AdamParamState&>(*it->second);
+            snapshot.exp_avg.push_back(toHost(adam.exp_avg()));
+            snapshot.exp_avg_sq.push_back(toHost(adam.exp_avg_sq()));
+            snapshot.steps.push_back(adam.step());
+        }
+    }
+
+    // Parameters that never received a gradient have no state; restart the moments then
+    if (snapshot.exp_avg.size() != snapshot.parameters.size()) {
+        snapshot.exp_avg.clear();
+        snapshot.exp_avg_sq.clear();
+        snapshot.steps.clear();
+    }
+    return snapshot;
+}
+
+void restoreNetwork(const NetworkSnapshot& snapshot, torch::optim::Adam& optimizer) {
+    torch::NoGradGuard no_grad;
+    auto parameters = optimizerParameters(optimizer);
+    checkShapes(snapshot.parameters, parameters, "parameter");
+    const bool has_moments = !snapshot.exp_avg.empty();
+    if (has_moments) {
+        checkShapes(snapshot.exp_avg, parameters, "exp_avg");
+        checkShapes(snapshot.exp_avg_sq, parameters, "exp_avg_sq");
+        if (snapshot.steps.size() != parameters.size()) {
+            throw std::runtime_error("Checkpoint step counts do not match the network");
+        }
+    }
+
+    auto& state = optimizer.state();
+    state.clear();
+    for (size_t i = 0; i < parameters.size(); ++i) {
+        parameters[i].copy_(snapshot.parameters[i]);
+        if (has_moments) {
+            auto adam = std::make_unique<torch::optim::AdamParamState>();
+            adam->step(snapshot.steps[i]);
+            adam->exp_avg(snapshot.exp_avg[i].to(parameters[i].device(), parameters[i].scalar_type()));
+            adam->exp_avg_sq(snapshot.exp_avg_sq[i].to(parameters[i].device(), parameters[i].scalar_type()));
+            state[parameters[i].unsafeGetTensorImpl()] = std::move(adam);
+        }
+    }
+}
+
+void restoreParameters(const NetworkSnapshot& snapshot, torch::nn::Module& module) {
+    torch::NoGradGuard no_grad;
+    auto parameters = module.parameters();
+    checkShapes(snapshot.parameters, parameters, "parameter");
+    for (size_t i = 0; i < parameters.size(); ++i) {
+        parameters[i].copy_(snapshot.parameters[i]);
+    }
+}
+
+void moveOptimizerState(torch::optim::Adam& optimizer, const torch::Device& device) {
+    for (auto& entry : optimizer.state()) {
+        auto& adam = static_cast<torch::optim::AdamParamState&>(*entry.second);
+        adam.exp_avg(adam.exp_avg().to(device));
+        adam.exp_avg_sq(adam.exp_avg_sq().to(device));
+        if (adam.max_exp_avg_sq().defined()) {
+            adam.max_exp_avg_sq(adam.max_exp_avg_sq().to(device));
+        }
+    }
+}
+
+Checkpointer::Checkpointer(const std::string& directory, const std::string& name, size_t versions)
+    : directory_(directory), name_(name), versions_(std::max<size_t>(1, versions)) {
+    std::filesystem::create_directories(directory_);
+
+    // Leftovers of a write interrupted by a crash
+    for (const auto& entry : std::filesystem::directory_iterator(directory_)) {
+        const std::string file = entry.path().filename().string();
+        if (file.rfind(name_ + "-", 0) == 0 && entry.path().extension() == ".tmp") {
+            std::error_code ec;
+            std::filesystem::remove(entry.path(), ec);
+        }
+    }
+
+    auto files = versionFiles();
+    if (!files.empty()) {
+        next_version_ = *versionOf(files.front()) + 1;
+    }
+    thread_ = std::thread(&Checkpointer::run, this);
+}
+
+Checkpointer::~Checkpointer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    cv_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void Checkpointer::write(CheckpointSnapshot snapshot) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_ = std::move(snapshot);
+    }
+    cv_.notify_one();
+}
+
+void Checkpointer::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [this] { return !running_ || pending_; });
+        if (!pending_) break;  // Stopping with nothing left to write
+
+        CheckpointSnapshot snapshot = std::move(*pending_);
+        pending_.reset();
+        lock.unlock();
+        try {
+            writeFile(snapshot);
+        } catch (const std::exception& e) {
+            LOG_ERROR("Error writing checkpoint ({}): {}", snapshot.reason, e.what());
+        }
+        lock.lock();
+    }
+}
+
+void Checkpointer::writeFile(const CheckpointSnapshot& snapshot) {
+    torch::serialize::OutputArchive archive;
+    writeNetwork(archive, "actor", snapshot.actor);
+    writeNetwork(archive, "critic", snapshot.critic);
+
+    const auto path = versionPath(next_version_);
+    auto temp = path;
+    temp += ".tmp";
+    archive.save_to(temp.string());
+    syncPath(temp);
+    std::filesystem::rename(temp, path);
+    syncPath(directory_);
+    ++next_version_;
+
+    prune();
+    LOG_INFO("Model saved ({}) to {}", snapshot.reason, path.string());
+}
+
+void Checkpointer::prune() const {
+    auto files = versionFiles();
+    for (size_t i = versions_; i < files.size(); ++i) {
+        std::error_code ec;
+        std::filesystem::remove(files[i], ec);
+        if (ec) {
+            LOG_ERROR("Error removing old checkpoint {}: {}", files[i].string(), ec.message());
+        }
+    }
+}
+
+std::optional<CheckpointSnapshot> Checkpointer::loadNewest() const {
+    auto candidates = versionFiles();
+    const auto legacy = directory_ / (name_ + ".pt");  // Single file written by older builds
+    if (std::filesystem::exists(legacy)) {
+        candidates.push_back(legacy);
+    }
+
+    for (const auto& path : candidates) {
+        try {
+            CheckpointSnapshot snapshot = read(path);
+            LOG_INFO("Loading checkpoint {}", path.string());
+            return snapshot;
+        } catch (const std::exception& e) {
+            LOG_WARN("Skipping unreadable checkpoint {}: {}", path.string(), e.what());
+        }
+    }
+    return std::nullopt;
+}
+
+CheckpointSnapshot Checkpointer::read(const std::filesystem::path& path) {
+    torch::serialize::InputArchive archive;
+    archive.load_from(path.string(), torch::Device(torch::kCPU));  // Readable whatever device saved it
+    CheckpointSnapshot snapshot;
+    snapshot.actor = readNetwork(archive, "actor");
+    snapshot.critic = readNetwork(archive, "critic");
+    snapshot.reason = path.filename().string();
+    return snapshot;
+}
+
+std::vector<std::filesystem::path> Checkpointer::versionFiles() const {
+    std::vector<std::pair<uint64_t, std::filesystem::path>> found;
+    for (const auto& entry : std::filesystem::directory_iterator(directory_)) {
+        if (auto version = versionOf(entry.path())) {
+            found.emplace_back(*version, entry.path());
+        }
+    }
+    std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    std::vector<std::filesystem::path> files;
+    for (auto& [version, path] : found) {
+        files.push_back(std::move(path));
+    }
+    return files;
+}
+
+std::filesystem::path Checkpointer::versionPath(uint64_t version) const {
+    std::ostringstream file;
+    file << name_ << "-" << std::setw(8) << std::setfill('0') << version << ".pt";
+    return directory_ / file.str();
+}
+
+std::optional<uint64_t> Checkpointer::versionOf(const std::filesystem::path& path) const {
+    const std::string file = path.filename().string();
+    const std::string prefix = name_ + "-";
+    if (file.size() <= prefix.size() + 3 || file.rfind(prefix, 0) != 0 ||
+        file.compare(file.size() - 3, 3, ".pt") != 0) {
+        return std::nullopt;
+    }
+    const std::string digits = file.substr(prefix.size(), file.size() - prefix.size() - 3);
+    if (digits.empty() || !std::all_of(digits.begin(), digits.end(), [](unsigned char c) { return std::isdigit(c); })) {
+        return std::nullopt;
+    }
+    return std::stoull(digits);
+}
@@ -0,0 +1,61 @@
+#include "../include/device.hpp"
+#include <stdexcept>
+#ifdef PPO_WITH_CUDA
+#include <c10/cuda/CUDAGuard.h>
+#include <c10/cuda/CUDAStream.h>
+#endif
+
+torch::Device resolveDevice(const std::string& name) {
+    if (name == "auto") {
+        return torch::cuda::is_available() ? torch::Device(torch::kCUDA, 0) : torch::Device(torch::kCPU);
+    }
+
+    std::unique_ptr<torch::Device> device;
+    try {
+        device = std::make_unique<torch::Device>(name);
+    } catch (const c10::Error&) {
+        throw std::runtime_error("Unknown device " + name);
+    }
+    if (device->is_cuda()) {
+        const int64_t index = device->has_index() ? device->index() : 0;
+        if (!torch::cuda::is_available() || index >= static_cast<int64_t>(torch::cuda::device_count())) {
+            throw std::runtime_error("Device " + name + " is not available");
+        }
+        return torch::Device(torch::kCUDA, static_cast<c10::DeviceIndex>(index));
+    }
+    if (!device->is_cpu()) {
+        throw std::runtime_error("Unsupported device " + name);
+    }
+    return *device;
+}
+
+void synchronizeDevice(const torch::Device& device) {
+    if (!device.is_cuda()) return;
+#ifdef PPO_WITH_CUDA
+    c10::cuda::getCurrentCUDAStream(device.index()).synchronize();
+#else
+    torch::cuda::synchronize(device.index());
+#endif
+}
+
+#ifdef PPO_WITH_CUDA
+struct SideStreamScope::Guard {
+    explicit Guard(const torch::Device& device)
+        : stream_guard(c10::cuda::getStreamFromPool(/*isHighPriority=*/false, device.index())) {}
+    c10::cuda::CUDAStreamGuard stream_guard;
+};
+#else
+struct SideStreamScope::Guard {};
+#endif
+
+SideStreamScope::SideStreamScope(const torch::Device& device) {
+#ifdef PPO_WITH_CUDA
+    if (device.is_cuda()) {
+        guard_ = std::make_unique<Guard>(device);
+    }
+#else
+    (void)device;
+#endif
+}
+
+SideStreamScope::~SideStreamScope() = default;
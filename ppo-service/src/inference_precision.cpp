@@ -0,0 +1,143 @@
+#include "../include/inference_precision.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <stdexcept>
+#include <vector>
+
+const char* precisionName(InferencePrecision precision) {
+    switch (precision) {
+        case InferencePrecision::Float64: return "float64";
+        case InferencePrecision::Float32: return "float32";
+        case InferencePrecision::BFloat16: return "bf16";
+        case InferencePrecision::Int8: return "int8";
+    }
+    return "unknown";
+}
+
+bool parsePrecision(const std::string& name, InferencePrecision& precision) {
+    for (auto candidate : {InferencePrecision::Float64, InferencePrecision::Float32,
+                           InferencePrecision::BFloat16, InferencePrecision::Int8}) {
+        if (name == precisionName(candidate)) {
+            precision = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+torch::ScalarType precisionDtype(InferencePrecision precision) {
+    switch (precision) {
+        case InferencePrecision::Float64: return torch::kFloat64;
+        case InferencePrecision::BFloat16: return torch::kBFloat16;
+        case InferencePrecision::Float32:
+        case InferencePrecision::Int8: return torch::kFloat32;
+    }
+    return torch::kFloat64;
+}
+
+Actor makeInferenceActor(const Actor& master, InferencePrecision precision) {
+    const auto device = master->parameters().front().device();
+    if (precision == InferencePrecision::Int8 && !device.is_cpu()) {
+        throw std::runtime_error("int8 inference is only available on the CPU");
+    }
+
+    Actor inference(0);  // The input size argument is not used by the architecture
+    inference->to(device);
+    syncInferenceActor(master, inference, precision);
+    inference->eval();
+    return inference;
+}
+
+void syncInferenceActor(const Actor& master, Actor& inference, InferencePrecision precision) {
+    torch::NoGradGuard no_grad;
+    auto source = master->parameters();
+    auto target = inference->parameters();
+    for (size_t i = 0; i < source.size() && i < target.size(); ++i) {
+        target[i].copy_(source[i]);
+    }
+    inference->to(precisionDtype(precision));
+
+    if (precision == InferencePrecision::Int8) {
+        inference->quantizeDense();
+    }
+}
+
+void benchmarkPrecisions(const Actor& master, size_t iterations, std::ostream& out) {
+    torch::NoGradGuard no_grad;
+    constexpr size_t NUM_INPUTS = 16;
+    constexpr size_t WARMUP = 5;
+
+    // Random windows shaped like the network input; actions are compared on identical inputs
+    const auto device = master->parameters().front().device();
+    std::vector<torch::Tensor> inputs;
+    std::vector<std::tuple<torch::Tensor, torch::Tensor>> reference;
+    for (size_t i = 0; i < NUM_INPUTS; ++i) {
+        inputs.push_back(torch::randn({1, 80, 2421}, torch::TensorOptions().dtype(torch::kFloat64).device(device)));
+        reference.push_back(master->forward(inputs.back()));
+    }
+
+    out << std::left << std::setw(10) << "precision" << std::right
+        << std::setw(12) << "mean us" << std::setw(12) << "p99 us"
+        << std::setw(16) << "max |dprice|" << std::setw(16) << "max |dvolume|"
+        << std::setw(14) << "sign flips" << std::endl;
+
+    for (auto precision : {InferencePrecision::Float64, InferencePrecision::Float32,
+                           InferencePrecision::BFloat16, InferencePrecision::Int8}) {
+        try {
+            Actor actor = makeInferenceActor(master, precision);
+            const auto dtype = precisionDtype(precision);
+
+            std::vector<torch::Tensor> cast_inputs;
+            for (const auto& input : inputs) {
+                cast_inputs.push_back(input.to(dtype));
+            }
+            for (size_t i = 0; i < WARMUP; ++i) {
+                actor->forward(cast_inputs[i % NUM_INPUTS]);
+            }
+
+            std::vector<double> latencies;
+            latencies.reserve(iterations);
+            double max_price_diff = 0.0;
+            double max_volume_diff = 0.0;
+            size_t sign_flips = 0;
+            for (size_t i = 0; i < iterations; ++i) {
+                const size_t idx = i % NUM_INPUTS;
+                auto start = std::chrono::steady_clock::now();
+                auto [price, volume] = actor->forward(cast_inputs[idx]);
+                const double price_value = price.item<double>();
+                const double volume_value = volume.item<double>();
+                latencies.push_back(std::chrono::duration<double, std::micro>(
+                    std::chrono::steady_clock::now() - start).count());
+
+                const double reference_price = std::get<0>(reference[idx]).item<double>();
+                const double reference_volume = std::get<1>(reference[idx]).item<double>();
+                max_price_diff = std::max(max_price_diff, std::abs(price_value - reference_price));
+                max_volume_diff = std::max(max_volume_diff, std::abs(volume_value - reference_volume));
+                if ((price_value < 0.0) != (reference_price < 0.0)) {
+                    ++sign_flips;  // Decision would change direction
+                }
+            }
+
+            if (latencies.empty()) continue;
+            std::sort(latencies.begin(), latencies.end());
+            double mean = 0.0;
+            for (double latency : latencies) mean += latency;
+            mean /= static_cast<double>(latencies.size());
+            const double p99 = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+
+            out << std::left << std::setw(10) << precisionName(precision) << std::right << std::fixed
+                << std::setprecision(1) << std::setw(12) << mean << std::setw(12) << p99
+                << std::scientific << std::setprecision(2) << std::setw(16) << max_price_diff
+                << std::setw(16) << max_volume_diff << std::setw(14) << sign_flips
+                << std::defaultfloat << std::endl;
+        } catch (const c10::Error& e) {
+            out << std::left << std::setw(10) << precisionName(precision)
+                << " unavailable: " << e.what_without_backtrace() << std::endl;
+        } catch (const std::runtime_error& e) {
+            out << std::left << std::setw(10) << precisionName(precision)
+                << " unavailable: " << e.what() << std::endl;
+        }
+    }
+}
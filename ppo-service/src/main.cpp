@@ -1,8 +1,11 @@
 #include "../include/ppo_handler.hpp"
+#include <metrics_server.hpp>
 #include <iostream>
 #include <cstdlib>
 #include <csignal>
 #include <string>
+#include <sstream>
+#include <vector>
 
 // Global PPO handler for signal handling
 PPOHandler* g_ppo_handler = nullptr;
@@ -26,11 +29,79 @@ int main() {
         int port = std::getenv("RABBITMQ_PORT") ? std::stoi(std::getenv("RABBITMQ_PORT")) : 5672;
         std::string username = std::getenv("RABBITMQ_USERNAME") ? std::getenv("RABBITMQ_USERNAME") : "guest";
         std::string password = std::getenv("RABBITMQ_PASSWORD") ? std::getenv("RABBITMQ_PASSWORD") : "guest";
+        std::string instrument = std::getenv("PPO_INSTRUMENT") ? std::getenv("PPO_INSTRUMENT") : "BTC-USDT-SWAP";
 
         // Create and start PPO handler
-        PPOHandler ppo(host, port, username, password);
+        PPOHandler ppo(host, port, username, password, instrument);
         g_ppo_handler = &ppo;
 
+        // PPO_DEVICE: auto (default, CUDA when available), cpu, cuda or cuda:<index>
+        ppo.setDevice(resolveDevice(std::getenv("PPO_DEVICE") ? std::getenv("PPO_DEVICE") : "auto"));
+
+        // PPO_PREFETCH, PPO_ACK_BATCH and PPO_ACK_INTERVAL_MS tune the consumers (256, 64, 20)
+        ppo.setConsumerOptions(amqp_consumer::optionsFromEnv("PPO"));
+
+        // PPO_TRANSPORT=shm exchanges states and actions through shared memory (default rabbitmq)
+        if (const char* name = std::getenv("PPO_TRANSPORT")) {
+            transport::Kind kind;
+            if (!transport::parseKind(name, kind)) {
+                std::cerr << "Unknown PPO_TRANSPORT " << name << std::endl;
+                return 1;
+            }
+            ppo.setTransport(kind);
+        }
+
+        // PPO_CONFLATE=0 decides on every due state even when the consumer is behind
+        if (std::getenv("PPO_CONFLATE") && std::string(std::getenv("PPO_CONFLATE")) == "0") {
+            ppo.setConflation(false);
+        }
+
+        // PPO_INCREMENTAL_INFERENCE=0 runs the full actor forward for every decision
+        if (std::getenv("PPO_INCREMENTAL_INFERENCE") && std::string(std::getenv("PPO_INCREMENTAL_INFERENCE")) == "0") {
+            ppo.setIncrementalInference(false);
+            std::cout << "Incremental inference disabled" << std::endl;
+        }
+
+        // PPO_INFERENCE_PRECISION: float64 (default), float32, bf16 or int8
+        if (const char* name = std::getenv("PPO_INFERENCE_PRECISION")) {
+            InferencePrecision precision;
+            if (!parsePrecision(name, precision)) {
+                std::cerr << "Unknown PPO_INFERENCE_PRECISION " << name << std::endl;
+                return 1;
+            }
+            ppo.setInferencePrecision(precision);
+        }
+
+        // PPO_CUDA_GRAPHS=1 replays a captured graph of the actor forward for every decision
+        if (std::getenv("PPO_CUDA_GRAPHS") && std::string(std::getenv("PPO_CUDA_GRAPHS")) == "1") {
+            ppo.setCudaGraphs(true);
+        }
+
+        // PPO_SHADOW_MODELS: comma-separated checkpoint files evaluated alongside the champion
+        if (const char* models = std::getenv("PPO_SHADOW_MODELS")) {
+            std::vector<std::string> paths;
+            std::stringstream list(models);
+            for (std::string path; std::getline(list, path, ',');) {
+                if (!path.empty()) {
+                    paths.push_back(path);
+                }
+            }
+            ppo.addShadowModels(paths, std::getenv("PPO_SHADOW_LOG") ? std::getenv("PPO_SHADOW_LOG") : "shadow_actions.csv");
+        }
+
+        // PPO_PRECISION_BENCHMARK=<iterations> compares the precisions and exits
+        if (const char* iterations = std::getenv("PPO_PRECISION_BENCHMARK")) {
+            ppo.runPrecisionBenchmark(std::stoul(iterations));
+            return 0;
+        }
+
+        // PPO_METRICS_PORT serves the stage latencies for Prometheus (default 9102, 0 disables)
+        const int metrics_port = std::getenv("PPO_METRICS_PORT") ? std::stoi(std::getenv("PPO_METRICS_PORT")) : 9102;
+        latency::MetricsServer metrics(static_cast<uint16_t>(metrics_port));
+        if (metrics_port > 0) {
+            metrics.start();
+        }
+
         std::cout << "Starting PPO service..." << std::endl;
         ppo.start();
 
@@ -1,5 +1,7 @@
 #include "../include/ppo_handler.hpp"
 #include <binary_utils.hpp>
+#include <orderbook_wire.hpp>
+#include <async_logger.hpp>
 #include <iostream>
 #include <iomanip>
 #include <stdexcept>
@@ -9,37 +11,99 @@
 #include <filesystem>
 
 PPOHandler::PPOHandler(const std::string& host, int port,
-                     const std::string& username, const std::string& password)
+                     const std::string& username, const std::string& password,
+                     const std::string& instrument)
     : host_(host), port_(port), username_(username), password_(password),
+      instrument_(instrument), orderbook_routing_key_("orderbook.updates." + instrument),
+      execution_routing_key_("execution.update." + instrument), action_routing_key_("oms.action." + instrument),
+      orderbook_queue_("ppo_queue." + instrument), execution_queue_("ppo_execution_queue." + instrument),
       is_running_(false), conn_(nullptr), socket_(nullptr),
-      actor_(INPUT_SIZE), critic_(INPUT_SIZE), state_counter_(0) {
+      actor_(INPUT_SIZE), critic_(INPUT_SIZE),
+      incremental_actors_{IncrementalActor<NETWORK_INPUT_SIZE>(Actor(nullptr)),
+                          IncrementalActor<NETWORK_INPUT_SIZE>(Actor(nullptr))},
+      state_counter_(0) {
     
     // Initialize random seed
     srand(static_cast<unsigned int>(time(nullptr)));
     
-    // Create models directory if it doesn't exist
-    std::filesystem::create_directories(MODEL_DIR);
-    
     initializeNetworks();
     
     // Try to load existing model
     if (loadModel()) {
-        std::cout << "Loaded pre-trained model successfully" << std::endl;
+        LOG_INFO("Loaded pre-trained model successfully");
     } else {
-        std::cout << "Starting with fresh model" << std::endl;
+        LOG_INFO("Starting with fresh model");
     }
+
+    // Decision copies start from the loaded weights
+    resetInferenceActors();
 }
 
 PPOHandler::~PPOHandler() {
-    // Save model on shutdown
+    // The master networks are only safe to read once the learner is gone
+    stopLearner();
+
+    // Save model on shutdown; the checkpointer finishes writing it before it is destroyed
     try {
         saveModel("shutdown");
     } catch (const std::exception& e) {
-        std::cerr << "Error saving model during shutdown: " << e.what() << std::endl;
+        LOG_ERROR("Error saving model during shutdown: {}", e.what());
     }
     stop();
 }
 
+void PPOHandler::setDevice(const torch::Device& device) {
+    device_ = device;
+    actor_->to(device_);
+    critic_->to(device_);
+
+    // Adam moments restored from a checkpoint follow the parameters
+    moveOptimizerState(*actor_optimizer_, device_);
+    moveOptimizerState(*critic_optimizer_, device_);
+
+    state_ring_.setDevice(device_);
+    resetInferenceActors();
+    LOG_INFO("Running networks on {}", device_.str());
+}
+
+void PPOHandler::setCudaGraphs(bool enabled) {
+#ifdef PPO_WITH_CUDA
+    if (enabled && !device_.is_cuda()) {
+        LOG_WARN("CUDA graphs need a CUDA device, deciding without them");
+        return;
+    }
+    cuda_graphs_ = enabled;
+    resetInferenceActors();
+#else
+    if (enabled) {
+        LOG_WARN("Built without PPO_WITH_CUDA, deciding without CUDA graphs");
+    }
+#endif
+}
+
+void PPOHandler::setInferencePrecision(InferencePrecision precision) {
+    inference_precision_ = precision;
+    resetInferenceActors();
+    LOG_INFO("Deciding with {} inference", precisionName(precision));
+}
+
+void PPOHandler::resetInferenceActors() {
+    inference_actors_.reset(actor_, inference_precision_);
+    incremental_actors_ = {IncrementalActor<NETWORK_INPUT_SIZE>(inference_actors_.buffer(0)),
+                           IncrementalActor<NETWORK_INPUT_SIZE>(inference_actors_.buffer(1))};
+#ifdef PPO_WITH_CUDA
+    for (size_t i = 0; i < graph_actors_.size(); ++i) {
+        graph_actors_[i] = cuda_graphs_ ? std::make_unique<CudaGraphActor>(inference_actors_.buffer(i)) : nullptr;
+    }
+#endif
+    active_inference_ = 0;
+}
+
+void PPOHandler::runPrecisionBenchmark(size_t iterations) {
+    actor_->eval();
+    benchmarkPrecisions(actor_, iterations, std::cout);
+}
+
 void PPOHandler::initializeNetworks() {
     try {
         // Initialize networks
@@ -55,12 +119,12 @@ void PPOHandler::initializeNetworks() {
         actor_->eval();
         critic_->eval();
 
-        std::cout << "Neural networks initialized with double precision" << std::endl;
+        LOG_INFO("Neural networks initialized with double precision");
     } catch (const c10::Error& e) {
-        std::cerr << "LibTorch error during network initialization: " << e.what() << std::endl;
+        LOG_ERROR("LibTorch error during network initialization: {}", e.what());
         throw;
     } catch (const std::exception& e) {
-        std::cerr << "Error during network initialization: " << e.what() << std::endl;
+        LOG_ERROR("Error during network initialization: {}", e.what());
         throw;
     }
 }
@@ -76,28 +140,29 @@ void PPOHandler::declareExchangesAndQueues() {
         amqp_cstring_bytes("execution-exchange"), amqp_cstring_bytes("topic"),
         0, 1, 0, 0, amqp_empty_table);
 
-    // Declare and bind queue for orderbook updates
+    // Declare and bind queue for orderbook updates, one per instrument so the PPO processes of
+    // different instruments never compete for each other's states
     amqp_queue_declare(conn_, 1,
-        amqp_cstring_bytes("ppo_queue"),
+        amqp_cstring_bytes(orderbook_queue_.c_str()),
         0, 1, 0, 0,
         amqp_empty_table);
     
     amqp_queue_bind(conn_, 1,
-        amqp_cstring_bytes("ppo_queue"),
+        amqp_cstring_bytes(orderbook_queue_.c_str()),
         amqp_cstring_bytes("orderbook"),
-        amqp_cstring_bytes("orderbook.updates"),
+        amqp_cstring_bytes(orderbook_routing_key_.c_str()),
         amqp_empty_table);
 
-    // Declare and bind queue for execution updates
+    // Declare and bind queue for the execution updates of this instrument's OMS
     amqp_queue_declare(conn_, 1,
-        amqp_cstring_bytes("ppo_execution_queue"),
+        amqp_cstring_bytes(execution_queue_.c_str()),
         0, 1, 0, 0,
         amqp_empty_table);
     
     amqp_queue_bind(conn_, 1,
-        amqp_cstring_bytes("ppo_execution_queue"),
+        amqp_cstring_bytes(execution_queue_.c_str()),
         amqp_cstring_bytes("execution-exchange"),
-        amqp_cstring_bytes("execution.update"),
+        amqp_cstring_bytes(execution_routing_key_.c_str()),
         amqp_empty_table);
 }
 
@@ -110,66 +175,173 @@ void PPOHandler::start() {
         initializeRabbitMQ();
         declareExchangesAndQueues();
         is_running_ = true;
+        startLearner();
+
+        // Orderbook states and execution updates on separate channels with manual, batched acks,
+        // so a backlog of states never holds an execution update behind it
+        amqp_consumer::Consumer consumer(conn_, consumer_options_);
+        std::unique_ptr<transport::ShmSubscriber> states;
+        if (transport_ == transport::Kind::Shm) {
+            states = std::make_unique<transport::ShmSubscriber>(transport::ringName(orderbook_routing_key_));
+            action_publisher_ = std::make_unique<transport::ShmPublisher>(
+                transport::actionRingName(instrument_), ACTION_RING_SLOT_SIZE, ACTION_RING_SLOTS);
+        } else {
+            consumer.subscribe(ORDERBOOK_CHANNEL, orderbook_queue_, false);
+            action_publisher_ = std::make_unique<transport::AmqpPublisher>(conn_, ORDERBOOK_CHANNEL, "oms",
+                                                                           action_routing_key_);
+        }
+        consumer.subscribe(EXECUTION_CHANNEL, execution_queue_);
+        execution_channel_open_ = true;
 
-        // Start consuming messages from both queues with manual ack
-        amqp_basic_consume(conn_, 1,
-            amqp_cstring_bytes("ppo_queue"),
-            amqp_empty_bytes, 0, 0, 0,  // Changed auto_ack to 0
-            amqp_empty_table);
-
-        amqp_basic_consume(conn_, 1,
-            amqp_cstring_bytes("ppo_execution_queue"),
-            amqp_empty_bytes, 0, 0, 0,  // Changed auto_ack to 0
-            amqp_empty_table);
-
-        std::cout << "PPO service started. Listening for orderbook and execution updates..." << std::endl;
+        LOG_INFO("PPO service started. Listening for orderbook and execution updates...");
 
         // Message consumption loop
+        auto handle = [this](const amqp_consumer::Delivery& delivery) {
+            try {
+                if (delivery.routing_key == orderbook_routing_key_) {
+                    handleMessage(delivery.body);
+                } else if (delivery.routing_key == execution_routing_key_) {
+                    handleExecutionUpdate(delivery.body);
+                } else {
+                    // A binding this process did not declare, e.g. left over on a durable queue
+                    LOG_RATE_LIMITED(1000, Warn, "Dropping message with unexpected routing key {}",
+                                     delivery.routing_key);
+                }
+                return amqp_consumer::Outcome::Ack;
+            } catch (const std::exception& e) {
+                LOG_ERROR("Error processing message: {}", e.what());
+                return amqp_consumer::Outcome::Requeue;
+            }
+        };
         while (is_running_) {
-            amqp_envelope_t envelope;
-            amqp_maybe_release_buffers(conn_);
-            
-            struct timeval timeout;
-            timeout.tv_sec = 1;
-            timeout.tv_usec = 0;
-            
-            auto result = amqp_consume_message(conn_, &envelope, &timeout, 0);
-            
-            if (result.reply_type == AMQP_RESPONSE_NORMAL) {
-                std::string message(static_cast<char*>(envelope.message.body.bytes),
-                                  envelope.message.body.len);
-                
-                try {
-                    // Check the routing key to determine message type
-                    std::string routing_key(static_cast<char*>(envelope.routing_key.bytes),
-                                          envelope.routing_key.len);
-                    
-                    if (routing_key == "orderbook.updates") {
+            if (states) {
+                // States from the ring, then whatever execution update the broker has, without waiting
+                std::string_view message;
+                if (states->poll(message, SHM_POLL_WAIT)) {
+                    try {
                         handleMessage(message);
-                        // Acknowledge message after successful processing
-                        amqp_basic_ack(conn_, 1, envelope.delivery_tag, 0);
-                    } else if (routing_key == "execution.update") {
-                        handleExecutionUpdate(message);
-                        // Acknowledge message after successful processing
-                        amqp_basic_ack(conn_, 1, envelope.delivery_tag, 0);
+                    } catch (const std::exception& e) {
+                        LOG_ERROR("Error processing message: {}", e.what());
                     }
-                } catch (const std::exception& e) {
-                    std::cerr << "Error processing message: " << e.what() << std::endl;
-                    // Reject and requeue message on error
-                    amqp_basic_reject(conn_, 1, envelope.delivery_tag, 1);
                 }
-                
-                amqp_destroy_envelope(&envelope);
+                consumer.poll(handle, std::chrono::microseconds(0));
+            } else {
+                consumer.poll(handle, std::chrono::seconds(1));
+            }
+
+            // Decide once the buffered deliveries are drained, on the newest state. As without
+            // conflation that must be an even state ID; an odd newest one waits for the next.
+            const bool backlogged = consumer.backlogged() || (states && states->backlogged());
+            if (decision_pending_ && !(conflate_ && backlogged) && state_ring_.newestInfo().state_id % 2 == 0) {
+                decidePending();
             }
         }
 
     } catch (const std::exception& e) {
-        std::cerr << "Error in PPO service: " << e.what() << std::endl;
+        LOG_ERROR("Error in PPO service: {}", e.what());
         stop();
         throw;
     }
 }
 
+void PPOHandler::startLearner() {
+    {
+        std::lock_guard<std::mutex> lock(learner_mutex_);
+        if (learner_running_) return;
+        learner_running_ = true;
+    }
+    learner_thread_ = std::thread(&PPOHandler::learnerLoop, this);
+}
+
+void PPOHandler::stopLearner() {
+    {
+        std::lock_guard<std::mutex> lock(learner_mutex_);
+        learner_running_ = false;
+        if (!learner_jobs_.empty()) {
+            LOG_WARN("Dropping {} queued trades on shutdown", learner_jobs_.size());
+            learner_jobs_.clear();
+        }
+    }
+    learner_cv_.notify_one();
+    if (learner_thread_.joinable()) {
+        learner_thread_.join();
+    }
+}
+
+void PPOHandler::enqueueTraining(const TradeInfo& trade) {
+    // The states are gathered here, on the thread that owns the state ring
+    LearnerJob job;
+    job.trade = trade;
+    job.states = getStatesFromTrade(trade, job.coefficients);
+    if (job.states.empty()) {
+        LOG_WARN("No buffered states for the completed trade, skipping training");
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(learner_mutex_);
+        if (learner_jobs_.size() >= MAX_PENDING_TRADES) {
+            LOG_WARN("Learner is {} trades behind, dropping the oldest", learner_jobs_.size());
+            learner_jobs_.pop_front();
+        }
+        learner_jobs_.push_back(std::move(job));
+    }
+    learner_cv_.notify_one();
+}
+
+void PPOHandler::requestSave(const std::string& reason) {
+    {
+        std::lock_guard<std::mutex> lock(learner_mutex_);
+        save_request_ = reason;
+    }
+    learner_cv_.notify_one();
+}
+
+void PPOHandler::learnerLoop() {
+    // Training kernels get their own stream on CUDA, decisions keep the default one
+    SideStreamScope stream(device_);
+    logging::setThreadName("learner");
+
+    while (true) {
+        std::optional<LearnerJob> job;
+        std::string save_reason;
+        {
+            std::unique_lock<std::mutex> lock(learner_mutex_);
+            learner_cv_.wait_for(lock, LEARNER_IDLE_WAIT, [this] {
+                return !learner_running_ || !learner_jobs_.empty() || !save_request_.empty();
+            });
+            if (!learner_running_) break;
+            if (!learner_jobs_.empty()) {
+                job = std::move(learner_jobs_.front());
+                learner_jobs_.pop_front();
+            }
+            save_reason.swap(save_request_);
+        }
+
+        if (job) {
+            LOG_INFO("Starting network update...");
+            updateNetworks(*job);
+            LOG_INFO("Network update completed");
+        }
+
+        // Retried every wakeup until the inference thread has let go of the spare copy
+        if (weights_pending_ && inference_actors_.publish(actor_)) {
+            weights_pending_ = false;
+        }
+
+        if (!save_reason.empty()) {
+            try {
+                saveModel(save_reason);
+            } catch (const std::exception& e) {
+                LOG_ERROR("Error saving model at interval: {}", e.what());
+            }
+        }
+    }
+
+    // Hand the master networks back with none of the learner's kernels still in flight
+    synchronizeDevice(device_);
+}
+
 void PPOHandler::stop() {
     is_running_ = false;
     cleanupRabbitMQ();
@@ -203,7 +375,11 @@ void PPOHandler::initializeRabbitMQ() {
 void PPOHandler::cleanupRabbitMQ() {
     if (conn_) {
         try {
-            amqp_channel_close(conn_, 1, AMQP_REPLY_SUCCESS);
+            if (execution_channel_open_) {
+                amqp_channel_close(conn_, EXECUTION_CHANNEL, AMQP_REPLY_SUCCESS);
+                execution_channel_open_ = false;
+            }
+            amqp_channel_close(conn_, ORDERBOOK_CHANNEL, AMQP_REPLY_SUCCESS);
             amqp_connection_close(conn_, AMQP_REPLY_SUCCESS);
             amqp_destroy_connection(conn_);
         } catch (...) {
@@ -214,123 +390,159 @@ void PPOHandler::cleanupRabbitMQ() {
     }
 }
 
-void PPOHandler::handleMessage(const std::string& message) {
+void PPOHandler::handleMessage(std::string_view message) {
+    const uint64_t start_ns = latency::nowNanos();
     try {
-        const size_t expected_size = (OrderBookState::LEVELS * 2 * OrderBookState::VALUES_PER_LEVEL + 
-                                    1 + OrderBookState::NUM_DEPTHS * OrderBookState::NUM_FEATURES) * sizeof(uint64_t) +
-                                    sizeof(uint32_t) +  // 4 bytes for mid-price
-                                    sizeof(uint16_t);   // 2 bytes for state ID
-
-        if (message.size() != expected_size) {
+        // Dispatch on the message version: v2 has a fixed size, v3 carries a header.
+        // Either way the state is decoded straight into its row of the history ring.
+        double* row = state_ring_.acquire();
+        StateInfo info;
+        if (message.size() == orderbook_wire::V2_MESSAGE_SIZE) {
+            decodeV2Message(message, row, info);
+        } else if (orderbook_wire::isV3Message(message.data(), message.size())) {
+            if (!decodeV3Message(message, row, info)) {
+                return;  // Delta whose base state we do not have
+            }
+        } else {
             throw std::runtime_error("Invalid message size: got " + std::to_string(message.size()) + 
-                                   " bytes, expected " + std::to_string(expected_size) + " bytes");
+                                   " bytes, expected " + std::to_string(orderbook_wire::V2_MESSAGE_SIZE) +
+                                   " bytes or a v3 message");
         }
 
-        const uint64_t* data = reinterpret_cast<const uint64_t*>(message.data());
-        OrderBookState state;
-        size_t offset = 0;
-        
-        // Process bids
-        for (size_t i = 0; i < OrderBookState::LEVELS; ++i) {
-            double* level = state.bid_level(i);
-            level[0] = binary_utils::decodeChangeValue(data[offset++]);    // price
-            level[1] = binary_utils::decodeOrderBookValue(data[offset++]); // volume
-            level[2] = binary_utils::decodeOrderBookValue(data[offset++]); // orders
-        }
-        
-        // Process asks
-        for (size_t i = 0; i < OrderBookState::LEVELS; ++i) {
-            double* level = state.ask_level(i);
-            level[0] = binary_utils::decodeChangeValue(data[offset++]);    // price
-            level[1] = binary_utils::decodeOrderBookValue(data[offset++]); // volume
-            level[2] = binary_utils::decodeOrderBookValue(data[offset++]); // orders
-        }
+        // The ring keeps the last 1000 states, overwriting the oldest
+        state_ring_.commit(info);
+        decode_latency_.recordSince(start_ns);
         
-        // Process mid price change
-        state.mid_price_change = binary_utils::decodeChangeValue(data[offset++]);
-        
-        // Process market features
-        for (size_t depth = 0; depth < OrderBookState::NUM_DEPTHS; ++depth) {
-            state.feature_at(depth, 0) = binary_utils::decodeChangeValue(data[offset++]); // volume imbalance
-            state.feature_at(depth, 1) = binary_utils::decodeChangeValue(data[offset++]); // order imbalance
-            state.feature_at(depth, 2) = binary_utils::decodeChangeValue(data[offset++]); // bid VWAP change
-            state.feature_at(depth, 3) = binary_utils::decodeChangeValue(data[offset++]); // ask VWAP change
-        }
-
-        // Get mid-price from the last 4 bytes before state ID
-        const uint32_t* mid_price_cents = reinterpret_cast<const uint32_t*>(
-            message.data() + message.size() - sizeof(uint16_t) - sizeof(uint32_t));
-        state.mid_price = static_cast<double>(*mid_price_cents) / binary_utils::CENTS_MULTIPLIER;
-
-        // Get state ID from the last two bytes
-        const uint16_t* last_bytes = reinterpret_cast<const uint16_t*>(
-            message.data() + message.size() - sizeof(uint16_t));
-        state.state_id = *last_bytes;
-
-        // Maintain the 1000-state history buffer
-        if (state_buffer_.size() >= HISTORY_BUFFER_SIZE) {
-            state_buffer_.pop_front();
-        }
-        state_buffer_.push_back(std::move(state));
-        
-        // Increment state counter and save if needed
+        // Increment state counter and have the learner save if needed
         state_counter_++;
         if (state_counter_ % SAVE_INTERVAL == 0) {
-            try {
-                saveModel();
-                std::cout << "[" << getCurrentTimestamp() << "] Model saved after " 
-                          << state_counter_ << " states" << std::endl;
-            } catch (const std::exception& e) {
-                std::cerr << "Error saving model at interval: " << e.what() << std::endl;
-            }
+            requestSave("interval after " + std::to_string(state_counter_) + " states");
         }
 
-        // Process if we have enough states for network input
-        if (state_buffer_.size() >= NETWORK_INPUT_SIZE && state_buffer_.back().state_id % 2 == 0) {
-            trigger_state_id_ = state_buffer_.back().state_id;
-            forwardPass();
+        // Every other state is due for a decision once there are enough states for network input.
+        // The consumer loop makes it, after any newer buffered states (see setConflation).
+        if (state_ring_.size() >= NETWORK_INPUT_SIZE && state_ring_.newestInfo().state_id % 2 == 0) {
+            if (decision_pending_) {
+                conflated_decisions_++;
+                LOG_RATE_LIMITED(10000, Info, "Behind the orderbook, {} decisions skipped for newer states",
+                                 conflated_decisions_);
+            }
+            decision_pending_ = true;
         }
 
     } catch (const std::exception& e) {
-        std::cerr << "Error processing binary message: " << e.what() << std::endl;
+        LOG_ERROR("Error processing binary message: {}", e.what());
     }
 }
 
-torch::Tensor PPOHandler::preprocessState() {
-    std::vector<double> features;
-    features.reserve(OrderBookState::TOTAL_FEATURES * NETWORK_INPUT_SIZE);
-    
-    // Use only the newest NETWORK_INPUT_SIZE states
-    auto start_it = std::prev(state_buffer_.end(), NETWORK_INPUT_SIZE);
-    auto end_it = state_buffer_.end();
-    
-    for (auto it = start_it; it != end_it; ++it) {
-        // Direct copy, no type conversion
-        features.insert(features.end(), it->bids.begin(), it->bids.end());
-        features.insert(features.end(), it->asks.begin(), it->asks.end());
-        features.push_back(it->mid_price_change);
-        features.insert(features.end(), it->features.begin(), it->features.end());
+void PPOHandler::decidePending() {
+    decision_pending_ = false;
+    trigger_state_id_ = state_ring_.newestInfo().state_id;
+    try {
+        forwardPass();
+    } catch (const std::exception& e) {
+        LOG_ERROR("Error during forward pass: {}", e.what());
     }
-    
-    // Create float64 tensor with shape [1, 80, 2421]
-    return torch::from_blob(
-        features.data(),
-        {1, NETWORK_INPUT_SIZE, OrderBookState::TOTAL_FEATURES},
-        torch::TensorOptions().dtype(torch::kFloat64)
-    ).clone();
+}
+
+void PPOHandler::decodeV2Message(std::string_view message, double* row, StateInfo& info) {
+    const char* data = message.data();
+    constexpr size_t SIDE_BYTES = OrderBookState::SIDE_VALUES * sizeof(uint64_t);
+
+    // Bulk-decode bids and asks straight into the row
+    binary_utils::decodeLevels(data, OrderBookState::LEVELS, row + OrderBookState::BIDS_OFFSET);
+    binary_utils::decodeLevels(data + SIDE_BYTES, OrderBookState::LEVELS, row + OrderBookState::ASKS_OFFSET);
+
+    // Mid price change followed by the [depth][feature] market features, adjacent in the row
+    const char* feature_data = data + 2 * SIDE_BYTES;
+    binary_utils::decodeChangeValues(feature_data, 1 + OrderBookState::NUM_MARKET_FEATURES,
+                                     row + OrderBookState::MID_PRICE_CHANGE_OFFSET);
+
+    // Get mid-price from the last 4 bytes before state ID
+    const uint32_t* mid_price_cents = reinterpret_cast<const uint32_t*>(
+        message.data() + message.size() - sizeof(uint16_t) - sizeof(uint32_t));
+    info.mid_price = static_cast<double>(*mid_price_cents) / binary_utils::CENTS_MULTIPLIER;
+
+    // Get state ID from the last two bytes
+    const uint16_t* last_bytes = reinterpret_cast<const uint16_t*>(
+        message.data() + message.size() - sizeof(uint16_t));
+    info.state_id = *last_bytes;
+}
+
+bool PPOHandler::decodeV3Message(std::string_view message, double* row, StateInfo& info) {
+    static_assert(OrderBookState::LEVELS == orderbook_wire::LEVELS &&
+                  1 + OrderBookState::NUM_MARKET_FEATURES == orderbook_wire::FEATURE_VALUES,
+                  "OrderBookState out of sync with the wire format");
+    const auto header = orderbook_wire::parseHeader(message.data(), message.size());
+
+    // Deltas rebuild on top of the newest buffered state
+    const double* base = nullptr;
+    if (!header.keyframe()) {
+        if (state_ring_.empty() || state_ring_.newestInfo().state_id != header.base_state_id) {
+            if (v3_synced_) {
+                LOG_WARN("Missing base state {} for delta {}, waiting for keyframe", header.base_state_id, header.state_id);
+                v3_synced_ = false;
+            }
+            return false;
+        }
+        base = state_ring_.newest();
+    }
+
+    // The mid price change and market features are decoded as one run, matching the row layout
+    orderbook_wire::decodeMessage(message.data(), message.size(), header,
+                                  base ? base + OrderBookState::BIDS_OFFSET : nullptr,
+                                  base ? base + OrderBookState::ASKS_OFFSET : nullptr,
+                                  row + OrderBookState::BIDS_OFFSET, row + OrderBookState::ASKS_OFFSET,
+                                  row + OrderBookState::MID_PRICE_CHANGE_OFFSET);
+
+    info.mid_price = static_cast<double>(header.mid_price_cents) / binary_utils::CENTS_MULTIPLIER;
+    info.state_id = header.state_id;
+    info.origin_ns = header.origin_ns;
+    v3_synced_ = true;
+    return true;
+}
+
+torch::Tensor PPOHandler::preprocessState() {
+    // [1, 80, 2421] float64 view of the newest states; no copy
+    return state_ring_.window();
 }
 
 void PPOHandler::forwardPass() {
     torch::NoGradGuard no_grad;
+    const uint64_t start_ns = latency::nowNanos();
     
-    auto input_tensor = preprocessState();
-    
-    // Forward pass through actor network (all in float64)
-    auto [price_tensor, volume_tensor] = actor_->forward(input_tensor);
+    // Decide with the newest published copy; its conv1 cache predates the new weights
+    const size_t idx = inference_actors_.acquire();
+    if (idx != active_inference_) {
+        incremental_actors_[idx].invalidate();
+        active_inference_ = idx;
+    }
+
+    // Forward pass through actor network (float64 unless a lower inference precision is set)
+    torch::Tensor price_tensor;
+    torch::Tensor volume_tensor;
+#ifdef PPO_WITH_CUDA
+    if (cuda_graphs_) {
+        try {
+            std::tie(price_tensor, volume_tensor) =
+                graph_actors_[idx]->forward(preprocessState().to(precisionDtype(inference_precision_)));
+        } catch (const c10::Error& e) {
+            LOG_ERROR("CUDA graph capture failed, deciding without graphs: {}", e.what_without_backtrace());
+            cuda_graphs_ = false;
+        }
+    }
+#endif
+    if (!price_tensor.defined()) {
+        std::tie(price_tensor, volume_tensor) = incremental_inference_
+            ? incremental_actors_[idx].forward(state_ring_)
+            : inference_actors_.buffer(idx)->forward(preprocessState().to(precisionDtype(inference_precision_)));
+    }
     
     // Get the values from tensors
     double price_value = price_tensor.item<double>();
     double volume_value = volume_tensor.item<double>();
+    const double policy_price = price_value;
+    forward_latency_.recordSince(start_ns);
 
     // Apply exploration during initial period (first 1000 states)
     constexpr size_t EXPLORATION_PERIOD = 1000;
@@ -338,8 +550,7 @@ void PPOHandler::forwardPass() {
         // During exploration, randomly flip the price signal with 50% probability
         if (rand() % 2 == 0) {
             price_value = -price_value;
-            std::cout << "[" << getCurrentTimestamp() << "] Exploration: Flipped price signal to " 
-                      << price_value << " (State " << state_counter_ << "/" << EXPLORATION_PERIOD << ")" << std::endl;
+            LOG_DEBUG("Exploration: Flipped price signal to {} (State {}/{})", price_value, state_counter_, EXPLORATION_PERIOD);
         }
     }
 
@@ -349,9 +560,65 @@ void PPOHandler::forwardPass() {
     
     // Publish the action with possibly modified values
     publishAction(modified_price_tensor, modified_volume_tensor);
+    tick_to_action_latency_.recordSince(state_ring_.newestInfo().origin_ns);
+
+    // Shadows only run once the champion's action is out
+    if (shadow_ensemble_) {
+        evaluateShadows(policy_price, volume_value);
+    }
+}
+
+void PPOHandler::addShadowModels(const std::vector<std::string>& paths, const std::string& log_path) {
+    std::vector<Actor> members;
+    for (const auto& path : paths) {
+        Actor actor(INPUT_SIZE);
+        restoreParameters(Checkpointer::read(path).actor, *actor);
+        actor->to(device_);
+        members.push_back(actor);
+        shadow_names_.push_back(std::filesystem::path(path).stem().string());
+    }
+    if (members.empty()) return;
+
+    shadow_ensemble_ = ActorEnsemble(members);
+    shadow_ensemble_->to(precisionDtype(inference_precision_));  // int8 shadows stay float32
+    shadow_ensemble_->eval();
+    shadow_incremental_ = std::make_unique<IncrementalActor<NETWORK_INPUT_SIZE, ActorEnsemble>>(shadow_ensemble_);
+
+    shadow_log_.open(log_path, std::ios::app);
+    if (!shadow_log_) {
+        throw std::runtime_error("Cannot open shadow action log " + log_path);
+    }
+    shadow_log_ << std::setprecision(10);
+    shadow_log_ << "timestamp,state_id,champion_price,champion_volume";
+    for (const auto& name : shadow_names_) {
+        shadow_log_ << ',' << name << "_price," << name << "_volume";
+    }
+    shadow_log_ << std::endl;
+    LOG_INFO("Evaluating {} shadow models, logging to {}", shadow_names_.size(), log_path);
+}
+
+void PPOHandler::evaluateShadows(double champion_price, double champion_volume) {
+    torch::NoGradGuard no_grad;
+    try {
+        auto [prices, volumes] = incremental_inference_
+            ? shadow_incremental_->forward(state_ring_)
+            : shadow_ensemble_->forward(preprocessState().to(precisionDtype(inference_precision_)));
+        prices = prices.to(torch::kCPU, torch::kFloat64).contiguous();
+        volumes = volumes.to(torch::kCPU, torch::kFloat64).contiguous();
+
+        shadow_log_ << getCurrentTimestamp() << ',' << trigger_state_id_ << ','
+                    << champion_price << ',' << champion_volume;
+        for (int64_t k = 0; k < prices.size(0); ++k) {
+            shadow_log_ << ',' << prices.data_ptr<double>()[k] << ',' << volumes.data_ptr<double>()[k];
+        }
+        shadow_log_ << '\n';
+    } catch (const std::exception& e) {
+        LOG_ERROR("Error evaluating shadow models: {}", e.what());
+    }
 }
 
 void PPOHandler::publishAction(const torch::Tensor& price, const torch::Tensor& volume) {
+    const uint64_t start_ns = latency::nowNanos();
     try {
         // Get the values from tensors
         double price_value = price.item<double>();
@@ -361,7 +628,7 @@ void PPOHandler::publishAction(const torch::Tensor& price, const torch::Tensor&
         ActionInfo action;
         action.price = price_value;
         action.volume = volume_value;
-        action.state_id = state_buffer_.back().state_id;  // Use the newest state ID
+        action.state_id = state_ring_.newestInfo().state_id;  // Use the newest state ID
         
         // Maintain action buffer size
         if (action_buffer_.size() >= ACTION_BUFFER_SIZE) {
@@ -369,63 +636,44 @@ void PPOHandler::publishAction(const torch::Tensor& price, const torch::Tensor&
         }
         action_buffer_.push_back(action);
 
-        // 23 bytes: 1 byte action type + 8 bytes price + 8 bytes volume + 4 bytes mid-price + 2 bytes state ID
-        std::vector<char> buffer(23);
+        // 31 bytes: 1 byte action type + 8 bytes price + 8 bytes volume + 4 bytes mid-price + 2 bytes state ID
+        // + 8 bytes origin of the state
+        std::array<char, binary_utils::OMS_ACTION_V3_SIZE> buffer;
         
         // Get current mid-price from the latest state
-        double current_mid_price = state_buffer_.back().mid_price;
-        uint16_t current_state_id = state_buffer_.back().state_id;
+        double current_mid_price = state_ring_.newestInfo().mid_price;
+        uint16_t current_state_id = state_ring_.newestInfo().state_id;
         
-        // Encode action, price, volume, mid-price, and state ID using encodeOmsActionV2
-        binary_utils::encodeOmsActionV2(buffer.data(), 0, price_value, volume_value, current_mid_price, current_state_id);
+        // Encode action, price, volume, mid-price, state ID and origin using encodeOmsActionV3
+        binary_utils::encodeOmsActionV3(buffer.data(), 0, price_value, volume_value, current_mid_price, current_state_id,
+                                        state_ring_.newestInfo().origin_ns);
         
-        // Publish to RabbitMQ
-        amqp_basic_properties_t props;
-        props._flags = AMQP_BASIC_CONTENT_TYPE_FLAG | AMQP_BASIC_DELIVERY_MODE_FLAG;
-        props.content_type = amqp_cstring_bytes("application/octet-stream");
-        props.delivery_mode = 2; // persistent delivery mode
-
-        // Publish the message using direct RabbitMQ connection
-        int status = amqp_basic_publish(
-            conn_,
-            1,
-            amqp_cstring_bytes("oms"),
-            amqp_cstring_bytes("oms.action"),
-            0,
-            0,
-            &props,
-            amqp_bytes_t{buffer.size(), buffer.data()}
-        );
-
-        if (status != AMQP_STATUS_OK) {
+        // Publish to the OMS, persistent on oms.action.<instrument> or into the shared-memory ring
+        if (!action_publisher_->publish(buffer.data(), buffer.size())) {
             throw std::runtime_error("Failed to publish action");
         }
+        publish_latency_.recordSince(start_ns);
 
-        // Log the action storage
-        std::cout << "[" << getCurrentTimestamp() << "] Stored action: "
-                  << "Price=" << price_value
-                  << " Volume=" << volume_value
-                  << " MidPrice=" << current_mid_price
-                  << " StateID=" << current_state_id
-                  << " (Buffer size: " << action_buffer_.size() << ")" << std::endl;
+        // Log a sample of the stored actions, one is published per orderbook update
+        LOG_SAMPLED(ACTION_LOG_SAMPLE, Info, "Stored action: Price={} Volume={} MidPrice={} StateID={} (Buffer size: {})",
+                    price_value, volume_value, current_mid_price, current_state_id, action_buffer_.size());
 
     } catch (const std::exception& e) {
-        std::cerr << "Error publishing action: " << e.what() << std::endl;
+        LOG_ERROR("Error publishing action: {}", e.what());
     }
 }
 
-void PPOHandler::handleExecutionUpdate(const std::string& message) {
+void PPOHandler::handleExecutionUpdate(std::string_view message) {
     try {
-        auto json = nlohmann::json::parse(message);
-        std::cout << "[" << getCurrentTimestamp() << "] Execution Update:\n" 
-                  << json.dump(2) << std::endl;
+        auto json = nlohmann::json::parse(message.begin(), message.end());
+        LOG_DEBUG_STREAM << "Execution Update:\n" << json.dump(2);
 
         bool is_trade_closed = json["is_trade_closed"].get<bool>();
 
         if (is_trade_closed) {
             // Check if we have any orders before processing closure
             if (current_trade_.orders.empty() && !json.contains("filled_portions")) {
-                std::cerr << "Error: Received trade closure without any orders" << std::endl;
+                LOG_ERROR("Received trade closure without any orders");
                 return;
             }
 
@@ -450,21 +698,15 @@ void PPOHandler::handleExecutionUpdate(const std::string& message) {
             }
 
             // Log the completed trade
-            std::cout << "[" << getCurrentTimestamp() << "] Trade closed:\n"
-                      << "  Reward: " << current_trade_.reward << "\n"
-                      << "  Orders: " << current_trade_.orders.size() << "\n";
+            LOG_INFO("Trade closed: Reward: {} Orders: {}", current_trade_.reward, current_trade_.orders.size());
             for (const auto& order : current_trade_.orders) {
-                std::cout << "    OKX ID: " << order.okx_id 
-                          << ", Coefficient: " << order.coefficient 
-                          << ", States: " << order.state_ids.size()
-                          << ", Action found: " << (order.action.state_id != 0) << "\n";
+                LOG_INFO("    OKX ID: {}, Coefficient: {}, States: {}, Action found: {}",
+                         order.okx_id, order.coefficient, order.state_ids.size(), order.action.state_id != 0);
             }
 
-            // Update networks with completed trade before resetting
+            // Hand the completed trade to the learner before resetting
             if (!current_trade_.orders.empty()) {
-                std::cout << "[" << getCurrentTimestamp() << "] Starting network update..." << std::endl;
-                updateNetworks(current_trade_);
-                std::cout << "[" << getCurrentTimestamp() << "] Network update completed" << std::endl;
+                enqueueTraining(current_trade_);
             }
 
             // Reset trade for next one
@@ -472,7 +714,7 @@ void PPOHandler::handleExecutionUpdate(const std::string& message) {
         } else {
             // For non-closure updates, we still need state_id and okx_id
             if (!json.contains("state_id") || !json.contains("okx_id")) {
-                std::cerr << "Error: Missing required fields in execution update" << std::endl;
+                LOG_ERROR("Missing required fields in execution update");
                 return;
             }
 
@@ -484,31 +726,21 @@ void PPOHandler::handleExecutionUpdate(const std::string& message) {
                 [&okx_id](const OrderInfo& order) { return order.okx_id == okx_id; });
             
             if (existing_order != current_trade_.orders.end()) {
-                std::cout << "Warning: Duplicate order update received for OKX ID: " << okx_id << std::endl;
+                LOG_WARN("Duplicate order update received for OKX ID: {}", okx_id);
                 return;
             }
 
             // Handle single order update
             OrderInfo order;
             
-            // Handle state ID wraparound and range calculation
+            // State IDs are uint16 and wrap from 65535 to 0, so plain uint16 arithmetic handles it
             std::vector<uint16_t> state_sequence;
-            uint16_t start_state_id;
-            
-            if (state_id >= NETWORK_INPUT_SIZE) {
-                start_state_id = state_id - NETWORK_INPUT_SIZE + 1;
-            } else {
-                // Handle wraparound
-                uint16_t wraparound_start = std::numeric_limits<uint16_t>::max() - 
-                    (NETWORK_INPUT_SIZE - state_id - 1);
-                start_state_id = wraparound_start;
-            }
+            const uint16_t start_state_id = static_cast<uint16_t>(state_id - (NETWORK_INPUT_SIZE - 1));
 
             // Collect state sequence
             bool has_all_states = true;
             for (uint16_t i = 0; i < NETWORK_INPUT_SIZE; ++i) {
-                uint16_t current_state = (start_state_id + i) % std::numeric_limits<uint16_t>::max();
-                state_sequence.push_back(current_state);
+                state_sequence.push_back(static_cast<uint16_t>(start_state_id + i));
             }
 
             order.state_ids = state_sequence;
@@ -522,9 +754,9 @@ void PPOHandler::handleExecutionUpdate(const std::string& message) {
             }
 
             if (matching_actions.empty()) {
-                std::cout << "Warning: No matching action found for state ID: " << state_id << std::endl;
+                LOG_WARN("No matching action found for state ID: {}", state_id);
             } else if (matching_actions.size() > 1) {
-                std::cout << "Warning: Multiple actions found for state ID: " << state_id << std::endl;
+                LOG_WARN("Multiple actions found for state ID: {}", state_id);
             } else {
                 order.action = matching_actions[0];
             }
@@ -535,15 +767,12 @@ void PPOHandler::handleExecutionUpdate(const std::string& message) {
             // Add to current trade
             current_trade_.orders.push_back(order);
 
-            std::cout << "[" << getCurrentTimestamp() << "] Added order to trade:\n"
-                      << "  OKX ID: " << order.okx_id 
-                      << ", States: " << order.state_ids.size()
-                      << ", Action found: " << (order.action.state_id != 0)
-                      << ", Complete state sequence: " << has_all_states << "\n";
+            LOG_INFO("Added order to trade: OKX ID: {}, States: {}, Action found: {}, Complete state sequence: {}",
+                     order.okx_id, order.state_ids.size(), order.action.state_id != 0, has_all_states);
         }
 
     } catch (const std::exception& e) {
-        std::cerr << "Error parsing execution update: " << e.what() << std::endl;
+        LOG_ERROR("Error parsing execution update: {}", e.what());
     }
 }
 
@@ -555,84 +784,87 @@ std::string PPOHandler::getCurrentTimestamp() const {
     return ss.str();
 }
 
-void PPOHandler::updateNetworks(const TradeInfo& completed_trade) {
-    // Store trade in training buffer
-    training_buffer_.push_back(completed_trade);
-    if (training_buffer_.size() > MAX_TRAINING_BUFFER_SIZE) {
-        training_buffer_.erase(training_buffer_.begin());
-    }
-
-    // Enter training mode
-    actor_->train();
-    critic_->train();
-
+void PPOHandler::updateNetworks(const LearnerJob& job) {
     try {
-        // Get states and compute values
-        auto states = getStatesFromTrade(completed_trade);
-        auto values = getValuesFromStates(states);
-        
-        // Get action probabilities that were used during execution
-        auto [old_price_probs, old_volume_probs] = getProbabilitiesFromStates(states);
-        
-        // Extract coefficients
-        std::vector<double> coefficients;
-        coefficients.reserve(completed_trade.orders.size());
-        for (const auto& order : completed_trade.orders) {
-            coefficients.push_back(order.coefficient);
+        auto options = torch::TensorOptions().dtype(torch::kFloat64).device(device_);
+        auto new_states = torch::cat(job.states).to(device_);  // [n, 80, 2421], gathered on the host
+        auto new_coefficients = torch::tensor(job.coefficients, options);
+
+        // Record the trade's samples with the policy outputs they are clipped against
+        {
+            torch::NoGradGuard no_grad;
+            actor_->eval();
+            auto [old_price, old_volume] = getProbabilitiesFromStates(new_states);
+            replay_.add(new_states, new_coefficients * job.trade.reward, new_coefficients, old_price, old_volume);
         }
-        
-        // Compute advantages using coefficients
-        auto advantages = computeAdvantages(states, values, coefficients, completed_trade.reward);
-        
-        // PPO training loop
+
+        // Enter training mode
+        actor_->train();
+        critic_->train();
+
+        const int64_t samples = static_cast<int64_t>(replay_.size());
+        const int64_t batch_size = mini_batch_size_;
+        auto states = replay_.states();
+        auto targets = replay_.targets();
+
+        // Advantages against the critic before this update, fixed for all epochs
+        torch::Tensor advantages;
+        {
+            torch::NoGradGuard no_grad;
+            std::vector<torch::Tensor> values;
+            for (int64_t start = 0; start < samples; start += batch_size) {
+                values.push_back(getValuesFromStates(states.narrow(0, start, std::min(batch_size, samples - start))));
+            }
+            advantages = computeAdvantages(torch::cat(values), targets);
+        }
+
+        // PPO training loop over shuffled minibatches of the whole replay
         for (int epoch = 0; epoch < ppo_epochs_; ++epoch) {
-            // Get current probabilities
-            auto [new_price_probs, new_volume_probs] = getProbabilitiesFromStates(states);
-            
-            // Compute returns for value function
-            auto returns = advantages + torch::stack(values);
-            
-            // Compute losses
-            auto policy_loss = computePPOLoss(advantages, old_price_probs, old_volume_probs,
-                                            new_price_probs, new_volume_probs, coefficients);
-            auto value_loss = computeValueLoss(torch::stack(values), returns, coefficients);
-            auto entropy_loss = computeEntropyLoss(new_price_probs, new_volume_probs, coefficients);
-            
-            // Total loss
-            auto total_loss = policy_loss + value_coef_ * value_loss - entropy_coef_ * entropy_loss;
-            
-            // Optimize
-            actor_optimizer_->zero_grad();
-            critic_optimizer_->zero_grad();
-            total_loss.backward();
-            actor_optimizer_->step();
-            critic_optimizer_->step();
+            auto order = torch::randperm(samples, torch::TensorOptions().dtype(torch::kInt64).device(device_));
+            for (int64_t start = 0; start < samples; start += batch_size) {
+                auto idx = order.narrow(0, start, std::min(batch_size, samples - start));
+                auto batch_states = states.index_select(0, idx);
+                auto batch_coefficients = replay_.coefficients().index_select(0, idx);
+                auto batch_advantages = advantages.index_select(0, idx);
+
+                // Get current probabilities and values
+                auto [new_price_probs, new_volume_probs] = getProbabilitiesFromStates(batch_states);
+                auto batch_values = getValuesFromStates(batch_states);
+
+                // Compute losses; the value target is the coefficient-weighted trade reward
+                auto policy_loss = computePPOLoss(batch_advantages,
+                                                  replay_.oldPrice().index_select(0, idx),
+                                                  replay_.oldVolume().index_select(0, idx),
+                                                  new_price_probs, new_volume_probs, batch_coefficients);
+                auto value_loss = computeValueLoss(batch_values, targets.index_select(0, idx), batch_coefficients);
+                auto entropy_loss = computeEntropyLoss(new_price_probs, new_volume_probs, batch_coefficients);
+
+                // Total loss
+                auto total_loss = policy_loss + value_coef_ * value_loss - entropy_coef_ * entropy_loss;
+
+                // Optimize
+                actor_optimizer_->zero_grad();
+                critic_optimizer_->zero_grad();
+                total_loss.backward();
+                actor_optimizer_->step();
+                critic_optimizer_->step();
+            }
         }
     } catch (const std::exception& e) {
-        std::cerr << "Error during network update: " << e.what() << std::endl;
+        LOG_ERROR("Error during network update: {}", e.what());
     }
 
     // Return to eval mode
     actor_->eval();
     critic_->eval();
+
+    // The decision copies are refreshed by the learner loop
+    weights_pending_ = true;
 }
 
-torch::Tensor PPOHandler::computeAdvantages(
-    const std::vector<torch::Tensor>& states,
-    const std::vector<torch::Tensor>& values,
-    const std::vector<double>& coefficients,
-    double reward) {
-    
-    auto device = states[0].device();
-    auto advantages = torch::zeros({static_cast<long>(states.size())}, 
-                                 torch::TensorOptions().dtype(torch::kFloat64).device(device));
-    
-    // Compute weighted advantages
-    for (size_t i = 0; i < states.size(); ++i) {
-        advantages[i] = reward * coefficients[i] - values[i].item<double>();
-    }
-    
-    return advantages;
+torch::Tensor PPOHandler::computeAdvantages(const torch::Tensor& values, const torch::Tensor& targets) {
+    // Coefficient-weighted reward minus the critic's estimate, for every sample at once
+    return targets - values;
 }
 
 torch::Tensor PPOHandler::computePPOLoss(
@@ -641,11 +873,7 @@ torch::Tensor PPOHandler::computePPOLoss(
     const torch::Tensor& old_volume_probs,
     const torch::Tensor& new_price_probs,
     const torch::Tensor& new_volume_probs,
-    const std::vector<double>& coefficients) {
-    
-    auto device = advantages.device();
-    auto coeff_tensor = torch::tensor(coefficients, 
-                                    torch::TensorOptions().dtype(torch::kFloat64).device(device));
+    const torch::Tensor& coefficients) {
     
     // Compute probability ratios
     auto price_ratio = new_price_probs / old_price_probs;
@@ -660,69 +888,45 @@ torch::Tensor PPOHandler::computePPOLoss(
     auto volume_loss = -torch::min(volume_ratio * advantages, volume_clipped * advantages);
     
     // Apply coefficients and mean
-    return ((price_loss + volume_loss) * coeff_tensor.unsqueeze(1)).mean();
+    return ((price_loss + volume_loss) * coefficients).mean();
 }
 
 torch::Tensor PPOHandler::computeValueLoss(
     const torch::Tensor& values,
     const torch::Tensor& returns,
-    const std::vector<double>& coefficients) {
-    
-    auto device = values.device();
-    auto coeff_tensor = torch::tensor(coefficients, 
-                                    torch::TensorOptions().dtype(torch::kFloat64).device(device));
+    const torch::Tensor& coefficients) {
     
     // MSE loss weighted by coefficients
     auto value_loss = torch::pow(values - returns, 2);
-    return (value_loss * coeff_tensor.unsqueeze(1)).mean();
+    return (value_loss * coefficients).mean();
 }
 
 torch::Tensor PPOHandler::computeEntropyLoss(
     const torch::Tensor& price_probs,
     const torch::Tensor& volume_probs,
-    const std::vector<double>& coefficients) {
-    
-    auto device = price_probs.device();
-    auto coeff_tensor = torch::tensor(coefficients, 
-                                    torch::TensorOptions().dtype(torch::kFloat64).device(device));
+    const torch::Tensor& coefficients) {
     
     // Compute entropy for both heads
     auto price_entropy = -(price_probs * torch::log(price_probs + 1e-10));
     auto volume_entropy = -(volume_probs * torch::log(volume_probs + 1e-10));
     
     // Weight by coefficients and mean
-    return ((price_entropy + volume_entropy) * coeff_tensor.unsqueeze(1)).mean();
+    return ((price_entropy + volume_entropy) * coefficients).mean();
 }
 
-std::vector<torch::Tensor> PPOHandler::getStatesFromTrade(const TradeInfo& trade) {
+std::vector<torch::Tensor> PPOHandler::getStatesFromTrade(const TradeInfo& trade, std::vector<double>& coefficients) {
     std::vector<torch::Tensor> states;
     states.reserve(trade.orders.size());
+    coefficients.clear();
     
     for (const auto& order : trade.orders) {
-        // Reconstruct state tensor from state IDs
-        std::vector<double> features;
-        features.reserve(OrderBookState::TOTAL_FEATURES * NETWORK_INPUT_SIZE);
-        
-        // Find states in buffer by IDs
-        for (auto state_id : order.state_ids) {
-            auto state_it = std::find_if(state_buffer_.begin(), state_buffer_.end(),
-                [state_id](const OrderBookState& state) { return state.state_id == state_id; });
-            
-            if (state_it != state_buffer_.end()) {
-                features.insert(features.end(), state_it->bids.begin(), state_it->bids.end());
-                features.insert(features.end(), state_it->asks.begin(), state_it->asks.end());
-                features.push_back(state_it->mid_price_change);
-                features.insert(features.end(), state_it->features.begin(), state_it->features.end());
-            }
-        }
-        
-        // Create tensor
-        if (features.size() == OrderBookState::TOTAL_FEATURES * NETWORK_INPUT_SIZE) {
-            states.push_back(torch::from_blob(
-                features.data(),
-                {1, NETWORK_INPUT_SIZE, OrderBookState::TOTAL_FEATURES},
-                torch::TensorOptions().dtype(torch::kFloat64)
-            ).clone());
+        if (order.state_ids.size() != NETWORK_INPUT_SIZE) continue;
+
+        // Copied out of the ring by ID lookup, since the ring keeps being overwritten
+        auto window = state_ring_.windowEndingAt(order.state_ids.back());
+        if (window.defined()) {
+            states.push_back(std::move(window));
+            coefficients.push_back(order.coefficient);  // Stays aligned with states when orders are skipped
         }
     }
     
@@ -746,159 +950,48 @@ std::tuple<torch::Tensor, torch::Tensor> PPOHandler::getActionsFromTrade(const T
     );
 }
 
-std::vector<torch::Tensor> PPOHandler::getValuesFromStates(const std::vector<torch::Tensor>& states) {
-    std::vector<torch::Tensor> values;
-    values.reserve(states.size());
-    
-    for (const auto& state : states) {
-        values.push_back(critic_->forward(state));
-    }
-    
-    return values;
+torch::Tensor PPOHandler::getValuesFromStates(const torch::Tensor& states) {
+    // One batched forward: [B, 80, 2421] -> [B]
+    return critic_->forward(states).squeeze(1);
 }
 
-std::tuple<torch::Tensor, torch::Tensor> PPOHandler::getProbabilitiesFromStates(
-    const std::vector<torch::Tensor>& states) {
-    
-    std::vector<torch::Tensor> price_probs, volume_probs;
-    price_probs.reserve(states.size());
-    volume_probs.reserve(states.size());
-    
-    for (const auto& state : states) {
-        auto [price, volume] = actor_->forward(state);
-        price_probs.push_back(price);
-        volume_probs.push_back(volume);
-    }
-    
-    return std::make_tuple(
-        torch::stack(price_probs),
-        torch::stack(volume_probs)
-    );
-}
-
-std::string PPOHandler::getModelPath() const {
-    return MODEL_DIR + "/ppo_model.pt";
+std::tuple<torch::Tensor, torch::Tensor> PPOHandler::getProbabilitiesFromStates(const torch::Tensor& states) {
+    // One batched forward: [B, 80, 2421] -> [B] per head
+    auto [price, volume] = actor_->forward(states);
+    return std::make_tuple(price.squeeze(1), volume.squeeze(1));
 }
 
 void PPOHandler::saveModel(const std::string& reason) {
     try {
-        // Create a serialization archive
-        torch::serialize::OutputArchive archive;
-        
-        // Save actor state
-        archive.write("actor", actor_->parameters());
-        
-        // Save critic state
-        archive.write("critic", critic_->parameters());
-        
-        // Save optimizer states
-        std::vector<torch::Tensor> actor_optim_params;
-        std::vector<torch::Tensor> critic_optim_params;
-        
-        for (const auto& param_group : actor_optimizer_->param_groups()) {
-            for (const auto& p : param_group.params()) {
-                if (p.grad().defined()) {
-                    actor_optim_params.push_back(p.grad().clone());
-                }
-            }
-        }
-        
-        for (const auto& param_group : critic_optimizer_->param_groups()) {
-            for (const auto& p : param_group.params()) {
-                if (p.grad().defined()) {
-                    critic_optim_params.push_back(p.grad().clone());
-                }
-            }
-        }
-        
-        archive.write("actor_optim", actor_optim_params);
-        archive.write("critic_optim", critic_optim_params);
-        
-        // Save to file
-        archive.save_to(getModelPath());
-        
-        std::cout << "[" << getCurrentTimestamp() << "] Model saved (" << reason << ")" << std::endl;
+        // Only the host copy is taken here; the checkpointer thread serializes and writes it
+        CheckpointSnapshot snapshot;
+        snapshot.actor = snapshotNetwork(*actor_optimizer_);
+        snapshot.critic = snapshotNetwork(*critic_optimizer_);
+        snapshot.reason = reason;
+        checkpointer_.write(std::move(snapshot));
     } catch (const std::exception& e) {
-        std::cerr << "Error saving model: " << e.what() << std::endl;
+        LOG_ERROR("Error saving model: {}", e.what());
         throw;
     }
 }
 
 bool PPOHandler::loadModel() {
     try {
-        if (!std::filesystem::exists(getModelPath())) {
+        // Parameters and Adam moments of the newest readable checkpoint
+        auto snapshot = checkpointer_.loadNewest();
+        if (!snapshot) {
             return false;
         }
-        
-        // Load archive
-        torch::serialize::InputArchive archive;
-        archive.load_from(getModelPath());
-        
-        // Create temporary IValues for reading
-        c10::IValue actor_ivalue;
-        c10::IValue critic_ivalue;
-        c10::IValue actor_optim_ivalue;
-        c10::IValue critic_optim_ivalue;
-        
-        // Read values into IValues
-        archive.read("actor", actor_ivalue);
-        archive.read("critic", critic_ivalue);
-        archive.read("actor_optim", actor_optim_ivalue);
-        archive.read("critic_optim", critic_optim_ivalue);
-        
-        // Convert IValues to tensor vectors
-        std::vector<torch::Tensor> actor_params = actor_ivalue.toTensorVector();
-        std::vector<torch::Tensor> critic_params = critic_ivalue.toTensorVector();
-        std::vector<torch::Tensor> actor_optim_params = actor_optim_ivalue.toTensorVector();
-        std::vector<torch::Tensor> critic_optim_params = critic_optim_ivalue.toTensorVector();
-        
-        // Apply parameters to networks
-        auto actor_params_it = actor_params.begin();
-        for (auto& param : actor_->parameters()) {
-            if (actor_params_it != actor_params.end()) {
-                param.data().copy_(*actor_params_it++);
-            }
-        }
-        
-        auto critic_params_it = critic_params.begin();
-        for (auto& param : critic_->parameters()) {
-            if (critic_params_it != critic_params.end()) {
-                param.data().copy_(*critic_params_it++);
-            }
-        }
-        
-        // Apply gradients to optimizers
-        auto actor_optim_it = actor_optim_params.begin();
-        for (auto& param_group : actor_optimizer_->param_groups()) {
-            for (auto& p : param_group.params()) {
-                if (actor_optim_it != actor_optim_params.end()) {
-                    if (!p.grad().defined()) {
-                        p.mutable_grad() = torch::zeros_like(p);
-                    }
-                    p.mutable_grad().copy_(*actor_optim_it++);
-                }
-            }
-        }
-        
-        auto critic_optim_it = critic_optim_params.begin();
-        for (auto& param_group : critic_optimizer_->param_groups()) {
-            for (auto& p : param_group.params()) {
-                if (critic_optim_it != critic_optim_params.end()) {
-                    if (!p.grad().defined()) {
-                        p.mutable_grad() = torch::zeros_like(p);
-                    }
-                    p.mutable_grad().copy_(*critic_optim_it++);
-                }
-            }
-        }
-        
+        restoreNetwork(snapshot->actor, *actor_optimizer_);
+        restoreNetwork(snapshot->critic, *critic_optimizer_);
+
         // Ensure models are in eval mode
         actor_->eval();
         critic_->eval();
-        
+
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "Error loading model: " << e.what() << std::endl;
+        LOG_ERROR("Error loading model: {}", e.what());
         return false;
     }
 } 
\ No newline at end of file